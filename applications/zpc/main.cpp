@@ -325,5 +325,7 @@ int main(int argc, char **argv)
         sl_log_warning(LOG_TAG.data(), "Some components failed to shutdown properly: %d\n", shutdown_errors);
     }
 
+    // Write out what the async log sink still holds before exiting
+    sl_log_flush();
     return shutdown_errors;
 }
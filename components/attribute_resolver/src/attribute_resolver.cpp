@@ -50,6 +50,20 @@ namespace
 {
     // A stack of node that need either Set or Get resolution
     std::deque<std::pair<attribute_store_node_t, uint32_t>> stack;
+    // Subtree roots waiting to be scanned, in the order they were requested.
+    // ready_nodes mirrors ready_queue so that a node is only queued once.
+    std::deque<attribute_store_node_t> ready_queue;
+    std::unordered_set<attribute_store_node_t> ready_nodes;
+    // Nodes that could not be resolved when visited because they wait for
+    // their own (or their group's) resolution. They are queued again when
+    // they get updated or when that resolution completes.
+    std::unordered_set<attribute_store_node_t> deferred_nodes;
+    // Nodes that could not be resolved when visited because the rule slot or
+    // the send function was busy, in the order they were deferred.
+    // slot_waiting_nodes mirrors slot_waiting_queue so that a node is only
+    // queued once. One of them is queued again each time the slot frees up.
+    std::deque<attribute_store_node_t> slot_waiting_queue;
+    std::unordered_set<attribute_store_node_t> slot_waiting_nodes;
     // A list of nodes that are paused and should not be resolved until they are resumed.
     std::unordered_set<attribute_store_node_t> paused_nodes;
     // List of callbacks to invoke when a resolution has been performed on a subtree.
@@ -91,8 +105,8 @@ static std::map<attribute_store_node_t, uint8_t> rearm_after_completion;
 // Has a full scan of the attribute store been requested
 static std::atomic<bool> scan_requested;
 
-// Protects pending_get_resolutions, pending_set_resolutions, stack, and
-// paused_nodes from concurrent access across the resolver thread, attribute
+// Protects pending_get_resolutions, pending_set_resolutions, stack,
+// ready_queue, deferred_nodes, slot_waiting_queue and paused_nodes from concurrent access across the resolver thread, attribute
 // store callbacks, and TX-complete callbacks.  Recursive because several
 // code-paths re-enter (e.g. give_up_get_resolution_on_group triggers
 // attribute store callbacks that call on_resolver_node_update).
@@ -138,12 +152,36 @@ static bool is_node_under_resolution(attribute_store_node_t node);
 static bool is_node_get_resolution_max_retries_reached(attribute_store_node_t node);
 
 /**
- * @brief This function traverses the stack and set the child_index of the common parent to 0.
- *        This enables the attribute resolver to scan updated attribute node.
+ * @brief Pops the next subtree root from the ready queue and pushes it
+ *        on the stack.
  *
- * @param node  Attribute node
+ * @returns true if a node was pushed on the stack, false if the ready queue
+ *          is empty.
+ */
+static bool load_next_ready_node();
+
+/**
+ * @brief Moves a deferred node back to the ready queue, if it was deferred.
+ */
+static void requeue_deferred_node(attribute_store_node_t node);
+
+/**
+ * @brief Removes the oldest node waiting for the rule slot from its queue.
+ *
+ * @returns The node, ATTRIBUTE_STORE_INVALID_NODE if no node is waiting for
+ *          the rule slot.
+ */
+static attribute_store_node_t pop_next_slot_waiting_node();
+
+/**
+ * @brief Pushes the oldest node waiting for the rule slot on the stack, as
+ *        long as budget allows it.
+ *
+ * @param budget  Number of nodes that may still be loaded, decremented for
+ *                each node loaded.
+ * @returns true if a node was pushed on the stack, false otherwise.
  */
-static void set_common_parent_stack_index_zero(attribute_store_node_t node);
+static bool load_next_slot_waiting_node(size_t &budget);
 
 /**
  * @brief This function traverses the list of nodes pending a get resolution
@@ -160,8 +198,8 @@ static void attribute_resolver_restart_pending_get_nodes_timer();
 static void attribute_resume_expired_pending_get_nodes();
 
 /**
- * @brief Ensures that a node gets scanned, as part of the current
- *        scan or by starting a new scan.
+ * @brief Ensures that a node and its subtree get scanned, by adding it to
+ *        the ready queue.
  */
 static void scan_node(attribute_store_node_t node_to_scan);
 
@@ -406,6 +444,7 @@ void attribute_resolver_state_log()
 {
     std::lock_guard<std::recursive_mutex> lock(resolver_mutex);
     sl_log_debug(LOG_TAG, "Scan Requested: %d", scan_requested.load());
+    sl_log_debug(LOG_TAG, "Ready queue: %zu nodes, deferred: %zu nodes, waiting for the rule slot: %zu nodes", ready_queue.size(), deferred_nodes.size(), slot_waiting_queue.size());
     if (stack.empty()) {
         sl_log_debug(LOG_TAG, "Stack is empty");
     } else {
@@ -633,10 +672,17 @@ static sl_status_t execute_set(attribute_store_node_t node)
  *      C   D
  *
  * The execution order will be: C D B E A
+ *
+ * When the stack runs empty, the next subtree root is taken from the ready
+ * queue, so only subtrees that were reported as changed get visited.
  */
 static void resolver_find_next_resolve()
 {
-    while (!stack.empty()) {
+    // If the nodes visited in this pass leave the rule slot free, give the
+    // nodes waiting for it a chance, at most once each so that nodes
+    // deferred again do not get revisited forever.
+    size_t slot_waiting_budget = slot_waiting_queue.size();
+    while (!stack.empty() || load_next_ready_node() || load_next_slot_waiting_node(slot_waiting_budget)) {
         attribute_store_node_t node = stack.back().first;
         uint32_t index              = stack.back().second;
 
@@ -690,6 +736,7 @@ static void resolver_find_next_resolve()
 
             if (rule_status == SL_STATUS_IS_WAITING) {
                 sl_log_debug(LOG_TAG, "Attribute ID %d resolution is working. Skipping\n", node);
+                deferred_nodes.insert(node);
                 continue;
             }
 
@@ -698,6 +745,9 @@ static void resolver_find_next_resolve()
                              "Send function is not ready to send. "
                              "Skipping attribute ID %d resolution.\n",
                              node);
+                if (slot_waiting_nodes.insert(node).second) {
+                    slot_waiting_queue.push_back(node);
+                }
                 continue;
             }
 
@@ -793,6 +843,10 @@ static void on_resolver_node_update(attribute_store_node_t updated_node, attribu
         set_retry_cooldown_until_.erase(updated_node);
     }
 
+    // If this node was skipped earlier waiting on its own state, it may be
+    // resolvable now.
+    requeue_deferred_node(updated_node);
+
     // See if we need to scan something.
     // if somebody is waiting for a resolution notification, (possibly above the current node)
     // ensure that the node gets scanned again
@@ -814,7 +868,9 @@ static void on_resolver_node_deleted(attribute_store_node_t node)
     pending_set_resolutions.erase(node);
     set_retry_cooldown_until_.erase(node);
     rearm_after_completion.erase(node);
-    // Don't remove the node from the stack, the stack will
+    deferred_nodes.erase(node);
+    slot_waiting_nodes.erase(node);
+    // Don't remove the node from the stack or the ready queue, they will
     // detect missing nodes.
     // Tell the Resolver Rule part to stop waiting for a callback for deleted nodes.
     attribute_resolver_rule_abort(node);
@@ -866,16 +922,52 @@ static attribute_store_node_t get_highest_parent_with_resolution_listener(attrib
     return parent_with_listener;
 }
 
-static void set_common_parent_stack_index_zero(attribute_store_node_t node)
+static bool load_next_ready_node()
 {
-    for (attribute updated_node = node; updated_node.is_valid(); updated_node = updated_node.parent()) {
-        for (uint16_t i = 0; i < stack.size(); i++) {
-            if (stack[i].first == updated_node) {
-                stack[i].second = 0;
-                return;
-            }
+    while (!ready_queue.empty()) {
+        attribute_store_node_t node = ready_queue.front();
+        ready_queue.pop_front();
+        ready_nodes.erase(node);
+        if (attribute_store_node_exists(node)) {
+            stack.push_back(std::pair<attribute_store_node_t, int>(node, 0));
+            return true;
         }
     }
+    return false;
+}
+
+static void requeue_deferred_node(attribute_store_node_t node)
+{
+    if (deferred_nodes.erase(node) > 0) {
+        scan_node(node);
+    }
+}
+
+static attribute_store_node_t pop_next_slot_waiting_node()
+{
+    while (!slot_waiting_queue.empty()) {
+        attribute_store_node_t node = slot_waiting_queue.front();
+        slot_waiting_queue.pop_front();
+        // Nodes deleted meanwhile are no longer in slot_waiting_nodes
+        if (slot_waiting_nodes.erase(node) > 0 && attribute_store_node_exists(node)) {
+            return node;
+        }
+    }
+    return ATTRIBUTE_STORE_INVALID_NODE;
+}
+
+static bool load_next_slot_waiting_node(size_t &budget)
+{
+    if (budget == 0) {
+        return false;
+    }
+    attribute_store_node_t node = pop_next_slot_waiting_node();
+    if (node == ATTRIBUTE_STORE_INVALID_NODE) {
+        return false;
+    }
+    budget--;
+    stack.push_back(std::pair<attribute_store_node_t, int>(node, 0));
+    return true;
 }
 
 static void scan_node(attribute_store_node_t node_to_scan)
@@ -883,13 +975,18 @@ static void scan_node(attribute_store_node_t node_to_scan)
     if (node_to_scan == ATTRIBUTE_STORE_INVALID_NODE) {
         return;
     }
-    // Adjust the in-progress scan so the node is revisited.
-    if (!stack.empty()) {
-        set_common_parent_stack_index_zero(node_to_scan);
+    // A full scan is pending, it will visit this node anyway.
+    if (scan_requested) {
+        return;
+    }
+    if (!ready_nodes.insert(node_to_scan).second) {
+        return;
     }
+    ready_queue.push_back(node_to_scan);
 
-    if (!scan_requested) {
-        scan_requested = true;
+    // Wake up the resolver if it is idle. If a scan is in progress, the ready
+    // queue gets drained when the stack runs empty.
+    if (ready_queue.size() == 1 && stack.empty()) {
         zwave_component::attribute_resolver_handler::attribute_resolver_event_data ev_data;
         ev_data.event = zwave_component::attribute_resolver_handler::attribute_resolver_event_t::NEXT_EVENT;
         ev_data.data  = std::any {};
@@ -1014,6 +1111,22 @@ void on_resolver_rule_execute_complete(attribute_store_node_t node, clock_time_t
     std::lock_guard<std::recursive_mutex> lock(resolver_mutex);
     (void)transmission_time;
 
+    // A resolution that went to the network finished. Nodes of its group
+    // skipped while it was ongoing get another chance, and the rule slot is
+    // free again for the oldest node waiting for it.
+    if (is_node_under_resolution(node)) {
+        requeue_deferred_node(node);
+        if (!deferred_nodes.empty()) {
+            for (attribute_store_node_t group_node: attribute_resolver_rule_get_group_nodes(RESOLVER_GET_RULE, node)) {
+                requeue_deferred_node(group_node);
+            }
+            for (attribute_store_node_t group_node: attribute_resolver_rule_get_group_nodes(RESOLVER_SET_RULE, node)) {
+                requeue_deferred_node(group_node);
+            }
+        }
+        scan_node(pop_next_slot_waiting_node());
+    }
+
     // Get rule is complete, check if we want to wait for a retry.
     // Use a fixed get_retry_timeout only — do not add transmission_time.
     // Airtime can be inflated (S2 send-data timer expiry, rule timeout using
@@ -1091,7 +1204,7 @@ void on_resolver_rule_execute_complete(attribute_store_node_t node, clock_time_t
     }
 
     // Process the next element in our scan
-    if (!stack.empty()) {
+    if (!stack.empty() || !ready_queue.empty()) {
         zwave_component::attribute_resolver_handler::attribute_resolver_event_data ev_data;
         ev_data.event = zwave_component::attribute_resolver_handler::attribute_resolver_event_t::NEXT_EVENT;
         ev_data.data  = std::any {};
@@ -1174,6 +1287,11 @@ sl_status_t attribute_resolver_init(attribute_resolver_config_t resolver_config)
     set_retry_cooldown_until_.clear();
     rearm_after_completion.clear();
     stack.clear();
+    ready_queue.clear();
+    ready_nodes.clear();
+    deferred_nodes.clear();
+    slot_waiting_queue.clear();
+    slot_waiting_nodes.clear();
     timer_stop(&pending_get_resume_timer);
     scan_requested = true;
 
@@ -1206,6 +1324,11 @@ int attribute_resolver_teardown()
     set_retry_cooldown_until_.clear();
     rearm_after_completion.clear();
     stack.clear();
+    ready_queue.clear();
+    ready_nodes.clear();
+    deferred_nodes.clear();
+    slot_waiting_queue.clear();
+    slot_waiting_nodes.clear();
     // The thread is stopped in main.cpp cleanup
     return 0;
 }
@@ -1225,7 +1348,15 @@ static void attribute_resolver_ev_next()
     if (stack.empty() && scan_requested) {
         sl_log_debug(LOG_TAG, "Starting scan from the top");
         scan_requested = false;
+        // The full scan covers everything that was queued or deferred.
+        ready_queue.clear();
+        ready_nodes.clear();
+        deferred_nodes.clear();
+    slot_waiting_queue.clear();
+    slot_waiting_nodes.clear();
         stack.push_back(std::pair<attribute_store_node_t, int>(attribute_store_get_root(), 0));
+    } else if (stack.empty()) {
+        load_next_ready_node();
     }
     // Find next node to resolve
     if (!attribute_resolver_rule_busy()) {
@@ -1234,11 +1365,10 @@ static void attribute_resolver_ev_next()
         sl_log_debug(LOG_TAG, "Scan blocked: rule busy tid=%lu", sl_log_thread_id());
     }
 
-    // A scan may have been requested (via scan_node) while we were busy or
-    // while an earlier scan was in progress.  If the scan has now finished
-    // but the request is still pending, schedule another pass so it is not
-    // silently dropped.
-    if (stack.empty() && scan_requested) {
+    // A scan may have been requested while we were busy or while an earlier
+    // scan was in progress.  If the scan has now finished but the request is
+    // still pending, schedule another pass so it is not silently dropped.
+    if (stack.empty() && (scan_requested || !ready_queue.empty())) {
         zwave_component::attribute_resolver_handler::attribute_resolver_event_data ev_data;
         ev_data.event = zwave_component::attribute_resolver_handler::attribute_resolver_event_t::NEXT_EVENT;
         ev_data.data  = std::any {};
@@ -65,6 +65,16 @@ void attribute_store_configuration_set_auto_save_safety_interval(unsigned int se
  */
 void attribute_store_configuration_set_auto_save_cooldown_interval(unsigned int seconds);
 
+/**
+ * @brief Configures how often the Attribute Store writes a snapshot of the
+ * whole tree next to the datastore, used to speed up the next start-up.
+ * A snapshot is always written at teardown.
+ * @param seconds  Minimum interval in seconds between two snapshots written
+ *                 after a save to the datastore. The value 0 indicates to
+ *                 only write a snapshot at teardown.
+ */
+void attribute_store_configuration_set_snapshot_interval(unsigned int seconds);
+
 #ifdef __cplusplus
 }
 #endif
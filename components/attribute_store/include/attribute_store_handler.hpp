@@ -18,11 +18,22 @@
 #include "threading.hpp"
 #include "init_builder.hpp"
 #include "sl_status.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <string>
 
 namespace zwave_component
 {
-    class attribute_store_handler : public Initializable
+    /**
+     * @brief Attribute Store process, owning the persistence thread.
+     *
+     * Auto-save requests are committed to the datastore from this thread, so
+     * that SQLite I/O never runs on the shared timer thread. The datastore WAL
+     * is checkpointed from here too, once no save happened for a while.
+     */
+    class attribute_store_handler : public threading::threading, public Initializable
     {
         public:
             attribute_store_handler();
@@ -32,6 +43,29 @@ namespace zwave_component
             sl_status_t initialize() override;
             int shutdown() override;
             std::string name() const override;
+
+            void start() override;
+
+            /**
+             * @brief Request a save of the Attribute Store on the persistence
+             * thread. Saves synchronously if the thread is not running.
+             */
+            static void request_save();
+
+        private:
+            void run() override;
+            void wake() override;
+            std::mutex save_mutex;
+            std::condition_variable save_condition;
+            /// Set by request_save() until the persistence thread picks it up
+            bool save_requested = false;
+            /// Set while the persistence thread takes save requests
+            std::atomic<bool> accepting_requests {false};
+            /// Set after a save, until the WAL was checkpointed
+            bool checkpoint_pending = false;
+            std::chrono::steady_clock::time_point last_save_time;
+            constexpr static std::chrono::seconds idle_checkpoint_delay = std::chrono::seconds(2);
+            static attribute_store_handler *instance;
     };
 }  // namespace zwave_component
 
@@ -0,0 +1,63 @@
+/******************************************************************************
+ * # License
+ * <b>Copyright 2025 Silicon Laboratories Inc. www.silabs.com</b>
+ ******************************************************************************
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ *****************************************************************************/
+
+/**
+ * @defgroup attribute_store_statistics Attribute Store Statistics
+ * @ingroup attribute_store_api
+ * @brief Runtime metrics of the Attribute Store persistence
+ *
+ * @{
+ */
+
+#ifndef ATTRIBUTE_STORE_STATISTICS_H
+#define ATTRIBUTE_STORE_STATISTICS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Metrics of the Attribute Store saves to the datastore.
+ */
+typedef struct {
+        /// Number of saves committed to the datastore
+        uint32_t save_count;
+        /// Duration of the last save, in milliseconds
+        uint32_t last_save_duration_ms;
+        /// Longest save duration observed, in milliseconds
+        uint32_t max_save_duration_ms;
+        /// Number of attributes written by the last save
+        uint32_t last_saved_attributes;
+        /// Number of attributes deleted by the last save
+        uint32_t last_deleted_attributes;
+        /// Number of modified attributes currently waiting for a save
+        uint32_t pending_save_attributes;
+        /// Number of deleted attributes currently waiting for a save
+        uint32_t pending_deletion_attributes;
+} attribute_store_persistence_statistics_t;
+
+/**
+ * @brief Read the current persistence metrics of the Attribute Store.
+ *
+ * @param statistics Pointer where the metrics will be copied.
+ */
+void attribute_store_get_persistence_statistics(attribute_store_persistence_statistics_t *statistics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ATTRIBUTE_STORE_STATISTICS_H
+/** @} end attribute_store_statistics */
@@ -22,13 +22,16 @@
 #include "attribute_store_configuration_internal.h"
 #include "attribute_store_validation.h"
 #include "attribute_store_process.h"
+#include "attribute_store_statistics.h"
+#include "attribute_store_snapshot.h"
 
 // Generic includes
 #include <stdbool.h>
-#include <map>
+#include <chrono>
 #include <mutex>
 #include <set>
 #include <queue>
+#include <random>
 #include <string.h>
 #include <assert.h>
 
@@ -37,6 +40,7 @@
 #include "sl_status.h"
 #include "datastore.h"
 #include "datastore_attributes.h"
+#include "datastore_checkpoint.h"
 
 /// Setup Log tag
 constexpr char LOG_TAG[] = "attribute_store";
@@ -47,9 +51,9 @@ namespace
     // The base of our attribute store tree
     attribute_store_node *root_node = nullptr;
 
-    // Map between ids and pointers for speedy identification
+    // Direct-indexed table between ids and pointers for speedy identification
     // instead of using node->find_id
-    std::map<attribute_store_node_t, attribute_store_node *> id_node_map;
+    attribute_store_node_table id_node_map;
 
     // List of attribute store nodes that we have added/modified, that are not
     // saved yet in the datastore.
@@ -69,9 +73,51 @@ namespace
     // callbacks, because callbacks may acquire resolver_mutex -- holding both
     // in the opposite order would deadlock with the resolver thread.
     std::recursive_mutex attribute_store_mutex;
+
+    // Serialises all attribute writes to the datastore (shared prepared
+    // statements and transactions). It may be taken while holding
+    // attribute_store_mutex, but never the other way around.
+    std::mutex attribute_store_datastore_mutex;
+
+    // Serialises complete save cycles (snapshot + commit), so that two saves
+    // cannot commit their snapshots out of order. Must never be taken while
+    // holding attribute_store_mutex.
+    std::mutex attribute_store_save_mutex;
+
+    // Copy of a modified node, taken under attribute_store_mutex so that it can
+    // be committed to the datastore without holding the lock.
+    struct attribute_store_snapshot_entry {
+            attribute_store_node_t id;
+            attribute_store_type_t type;
+            attribute_store_node_t parent_id;
+            size_t reported_value_offset;
+            uint8_t reported_value_size;
+            size_t desired_value_offset;
+            uint8_t desired_value_size;
+    };
+
+    // Persistence metrics, protected by attribute_store_mutex.
+    attribute_store_persistence_statistics_t persistence_statistics = {};
+
+    // Path of the tree snapshot next to the datastore, empty if not used.
+    std::string snapshot_path;
+    // Generation of the attributes in the datastore, saved along with them.
+    // A snapshot is only valid for the generation it was written for, the
+    // generation is bumped by the first write that follows a snapshot.
+    // Both protected by attribute_store_datastore_mutex.
+    int64_t datastore_generation    = 0;
+    bool snapshot_matches_datastore = false;
+    // Random identity of the datastore, saved along with the attributes. The
+    // generation restarts from 0 in every new datastore, so a snapshot must
+    // also carry the identity of its datastore. 0 if there is none.
+    int64_t datastore_identity = 0;
+    // When the last snapshot was written, protected by attribute_store_save_mutex.
+    std::chrono::steady_clock::time_point last_snapshot_time;
 }  // namespace
 
-constexpr char DATASTORE_LAST_ASSIGNED_ID_KEY[] = "attribute_store_last_assigned_id";
+constexpr char DATASTORE_LAST_ASSIGNED_ID_KEY[]      = "attribute_store_last_assigned_id";
+constexpr char DATASTORE_SNAPSHOT_GENERATION_KEY[] = "attribute_store_snapshot_generation";
+constexpr char DATASTORE_IDENTITY_KEY[]            = "attribute_store_datastore_identity";
 
 ///////////////////////////////////////////////////////////////////////////////
 // Private helper functions
@@ -104,6 +150,21 @@ static attribute_store_node_t attribute_store_get_next_id()
     return last_assigned_id;
 }
 
+/**
+ * @brief Makes the snapshot stale before the datastore attributes get modified.
+ *
+ * Must be called with attribute_store_datastore_mutex held, in the same
+ * transaction as the modification if there is one.
+ */
+static void attribute_store_invalidate_snapshot()
+{
+    if (snapshot_matches_datastore) {
+        datastore_generation++;
+        datastore_store_int(DATASTORE_SNAPSHOT_GENERATION_KEY, datastore_generation);
+        snapshot_matches_datastore = false;
+    }
+}
+
 /**
  * @brief Decides if we push attribute modifications directly to the datastore
  * or add it in the pending queue
@@ -114,8 +175,12 @@ static attribute_store_node_t attribute_store_get_next_id()
 static void attribute_store_store_attribute(attribute_store_node *node)
 {
     if (node == root_node) {
+        std::lock_guard<std::mutex> datastore_lock(attribute_store_datastore_mutex);
+        attribute_store_invalidate_snapshot();
         STORE_ROOT_ATTRIBUTE(root_node);
     } else if (attribute_store_get_auto_save_cooldown_interval() == 0) {
+        std::lock_guard<std::mutex> datastore_lock(attribute_store_datastore_mutex);
+        attribute_store_invalidate_snapshot();
         STORE_ATTRIBUTE(node);
         node_id_never_saved.erase(node->id);
     } else {
@@ -139,11 +204,10 @@ static attribute_store_node *attribute_store_get_node_from_id(attribute_store_no
         return nullptr;
     }
 
-    // Look into our ID map.
-    std::map<attribute_store_node_t, attribute_store_node *>::iterator it;
-    it = id_node_map.find(id);
-    if (it != id_node_map.end()) {
-        return it->second;
+    // Look into our ID table.
+    attribute_store_node *node = id_node_map.find(id);
+    if (node != nullptr) {
+        return node;
     }
 
     // Else if we get here, we did not find the ID using our map.
@@ -152,7 +216,7 @@ static attribute_store_node *attribute_store_get_node_from_id(attribute_store_no
     attribute_store_node *found_node = root_node->find_id(id);
 
     if (found_node != nullptr) {
-        id_node_map[id] = found_node;
+        id_node_map.insert(id, found_node);
         sl_log_error(LOG_TAG,
                      "Attribute store Map got out-of-sync with the attribute store tree. "
                      "Please verify that the map gets correctly updated at any tree update!");
@@ -177,15 +241,12 @@ static attribute_store_node *attribute_store_get_node_from_id(attribute_store_no
  */
 static bool attribute_store_is_value_identical(const attribute_store_node *node, attribute_store_node_value_state_t value_state, const uint8_t *value, uint8_t value_size)
 {
-    // Make a vector our of the received uint8_t array:
-    std::vector<uint8_t> received_value(value, value + value_size);
-
-    // Compare our received vector with the right value state
+    // Compare the received buffer with the right value state
     if (value_state == REPORTED_ATTRIBUTE) {
-        return node->reported_value == received_value;
+        return node->reported_value.equals(value, value_size);
     }
     if (value_state == DESIRED_ATTRIBUTE) {
-        return node->desired_value == received_value;
+        return node->desired_value.equals(value, value_size);
     }
 
     // value state was invalid
@@ -227,17 +288,11 @@ static sl_status_t attribute_store_load_all_nodes_from_datastore()
         node_links.push_back({received_attribute.parent_id, received_attribute.id});
 
         // Push the data into the node
-        node->reported_value.resize(received_attribute.reported_value_size);
-        if (received_attribute.reported_value_size > 0) {
-            node->reported_value.assign(received_attribute.reported_value, received_attribute.reported_value + received_attribute.reported_value_size);
-        }
-        node->desired_value.resize(received_attribute.desired_value_size);
-        if (received_attribute.desired_value_size > 0) {
-            node->desired_value.assign(received_attribute.desired_value, received_attribute.desired_value + received_attribute.desired_value_size);
-        }
+        node->reported_value.assign(received_attribute.reported_value, received_attribute.reported_value_size);
+        node->desired_value.assign(received_attribute.desired_value, received_attribute.desired_value_size);
 
         // We just created a node, keep the local map updated
-        id_node_map[node->id] = node;
+        id_node_map.insert(node->id, node);
 
         // Get the next attribute
         datastore_status = datastore_fetch_all_attributes(&received_attribute);
@@ -269,47 +324,143 @@ static sl_status_t attribute_store_load_all_nodes_from_datastore()
 }
 
 /**
- * @brief Takes a node, saves it and all its children in
- * the datastore from the "in-memory" attribute store.
+ * @brief Reads the identity of the datastore, creating one if it has none.
  *
- * @param node  Pointer to the in memory object where to copy the data.
- *
- * @returns SL_STATUS_OK if the node and its subtree have been loaded
- * @returns SL_STATUS_FAIL if an error occurred.
+ * If no identity can be saved, it stays 0 and no snapshot is used.
  */
-static sl_status_t attribute_store_save_node_to_datastore(attribute_store_node *node)
+static void attribute_store_load_datastore_identity()
 {
-    if (node == nullptr) {
-        sl_log_error(LOG_TAG, "Attempting to save data from a NULL pointer. Ignoring");
-        return SL_STATUS_FAIL;
+    datastore_identity = 0;
+    if (datastore_fetch_int(DATASTORE_IDENTITY_KEY, &datastore_identity) == SL_STATUS_OK && datastore_identity != 0) {
+        return;
+    }
+    std::random_device random_device;
+    std::uniform_int_distribution<int64_t> distribution(1, INT64_MAX);
+    int64_t identity = distribution(random_device);
+    if (datastore_store_int(DATASTORE_IDENTITY_KEY, identity) == SL_STATUS_OK) {
+        datastore_identity = identity;
+    } else {
+        datastore_identity = 0;
     }
+}
 
-    // Save the node first, then its children:
-    sl_status_t save_status = SL_STATUS_OK;
-    if (node->parent_node == nullptr) {
-        // This is the root, no parent
-        save_status = STORE_ROOT_ATTRIBUTE(node);
-    } else if (node_id_pending_save.contains(node->id)) {
-        save_status = STORE_ATTRIBUTE(node);
-        node_id_pending_save.erase(node->id);
+/**
+ * @brief Loads the Attribute Store from the snapshot, if it matches the
+ * datastore.
+ *
+ * Must only be called while the tree holds nothing but the root node.
+ *
+ * @returns SL_STATUS_OK   If the Attribute Store was loaded from the snapshot.
+ * @returns any other value if the datastore must be used instead.
+ */
+static sl_status_t attribute_store_load_all_nodes_from_snapshot()
+{
+    auto start_time    = std::chrono::steady_clock::now();
+    sl_status_t status = attribute_store_snapshot_load(snapshot_path, datastore_identity, datastore_generation, root_node, id_node_map);
+    if (status != SL_STATUS_OK) {
+        return status;
     }
+    snapshot_matches_datastore = true;
+    sl_log_info(LOG_TAG,
+                "Loaded %d attributes from the snapshot in %d ms.",
+                id_node_map.size(),
+                static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count()));
 
-    if (save_status != SL_STATUS_OK) {
-        sl_log_error(LOG_TAG, "Error saving Attribute ID %d. Aborting", node->id);
-        attribute_store_log_node(node->id, false);
-        return save_status;
+    // Invoke callbacks on our brand new tree
+    attribute_store_refresh_node_and_children_callbacks(root_node->id);
+    return SL_STATUS_OK;
+}
+
+/**
+ * @brief Writes a snapshot of the tree, if one is due and the tree matches
+ * the datastore.
+ *
+ * Must be called with attribute_store_save_mutex held, after a save.
+ *
+ * @param forced  Write the snapshot regardless of the snapshot interval.
+ */
+static void attribute_store_write_snapshot(bool forced)
+{
+    if (snapshot_path.empty() || datastore_identity == 0) {
+        return;
+    }
+    auto now              = std::chrono::steady_clock::now();
+    unsigned int interval = attribute_store_get_snapshot_interval();
+    bool interval_elapsed = (interval > 0) && (now - last_snapshot_time >= std::chrono::seconds(interval));
+    if (!forced && !interval_elapsed) {
+        return;
     }
 
-    // Save all children next
-    for (uint32_t i = 0; i < node->child_nodes.size(); i++) {
-        save_status = attribute_store_save_node_to_datastore(node->child_nodes.at(i));
-        if (save_status != SL_STATUS_OK) {
-            sl_log_error(LOG_TAG, "Error saving children of Attribute ID %d. Aborting", node->id);
-            attribute_store_log_node(node->child_nodes.at(i)->id, false);
-            return save_status;
+    attribute_store_snapshot_image image;
+    int64_t generation;
+    {
+        std::lock_guard<std::recursive_mutex> lock(attribute_store_mutex);
+        // Modifications not saved yet would make the snapshot differ from the
+        // datastore. Try again after the next save.
+        if (root_node == nullptr || !node_id_pending_save.empty() || !node_id_pending_deletion.empty()) {
+            return;
+        }
+        std::lock_guard<std::mutex> datastore_lock(attribute_store_datastore_mutex);
+        if (snapshot_matches_datastore) {
+            // Nothing was written since the last snapshot.
+            return;
         }
+        generation = datastore_generation + 1;
+        if (datastore_store_int(DATASTORE_SNAPSHOT_GENERATION_KEY, generation) != SL_STATUS_OK) {
+            return;
+        }
+        datastore_generation       = generation;
+        snapshot_matches_datastore = true;
+        attribute_store_snapshot_capture(root_node, image);
+    }
+
+    // A snapshot that could not be written does not need invalidating, the
+    // file left behind, if any, has an older generation.
+    last_snapshot_time = now;
+    if (attribute_store_snapshot_write(snapshot_path, image, datastore_identity, generation) != SL_STATUS_OK) {
+        std::lock_guard<std::mutex> datastore_lock(attribute_store_datastore_mutex);
+        if (datastore_generation == generation) {
+            snapshot_matches_datastore = false;
+        }
+    }
+}
+
+/**
+ * @brief Copies a node pending save into the snapshot, after any of its
+ * ancestors that are also pending save.
+ *
+ * The datastore enforces that parents exist before their children, so the
+ * snapshot is built in parent-before-child order by walking up the chain of
+ * modified ancestors, which costs O(depth) per modified node instead of a
+ * traversal of the whole tree.
+ *
+ * @param id        ID of the node pending save.
+ * @param entries   Snapshot entries to append to.
+ * @param values    Buffer holding the snapshot values.
+ */
+static void attribute_store_snapshot_pending_node(attribute_store_node_t id, std::vector<attribute_store_snapshot_entry> &entries, std::vector<uint8_t> &values)
+{
+    node_id_pending_save.erase(id);
+    const attribute_store_node *node = id_node_map.find(id);
+    if (node == nullptr || node->parent_node == nullptr) {
+        return;
+    }
+
+    if (node_id_pending_save.contains(node->parent_node->id)) {
+        attribute_store_snapshot_pending_node(node->parent_node->id, entries, values);
     }
-    return save_status;
+
+    attribute_store_snapshot_entry entry = {};
+    entry.id                             = node->id;
+    entry.type                           = node->type;
+    entry.parent_id                      = node->parent_node->id;
+    entry.reported_value_offset          = values.size();
+    entry.reported_value_size            = node->reported_value.size();
+    values.insert(values.end(), node->reported_value.data(), node->reported_value.data() + node->reported_value.size());
+    entry.desired_value_offset = values.size();
+    entry.desired_value_size   = node->desired_value.size();
+    values.insert(values.end(), node->desired_value.data(), node->desired_value.data() + node->desired_value.size());
+    entries.push_back(entry);
 }
 
 /**
@@ -320,21 +471,25 @@ static sl_status_t attribute_store_save_node_to_datastore(attribute_store_node *
  */
 static sl_status_t attribute_store_delete_pending_deletions_from_datastore()
 {
-    sl_status_t aggregated_status = SL_STATUS_OK;
+    std::vector<attribute_store_node_t> node_ids_to_delete;
+    node_ids_to_delete.reserve(node_id_pending_deletion.size());
     while (!node_id_pending_deletion.empty()) {
         attribute_store_node_t node_id_to_delete = node_id_pending_deletion.front();
-        sl_status_t deletion_status              = SL_STATUS_OK;
         if (!node_id_never_saved.contains(node_id_to_delete)) {
-            deletion_status = datastore_delete_attribute(node_id_to_delete);
-        }
-        if (SL_STATUS_OK != deletion_status) {
-            sl_log_error(LOG_TAG, "Could not delete ID %d from the datastore.", node_id_to_delete);
+            node_ids_to_delete.push_back(node_id_to_delete);
         }
-        aggregated_status |= deletion_status;
         node_id_pending_deletion.pop();
     }
 
-    return aggregated_status;
+    std::lock_guard<std::mutex> datastore_lock(attribute_store_datastore_mutex);
+    if (!node_ids_to_delete.empty()) {
+        attribute_store_invalidate_snapshot();
+    }
+    sl_status_t deletion_status = datastore_delete_attributes(node_ids_to_delete.data(), node_ids_to_delete.size());
+    if (SL_STATUS_OK != deletion_status) {
+        sl_log_error(LOG_TAG, "Could not delete %d attributes from the datastore.", node_ids_to_delete.size());
+    }
+    return deletion_status;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -355,15 +510,23 @@ sl_status_t attribute_store_init(void)
 
         // Add the root as our first node in the id map:
         id_node_map.clear();
-        id_node_map[root_node->id] = root_node;
+        id_node_map.insert(root_node->id, root_node);
+
+        snapshot_path              = attribute_store_snapshot_path(datastore_get_file_path());
+        datastore_generation       = 0;
+        snapshot_matches_datastore = false;
+        datastore_fetch_int(DATASTORE_SNAPSHOT_GENERATION_KEY, &datastore_generation);
+        attribute_store_load_datastore_identity();
 
-        // Load the root data and all its children from the datastore, in case it's there.
+        // Load the root data and all its children from the snapshot or the datastore, in case it's there.
         // Do not reload from SQLite if root_node was already allocated.
-        sl_log_info(LOG_TAG, "Loading Attribute Store data from the datastore.");
-        if (attribute_store_load_all_nodes_from_datastore() != SL_STATUS_OK) {
-            sl_log_info(LOG_TAG,
-                        "Attribute Store data could not be loaded from the datastore. "
-                        "Starting with an empty Attribute Store.");
+        if (attribute_store_load_all_nodes_from_snapshot() != SL_STATUS_OK) {
+            sl_log_info(LOG_TAG, "Loading Attribute Store data from the datastore.");
+            if (attribute_store_load_all_nodes_from_datastore() != SL_STATUS_OK) {
+                sl_log_info(LOG_TAG,
+                            "Attribute Store data could not be loaded from the datastore. "
+                            "Starting with an empty Attribute Store.");
+            }
         }
 
         // Print how much was loaded from the datastore.
@@ -379,6 +542,7 @@ sl_status_t attribute_store_init(void)
 
     if (nullptr != root_node) {
         // Save the root in the datastore:
+        std::lock_guard<std::mutex> datastore_lock(attribute_store_datastore_mutex);
         STORE_ROOT_ATTRIBUTE(root_node);
         return SL_STATUS_OK;
     }
@@ -389,16 +553,22 @@ sl_status_t attribute_store_init(void)
 
 int attribute_store_teardown(void)
 {
-    std::lock_guard<std::recursive_mutex> lock(attribute_store_mutex);
     sl_log_debug(LOG_TAG, "Teardown of the attribute store");
+    // make a last save in the datastore. This must happen before taking
+    // attribute_store_mutex (see attribute_store_save_mutex)
+    attribute_store_save_to_datastore();
+    {
+        // Make the next start-up fast.
+        std::lock_guard<std::mutex> save_lock(attribute_store_save_mutex);
+        attribute_store_write_snapshot(true);
+    }
+
+    std::lock_guard<std::recursive_mutex> lock(attribute_store_mutex);
     // Remove all registered callbacks
     attribute_store_callbacks_teardown();
     // Erase our record of registered types
     attribute_store_reset_registered_attribute_types();
 
-    // make a last save in the datastore
-    attribute_store_save_to_datastore();
-
     // Clear up our map
     id_node_map.clear();
 
@@ -417,29 +587,99 @@ int attribute_store_teardown(void)
 ///////////////////////////////////////////////////////////////////////////////
 sl_status_t attribute_store_save_to_datastore()
 {
-    std::lock_guard<std::recursive_mutex> lock(attribute_store_mutex);
-    if (root_node != nullptr) {
-        sl_status_t res = SL_STATUS_OK;
-        if ((!node_id_pending_save.empty()) || (!node_id_pending_deletion.empty())) {
-            datastore_start_transaction();
-            sl_log_debug(LOG_TAG, "Saving %d attributes to the datastore. ", node_id_pending_save.size());
-            res |= attribute_store_save_node_to_datastore(root_node);
-            sl_log_debug(LOG_TAG, "Deleting %d attributes from the datastore. ", node_id_pending_deletion.size());
-            res |= attribute_store_delete_pending_deletions_from_datastore();
+    std::lock_guard<std::mutex> save_lock(attribute_store_save_mutex);
+    auto start_time = std::chrono::steady_clock::now();
+
+    // Take a consistent snapshot of the changes, so that the datastore commit
+    // does not block the other users of the Attribute Store.
+    std::vector<attribute_store_snapshot_entry> entries;
+    std::vector<uint8_t> values;
+    std::vector<attribute_store_node_t> node_ids_to_delete;
+    attribute_store_node_t root_id = ATTRIBUTE_STORE_INVALID_NODE;
+    attribute_store_type_t root_type;
+    std::vector<uint8_t> root_reported_value;
+    std::vector<uint8_t> root_desired_value;
+    attribute_store_node_t last_assigned_id_snapshot;
+    {
+        std::lock_guard<std::recursive_mutex> lock(attribute_store_mutex);
+        if (root_node == nullptr) {
+            log_attribute_store_not_initialized();
+            return SL_STATUS_FAIL;
+        }
 
-            // Save the last assigned ID:
-            datastore_store_int(DATASTORE_LAST_ASSIGNED_ID_KEY, static_cast<int64_t>(last_assigned_id));
+        if ((!node_id_pending_save.empty()) || (!node_id_pending_deletion.empty())) {
+            root_id   = root_node->id;
+            root_type = root_node->type;
+            root_reported_value.assign(root_node->reported_value.data(), root_node->reported_value.data() + root_node->reported_value.size());
+            root_desired_value.assign(root_node->desired_value.data(), root_node->desired_value.data() + root_node->desired_value.size());
+
+            entries.reserve(node_id_pending_save.size());
+            while (!node_id_pending_save.empty()) {
+                attribute_store_snapshot_pending_node(*node_id_pending_save.begin(), entries, values);
+            }
 
-            datastore_commit_transaction();
+            node_ids_to_delete.reserve(node_id_pending_deletion.size());
+            while (!node_id_pending_deletion.empty()) {
+                if (!node_id_never_saved.contains(node_id_pending_deletion.front())) {
+                    node_ids_to_delete.push_back(node_id_pending_deletion.front());
+                }
+                node_id_pending_deletion.pop();
+            }
         }
-        // Mark that we have no node never saved.
+        last_assigned_id_snapshot = last_assigned_id;
+        // Everything never saved so far is now part of the snapshot.
         node_id_never_saved.clear();
-        // Tell the process we made a fresh back-up.
-        attribute_store_process_on_attribute_store_saved();
-        return res;
     }
-    log_attribute_store_not_initialized();
-    return SL_STATUS_FAIL;
+
+    sl_status_t res = SL_STATUS_OK;
+    if (root_id != ATTRIBUTE_STORE_INVALID_NODE) {
+        std::lock_guard<std::mutex> datastore_lock(attribute_store_datastore_mutex);
+        datastore_start_transaction();
+        attribute_store_invalidate_snapshot();
+        sl_log_debug(LOG_TAG, "Saving %d attributes to the datastore. ", entries.size());
+        std::vector<datastore_attribute_entry_t> rows;
+        rows.reserve(entries.size() + 1);
+        rows.push_back({root_id, root_type, ATTRIBUTE_STORE_NULL_ID, root_reported_value.data(), static_cast<uint8_t>(root_reported_value.size()), root_desired_value.data(), static_cast<uint8_t>(root_desired_value.size())});
+        for (const auto &entry: entries) {
+            rows.push_back({entry.id,
+                            entry.type,
+                            entry.parent_id,
+                            values.data() + entry.reported_value_offset,
+                            entry.reported_value_size,
+                            values.data() + entry.desired_value_offset,
+                            entry.desired_value_size});
+        }
+        res |= datastore_store_attributes(rows.data(), rows.size());
+        sl_log_debug(LOG_TAG, "Deleting %d attributes from the datastore. ", node_ids_to_delete.size());
+        res |= datastore_delete_attributes(node_ids_to_delete.data(), node_ids_to_delete.size());
+
+        // Save the last assigned ID:
+        datastore_store_int(DATASTORE_LAST_ASSIGNED_ID_KEY, static_cast<int64_t>(last_assigned_id_snapshot));
+
+        datastore_commit_transaction();
+    }
+
+    uint32_t duration_ms = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count());
+    {
+        std::lock_guard<std::recursive_mutex> lock(attribute_store_mutex);
+        persistence_statistics.save_count++;
+        persistence_statistics.last_save_duration_ms   = duration_ms;
+        persistence_statistics.max_save_duration_ms    = std::max(persistence_statistics.max_save_duration_ms, duration_ms);
+        persistence_statistics.last_saved_attributes   = static_cast<uint32_t>(entries.size());
+        persistence_statistics.last_deleted_attributes = static_cast<uint32_t>(node_ids_to_delete.size());
+    }
+
+    attribute_store_write_snapshot(false);
+
+    // Tell the process we made a fresh back-up.
+    attribute_store_process_on_attribute_store_saved();
+    return res;
+}
+
+sl_status_t attribute_store_checkpoint_datastore()
+{
+    std::lock_guard<std::mutex> datastore_lock(attribute_store_datastore_mutex);
+    return datastore_checkpoint_if_idle();
 }
 
 sl_status_t attribute_store_load_from_datastore()
@@ -504,7 +744,7 @@ attribute_store_node_t attribute_store_add_node(attribute_store_type_t type, att
         new_node                       = parent->add_child(type, attribute_store_get_next_id());
 
         if (new_node != nullptr) {
-            id_node_map[new_node->id] = new_node;
+            id_node_map.insert(new_node->id, new_node);
             node_id_never_saved.insert(new_node->id);
             attribute_store_store_attribute(new_node);
             new_id = new_node->id;
@@ -577,8 +817,10 @@ sl_status_t attribute_store_delete_node(attribute_store_node_t id)
 
     if (is_root) {
         std::lock_guard<std::recursive_mutex> lock(attribute_store_mutex);
-        root_node->reported_value.resize(0);
-        root_node->desired_value.resize(0);
+        root_node->reported_value.clear();
+        root_node->desired_value.clear();
+        std::lock_guard<std::mutex> datastore_lock(attribute_store_datastore_mutex);
+        attribute_store_invalidate_snapshot();
         STORE_ROOT_ATTRIBUTE(root_node);
     } else {
         {
@@ -703,18 +945,12 @@ sl_status_t attribute_store_set_node_attribute_value(attribute_store_node_t id,
             attribute_store_log_attribute_type_information(node_to_modify->type);
             return SL_STATUS_FAIL;
         } else if (value_state == DESIRED_ATTRIBUTE) {
-            node_to_modify->desired_value.resize(value_size);
-            if (value_size > 0) {
-                node_to_modify->desired_value.assign(value, value + value_size);
-            }
+            node_to_modify->desired_value.assign(value, value_size);
             cb_id   = node_to_modify->id;
             cb_type = node_to_modify->type;
             attribute_store_store_attribute(node_to_modify);
         } else if (value_state == REPORTED_ATTRIBUTE) {
-            node_to_modify->reported_value.resize(value_size);
-            if (value_size > 0) {
-                node_to_modify->reported_value.assign(value, value + value_size);
-            }
+            node_to_modify->reported_value.assign(value, value_size);
             cb_id   = node_to_modify->id;
             cb_type = node_to_modify->type;
             attribute_store_store_attribute(node_to_modify);
@@ -817,7 +1053,7 @@ attribute_store_node_t attribute_store_get_node_child(attribute_store_node_t id,
         // Ensure the child node is in the map - this can happen if nodes are added
         // directly to the tree structure (e.g., during datastore loading or callbacks)
         if (!id_node_map.contains(child_node->id)) {
-            id_node_map[child_node->id] = child_node;
+            id_node_map.insert(child_node->id, child_node);
         }
         return child_node->id;
     }
@@ -1015,22 +1251,18 @@ attribute_store_node_t attribute_store_get_node_child_by_value(attribute_store_n
         if (node_to_read->child_nodes.at(i)->type == child_type) {
             // Attribute ID is matching, compare the value:
             if (value_state == DESIRED_ATTRIBUTE) {
-                if (node_to_read->child_nodes.at(i)->desired_value.size() == value_size) {
-                    if (0 == memcmp(value, node_to_read->child_nodes.at(i)->desired_value.data(), value_size)) {
-                        if (child_counter == child_index) {
-                            return node_to_read->child_nodes.at(i)->id;
-                        }
-                        child_counter++;
+                if (node_to_read->child_nodes.at(i)->desired_value.equals(value, value_size)) {
+                    if (child_counter == child_index) {
+                        return node_to_read->child_nodes.at(i)->id;
                     }
+                    child_counter++;
                 }
             } else if (value_state == REPORTED_ATTRIBUTE) {
-                if (node_to_read->child_nodes.at(i)->reported_value.size() == value_size) {
-                    if (0 == memcmp(value, node_to_read->child_nodes.at(i)->reported_value.data(), value_size)) {
-                        if (child_counter == child_index) {
-                            return node_to_read->child_nodes.at(i)->id;
-                        }
-                        child_counter++;
+                if (node_to_read->child_nodes.at(i)->reported_value.equals(value, value_size)) {
+                    if (child_counter == child_index) {
+                        return node_to_read->child_nodes.at(i)->id;
                     }
+                    child_counter++;
                 }
             }
         }
@@ -1062,6 +1294,17 @@ sl_status_t attribute_store_refresh_node_and_children_callbacks(attribute_store_
     return SL_STATUS_OK;
 }
 
+void attribute_store_get_persistence_statistics(attribute_store_persistence_statistics_t *statistics)
+{
+    if (statistics == nullptr) {
+        return;
+    }
+    std::lock_guard<std::recursive_mutex> lock(attribute_store_mutex);
+    *statistics                             = persistence_statistics;
+    statistics->pending_save_attributes     = static_cast<uint32_t>(node_id_pending_save.size());
+    statistics->pending_deletion_attributes = static_cast<uint32_t>(node_id_pending_deletion.size());
+}
+
 void attribute_store_log()
 {
     std::lock_guard<std::recursive_mutex> lock(attribute_store_mutex);
@@ -16,9 +16,13 @@
 #include "attribute_store_callbacks.h"
 
 // Generic includes
+#include <array>
+#include <atomic>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <set>
+#include <unordered_map>
 #include <vector>
 
 // Includes from other components
@@ -43,12 +47,43 @@ using attribute_store_value_callback_setting_t = std::pair<attribute_store_type_
 ///////////////////////////////////////////////////////////////////////////////
 namespace
 {
-    // A stack of node that need either Set or Get resolution
+    /**
+     * @brief Callbacks registered for one attribute type.
+     */
+    struct type_dispatch_t {
+            /// Invoked for any change of a node of this type
+            std::vector<attribute_store::node_changed_callback> callbacks;
+            /// Invoked for changes of a given value state, indexed by value state
+            std::array<std::vector<attribute_store::node_changed_callback>, DESIRED_OR_REPORTED_ATTRIBUTE + 1> value_callbacks;
+    };
+
+    /**
+     * @brief Immutable view of all registered callbacks, used for dispatch.
+     *
+     * Registrations only mark the registry stale, so that the many
+     * registrations done at start-up do not rebuild it each time. The first
+     * invocation after them builds it in one pass and swaps it in. Other
+     * invocations load the current registry without locking, copying or
+     * allocating, and keep it alive while handlers run, so handlers may
+     * register callbacks (which apply from the next change on).
+     */
+    struct callback_registry_t {
+            std::vector<attribute_store_node_update_callback_t> generic_callbacks;
+            std::vector<attribute_store_node_touch_callback_t> touch_generic_callbacks;
+            std::vector<attribute_store_node_delete_callback_t> delete_callbacks;
+            std::unordered_map<attribute_store_type_t, type_dispatch_t> type_dispatch;
+    };
+
     // Protects all callback containers below. Register/clear operations hold the lock
-    // for the full mutation. Invoke functions hold it only long enough to snapshot the
-    // container, then release before calling handlers (same pattern as component_connector).
+    // for the full mutation and mark the registry stale before releasing it.
+    // Invoke functions only take it to rebuild a stale registry.
     std::mutex callbacks_mutex;
 
+    // Registry used by the invoke functions, rebuilt from the containers below.
+    std::atomic<std::shared_ptr<const callback_registry_t>> registry {std::make_shared<const callback_registry_t>()};
+    // Set when the containers changed since the registry was built.
+    std::atomic<bool> registry_stale {false};
+
     // We have 4 lists of callback functions.
 
     // 1. For any modification in the attribute store
@@ -79,6 +114,119 @@ namespace
     // we keep track of C functions that are registered for value callbacks
     std::map<attribute_store_value_callback_setting_t, std::set<attribute_store_node_changed_callback_t>> c_node_value_callbacks;
 
+    /**
+     * @brief Check that a value state can index type_dispatch_t::value_callbacks
+     */
+    bool is_dispatched_value_state(attribute_store_node_value_state_t value_state)
+    {
+        return static_cast<size_t>(value_state) < std::tuple_size_v<decltype(type_dispatch_t::value_callbacks)>;
+    }
+
+    /**
+     * @brief Build a registry from the callback containers and make it the one
+     * used by the invoke functions. callbacks_mutex must be held.
+     */
+    void publish_registry()
+    {
+        auto new_registry = std::make_shared<callback_registry_t>();
+        new_registry->type_dispatch.reserve(type_callbacks.size() + value_callbacks.size());
+        new_registry->generic_callbacks.assign(generic_callbacks.begin(), generic_callbacks.end());
+        new_registry->touch_generic_callbacks.assign(touch_generic_callbacks.begin(), touch_generic_callbacks.end());
+        new_registry->delete_callbacks.assign(delete_callbacks.begin(), delete_callbacks.end());
+        for (const auto &[type, callbacks]: type_callbacks) {
+            new_registry->type_dispatch[type].callbacks = callbacks;
+        }
+        for (const auto &[setting, callbacks]: value_callbacks) {
+            if (is_dispatched_value_state(setting.second)) {
+                new_registry->type_dispatch[setting.first].value_callbacks[setting.second] = callbacks;
+            }
+        }
+        registry.store(std::move(new_registry), std::memory_order_release);
+        registry_stale.store(false, std::memory_order_release);
+    }
+
+    /**
+     * @brief Make the invoke functions rebuild the registry before their next
+     * dispatch. callbacks_mutex must be held.
+     */
+    void invalidate_registry()
+    {
+        registry_stale.store(true, std::memory_order_release);
+    }
+
+    /**
+     * @brief Get the registry to dispatch from, rebuilding it first if
+     * callbacks were registered or cleared since it was built.
+     */
+    std::shared_ptr<const callback_registry_t> load_registry()
+    {
+        if (registry_stale.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lk(callbacks_mutex);
+            if (registry_stale.load(std::memory_order_relaxed)) {
+                publish_registry();
+            }
+        }
+        return registry.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Clear all callback containers. callbacks_mutex must be held.
+     */
+    void clear_callbacks()
+    {
+        generic_callbacks.clear();
+        type_callbacks.clear();
+        delete_callbacks.clear();
+        value_callbacks.clear();
+        touch_generic_callbacks.clear();
+        c_node_changed_callbacks.clear();
+        c_node_value_callbacks.clear();
+        invalidate_registry();
+    }
+
+    const type_dispatch_t *find_type_dispatch(const callback_registry_t &current, attribute_store_type_t type)
+    {
+        auto it = current.type_dispatch.find(type);
+        return (it != current.type_dispatch.end()) ? &it->second : nullptr;
+    }
+
+    void invoke_generic_callbacks(const callback_registry_t &current, attribute_changed_event_t *change_event)
+    {
+        for (const auto &callback_function: current.generic_callbacks) {
+            callback_function(change_event);
+        }
+    }
+
+    /**
+     * @brief Invoke the type callbacks, then the type and value state callbacks.
+     */
+    void invoke_type_callbacks(const callback_registry_t &current,
+                               attribute_store_node_t updated_node,
+                               attribute_store_type_t type,
+                               attribute_store_node_value_state_t value_state,
+                               attribute_store_change_t change)
+    {
+        const type_dispatch_t *dispatch = find_type_dispatch(current, type);
+        if (dispatch == nullptr) {
+            return;
+        }
+        for (const auto &callback_function: dispatch->callbacks) {
+            callback_function(updated_node, change);
+        }
+        if (is_dispatched_value_state(value_state)) {
+            for (const auto &callback_function: dispatch->value_callbacks[value_state]) {
+                callback_function(updated_node, change);
+            }
+        }
+    }
+
+    void invoke_delete_callbacks(const callback_registry_t &current, attribute_store_node_t deleted_node)
+    {
+        for (const auto &callback_function: current.delete_callbacks) {
+            callback_function(deleted_node);
+        }
+    }
+
 }  // namespace
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -93,91 +241,59 @@ void attribute_store_invoke_callbacks(attribute_store_node_t updated_node, attri
 {
     attribute_changed_event_t change_event = {.updated_node = updated_node, .type = type, .value_state = value_state, .change = change};
 
-    attribute_store_invoke_generic_callbacks(&change_event);
-    attribute_store_invoke_type_callbacks(updated_node, type, change);
-    attribute_store_invoke_value_callbacks(updated_node, type, value_state, change);
+    const auto current = load_registry();
+    invoke_generic_callbacks(*current, &change_event);
+    invoke_type_callbacks(*current, updated_node, type, value_state, change);
     if (change == ATTRIBUTE_DELETED) {
-        attribute_store_invoke_delete_callbacks(updated_node);
+        invoke_delete_callbacks(*current, updated_node);
     }
 }
 
 void attribute_store_invoke_generic_callbacks(attribute_changed_event_t *change_event)
 {
-    std::set<attribute_store_node_update_callback_t> callbacks_to_invoke;
-    {
-        std::lock_guard<std::mutex> lk(callbacks_mutex);
-        callbacks_to_invoke = generic_callbacks;
-    }
-    for (const auto &callback_function: callbacks_to_invoke) {
-        callback_function(change_event);
-    }
+    invoke_generic_callbacks(*load_registry(), change_event);
 }
 
 void attribute_store_invoke_touch_generic_callbacks(attribute_store_node_t touched_node)
 {
-    std::set<attribute_store_node_touch_callback_t> callbacks_to_invoke;
-    {
-        std::lock_guard<std::mutex> lk(callbacks_mutex);
-        callbacks_to_invoke = touch_generic_callbacks;
-    }
-    for (const auto &callback_function: callbacks_to_invoke) {
+    const auto current = load_registry();
+    for (const auto &callback_function: current->touch_generic_callbacks) {
         callback_function(touched_node);
     }
 }
 
 void attribute_store_invoke_type_callbacks(attribute_store_node_t updated_node, attribute_store_type_t type, attribute_store_change_t change)
 {
-    std::vector<attribute_store::node_changed_callback> callbacks_to_invoke;
-    {
-        std::lock_guard<std::mutex> lk(callbacks_mutex);
-        auto it = type_callbacks.find(type);
-        if (it != type_callbacks.end()) {
-            callbacks_to_invoke = it->second;
+    const auto current = load_registry();
+    if (const type_dispatch_t *dispatch = find_type_dispatch(*current, type)) {
+        for (const auto &callback_function: dispatch->callbacks) {
+            callback_function(updated_node, change);
         }
     }
-    for (auto callback_function: callbacks_to_invoke) {
-        callback_function(updated_node, change);
-    }
 }
 
 void attribute_store_invoke_value_callbacks(attribute_store_node_t updated_node, attribute_store_type_t type, attribute_store_node_value_state_t value_state, attribute_store_change_t change)
 {
-    attribute_store_value_callback_setting_t setting = {type, value_state};
-    std::vector<attribute_store::node_changed_callback> callbacks_to_invoke;
-    {
-        std::lock_guard<std::mutex> lk(callbacks_mutex);
-        auto it = value_callbacks.find(setting);
-        if (it != value_callbacks.end()) {
-            callbacks_to_invoke = it->second;
-        }
+    if (!is_dispatched_value_state(value_state)) {
+        return;
     }
-    for (auto callback_function: callbacks_to_invoke) {
-        callback_function(updated_node, change);
+    const auto current = load_registry();
+    if (const type_dispatch_t *dispatch = find_type_dispatch(*current, type)) {
+        for (const auto &callback_function: dispatch->value_callbacks[value_state]) {
+            callback_function(updated_node, change);
+        }
     }
 }
 
 void attribute_store_invoke_delete_callbacks(attribute_store_node_t deleted_node)
 {
-    std::set<attribute_store_node_delete_callback_t> callbacks_to_invoke;
-    {
-        std::lock_guard<std::mutex> lk(callbacks_mutex);
-        callbacks_to_invoke = delete_callbacks;
-    }
-    for (const auto &callback_function: callbacks_to_invoke) {
-        callback_function(deleted_node);
-    }
+    invoke_delete_callbacks(*load_registry(), deleted_node);
 }
 
 sl_status_t attribute_store_callbacks_init(void)
 {
     std::lock_guard<std::mutex> lk(callbacks_mutex);
-    generic_callbacks.clear();
-    type_callbacks.clear();
-    delete_callbacks.clear();
-    value_callbacks.clear();
-    touch_generic_callbacks.clear();
-    c_node_changed_callbacks.clear();
-    c_node_value_callbacks.clear();
+    clear_callbacks();
 
     return SL_STATUS_OK;
 }
@@ -185,13 +301,7 @@ sl_status_t attribute_store_callbacks_init(void)
 int attribute_store_callbacks_teardown(void)
 {
     std::lock_guard<std::mutex> lk(callbacks_mutex);
-    generic_callbacks.clear();
-    type_callbacks.clear();
-    delete_callbacks.clear();
-    value_callbacks.clear();
-    touch_generic_callbacks.clear();
-    c_node_changed_callbacks.clear();
-    c_node_value_callbacks.clear();
+    clear_callbacks();
 
     return 0;
 }
@@ -209,6 +319,7 @@ sl_status_t attribute_store_register_touch_notification_callback(attribute_store
     }
     std::lock_guard<std::mutex> lk(callbacks_mutex);
     touch_generic_callbacks.insert(callback_function);
+    invalidate_registry();
     return SL_STATUS_OK;
 }
 
@@ -222,6 +333,7 @@ sl_status_t attribute_store_register_delete_callback(attribute_store_node_delete
     }
     std::lock_guard<std::mutex> lk(callbacks_mutex);
     delete_callbacks.insert(callback_function);
+    invalidate_registry();
     return SL_STATUS_OK;
 }
 
@@ -235,6 +347,7 @@ sl_status_t attribute_store_register_callback(attribute_store_node_update_callba
     }
     std::lock_guard<std::mutex> lk(callbacks_mutex);
     generic_callbacks.insert(callback_function);
+    invalidate_registry();
     return SL_STATUS_OK;
 }
 
@@ -254,6 +367,7 @@ sl_status_t attribute_store_register_callback_by_type(attribute_store_node_chang
         // Call directly (lock already held); the internal namespace function
         // must not re-acquire callbacks_mutex.
         type_callbacks[type].push_back(callback_function);
+        invalidate_registry();
     }
 
     return SL_STATUS_OK;
@@ -276,6 +390,7 @@ sl_status_t attribute_store_register_callback_by_type_and_state(attribute_store_
     if (!c_node_value_callbacks.contains(setting) || !c_node_value_callbacks[setting].contains(callback_function)) {
         c_node_value_callbacks[setting].insert(callback_function);
         value_callbacks[setting].push_back(callback_function);
+        invalidate_registry();
     }
 
     return SL_STATUS_OK;
@@ -288,6 +403,7 @@ namespace attribute_store
     {
         std::lock_guard<std::mutex> lk(callbacks_mutex);
         type_callbacks[type].push_back(callback_function);
+        invalidate_registry();
     }
 
     void register_callback_by_type_and_state(node_changed_callback callback_function, attribute_store_type_t type, attribute_store_node_value_state_t value_state)
@@ -295,6 +411,7 @@ namespace attribute_store
         attribute_store_value_callback_setting_t setting = {type, value_state};
         std::lock_guard<std::mutex> lk(callbacks_mutex);
         value_callbacks[setting].push_back(callback_function);
+        invalidate_registry();
     }
 
 }  // namespace attribute_store
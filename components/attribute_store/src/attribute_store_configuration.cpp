@@ -28,6 +28,9 @@ namespace
     // How long should elapse since last write in the attribute store before we back
     // up in the datastore. Unit is seconds
     unsigned int auto_save_cooldown_interval = 10;
+    // How long should elapse between two snapshots of the whole tree written
+    // after a save. Unit is seconds
+    unsigned int snapshot_interval = 10 * 60;
     // Should the Attribute Store perform additional validation when values
     // Based on the registered type informat?
     bool type_valiation_enabled = false;
@@ -63,6 +66,16 @@ void attribute_store_configuration_set_auto_save_cooldown_interval(unsigned int
     auto_save_cooldown_interval = seconds;
 }
 
+void attribute_store_configuration_set_snapshot_interval(unsigned int seconds)
+{
+    sl_log_info(LOG_TAG,
+                "Updating the Attribute Store snapshot interval "
+                "from %d seconds to %d seconds.",
+                snapshot_interval,
+                seconds);
+    snapshot_interval = seconds;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Internal functions, declared in attribute_store_configuration_internal.h
 ///////////////////////////////////////////////////////////////////////////////
@@ -80,3 +93,8 @@ unsigned int attribute_store_get_auto_save_cooldown_interval()
 {
     return auto_save_cooldown_interval;
 }
+
+unsigned int attribute_store_get_snapshot_interval()
+{
+    return snapshot_interval;
+}
@@ -51,6 +51,14 @@ unsigned int attribute_store_get_auto_save_safety_interval();
  */
 unsigned int attribute_store_get_auto_save_cooldown_interval();
 
+/**
+ * @brief Returns the snapshot interval configuration.
+ *
+ * @returns The minimum interval in seconds between two snapshots written
+ * after a save, 0 if snapshots are only written at teardown.
+ */
+unsigned int attribute_store_get_snapshot_interval();
+
 #ifdef __cplusplus
 }
 #endif
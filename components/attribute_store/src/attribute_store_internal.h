@@ -44,6 +44,13 @@ extern "C" {
  */
 sl_status_t attribute_store_save_to_datastore();
 
+/**
+ * @brief Copies the datastore write-ahead log back to the database, if needed
+ *
+ * @returns SL_STATUS_OK on success, other codes if nothing was done or in case of error
+ */
+sl_status_t attribute_store_checkpoint_datastore();
+
 /**
  * @brief Loads the entire attribute store from the datastore
  *
@@ -113,7 +113,7 @@ void attribute_store_node::log(uint8_t indent)
     char desired_value_data[MAXIMUM_MESSAGE_SIZE] = {0};
     uint16_t index                                = 0;
     for (uint8_t i = 0; i < this->desired_value.size(); i++) {
-        index += snprintf(desired_value_data + index, sizeof(desired_value_data) - index, "%02X ", this->desired_value.at(i));
+        index += snprintf(desired_value_data + index, sizeof(desired_value_data) - index, "%02X ", this->desired_value[i]);
     }
     if (index > 1) {
         desired_value_data[index - 1] = '\0';
@@ -122,7 +122,7 @@ void attribute_store_node::log(uint8_t indent)
     index                                          = 0;
     char reported_value_data[MAXIMUM_MESSAGE_SIZE] = {0};
     for (uint8_t i = 0; i < this->reported_value.size(); i++) {
-        index += snprintf(reported_value_data + index, sizeof(reported_value_data) - index, "%02X ", this->reported_value.at(i));
+        index += snprintf(reported_value_data + index, sizeof(reported_value_data) - index, "%02X ", this->reported_value[i]);
     }
     if (index > 1) {
         reported_value_data[index - 1] = '\0';
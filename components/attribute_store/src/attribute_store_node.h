@@ -18,6 +18,9 @@
 #include "attribute_store.h"
 
 // Generic includes
+#include <array>
+#include <memory>
+#include <string.h>
 #include <vector>
 
 /**
@@ -32,6 +35,104 @@
 extern "C" {
 #endif
 
+/**
+ * @brief Value storage for an attribute store node
+ *
+ * Most attribute values are a few bytes long (booleans, levels, versions), so
+ * values up to \ref INLINE_CAPACITY bytes are kept inside the node itself and
+ * only longer values (strings, association lists) are allocated on the heap.
+ * The object has the same footprint as a std::vector<uint8_t>.
+ */
+class attribute_store_node_value
+{
+    public:
+        /// Largest value size stored without a heap allocation.
+        static constexpr uint8_t INLINE_CAPACITY = 15;
+
+        attribute_store_node_value() : heap_data(nullptr), value_size(0) {}
+        ~attribute_store_node_value()
+        {
+            release();
+        }
+        attribute_store_node_value(const attribute_store_node_value &)            = delete;
+        attribute_store_node_value &operator=(const attribute_store_node_value &) = delete;
+
+        uint8_t size() const
+        {
+            return value_size;
+        }
+
+        bool empty() const
+        {
+            return value_size == 0;
+        }
+
+        const uint8_t *data() const
+        {
+            return is_inline() ? inline_data : heap_data;
+        }
+
+        uint8_t operator[](uint8_t index) const
+        {
+            return data()[index];
+        }
+
+        /**
+         * @brief Replace the value with a copy of the given buffer.
+         *
+         * @param value       Pointer to the new value. May be NULL if size is 0.
+         * @param size        Number of bytes to copy.
+         */
+        void assign(const uint8_t *value, uint8_t size)
+        {
+            if (size > INLINE_CAPACITY && (is_inline() || size > value_size)) {
+                uint8_t *new_data = new uint8_t[size];
+                release();
+                heap_data = new_data;
+            } else if (size <= INLINE_CAPACITY) {
+                release();
+            }
+            value_size = size;
+            if (size > 0) {
+                memcpy(is_inline() ? inline_data : heap_data, value, size);
+            }
+        }
+
+        void clear()
+        {
+            release();
+            value_size = 0;
+        }
+
+        /**
+         * @brief Compares the value with a buffer.
+         */
+        bool equals(const uint8_t *value, uint8_t size) const
+        {
+            return (size == value_size) && (size == 0 || 0 == memcmp(data(), value, size));
+        }
+
+    private:
+        bool is_inline() const
+        {
+            return value_size <= INLINE_CAPACITY;
+        }
+
+        void release()
+        {
+            if (!is_inline()) {
+                delete[] heap_data;
+                heap_data = nullptr;
+            }
+        }
+
+        union {
+                uint8_t inline_data[INLINE_CAPACITY];
+                uint8_t *heap_data;
+        };
+        uint8_t value_size;
+};
+
 /**
  * @brief A node in the attribute store tree
  *
@@ -50,9 +151,9 @@ class attribute_store_node
         // We have strings in configuration CC or
         // byte arrays in Association or Indicator CCs
         /// Desired value for the node attribute
-        std::vector<uint8_t> desired_value;
+        attribute_store_node_value desired_value;
         /// Reported value for the node attribute
-        std::vector<uint8_t> reported_value;
+        attribute_store_node_value reported_value;
         /// Pointer to the parent node in the tree.
         attribute_store_node *parent_node;
         /// Pointers to child nodes. There will be 0 to N child nodes.
@@ -131,6 +232,89 @@ class attribute_store_node
         void remove_child_link(attribute_store_node *_child_node);
 };
 
+/**
+ * @brief Direct-indexed table from attribute_store_node_t to node pointers
+ *
+ * Attribute IDs are handed out sequentially, so a paged array indexed by ID
+ * gives O(1) lookups without the pointer chasing of a tree-based map. Pages are
+ * allocated on first use and released again when their last node is erased,
+ * so sparse ID ranges left behind by deletions do not pin memory.
+ */
+class attribute_store_node_table
+{
+    public:
+        attribute_store_node *find(attribute_store_node_t id) const
+        {
+            size_t page_index = id >> PAGE_BITS;
+            if (page_index >= pages.size() || pages[page_index] == nullptr) {
+                return nullptr;
+            }
+            return pages[page_index]->nodes[id & PAGE_MASK];
+        }
+
+        bool contains(attribute_store_node_t id) const
+        {
+            return find(id) != nullptr;
+        }
+
+        void insert(attribute_store_node_t id, attribute_store_node *node)
+        {
+            size_t page_index = id >> PAGE_BITS;
+            if (page_index >= pages.size()) {
+                pages.resize(page_index + 1);
+            }
+            if (pages[page_index] == nullptr) {
+                pages[page_index] = std::make_unique<page>();
+            }
+            attribute_store_node *&slot = pages[page_index]->nodes[id & PAGE_MASK];
+            if (slot == nullptr) {
+                pages[page_index]->count++;
+                node_count++;
+            }
+            slot = node;
+        }
+
+        void erase(attribute_store_node_t id)
+        {
+            size_t page_index = id >> PAGE_BITS;
+            if (page_index >= pages.size() || pages[page_index] == nullptr) {
+                return;
+            }
+            attribute_store_node *&slot = pages[page_index]->nodes[id & PAGE_MASK];
+            if (slot == nullptr) {
+                return;
+            }
+            slot = nullptr;
+            node_count--;
+            if (--pages[page_index]->count == 0) {
+                pages[page_index].reset();
+            }
+        }
+
+        void clear()
+        {
+            pages.clear();
+            node_count = 0;
+        }
+
+        size_t size() const
+        {
+            return node_count;
+        }
+
+    private:
+        static constexpr size_t PAGE_BITS = 10;
+        static constexpr size_t PAGE_MASK = (1 << PAGE_BITS) - 1;
+
+        struct page {
+                std::array<attribute_store_node *, 1 << PAGE_BITS> nodes = {};
+                size_t count                                           = 0;
+        };
+
+        std::vector<std::unique_ptr<page>> pages;
+        size_t node_count = 0;
+};
+
 #ifdef __cplusplus
 }
 #endif
@@ -97,22 +97,31 @@ static void attribute_store_auto_save_timer_expired_event(void *ptr)
     sl_log_debug(LOG_TAG,
                  "Auto-save (cooldown or safety) interval elapsed. "
                  "Saving attributes to the datastore.\n");
-    attribute_store_save_to_datastore();
+    zwave_component::attribute_store_handler::request_save();
 }
 
 namespace zwave_component
 {
-    zwave_component::attribute_store_handler::attribute_store_handler()
+    attribute_store_handler *attribute_store_handler::instance = nullptr;
+
+    zwave_component::attribute_store_handler::attribute_store_handler() : threading("Attribute Store Handler")
     {
         sl_log_info(LOG_TAG, "Process started. Setting up timers\n");
+        instance = this;
         attribute_store_process_on_attribute_store_saved();
     }
 
     zwave_component::attribute_store_handler::~attribute_store_handler()
     {
         sl_log_info(LOG_TAG, "Process exited. Stopping timers\n");
+        // Stopped here, the base destructor would no longer reach our wake()
+        accepting_requests = false;
+        stop();
         timer_stop(&attribute_store_auto_save_safety_timer);
         timer_stop(&attribute_store_auto_save_cooldown_timer);
+        if (instance == this) {
+            instance = nullptr;
+        }
     }
 
     sl_status_t zwave_component::attribute_store_handler::initialize()
@@ -122,9 +131,65 @@ namespace zwave_component
 
     int zwave_component::attribute_store_handler::shutdown()
     {
+        accepting_requests = false;
+        stop();
         return 0;
     }
 
+    void zwave_component::attribute_store_handler::start()
+    {
+        threading::start();
+        accepting_requests = true;
+    }
+
+    void zwave_component::attribute_store_handler::request_save()
+    {
+        attribute_store_handler *handler = instance;
+        if (handler != nullptr && handler->accepting_requests) {
+            {
+                std::lock_guard<std::mutex> lock(handler->save_mutex);
+                // Several expiries while a save is ongoing collapse into one.
+                handler->save_requested = true;
+            }
+            handler->save_condition.notify_one();
+            return;
+        }
+        attribute_store_save_to_datastore();
+    }
+
+    void zwave_component::attribute_store_handler::wake()
+    {
+        // Taking the lock makes sure that run() is either waiting or sees should_stop()
+        std::lock_guard<std::mutex> lock(save_mutex);
+        save_condition.notify_one();
+    }
+
+    void zwave_component::attribute_store_handler::run()
+    {
+        std::unique_lock<std::mutex> lock(save_mutex);
+        auto woken = [this] {
+            return save_requested || should_stop();
+        };
+        // Sleep until a save is requested, or until the WAL is due for a checkpoint
+        if (checkpoint_pending) {
+            save_condition.wait_until(lock, last_save_time + idle_checkpoint_delay, woken);
+        } else {
+            save_condition.wait(lock, woken);
+        }
+
+        if (save_requested) {
+            save_requested = false;
+            lock.unlock();
+            attribute_store_save_to_datastore();
+            last_save_time     = std::chrono::steady_clock::now();
+            checkpoint_pending = true;
+        } else if (checkpoint_pending && std::chrono::steady_clock::now() - last_save_time >= idle_checkpoint_delay) {
+            lock.unlock();
+            attribute_store_checkpoint_datastore();
+            checkpoint_pending = false;
+        }
+    }
+
     std::string zwave_component::attribute_store_handler::name() const
     {
         return "Attribute Store Handler";
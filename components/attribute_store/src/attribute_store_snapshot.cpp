@@ -0,0 +1,322 @@
+/******************************************************************************
+ * # License
+ * <b>Copyright 2026 Silicon Laboratories Inc. www.silabs.com</b>
+ ******************************************************************************
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ *****************************************************************************/
+
+// Includes from this component
+#include "attribute_store_snapshot.h"
+#include "attribute_store_internal.h"
+
+// Generic includes
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Includes from other components
+#include "log.h"
+#include "zwave_crc16.h"
+
+/// Setup Log tag
+constexpr char LOG_TAG[] = "attribute_store_snapshot";
+
+namespace
+{
+    constexpr char SNAPSHOT_MAGIC[8]       = {'Z', 'P', 'C', 'A', 'S', 'N', 'A', 'P'};
+    constexpr uint32_t SNAPSHOT_VERSION    = 2;
+    constexpr uint32_t SNAPSHOT_NO_PARENT  = UINT32_MAX;
+    constexpr char SNAPSHOT_FILE_SUFFIX[]  = ".snapshot";
+    constexpr char SNAPSHOT_TEMP_SUFFIX[]  = ".tmp";
+
+    struct snapshot_header {
+            char magic[8];
+            uint32_t version;
+            uint32_t header_size;
+            int64_t generation;
+            int64_t identity;
+            uint32_t node_count;
+            uint32_t record_size;
+            uint64_t records_offset;
+            uint64_t values_offset;
+            uint64_t values_size;
+            uint16_t payload_crc;
+            uint16_t reserved;
+            // Covers all the fields above.
+            uint16_t header_crc;
+            uint16_t padding;
+    };
+    static_assert(sizeof(snapshot_header) == 72, "Snapshot header layout changed");
+
+    struct snapshot_record {
+            uint32_t id;
+            uint32_t type;
+            uint32_t parent_index;
+            uint32_t child_count;
+            uint32_t reported_value_offset;
+            uint32_t desired_value_offset;
+            uint8_t reported_value_size;
+            uint8_t desired_value_size;
+            uint16_t reserved;
+    };
+    static_assert(sizeof(snapshot_record) == 28, "Snapshot record layout changed");
+
+    uint16_t header_crc(const snapshot_header &header)
+    {
+        return zwave_crc16(CRC16_INIT_VALUE, reinterpret_cast<const uint8_t *>(&header), offsetof(snapshot_header, header_crc));
+    }
+
+    bool write_all(int fd, const uint8_t *data, size_t size)
+    {
+        while (size > 0) {
+            ssize_t written = write(fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Removes the nodes created by a failed load.
+     */
+    void discard_loaded_nodes(attribute_store_node *root, attribute_store_node_table &table)
+    {
+        for (attribute_store_node *child: root->child_nodes) {
+            child->parent_node = nullptr;
+            delete child;
+        }
+        root->child_nodes.clear();
+        root->reported_value.clear();
+        root->desired_value.clear();
+        table.clear();
+        table.insert(root->id, root);
+    }
+
+    /**
+     * @brief Checks the header and the checksums of a mapped snapshot.
+     */
+    bool validate_snapshot(const uint8_t *data, size_t size, int64_t identity, int64_t generation, snapshot_header &header)
+    {
+        if (size < sizeof(header)) {
+            sl_log_warning(LOG_TAG, "Snapshot is truncated.");
+            return false;
+        }
+        memcpy(&header, data, sizeof(header));
+        if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || header.header_size != sizeof(header) || header_crc(header) != header.header_crc) {
+            sl_log_warning(LOG_TAG, "Snapshot header is invalid.");
+            return false;
+        }
+        if (header.version != SNAPSHOT_VERSION || header.record_size != sizeof(snapshot_record)) {
+            sl_log_info(LOG_TAG, "Snapshot version %d is not supported.", header.version);
+            return false;
+        }
+        if (identity == 0 || header.identity != identity) {
+            sl_log_info(LOG_TAG, "Snapshot belongs to another datastore.");
+            return false;
+        }
+        if (header.generation != generation) {
+            sl_log_info(LOG_TAG, "Snapshot is stale (generation %lld, datastore generation %lld).", (long long)header.generation, (long long)generation);
+            return false;
+        }
+        uint64_t records_size = static_cast<uint64_t>(header.node_count) * sizeof(snapshot_record);
+        if (header.node_count == 0 || header.records_offset != sizeof(header) || header.values_offset != header.records_offset + records_size
+            || header.values_offset + header.values_size != size) {
+            sl_log_warning(LOG_TAG, "Snapshot sections do not match its size.");
+            return false;
+        }
+        if (zwave_crc16(CRC16_INIT_VALUE, data + header.records_offset, records_size + header.values_size) != header.payload_crc) {
+            sl_log_warning(LOG_TAG, "Snapshot checksum mismatch.");
+            return false;
+        }
+        return true;
+    }
+}  // namespace
+
+std::string attribute_store_snapshot_path(const char *datastore_file)
+{
+    if (datastore_file == nullptr || datastore_file[0] == '\0' || strcmp(datastore_file, ":memory:") == 0) {
+        return std::string();
+    }
+    return std::string(datastore_file) + SNAPSHOT_FILE_SUFFIX;
+}
+
+void attribute_store_snapshot_capture(const attribute_store_node *root, attribute_store_snapshot_image &image)
+{
+    image.records.clear();
+    image.values.clear();
+    image.node_count = 0;
+
+    // Depth-first walk with an explicit stack. Children are pushed in reverse
+    // so that they come out, and are restored, in their original order.
+    std::vector<std::pair<const attribute_store_node *, uint32_t>> stack;
+    stack.push_back({root, SNAPSHOT_NO_PARENT});
+    while (!stack.empty()) {
+        auto [node, parent_index] = stack.back();
+        stack.pop_back();
+
+        snapshot_record record       = {};
+        record.id                    = node->id;
+        record.type                  = node->type;
+        record.parent_index          = parent_index;
+        record.child_count           = static_cast<uint32_t>(node->child_nodes.size());
+        record.reported_value_offset = static_cast<uint32_t>(image.values.size());
+        record.reported_value_size   = node->reported_value.size();
+        image.values.insert(image.values.end(), node->reported_value.data(), node->reported_value.data() + node->reported_value.size());
+        record.desired_value_offset = static_cast<uint32_t>(image.values.size());
+        record.desired_value_size   = node->desired_value.size();
+        image.values.insert(image.values.end(), node->desired_value.data(), node->desired_value.data() + node->desired_value.size());
+
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&record);
+        image.records.insert(image.records.end(), bytes, bytes + sizeof(record));
+        uint32_t index = image.node_count++;
+
+        for (auto child = node->child_nodes.rbegin(); child != node->child_nodes.rend(); ++child) {
+            stack.push_back({*child, index});
+        }
+    }
+}
+
+sl_status_t attribute_store_snapshot_write(const std::string &path, const attribute_store_snapshot_image &image, int64_t identity, int64_t generation)
+{
+    snapshot_header header = {};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version        = SNAPSHOT_VERSION;
+    header.header_size    = sizeof(header);
+    header.generation     = generation;
+    header.identity       = identity;
+    header.node_count     = image.node_count;
+    header.record_size    = sizeof(snapshot_record);
+    header.records_offset = sizeof(header);
+    header.values_offset  = header.records_offset + image.records.size();
+    header.values_size    = image.values.size();
+
+    zwave_crc16_context_t crc;
+    zwave_crc16_init(&crc, CRC16_INIT_VALUE);
+    zwave_crc16_update(&crc, image.records.data(), image.records.size());
+    zwave_crc16_update(&crc, image.values.data(), image.values.size());
+    header.payload_crc = zwave_crc16_final(&crc);
+    header.header_crc  = header_crc(header);
+
+    std::string temp_path = path + SNAPSHOT_TEMP_SUFFIX;
+    int fd                = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        sl_log_error(LOG_TAG, "Cannot create %s: %s", temp_path.c_str(), strerror(errno));
+        return SL_STATUS_FAIL;
+    }
+    bool written = write_all(fd, reinterpret_cast<const uint8_t *>(&header), sizeof(header)) && write_all(fd, image.records.data(), image.records.size())
+                   && write_all(fd, image.values.data(), image.values.size()) && (fsync(fd) == 0);
+    close(fd);
+    if (!written || rename(temp_path.c_str(), path.c_str()) != 0) {
+        sl_log_error(LOG_TAG, "Cannot write %s: %s", path.c_str(), strerror(errno));
+        unlink(temp_path.c_str());
+        return SL_STATUS_FAIL;
+    }
+
+    // Make the rename itself durable.
+    std::string directory = path.substr(0, path.find_last_of('/') + 1);
+    int directory_fd      = open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directory_fd >= 0) {
+        fsync(directory_fd);
+        close(directory_fd);
+    }
+    sl_log_debug(LOG_TAG, "Wrote snapshot of %d attributes (generation %lld)", image.node_count, (long long)generation);
+    return SL_STATUS_OK;
+}
+
+sl_status_t attribute_store_snapshot_load(const std::string &path, int64_t identity, int64_t generation, attribute_store_node *root, attribute_store_node_table &table)
+{
+    if (path.empty()) {
+        return SL_STATUS_NOT_FOUND;
+    }
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return (errno == ENOENT) ? SL_STATUS_NOT_FOUND : SL_STATUS_FAIL;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        close(fd);
+        return SL_STATUS_FAIL;
+    }
+    size_t size = static_cast<size_t>(file_stat.st_size);
+    void *map   = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        sl_log_warning(LOG_TAG, "Cannot map %s: %s", path.c_str(), strerror(errno));
+        return SL_STATUS_FAIL;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+    const uint8_t *data = static_cast<const uint8_t *>(map);
+
+    snapshot_header header;
+    if (!validate_snapshot(data, size, identity, generation, header)) {
+        munmap(map, size);
+        return SL_STATUS_FAIL;
+    }
+
+    // Records are in pre-order, so a parent is always created before its
+    // children and nodes can be linked as soon as they are created.
+    const uint8_t *records = data + header.records_offset;
+    const uint8_t *values  = data + header.values_offset;
+    std::vector<attribute_store_node *> nodes(header.node_count, nullptr);
+    std::vector<uint32_t> missing_children(header.node_count, 0);
+    uint64_t announced_children = 0;
+    bool valid                  = true;
+    for (uint32_t index = 0; index < header.node_count && valid; index++) {
+        snapshot_record record;
+        memcpy(&record, records + static_cast<size_t>(index) * sizeof(record), sizeof(record));
+        if (static_cast<uint64_t>(record.reported_value_offset) + record.reported_value_size > header.values_size
+            || static_cast<uint64_t>(record.desired_value_offset) + record.desired_value_size > header.values_size) {
+            valid = false;
+            break;
+        }
+
+        attribute_store_node *node = nullptr;
+        if (index == 0) {
+            valid = (record.parent_index == SNAPSHOT_NO_PARENT) && (record.id == root->id);
+            node  = root;
+        } else if (record.parent_index >= index || missing_children[record.parent_index] == 0 || record.id == ATTRIBUTE_STORE_INVALID_NODE
+                   || table.contains(record.id)) {
+            valid = false;
+        } else {
+            attribute_store_node *parent = nodes[record.parent_index];
+            node                         = new attribute_store_node(parent, record.type, record.id);
+            parent->child_nodes.push_back(node);
+            missing_children[record.parent_index]--;
+            table.insert(node->id, node);
+        }
+        if (!valid) {
+            break;
+        }
+        node->reported_value.assign(values + record.reported_value_offset, record.reported_value_size);
+        node->desired_value.assign(values + record.desired_value_offset, record.desired_value_size);
+        node->child_nodes.reserve(record.child_count);
+        missing_children[index] = record.child_count;
+        announced_children += record.child_count;
+        nodes[index] = node;
+    }
+    munmap(map, size);
+
+    // No parent got more children than it announced, so if the announced
+    // children add up to all the nodes, every parent got all of them.
+    if (!valid || announced_children != header.node_count - 1) {
+        sl_log_warning(LOG_TAG, "Snapshot tree is inconsistent, discarding it.");
+        discard_loaded_nodes(root, table);
+        return SL_STATUS_FAIL;
+    }
+    return SL_STATUS_OK;
+}
@@ -0,0 +1,110 @@
+/******************************************************************************
+ * # License
+ * <b>Copyright 2026 Silicon Laboratories Inc. www.silabs.com</b>
+ ******************************************************************************
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ *****************************************************************************/
+
+/**
+ * @defgroup attribute_store_snapshot Attribute Store snapshot
+ * @ingroup attribute_store
+ * @brief Binary image of the Attribute Store tree, used for fast start-up
+ *
+ * The snapshot is a file next to the datastore, holding a header, one
+ * fixed-size record per node in pre-order and the node values:
+ *
+ * | Section | Content                                                    |
+ * |---------|------------------------------------------------------------|
+ * | Header  | Magic, version, identity, generation, offsets, checksums   |
+ * | Records | ID, type, parent record index, child count, value offsets  |
+ * | Values  | Reported and desired values, referenced by the records     |
+ *
+ * A parent record always comes before its children, so the tree is rebuilt in
+ * a single pass over the mapped file. The identity and the generation must
+ * match the ones saved in the datastore for the snapshot to be used. The
+ * identity ties the snapshot to its datastore, and the generation makes it
+ * stale as soon as the datastore is modified after it was written.
+ *
+ * @{
+ */
+
+#ifndef ATTRIBUTE_STORE_SNAPSHOT_H
+#define ATTRIBUTE_STORE_SNAPSHOT_H
+
+#include "attribute_store_node.h"
+#include "sl_status.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Copy of the tree, taken under the Attribute Store lock and written
+ * to the file without it.
+ */
+struct attribute_store_snapshot_image {
+        /// Fixed-size records, in pre-order.
+        std::vector<uint8_t> records;
+        /// Node values, referenced by the records.
+        std::vector<uint8_t> values;
+        /// Number of records.
+        uint32_t node_count = 0;
+};
+
+/**
+ * @brief Returns the path of the snapshot belonging to a datastore file.
+ *
+ * @param datastore_file Path of the datastore file.
+ * @returns The snapshot path, empty if the datastore is not a file.
+ */
+std::string attribute_store_snapshot_path(const char *datastore_file);
+
+/**
+ * @brief Copies a tree into a snapshot image.
+ *
+ * @param root   Root of the tree.
+ * @param image  Image to fill in.
+ */
+void attribute_store_snapshot_capture(const attribute_store_node *root, attribute_store_snapshot_image &image);
+
+/**
+ * @brief Writes a snapshot image to a file.
+ *
+ * The file is written next to its final path and renamed once it is
+ * complete, so a crash never leaves a partial snapshot behind.
+ *
+ * @param path        Path of the snapshot.
+ * @param image       Image to write.
+ * @param identity    Identity of the datastore the image corresponds to.
+ * @param generation  Datastore generation the image corresponds to.
+ * @returns SL_STATUS_OK on success, SL_STATUS_FAIL otherwise.
+ */
+sl_status_t attribute_store_snapshot_write(const std::string &path, const attribute_store_snapshot_image &image, int64_t identity, int64_t generation);
+
+/**
+ * @brief Rebuilds a tree from a snapshot.
+ *
+ * The root must have no children. Nodes are created under it and inserted
+ * in the table. If the snapshot is missing, stale or corrupted, nothing is
+ * modified.
+ *
+ * @param path        Path of the snapshot.
+ * @param identity    Identity of the current datastore.
+ * @param generation  Current datastore generation.
+ * @param root        Root of the tree.
+ * @param table       ID to node table to fill in.
+ * @returns SL_STATUS_OK if the tree was loaded from the snapshot,
+ *          SL_STATUS_NOT_FOUND if there is no snapshot,
+ *          SL_STATUS_FAIL if the snapshot cannot be used.
+ */
+sl_status_t attribute_store_snapshot_load(const std::string &path, int64_t identity, int64_t generation, attribute_store_node *root, attribute_store_node_table &table);
+
+/** @} end attribute_store_snapshot */
+
+#endif  // ATTRIBUTE_STORE_SNAPSHOT_H
@@ -47,6 +47,7 @@ extern "C" {
 #define CONFIG_KEY_MQTT_KEYFILE   "mqtt.keyfile"
 #define CONFIG_KEY_LOG_LEVEL      "log.level"
 #define CONFIG_KEY_LOG_TAG_LEVEL  "log.tag_level"
+#define CONFIG_KEY_LOG_ASYNC      "log.async"
 
 // Default Settings
 #define DEFAULT_CONFIG_PATH "/etc/zpc/zpc.cfg"
@@ -185,8 +186,8 @@ void config_reset();
 
 /**
  * @brief Apply log-level and tag-level settings from config to the log component.
- * Call after config_parse(). Reads CONFIG_KEY_LOG_LEVEL and CONFIG_KEY_LOG_TAG_LEVEL
- * and applies them via the log component.
+ * Call after config_parse(). Reads CONFIG_KEY_LOG_LEVEL, CONFIG_KEY_LOG_TAG_LEVEL
+ * and CONFIG_KEY_LOG_ASYNC and applies them via the log component.
  *
  * @return CONFIG_STATUS_OK on success, CONFIG_STATUS_ERROR if log level strings are invalid
  */
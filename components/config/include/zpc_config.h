@@ -67,6 +67,10 @@ typedef struct {
         int mqtt_port;
         /// File name for persistent storage
         const char *datastore_file;
+        /// SQLite synchronous level of the datastore ("off", "normal", "full" or "extra")
+        const char *datastore_synchronous;
+        /// Datastore WAL size (in KiB) above which it is checkpointed and truncated
+        int datastore_wal_size_limit_kb;
         /// Name of the serial port of the Z-Wave module
         const char *serial_port;
         /// IP address of the Z-Wave module
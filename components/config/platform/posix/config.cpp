@@ -131,6 +131,7 @@ class Config
         {
             this->config_add(CONFIG_KEY_LOG_LEVEL, "Log Level (d,i,w,e,c)", std::string("i"));
             this->config_add(CONFIG_KEY_LOG_TAG_LEVEL, "Tag-based log level\nFormat: <tag>:<severity>, <tag>:<severity>, ...", std::string(""));
+            this->config_add(CONFIG_KEY_LOG_ASYNC, "Write logs from a background thread", false);
         }
 
         template<typename T> config_status_t config_add(const char *name, const char *help, const T &default_value)
@@ -525,5 +526,9 @@ config_status_t config_apply_log_settings(void)
     if (sl_log_apply_config(log_level_str, tag_level_str) != SL_STATUS_OK) {
         return CONFIG_STATUS_ERROR;
     }
+    bool log_async = false;
+    if (config_get_as_bool(CONFIG_KEY_LOG_ASYNC, &log_async) == CONFIG_STATUS_OK) {
+        sl_log_set_async(log_async);
+    }
     return CONFIG_STATUS_OK;
 }
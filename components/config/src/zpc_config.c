@@ -52,6 +52,8 @@ static char zpc_rf_region_config_description[512];
 #define DEFAULT_NUMBER_OF_ACCEPTED_FRAME_TRANSMISSION_ERROR 2
 #define DEFAULT_INCLUSION_PROTOCOL_PREFERENCE               "1,2"
 #define DEFAULT_OTA_CACHE_PATH                              "/tmp/ota_cache"
+#define DEFAULT_DATASTORE_SYNCHRONOUS                       "full"
+#define DEFAULT_DATASTORE_WAL_SIZE_LIMIT_KB                 4096
 #define ZPC_DEVICE_ID_MAX_HEX_CHARS                         (0x1FU * 2U)
 
 // Config keys
@@ -75,6 +77,8 @@ static char zpc_rf_region_config_description[512];
 #define ZPC_CONFIG_NCP_VERSION            "zpc.ncp_version"
 #define ZPC_CONFIG_NCP_UPDATE             "zpc.ncp_update"
 #define ZPC_OTA_CACHE_PATH                "zpc.ota_cache_path"
+#define ZPC_DATASTORE_SYNCHRONOUS         "zpc.datastore_synchronous"
+#define ZPC_DATASTORE_WAL_SIZE_LIMIT_KB   "zpc.datastore_wal_size_limit_kb"
 
 #define ZPC_SECURITY_KEYS_DUMP_ENABLE                "security.security_keys_dump_enable"
 #define ZPC_SECURITY_KEYS_DUMP_RECIPIENT_PUBKEY_PATH "security.security_keys_dump_recipient_pubkey_path"
@@ -94,6 +98,11 @@ int zpc_config_init()
     config_status_t status = CONFIG_STATUS_OK;
 
     status |= config_add_string(CONFIG_KEY_ZPC_DATASTORE_FILE, "ZPC datastore database file", DEFAULT_ZPC_DATASTORE_FILE);
+    status |= config_add_string(ZPC_DATASTORE_SYNCHRONOUS, "SQLite synchronous level of the datastore: off, normal, full or extra", DEFAULT_DATASTORE_SYNCHRONOUS);
+    status |= config_add_int(ZPC_DATASTORE_WAL_SIZE_LIMIT_KB,
+                             "Size of the datastore write-ahead log (in KiB) above which it is "
+                             "checkpointed and truncated. 0 to never truncate it on size.",
+                             DEFAULT_DATASTORE_WAL_SIZE_LIMIT_KB);
     status |= config_add_string(ZPC_SERIAL, "Serial port where Z-Wave module is connected", DEFAULT_SERIAL_PORT);
     status |= config_add_string(ZPC_IP_ADDRESS, "IP address where Z-Wave module is connected", DEFAULT_IP_ADDRESS);
     status |= config_add_int(ZPC_IP_PORT, "IP port where Z-Wave module is connected", DEFAULT_IP_PORT);
@@ -266,6 +275,8 @@ sl_status_t zpc_config_fixt_setup()
 {
     config_status_t status = CONFIG_STATUS_OK;
     status |= config_get_as_string(CONFIG_KEY_ZPC_DATASTORE_FILE, &config.datastore_file);
+    status |= config_get_as_string(ZPC_DATASTORE_SYNCHRONOUS, &config.datastore_synchronous);
+    config.datastore_wal_size_limit_kb = config_get_int_safe(ZPC_DATASTORE_WAL_SIZE_LIMIT_KB);
     status |= config_get_as_string(ZPC_SERIAL, &config.serial_port);
     status |= config_get_as_string(ZPC_IP_ADDRESS, &config.ip_address);
     status |= config_get_as_int(ZPC_IP_PORT, &config.ip_port);
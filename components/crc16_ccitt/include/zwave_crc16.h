@@ -13,7 +13,7 @@
 
 /**
  * @defgroup crc16_ccitt CRC-16 CCITT Calculation Utility
- * @brief Inline CRC16-CCITT calculation function with Polynomial 0x1021
+ * @brief Inline table-driven (slice-by-8) CRC16-CCITT calculation with Polynomial 0x1021
  *
  * @{
  */
@@ -22,9 +22,41 @@
 
 #include <stdint.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #define CRC16_INIT_VALUE 0x1D0F
 #define CRC16_POLY       0x1021
 
+/**
+ * @brief Lookup tables for CRC16-CCITT with Polynomial 0x1021.
+ *
+ * Entry [k][n] is the CRC of byte n followed by k zero bytes, with a zero
+ * initial value. Table 0 is used to process one byte at a time, all 8 tables
+ * are used to process 8 bytes at a time (slice-by-8). Defined in
+ * zwave_crc16.c.
+ */
+extern const uint16_t zwave_crc16_table[8][256];
+
+/**
+ * @brief State of an incremental CRC16-CCITT calculation.
+ *
+ * Use it when the data is not available in one buffer, e.g. when reading
+ * a firmware image in chunks:
+ * @code
+ * zwave_crc16_context_t context;
+ * zwave_crc16_init(&context, CRC16_INIT_VALUE);
+ * while (read_chunk(&chunk)) {
+ *   zwave_crc16_update(&context, chunk.data, chunk.length);
+ * }
+ * uint16_t crc = zwave_crc16_final(&context);
+ * @endcode
+ */
+typedef struct {
+        uint16_t crc;
+} zwave_crc16_context_t;
+
 /**
  * @brief Calculation of CRC16-CCITT with Polynomial 0x1021 on data
  *
@@ -35,21 +67,55 @@
  */
 static inline uint16_t zwave_crc16(uint16_t crc16, const uint8_t *data_buf, unsigned long data_length)
 {
-    uint8_t work_data;
-    uint8_t new_bit;
+    while (data_length >= 8) {
+        crc16 = zwave_crc16_table[7][(uint8_t)(data_buf[0] ^ (crc16 >> 8))] ^ zwave_crc16_table[6][(uint8_t)(data_buf[1] ^ crc16)] ^ zwave_crc16_table[5][data_buf[2]] ^ zwave_crc16_table[4][data_buf[3]]
+                ^ zwave_crc16_table[3][data_buf[4]] ^ zwave_crc16_table[2][data_buf[5]] ^ zwave_crc16_table[1][data_buf[6]] ^ zwave_crc16_table[0][data_buf[7]];
+        data_buf += 8;
+        data_length -= 8;
+    }
     while (data_length--) {
-        work_data = *data_buf++;
-        for (uint8_t bit_mask = 0x80; bit_mask != 0; bit_mask >>= 1) {
-            /* Align test bit with next bit of the message byte, starting with msb. */
-            new_bit = ((work_data & bit_mask) != 0) ^ ((crc16 & 0x8000) != 0);
-            crc16 <<= 1;
-            if (new_bit) {
-                crc16 ^= CRC16_POLY;
-            }
-        }
+        crc16 = (uint16_t)((crc16 << 8) ^ zwave_crc16_table[0][(uint8_t)((crc16 >> 8) ^ *data_buf++)]);
     }
     return crc16;
 }
 
+/**
+ * @brief Starts an incremental CRC16-CCITT calculation
+ *
+ * @param context           Context to initialize
+ * @param crc16             Initial value for CRC 16 calculation algorithm
+ */
+static inline void zwave_crc16_init(zwave_crc16_context_t *context, uint16_t crc16)
+{
+    context->crc = crc16;
+}
+
+/**
+ * @brief Adds data to an incremental CRC16-CCITT calculation
+ *
+ * @param context           Context initialized with zwave_crc16_init
+ * @param data_buf          Pointer to the data buffer
+ * @param data_length       Length of the data
+ */
+static inline void zwave_crc16_update(zwave_crc16_context_t *context, const uint8_t *data_buf, unsigned long data_length)
+{
+    context->crc = zwave_crc16(context->crc, data_buf, data_length);
+}
+
+/**
+ * @brief Returns the CRC16-CCITT of all the data passed to zwave_crc16_update
+ *
+ * @param context           Context initialized with zwave_crc16_init
+ * @return calculated two byte CRC16 checksum
+ */
+static inline uint16_t zwave_crc16_final(const zwave_crc16_context_t *context)
+{
+    return context->crc;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif  // ZWAVE_CRC16_H
 /** @} end crc16_ccitt */
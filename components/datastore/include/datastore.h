@@ -166,6 +166,14 @@ bool datastore_contains_int(datastore_key_t key);
  */
 bool datastore_is_initialized();
 
+/**
+ * @brief Returns the path of the file backing the datastore.
+ *
+ * @return The path of the database file, or an empty string if the datastore
+ *         is not initialized or is kept in memory.
+ */
+const char *datastore_get_file_path();
+
 #ifdef __cplusplus
 }
 #endif
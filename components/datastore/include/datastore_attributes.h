@@ -31,6 +31,7 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "sl_status.h"
 
 /**
@@ -39,6 +40,19 @@
  */
 #define DATASTORE_ATTRIBUTE_VALUE_SIZE 255
 
+/**
+ * @brief Number of attributes removed by a single SQL statement in
+ * @ref datastore_delete_attributes
+ */
+#define DATASTORE_ATTRIBUTE_DELETE_BATCH_SIZE 64
+
+/**
+ * @brief Number of attributes written by a single SQL statement in
+ * @ref datastore_store_attributes (5 parameters each, within the default
+ * limit of 999 SQL parameters)
+ */
+#define DATASTORE_ATTRIBUTE_STORE_BATCH_SIZE 32
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -58,6 +72,20 @@ typedef struct _datastore_attribute_ {
         uint8_t desired_value_size;
 } datastore_attribute_t;
 
+/**
+ * @brief An attribute to be written with @ref datastore_store_attributes.
+ * The values are referenced, not copied.
+ */
+typedef struct _datastore_attribute_entry_ {
+        datastore_attribute_id_t id;
+        uint32_t type;
+        datastore_attribute_id_t parent_id;
+        const uint8_t *reported_value;
+        uint8_t reported_value_size;
+        const uint8_t *desired_value;
+        uint8_t desired_value_size;
+} datastore_attribute_entry_t;
+
 /**
  * @brief Store an attribute in the persistent datastore.
  *
@@ -85,6 +113,21 @@ typedef struct _datastore_attribute_ {
  */
 sl_status_t datastore_store_attribute(datastore_attribute_id_t id, uint32_t type, datastore_attribute_id_t parent_id, const uint8_t *reported_value, uint8_t reported_value_size, const uint8_t *desired_value, uint8_t desired_value_size);
 
+/**
+ * @brief Store a set of attributes in the persistent datastore.
+ * Attributes are inserted or updated like @ref datastore_store_attribute,
+ * with multi-row statements of up to @ref DATASTORE_ATTRIBUTE_STORE_BATCH_SIZE
+ * attributes each, in the order given and within a single transaction.
+ * Parents must therefore be listed before (or in the same batch as) their
+ * children.
+ * @param entries         Array of attributes to be inserted/updated
+ * @param count           Number of attributes in the array
+ * @returns SL_STATUS_OK if successful
+ * @returns SL_STATUS_FAIL if an error happened. Attributes that could be
+ *          written are still stored.
+ */
+sl_status_t datastore_store_attributes(const datastore_attribute_entry_t *entries, size_t count);
+
 /**
  * @brief Fetch an attribute from the persistent datastore.
  *
@@ -201,6 +244,23 @@ bool datastore_contains_attribute(const datastore_attribute_id_t id);
  */
 sl_status_t datastore_delete_attribute(const datastore_attribute_id_t id);
 
+/**
+ * @brief Delete a set of attributes from the persistent datastore.
+ *
+ * Attributes are removed with set-based statements of up to
+ * @ref DATASTORE_ATTRIBUTE_DELETE_BATCH_SIZE IDs each, in the order given.
+ * Children must therefore be listed before (or in the same batch as) their
+ * parent.
+ *
+ * @param ids             Array of unique IDs for the Attribute Store nodes to
+ *                        be deleted
+ * @param count           Number of IDs in the array
+ *
+ * @returns SL_STATUS_OK if successful
+ * @returns SL_STATUS_FAIL if an error happened
+ */
+sl_status_t datastore_delete_attributes(const datastore_attribute_id_t *ids, size_t count);
+
 /**
  * @brief Delete the whole attribute table in the persistent datastore.
  *
@@ -0,0 +1,145 @@
+/******************************************************************************
+ * # License
+ * <b>Copyright 2026 Silicon Laboratories Inc. www.silabs.com</b>
+ ******************************************************************************
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ *****************************************************************************/
+
+/**
+ * @defgroup datastore_checkpoint Datastore WAL checkpointing
+ * @ingroup zpc_datastore
+ * @brief Write-ahead log checkpoints and durability of the datastore
+ *
+ * The datastore database runs in WAL journal mode without SQLite's automatic
+ * checkpoints. Instead:
+ * - @ref datastore_checkpoint_if_idle copies the WAL back to the database
+ *   (passive checkpoint) when its user is idle.
+ * - When a commit leaves the WAL larger than the configured limit, a
+ *   truncating checkpoint runs right away and resets the WAL file to zero
+ *   bytes, so that the WAL (and the time to replay it at start-up) stays
+ *   bounded.
+ *
+ * @{
+ */
+
+#ifndef DATASTORE_CHECKPOINT_H
+#define DATASTORE_CHECKPOINT_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include "sl_status.h"
+
+/**
+ * @brief Default size of the WAL above which a truncating checkpoint is run,
+ * in bytes.
+ */
+#define DATASTORE_DEFAULT_WAL_SIZE_LIMIT (4 * 1024 * 1024)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief SQLite synchronous levels, see https://www.sqlite.org/pragma.html#pragma_synchronous
+ */
+typedef enum {
+    /// No syncs, a power loss may corrupt the database
+    DATASTORE_SYNCHRONOUS_OFF = 0,
+    /// Sync at checkpoints only, a power loss may lose the last commits
+    DATASTORE_SYNCHRONOUS_NORMAL = 1,
+    /// Sync the WAL at every commit
+    DATASTORE_SYNCHRONOUS_FULL = 2,
+    /// Like FULL, also syncing directories
+    DATASTORE_SYNCHRONOUS_EXTRA = 3,
+} datastore_synchronous_level_t;
+
+/**
+ * @brief Metrics of the datastore WAL and checkpoints.
+ */
+typedef struct {
+        /// Current size of the WAL file, in bytes
+        uint64_t wal_size_bytes;
+        /// Pages in the WAL after the last commit or checkpoint
+        uint32_t wal_pages;
+        /// Number of checkpoints run
+        uint32_t checkpoint_count;
+        /// Number of those checkpoints that truncated the WAL
+        uint32_t truncate_checkpoint_count;
+        /// Duration of the last checkpoint, in milliseconds
+        uint32_t last_checkpoint_duration_ms;
+        /// Longest checkpoint duration observed, in milliseconds
+        uint32_t max_checkpoint_duration_ms;
+        /// Pages written back to the database by the last checkpoint
+        uint32_t last_checkpoint_pages;
+        /// Pages written back to the database by all checkpoints
+        uint64_t total_checkpoint_pages;
+} datastore_checkpoint_statistics_t;
+
+/**
+ * @brief Set the SQLite synchronous level of the datastore.
+ *
+ * Must not be called while a transaction is ongoing.
+ *
+ * @param level The synchronous level to use
+ * @returns SL_STATUS_OK if successful
+ * @returns SL_STATUS_FAIL if the datastore is not initialized or an error happened
+ */
+sl_status_t datastore_set_synchronous_level(datastore_synchronous_level_t level);
+
+/**
+ * @brief Parse a synchronous level name ("off", "normal", "full" or "extra").
+ *
+ * @param name  The name to parse
+ * @param level Pointer where the level will be written
+ * @returns SL_STATUS_OK if successful
+ * @returns SL_STATUS_INVALID_PARAMETER if the name is unknown
+ */
+sl_status_t datastore_synchronous_level_from_string(const char *name, datastore_synchronous_level_t *level);
+
+/**
+ * @brief Set the WAL size above which a commit triggers a truncating checkpoint.
+ *
+ * @param size_bytes Size limit in bytes, 0 to never truncate the WAL on size
+ */
+void datastore_set_wal_size_limit(uint32_t size_bytes);
+
+/**
+ * @brief Run a checkpoint now.
+ *
+ * @param truncate Set to true to also truncate the WAL file to zero bytes,
+ *                 false for a passive checkpoint.
+ * @returns SL_STATUS_OK if successful
+ * @returns SL_STATUS_FAIL if the datastore is not initialized or an error happened
+ */
+sl_status_t datastore_checkpoint(bool truncate);
+
+/**
+ * @brief Run a passive checkpoint if the WAL holds pages not checkpointed yet.
+ *
+ * Meant to be called by the datastore user when it has been idle for a while.
+ *
+ * @returns SL_STATUS_OK if a checkpoint ran successfully
+ * @returns SL_STATUS_NOT_READY if there was nothing to checkpoint
+ * @returns SL_STATUS_FAIL if the datastore is not initialized or an error happened
+ */
+sl_status_t datastore_checkpoint_if_idle();
+
+/**
+ * @brief Read the current WAL and checkpoint metrics.
+ *
+ * @param statistics Pointer where the metrics will be copied.
+ */
+void datastore_get_checkpoint_statistics(datastore_checkpoint_statistics_t *statistics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // DATASTORE_CHECKPOINT_H
+/** @} end datastore_checkpoint */
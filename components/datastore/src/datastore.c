@@ -321,4 +321,10 @@ bool datastore_contains_arr(const datastore_key_t key)
 bool datastore_is_initialized()
 {
     return (NULL != db);
+}
+
+const char *datastore_get_file_path()
+{
+    const char *database_file = (db != NULL) ? sqlite3_db_filename(db, "main") : NULL;
+    return (database_file != NULL) ? database_file : "";
 }
\ No newline at end of file
@@ -35,10 +35,26 @@ static sqlite3_stmt *upsert_statement             = NULL;
 static sqlite3_stmt *select_statement             = NULL;
 static sqlite3_stmt *select_all_statement         = NULL;
 static sqlite3_stmt *select_child_index_statement = NULL;
+static sqlite3_stmt *select_next_child_statement  = NULL;
 static sqlite3_stmt *delete_statement             = NULL;
+static sqlite3_stmt *delete_batch_statement       = NULL;
 const char select_all_sql[]                       = "SELECT id, type, parent_id, reported_value, "
                                                     "desired_value FROM " DATASTORE_TABLE_ATTRIBUTES ";";
 
+// Multi-row upsert statements, indexed by their number of rows.
+// Prepared on first use and kept until the statement teardown.
+static sqlite3_stmt *upsert_batch_statements[DATASTORE_ATTRIBUTE_STORE_BATCH_SIZE + 1] = {NULL};
+
+// Last child returned by a child lookup, so that enumerating the children of a
+// parent with increasing child indices continues from there instead of
+// skipping child_index rows every time.
+static struct {
+        datastore_attribute_id_t parent_id;
+        uint32_t child_index;
+        datastore_attribute_id_t child_id;
+        bool valid;
+} last_child_lookup = {0};
+
 ////////////////////////////////////////////////////////////////////////////////
 // Private helper functions
 ////////////////////////////////////////////////////////////////////////////////
@@ -52,6 +68,132 @@ static void inline log_binding_failed()
     sl_log_error(LOG_TAG, "Binding operation failed: %s\n", sqlite3_errmsg(db));
 }
 
+/**
+ * @brief Bind one attribute row to the 5 upsert parameters starting at first_column.
+ */
+static sl_status_t bind_attribute_entry(sqlite3_stmt *statement, int first_column, const datastore_attribute_entry_t *entry)
+{
+    int rc = sqlite3_bind_int64(statement, first_column, entry->id);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_bind_int64(statement, first_column + 1, entry->type);
+    }
+    // Insert NULL value if the parent_id is set to 0x00
+    if (rc == SQLITE_OK) {
+        rc = (entry->parent_id == 0x00) ? sqlite3_bind_null(statement, first_column + 2) : sqlite3_bind_int64(statement, first_column + 2, entry->parent_id);
+    }
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_bind_blob(statement, first_column + 3, entry->reported_value, entry->reported_value_size, SQLITE_STATIC);
+    }
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_bind_blob(statement, first_column + 4, entry->desired_value, entry->desired_value_size, SQLITE_STATIC);
+    }
+    if (rc != SQLITE_OK) {
+        log_binding_failed();
+        return SL_STATUS_FAIL;
+    }
+    return SL_STATUS_OK;
+}
+
+/**
+ * @brief Get the upsert statement for a given number of rows, preparing it on first use.
+ */
+static sqlite3_stmt *get_upsert_batch_statement(size_t rows)
+{
+    if (upsert_batch_statements[rows] != NULL) {
+        return upsert_batch_statements[rows];
+    }
+
+    static const char upsert_head_sql[] = "INSERT INTO " DATASTORE_TABLE_ATTRIBUTES " (id, type, parent_id, reported_value, desired_value) VALUES (?,?,?,?,?)";
+    static const char upsert_row_sql[]  = ",(?,?,?,?,?)";
+    static const char upsert_tail_sql[] = " ON CONFLICT(id) DO UPDATE SET type = excluded.type,"
+                                          " parent_id = excluded.parent_id,"
+                                          " reported_value = excluded.reported_value,"
+                                          " desired_value = excluded.desired_value;";
+    char upsert_batch_sql[sizeof(upsert_head_sql) + DATASTORE_ATTRIBUTE_STORE_BATCH_SIZE * (sizeof(upsert_row_sql) - 1) + sizeof(upsert_tail_sql)] = {0};
+    int sql_length = snprintf(upsert_batch_sql, sizeof(upsert_batch_sql), "%s", upsert_head_sql);
+    for (size_t i = 1; i < rows; i++) {
+        sql_length += snprintf(upsert_batch_sql + sql_length, sizeof(upsert_batch_sql) - sql_length, "%s", upsert_row_sql);
+    }
+    snprintf(upsert_batch_sql + sql_length, sizeof(upsert_batch_sql) - sql_length, "%s", upsert_tail_sql);
+
+    int rc = sqlite3_prepare_v3(db, upsert_batch_sql, -1, SQLITE_PREPARE_PERSISTENT, &upsert_batch_statements[rows], NULL);
+    if (rc != SQLITE_OK) {
+        sl_log_error(LOG_TAG, "Prepare Batch Upsert statement failed: %s\n", sqlite3_errmsg(db));
+        sqlite3_finalize(upsert_batch_statements[rows]);
+        upsert_batch_statements[rows] = NULL;
+    }
+    return upsert_batch_statements[rows];
+}
+
+/**
+ * @brief Write rows with a single multi-row upsert statement.
+ */
+static sl_status_t store_attribute_batch(const datastore_attribute_entry_t *entries, size_t rows)
+{
+    sqlite3_stmt *statement = get_upsert_batch_statement(rows);
+    if (statement == NULL) {
+        return SL_STATUS_FAIL;
+    }
+
+    sl_status_t result = SL_STATUS_OK;
+    for (size_t i = 0; i < rows && result == SL_STATUS_OK; i++) {
+        result = bind_attribute_entry(statement, (int)(5 * i) + 1, &entries[i]);
+    }
+    if (result == SL_STATUS_OK) {
+        int rc = sqlite3_step(statement);
+        if (rc != SQLITE_DONE && rc != SQLITE_ROW) {
+            result = SL_STATUS_FAIL;
+        }
+    }
+    sqlite3_reset(statement);
+    return result;
+}
+
+/**
+ * @brief Find the nth child of a parent.
+ *
+ * On success, statement is left on the row of the child (id, type,
+ * reported_value, desired_value) and the caller must reset it.
+ */
+static sl_status_t find_attribute_child(datastore_attribute_id_t parent_id, uint32_t child_index, sqlite3_stmt **statement)
+{
+    sqlite3_stmt *stmt = select_child_index_statement;
+    int rc;
+    if (last_child_lookup.valid && last_child_lookup.parent_id == parent_id && (child_index == last_child_lookup.child_index + 1 || child_index == last_child_lookup.child_index)) {
+        // Continue from the previous child rather than skipping child_index rows
+        datastore_attribute_id_t after_id = (child_index == last_child_lookup.child_index) ? last_child_lookup.child_id - 1 : last_child_lookup.child_id;
+        stmt                              = select_next_child_statement;
+        rc                                = sqlite3_bind_int64(stmt, 1, parent_id);
+        if (rc == SQLITE_OK) {
+            rc = sqlite3_bind_int64(stmt, 2, after_id);
+        }
+    } else {
+        rc = sqlite3_bind_int64(stmt, 1, parent_id);
+        if (rc == SQLITE_OK) {
+            rc = sqlite3_bind_int64(stmt, 2, child_index);
+        }
+    }
+    if (rc != SQLITE_OK) {
+        log_binding_failed();
+        sqlite3_reset(stmt);
+        return SL_STATUS_FAIL;
+    }
+
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+        // No result was found for the parent_id / child_index
+        sqlite3_reset(stmt);
+        last_child_lookup.valid = false;
+        return SL_STATUS_NOT_FOUND;
+    }
+
+    last_child_lookup.parent_id   = parent_id;
+    last_child_lookup.child_index = child_index;
+    last_child_lookup.child_id    = (datastore_attribute_id_t)sqlite3_column_int64(stmt, 0);
+    last_child_lookup.valid       = true;
+    *statement                    = stmt;
+    return SL_STATUS_OK;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Init/teardown functions
 ////////////////////////////////////////////////////////////////////////////////
@@ -71,17 +213,16 @@ sl_status_t datastore_attribute_table_init()
         return SL_STATUS_FAIL;
     }
 
-    // Do not do use exessive checkpointing, we never rollback anyway
-    rc = datastore_exec_sql("PRAGMA wal_autocheckpoint = 0;");
+    // Filesystem operations are reduced and there is some performance gain if
+    // running in exclusive lock mode (though nobody else can open the database)
+    rc = datastore_exec_sql("PRAGMA locking_mode = EXCLUSIVE;");
     if (rc != SQLITE_OK) {
         sqlite3_close(db);
         return SL_STATUS_FAIL;
     }
 
-    // Filesystem operations are reduced and there is some performance gain if
-    // running in exclusive lock mode (though nobody else can open the database)
-    rc = datastore_exec_sql("PRAGMA locking_mode = EXCLUSIVE;");
-    if (rc != SQLITE_OK) {
+    // Write-ahead log, with checkpoints scheduled by datastore_checkpoint.c
+    if (datastore_checkpoint_init() != SL_STATUS_OK) {
         sqlite3_close(db);
         return SL_STATUS_FAIL;
     }
@@ -104,6 +245,15 @@ sl_status_t datastore_attribute_table_init()
         return SL_STATUS_FAIL;
     }
 
+    // Children are looked up by parent_id, ordered by id, and every deletion
+    // checks the parent_id foreign key. (parent_id, id) covers the child id
+    // lookups without visiting the table.
+    rc = datastore_exec_sql("CREATE INDEX IF NOT EXISTS " DATASTORE_TABLE_ATTRIBUTES "_parent_id ON " DATASTORE_TABLE_ATTRIBUTES " (parent_id, id);");
+    if (rc != SQLITE_OK) {
+        sqlite3_close(db);
+        return SL_STATUS_FAIL;
+    }
+
     // Run an optimization at init.
     // From the SQLite documentation: https://www.sqlite.org/pragma.html#pragma_optimize
     // Long-running applications might also benefit from setting a timer to run "PRAGMA optimize" every few hours.
@@ -167,6 +317,17 @@ sl_status_t datastore_attribute_statement_init()
         return SL_STATUS_FAIL;
     }
 
+    // Select next child statement: the first child after a given id,
+    // used to continue an enumeration of the children of a parent.
+    const char *select_next_child_sql = "SELECT id, type, reported_value, "
+                                        "desired_value FROM " DATASTORE_TABLE_ATTRIBUTES " WHERE parent_id = ? AND id > ? ORDER BY id LIMIT 1";
+
+    rc = sqlite3_prepare_v2(db, select_next_child_sql, -1, &select_next_child_statement, NULL);
+    if (rc != SQLITE_OK) {
+        sl_log_error(LOG_TAG, "Prepare Select Next Child statement failed: %s\n", sqlite3_errmsg(db));
+        return SL_STATUS_FAIL;
+    }
+
     // Delete statement:
     const char *delete_sql = "DELETE FROM " DATASTORE_TABLE_ATTRIBUTES " WHERE id = ?;";
 
@@ -177,6 +338,21 @@ sl_status_t datastore_attribute_statement_init()
         return SL_STATUS_FAIL;
     }
 
+    // Batch delete statement: "DELETE ... WHERE id IN (?,?,...,?)".
+    // Unused placeholders are bound to 0, which is never a valid id.
+    char delete_batch_sql[64 + 2 * DATASTORE_ATTRIBUTE_DELETE_BATCH_SIZE] = {0};
+    int sql_length = snprintf(delete_batch_sql, sizeof(delete_batch_sql), "DELETE FROM " DATASTORE_TABLE_ATTRIBUTES " WHERE id IN (?");
+    for (size_t i = 1; i < DATASTORE_ATTRIBUTE_DELETE_BATCH_SIZE; i++) {
+        sql_length += snprintf(delete_batch_sql + sql_length, sizeof(delete_batch_sql) - sql_length, ",?");
+    }
+    snprintf(delete_batch_sql + sql_length, sizeof(delete_batch_sql) - sql_length, ");");
+
+    rc = sqlite3_prepare_v2(db, delete_batch_sql, -1, &delete_batch_statement, NULL);
+    if (rc != SQLITE_OK) {
+        sl_log_error(LOG_TAG, "Prepare Batch Delete statement failed: %s\n", sqlite3_errmsg(db));
+        return SL_STATUS_FAIL;
+    }
+
     return SL_STATUS_OK;
 }
 
@@ -187,14 +363,23 @@ sl_status_t datastore_attribute_statement_teardown()
     sqlite3_finalize(select_statement);
     sqlite3_finalize(select_all_statement);
     sqlite3_finalize(select_child_index_statement);
+    sqlite3_finalize(select_next_child_statement);
     sqlite3_finalize(delete_statement);
+    sqlite3_finalize(delete_batch_statement);
+    for (size_t i = 0; i <= DATASTORE_ATTRIBUTE_STORE_BATCH_SIZE; i++) {
+        sqlite3_finalize(upsert_batch_statements[i]);
+        upsert_batch_statements[i] = NULL;
+    }
+    last_child_lookup.valid = false;
 
     // Set them back to NULL, so that we can detect if they are missing a re-init
     upsert_statement             = NULL;
     select_statement             = NULL;
     select_all_statement         = NULL;
     select_child_index_statement = NULL;
+    select_next_child_statement  = NULL;
     delete_statement             = NULL;
+    delete_batch_statement       = NULL;
 
     // Teardown always goes well
     return SL_STATUS_OK;
@@ -264,7 +449,51 @@ sl_status_t datastore_store_attribute(datastore_attribute_id_t id, uint32_t type
 
     // We are done, reset the statement so we can execute it again
     sqlite3_reset(upsert_statement);
+    last_child_lookup.valid = false;
+
+    return result;
+}
+
+sl_status_t datastore_store_attributes(const datastore_attribute_entry_t *entries, size_t count)
+{
+    if (db == NULL) {
+        log_database_not_initialized();
+        return SL_STATUS_FAIL;
+    }
+    if (count == 0) {
+        return SL_STATUS_OK;
+    }
+
+    // A savepoint is a nested transaction if the caller started one,
+    // and a transaction of its own otherwise.
+    if (datastore_exec_sql("SAVEPOINT store_attributes;") != SQLITE_OK) {
+        return SL_STATUS_FAIL;
+    }
+
+    sl_status_t result = SL_STATUS_OK;
+    for (size_t offset = 0; offset < count; offset += DATASTORE_ATTRIBUTE_STORE_BATCH_SIZE) {
+        size_t rows = count - offset;
+        if (rows > DATASTORE_ATTRIBUTE_STORE_BATCH_SIZE) {
+            rows = DATASTORE_ATTRIBUTE_STORE_BATCH_SIZE;
+        }
+        if (store_attribute_batch(&entries[offset], rows) == SL_STATUS_OK) {
+            continue;
+        }
+        // The statement fails as a whole, write the rows one by one so that
+        // the valid ones are stored and the failing ones are reported.
+        for (size_t i = offset; i < offset + rows; i++) {
+            const datastore_attribute_entry_t *entry = &entries[i];
+            if (datastore_store_attribute(entry->id, entry->type, entry->parent_id, entry->reported_value, entry->reported_value_size, entry->desired_value, entry->desired_value_size) != SL_STATUS_OK) {
+                sl_log_error(LOG_TAG, "Error storing Attribute ID %d.", entry->id);
+                result = SL_STATUS_FAIL;
+            }
+        }
+    }
+    last_child_lookup.valid = false;
 
+    if (datastore_exec_sql("RELEASE store_attributes;") != SQLITE_OK) {
+        return SL_STATUS_FAIL;
+    }
     return result;
 }
 
@@ -347,88 +576,53 @@ sl_status_t datastore_fetch_all_attributes(datastore_attribute_t *attribute)
 
 sl_status_t datastore_fetch_attribute_child(datastore_attribute_id_t parent_id, uint32_t child_index, datastore_attribute_id_t *child_id, uint32_t *type, uint8_t *reported_value, uint8_t *reported_value_size, uint8_t *desired_value, uint8_t *desired_value_size)
 {
-    sl_status_t status = SL_STATUS_FAIL;
-
     if (db == NULL) {
         log_database_not_initialized();
-        return status;
+        return SL_STATUS_FAIL;
     }
 
-    // Fill up those question marks from the SQL statements
-    int rc = sqlite3_bind_int64(select_child_index_statement, 1, parent_id);
-    if (rc != SQLITE_OK) {
-        log_binding_failed();
+    sqlite3_stmt *statement = NULL;
+    sl_status_t status      = find_attribute_child(parent_id, child_index, &statement);
+    if (status != SL_STATUS_OK) {
         return status;
     }
-    rc = sqlite3_bind_int64(select_child_index_statement, 2, child_index);
-    if (rc != SQLITE_OK) {
-        log_binding_failed();
-        return status;
-    }
-
-    // Execute the query
-    int step = sqlite3_step(select_child_index_statement);
 
-    if (step == SQLITE_ROW) {
-        // Pull the result from the first row (there should be only one)
-        *child_id = (uint32_t)sqlite3_column_int64(select_child_index_statement, 0);
-        *type     = (uint32_t)sqlite3_column_int64(select_child_index_statement, 1);
+    // Pull the result from the first row (there should be only one)
+    *child_id = (uint32_t)sqlite3_column_int64(statement, 0);
+    *type     = (uint32_t)sqlite3_column_int64(statement, 1);
 
-        // Get a pointer from sqlite and copy the data to the user pointer
-        const uint8_t *value_buffer = (const uint8_t *)sqlite3_column_blob(select_child_index_statement, 2);
-        *reported_value_size        = (uint8_t)sqlite3_column_bytes(select_child_index_statement, 2);
-        memcpy(reported_value, value_buffer, *reported_value_size);
+    // Get a pointer from sqlite and copy the data to the user pointer
+    const uint8_t *value_buffer = (const uint8_t *)sqlite3_column_blob(statement, 2);
+    *reported_value_size        = (uint8_t)sqlite3_column_bytes(statement, 2);
+    memcpy(reported_value, value_buffer, *reported_value_size);
 
-        // Same thing for the desired value
-        value_buffer        = sqlite3_column_blob(select_child_index_statement, 3);
-        *desired_value_size = (uint8_t)sqlite3_column_bytes(select_child_index_statement, 3);
-        memcpy(desired_value, value_buffer, *desired_value_size);
-        status = SL_STATUS_OK;
-    } else {
-        // No result was found for the parent_id / child_index
-        status = SL_STATUS_NOT_FOUND;
-    }
+    // Same thing for the desired value
+    value_buffer        = sqlite3_column_blob(statement, 3);
+    *desired_value_size = (uint8_t)sqlite3_column_bytes(statement, 3);
+    memcpy(desired_value, value_buffer, *desired_value_size);
 
-    sqlite3_reset(select_child_index_statement);
-    return status;
+    sqlite3_reset(statement);
+    return SL_STATUS_OK;
 }
 
 sl_status_t datastore_fetch_attribute_child_id(datastore_attribute_id_t parent_id, uint32_t child_index, datastore_attribute_id_t *child_id)
 {
-    sl_status_t status = SL_STATUS_FAIL;
-
     if (db == NULL) {
         log_database_not_initialized();
-        return status;
+        return SL_STATUS_FAIL;
     }
 
-    // Fill up those question marks from the SQL statements
-    int rc = sqlite3_bind_int64(select_child_index_statement, 1, parent_id);
-    if (rc != SQLITE_OK) {
-        log_binding_failed();
-        return status;
-    }
-    rc = sqlite3_bind_int64(select_child_index_statement, 2, child_index);
-    if (rc != SQLITE_OK) {
-        log_binding_failed();
+    sqlite3_stmt *statement = NULL;
+    sl_status_t status      = find_attribute_child(parent_id, child_index, &statement);
+    if (status != SL_STATUS_OK) {
         return status;
     }
 
-    // Execute the query
-    int step = sqlite3_step(select_child_index_statement);
-
-    if (step == SQLITE_ROW) {
-        // Pull the result from the first row (there should be only one)
-        *child_id = (uint32_t)sqlite3_column_int64(select_child_index_statement, 0);
-
-        status = SL_STATUS_OK;
-    } else {
-        // No result was found for the parent_id / child_index
-        status = SL_STATUS_NOT_FOUND;
-    }
+    // Pull the result from the first row (there should be only one)
+    *child_id = (uint32_t)sqlite3_column_int64(statement, 0);
 
-    sqlite3_reset(select_child_index_statement);
-    return status;
+    sqlite3_reset(statement);
+    return SL_STATUS_OK;
 }
 
 bool datastore_contains_attribute(datastore_attribute_id_t id)
@@ -476,6 +670,37 @@ sl_status_t datastore_delete_attribute(const datastore_attribute_id_t id)
     }
 
     sqlite3_reset(delete_statement);
+    last_child_lookup.valid = false;
+    return result;
+}
+
+sl_status_t datastore_delete_attributes(const datastore_attribute_id_t *ids, size_t count)
+{
+    if (db == NULL) {
+        log_database_not_initialized();
+        return SL_STATUS_FAIL;
+    }
+
+    sl_status_t result      = SL_STATUS_OK;
+    last_child_lookup.valid = false;
+    for (size_t offset = 0; offset < count; offset += DATASTORE_ATTRIBUTE_DELETE_BATCH_SIZE) {
+        for (size_t i = 0; i < DATASTORE_ATTRIBUTE_DELETE_BATCH_SIZE; i++) {
+            datastore_attribute_id_t id = (offset + i < count) ? ids[offset + i] : 0;
+            if (sqlite3_bind_int64(delete_batch_statement, (int)i + 1, id) != SQLITE_OK) {
+                log_binding_failed();
+                sqlite3_reset(delete_batch_statement);
+                return SL_STATUS_FAIL;
+            }
+        }
+
+        int step = sqlite3_step(delete_batch_statement);
+        if (step != SQLITE_DONE && step != SQLITE_ROW) {
+            sl_log_error(LOG_TAG, "Batch delete failed: %s\n", sqlite3_errmsg(db));
+            result = SL_STATUS_FAIL;
+        }
+        sqlite3_reset(delete_batch_statement);
+    }
+
     return result;
 }
 
@@ -486,7 +711,8 @@ sl_status_t datastore_delete_all_attributes()
         return SL_STATUS_FAIL;
     }
 
-    int rc = datastore_exec_sql("DELETE FROM " DATASTORE_TABLE_ATTRIBUTES ";");
+    last_child_lookup.valid = false;
+    int rc                  = datastore_exec_sql("DELETE FROM " DATASTORE_TABLE_ATTRIBUTES ";");
 
     if (rc != SQLITE_OK) {
         sl_log_error(LOG_TAG, "SQL Error: Failed to execute statement: %s\n", sqlite3_errmsg(db));
@@ -0,0 +1,248 @@
+/******************************************************************************
+ * # License
+ * <b>Copyright 2026 Silicon Laboratories Inc. www.silabs.com</b>
+ ******************************************************************************
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ *****************************************************************************/
+// Includes from this component
+#include "datastore.h"
+#include "datastore_checkpoint.h"
+#include "datastore_internals.h"
+
+// Includes from other components
+#include "log.h"
+#include "sl_status.h"
+
+// Generic includes
+#include <sqlite3.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+
+// Setup Log ID
+#define LOG_TAG "datastore_checkpoint"
+
+////////////////////////////////////////////////////////////////////////////////
+// Private variables
+////////////////////////////////////////////////////////////////////////////////
+// The WAL hook runs on the thread committing to the database, while the
+// limit and the statistics are accessed from other threads.
+static _Atomic uint32_t wal_size_limit = DATASTORE_DEFAULT_WAL_SIZE_LIMIT;
+static uint32_t page_size              = 4096;
+// Pages in the WAL, and how many of them are already copied to the database
+static _Atomic uint32_t wal_pages              = 0;
+static _Atomic uint32_t wal_checkpointed_pages = 0;
+static struct {
+        _Atomic uint32_t checkpoint_count;
+        _Atomic uint32_t truncate_checkpoint_count;
+        _Atomic uint32_t last_checkpoint_duration_ms;
+        _Atomic uint32_t max_checkpoint_duration_ms;
+        _Atomic uint32_t last_checkpoint_pages;
+        _Atomic uint64_t total_checkpoint_pages;
+} statistics;
+
+static const char *synchronous_level_names[] = {"off", "normal", "full", "extra"};
+
+////////////////////////////////////////////////////////////////////////////////
+// Private functions
+////////////////////////////////////////////////////////////////////////////////
+static uint32_t elapsed_ms(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000);
+}
+
+static sl_status_t run_checkpoint(int mode)
+{
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int log_pages          = 0;
+    int checkpointed_pages = 0;
+    int rc                 = sqlite3_wal_checkpoint_v2(db, NULL, mode, &log_pages, &checkpointed_pages);
+    uint32_t duration_ms   = elapsed_ms(&start);
+    if (rc != SQLITE_OK) {
+        sl_log_warning(LOG_TAG, "WAL checkpoint failed: %s\n", sqlite3_errmsg(db));
+        return SL_STATUS_FAIL;
+    }
+
+    if (log_pages < 0) {
+        // The database is not in WAL mode, nothing was done.
+        return SL_STATUS_OK;
+    }
+
+    // checkpointed_pages counts all the WAL pages copied so far, including by
+    // earlier checkpoints. A truncated WAL reports 0 pages, it had wal_pages.
+    uint32_t copied_pages      = (mode == SQLITE_CHECKPOINT_TRUNCATE) ? atomic_load(&wal_pages) : (uint32_t)checkpointed_pages;
+    uint32_t previously_copied = atomic_load(&wal_checkpointed_pages);
+    uint32_t written_pages     = (copied_pages > previously_copied) ? copied_pages - previously_copied : 0;
+    if (mode == SQLITE_CHECKPOINT_TRUNCATE) {
+        atomic_store(&wal_pages, 0);
+        atomic_store(&wal_checkpointed_pages, 0);
+        atomic_fetch_add(&statistics.truncate_checkpoint_count, 1);
+    } else {
+        atomic_store(&wal_pages, (uint32_t)log_pages);
+        atomic_store(&wal_checkpointed_pages, (uint32_t)checkpointed_pages);
+    }
+    atomic_fetch_add(&statistics.checkpoint_count, 1);
+    atomic_store(&statistics.last_checkpoint_duration_ms, duration_ms);
+    uint32_t max_duration_ms = atomic_load(&statistics.max_checkpoint_duration_ms);
+    while (duration_ms > max_duration_ms && !atomic_compare_exchange_weak(&statistics.max_checkpoint_duration_ms, &max_duration_ms, duration_ms)) {
+    }
+    atomic_store(&statistics.last_checkpoint_pages, written_pages);
+    atomic_fetch_add(&statistics.total_checkpoint_pages, written_pages);
+    sl_log_debug(LOG_TAG, "%s checkpoint wrote %d pages in %d ms\n", (mode == SQLITE_CHECKPOINT_TRUNCATE) ? "Truncating" : "Passive", written_pages, duration_ms);
+    return SL_STATUS_OK;
+}
+
+/**
+ * @brief Invoked by SQLite after each commit, with the number of pages in the WAL.
+ */
+static int on_wal_commit(void *context, sqlite3 *handle, const char *database, int pages)
+{
+    (void)context;
+    (void)handle;
+    (void)database;
+    if (pages < (int)atomic_load(&wal_pages)) {
+        // The WAL was rewound: it was fully checkpointed and is being reused.
+        atomic_store(&wal_checkpointed_pages, 0);
+    }
+    atomic_store(&wal_pages, (uint32_t)pages);
+    uint32_t size_limit = atomic_load(&wal_size_limit);
+    if (size_limit > 0 && (uint64_t)pages * page_size > size_limit) {
+        run_checkpoint(SQLITE_CHECKPOINT_TRUNCATE);
+    }
+    return SQLITE_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Functions shared within the component
+////////////////////////////////////////////////////////////////////////////////
+sl_status_t datastore_checkpoint_init()
+{
+    atomic_store(&statistics.checkpoint_count, 0);
+    atomic_store(&statistics.truncate_checkpoint_count, 0);
+    atomic_store(&statistics.last_checkpoint_duration_ms, 0);
+    atomic_store(&statistics.max_checkpoint_duration_ms, 0);
+    atomic_store(&statistics.last_checkpoint_pages, 0);
+    atomic_store(&statistics.total_checkpoint_pages, 0);
+    atomic_store(&wal_pages, 0);
+    atomic_store(&wal_checkpointed_pages, 0);
+
+    // Checkpoints are scheduled by this module rather than by SQLite after
+    // every 1000 pages, which would make commits randomly slow.
+    int rc = datastore_exec_sql("PRAGMA wal_autocheckpoint = 0;");
+    if (rc != SQLITE_OK) {
+        return SL_STATUS_FAIL;
+    }
+
+    sqlite3_stmt *stmt = NULL;
+    rc                 = sqlite3_prepare_v2(db, "PRAGMA journal_mode = WAL;", -1, &stmt, NULL);
+    if (rc != SQLITE_OK) {
+        sl_log_error(LOG_TAG, "Failed to set the journal mode: %s\n", sqlite3_errmsg(db));
+        return SL_STATUS_FAIL;
+    }
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        // In memory databases keep their "memory" journal mode.
+        sl_log_debug(LOG_TAG, "Datastore journal mode: %s\n", sqlite3_column_text(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+
+    rc = sqlite3_prepare_v2(db, "PRAGMA page_size;", -1, &stmt, NULL);
+    if (rc == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        page_size = (uint32_t)sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+
+    sqlite3_wal_hook(db, on_wal_commit, NULL);
+    return SL_STATUS_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public functions
+////////////////////////////////////////////////////////////////////////////////
+sl_status_t datastore_set_synchronous_level(datastore_synchronous_level_t level)
+{
+    if (db == NULL) {
+        sl_log_error(LOG_TAG, "Datastore is not initialized\n");
+        return SL_STATUS_FAIL;
+    }
+    if ((size_t)level >= sizeof(synchronous_level_names) / sizeof(synchronous_level_names[0])) {
+        return SL_STATUS_FAIL;
+    }
+
+    char sql[40] = {0};
+    snprintf(sql, sizeof(sql), "PRAGMA synchronous = %d;", (int)level);
+    if (datastore_exec_sql(sql) != SQLITE_OK) {
+        return SL_STATUS_FAIL;
+    }
+    sl_log_info(LOG_TAG, "Datastore synchronous level: %s\n", synchronous_level_names[level]);
+    return SL_STATUS_OK;
+}
+
+sl_status_t datastore_synchronous_level_from_string(const char *name, datastore_synchronous_level_t *level)
+{
+    for (size_t i = 0; name != NULL && i < sizeof(synchronous_level_names) / sizeof(synchronous_level_names[0]); i++) {
+        if (strcasecmp(name, synchronous_level_names[i]) == 0) {
+            *level = (datastore_synchronous_level_t)i;
+            return SL_STATUS_OK;
+        }
+    }
+    return SL_STATUS_INVALID_PARAMETER;
+}
+
+void datastore_set_wal_size_limit(uint32_t size_bytes)
+{
+    atomic_store(&wal_size_limit, size_bytes);
+}
+
+sl_status_t datastore_checkpoint(bool truncate)
+{
+    if (db == NULL) {
+        sl_log_error(LOG_TAG, "Datastore is not initialized\n");
+        return SL_STATUS_FAIL;
+    }
+    return run_checkpoint(truncate ? SQLITE_CHECKPOINT_TRUNCATE : SQLITE_CHECKPOINT_PASSIVE);
+}
+
+sl_status_t datastore_checkpoint_if_idle()
+{
+    if (db == NULL) {
+        return SL_STATUS_FAIL;
+    }
+    if (atomic_load(&wal_checkpointed_pages) >= atomic_load(&wal_pages)) {
+        return SL_STATUS_NOT_READY;
+    }
+    return run_checkpoint(SQLITE_CHECKPOINT_PASSIVE);
+}
+
+void datastore_get_checkpoint_statistics(datastore_checkpoint_statistics_t *checkpoint_statistics)
+{
+    checkpoint_statistics->wal_pages                   = atomic_load(&wal_pages);
+    checkpoint_statistics->checkpoint_count            = atomic_load(&statistics.checkpoint_count);
+    checkpoint_statistics->truncate_checkpoint_count   = atomic_load(&statistics.truncate_checkpoint_count);
+    checkpoint_statistics->last_checkpoint_duration_ms = atomic_load(&statistics.last_checkpoint_duration_ms);
+    checkpoint_statistics->max_checkpoint_duration_ms  = atomic_load(&statistics.max_checkpoint_duration_ms);
+    checkpoint_statistics->last_checkpoint_pages       = atomic_load(&statistics.last_checkpoint_pages);
+    checkpoint_statistics->total_checkpoint_pages      = atomic_load(&statistics.total_checkpoint_pages);
+    checkpoint_statistics->wal_size_bytes              = 0;
+
+    const char *database_file = datastore_get_file_path();
+    if (database_file[0] != '\0') {
+        char wal_file[512] = {0};
+        struct stat wal_stat;
+        snprintf(wal_file, sizeof(wal_file), "%s-wal", database_file);
+        if (stat(wal_file, &wal_stat) == 0) {
+            checkpoint_statistics->wal_size_bytes = (uint64_t)wal_stat.st_size;
+        }
+    }
+}
@@ -76,6 +76,8 @@ sl_status_t datastore_attribute_statement_init();
  */
 sl_status_t datastore_attribute_statement_teardown();
 
+sl_status_t datastore_checkpoint_init();
+
 #ifdef __cplusplus
 }
 #endif
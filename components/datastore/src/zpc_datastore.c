@@ -18,6 +18,7 @@
 #include "datastore_fixt.h"
 #include "zpc_config.h"
 #include "datastore.h"
+#include "datastore_checkpoint.h"
 #include "log.h"
 
 #define LOG_TAG "zpc_datastore_fixt"
@@ -30,7 +31,18 @@ sl_status_t zpc_datastore_fixt_setup()
         sl_log_error(LOG_TAG,
                      "Please erase or recover your datastore using the ZPC "
                      "datastore tools");
+        return res;
     }
 
+    datastore_synchronous_level_t synchronous_level = DATASTORE_SYNCHRONOUS_FULL;
+    if (datastore_synchronous_level_from_string(zpc_get_config()->datastore_synchronous, &synchronous_level) != SL_STATUS_OK) {
+        sl_log_error(LOG_TAG, "Invalid zpc.datastore_synchronous '%s'. Valid values: off, normal, full, extra", zpc_get_config()->datastore_synchronous);
+        return SL_STATUS_FAIL;
+    }
+    res = datastore_set_synchronous_level(synchronous_level);
+
+    int wal_size_limit_kb = zpc_get_config()->datastore_wal_size_limit_kb;
+    datastore_set_wal_size_limit((wal_size_limit_kb > 0) ? (uint32_t)wal_size_limit_kb * 1024 : 0);
+
     return res;
 }
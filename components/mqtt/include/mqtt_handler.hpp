@@ -18,12 +18,16 @@
 #include <cstdint>
 #include <chrono>
 #include <string>
+#include <deque>
 #include <map>
+#include <optional>
+#include <unordered_map>
 #include <vector>
 #include <set>
 #include <functional>
 #include <memory>
 #include <mutex>
+#include "mqtt_topic_trie.hpp"
 #include "threading.hpp"
 #include "safe_queue.hpp"
 #include "init_builder.hpp"
@@ -67,6 +71,41 @@ namespace zwave_component
 
             void reset_subscriptions(zwave_home_id_t new_home_id);
 
+            /// Metrics of the publish pipeline as a whole.
+            struct publish_statistics {
+                    /// Publishes waiting to be handed to the client
+                    size_t queue_depth = 0;
+                    /// Highest queue_depth observed
+                    size_t max_queue_depth = 0;
+                    /// Publishes handed to the client and not yet completed
+                    size_t in_flight = 0;
+                    /// Publishes completed
+                    uint64_t published = 0;
+                    /// Publishes whose delivery failed
+                    uint64_t failed = 0;
+                    /// Retained publishes replaced by a newer payload while queued
+                    uint64_t coalesced = 0;
+                    /// Non-retained publishes dropped because the queue was full
+                    uint64_t dropped = 0;
+                    /// Time from publish() to completion of the last publish, in microseconds
+                    uint32_t last_latency_us = 0;
+                    /// Longest time from publish() to completion, in microseconds
+                    uint32_t max_latency_us = 0;
+            };
+
+            /// Metrics of the publish pipeline for one topic.
+            struct topic_publish_statistics {
+                    size_t queued            = 0;
+                    size_t in_flight         = 0;
+                    uint64_t published       = 0;
+                    uint64_t coalesced       = 0;
+                    uint32_t last_latency_us = 0;
+                    uint32_t max_latency_us  = 0;
+            };
+
+            publish_statistics get_publish_statistics() const;
+            std::optional<topic_publish_statistics> get_topic_publish_statistics(const std::string &topic) const;
+
             // Delete copy constructor and assignment operator
             mqtt_handler(const mqtt_handler &)            = delete;
             mqtt_handler &operator=(const mqtt_handler &) = delete;
@@ -97,6 +136,25 @@ namespace zwave_component
                     std::string topic;
                     std::string message;
                     bool retain;
+                    uint64_t sequence;
+                    std::chrono::steady_clock::time_point enqueued;
+                    bool live = true;  // false once dropped, skipped when dequeued
+            };
+
+            // Publish handed to the client, waiting for its delivery token
+            struct in_flight_publish {
+                    mqtt::delivery_token_ptr token;
+                    std::string topic;
+                    std::chrono::steady_clock::time_point enqueued;
+                    bool clears_topic;  // empty retained payload, removing the topic from the broker
+            };
+
+            // Queue bookkeeping for one topic, dropped once a publish clearing
+            // the topic completed with nothing else queued or in flight for it
+            struct topic_publish_state {
+                    uint64_t last_sequence = 0;  // newest queued publish for the topic
+                    bool last_retained     = false;
+                    topic_publish_statistics statistics;
             };
 
             // Subscribe message queue entry
@@ -122,7 +180,6 @@ namespace zwave_component
             };
 
             // Helper functions
-            static bool topic_matches_sub(const std::string &sub, const std::string &topic);
             void handle_message(const std::string &topic, const std::string &message);
             void on_connect_internal();
             void on_disconnect_internal();
@@ -130,6 +187,8 @@ namespace zwave_component
             constexpr static std::chrono::milliseconds mqtt_client_poll_interval = std::chrono::milliseconds(100);  // MQTT_CLIENT_POLL_TIMER_MILLISECONDS
             constexpr static int mqtt_keep_alive_interval                        = 60;                              // seconds
             constexpr static int mqtt_qos                                        = 0;
+            constexpr static size_t mqtt_publish_max_in_flight                   = 64;
+            constexpr static size_t mqtt_publish_queue_max_depth                 = 500;
 
             struct config {
                     std::string client_id;
@@ -147,7 +206,8 @@ namespace zwave_component
 
             // Shared state — protected by client_mutex.
             // Accessed from the handler thread (_internal methods) and Paho callback threads.
-            std::map<std::string, std::vector<subscription_callback_t>> subscription_callbacks;
+            // Callbacks per topic filter, indexed by topic level for handle_message.
+            topic_trie<std::vector<subscription_callback_t>> subscription_callbacks;
             std::set<std::string> retained_topics;
             std::mutex client_mutex;
 
@@ -158,18 +218,38 @@ namespace zwave_component
 
             // Operation queues — thread-safe, used to pass work to the handler thread.
             // Public methods enqueue; run() dequeues and processes.
-            ::threading::safe_queue<publish_message> publish_queue;
             ::threading::safe_queue<subscribe_message> subscribe_queue;
             ::threading::safe_queue<unsubscribe_message> unsubscribe_queue;
             ::threading::safe_queue<unretain_message> unretain_queue;
             ::threading::safe_queue<reset_subscriptions_message> reset_queue;
 
+            // Publish pipeline — protected by publish_mutex.
+            // publish() appends to publish_queue; the handler thread hands messages to the
+            // client in queue order without waiting for each delivery, keeping at most
+            // mqtt_publish_max_in_flight outstanding. A retained publish replaces the payload
+            // of a still-queued retained publish on the same topic. Sequence numbers in
+            // publish_queue are contiguous, dropped entries stay as tombstones.
+            std::deque<publish_message> publish_queue;
+            std::deque<uint64_t> transient_sequences;  // queued non-retained publishes, oldest first
+            std::unordered_map<std::string, topic_publish_state> publish_topics;
+            uint64_t next_publish_sequence = 0;
+            publish_statistics publish_stats;
+            mutable std::mutex publish_mutex;
+
+            // Outstanding delivery tokens, oldest first — handler thread only.
+            std::deque<in_flight_publish> in_flight_publishes;
+
+            void enqueue_publish(const std::string &topic, const std::string &message, bool retain);
+            std::optional<publish_message> pop_publish();
+            bool pump_publish_queue();
+            void reap_publishes(std::chrono::milliseconds timeout);
+
             // Internal methods — run only on the handler thread.
             // Lock client_mutex briefly for shared-state updates, then release before
             // calling any Paho API. This avoids ABBA deadlock between client_mutex and
             // Paho's internal mqttasync_mutex (held by the receive thread when it
             // delivers messages via handle_message, which also needs client_mutex).
-            void publish_internal(const std::string &topic, const std::string &message, bool retain);
+            void publish_internal(const publish_message &msg);
             void subscribe_internal(const std::string &topic, const subscription_callback_t &callback);
             void unsubscribe_internal(const std::string &topic, const subscription_callback_t &callback);
             void unretain_internal(const std::string &prefix);
@@ -0,0 +1,386 @@
+/******************************************************************************
+ * # License
+ * <b>Copyright 2026 Silicon Laboratories Inc. www.silabs.com</b>
+ ******************************************************************************
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ *****************************************************************************/
+
+#ifndef MQTT_TOPIC_TRIE_HPP
+#define MQTT_TOPIC_TRIE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace zwave_component
+{
+    /**
+     * @brief Map from MQTT topic filters to values, searchable by topic
+     *
+     * Filters are stored in a trie with one node per topic level, where the
+     * `+` and `#` wildcard levels have their own branches. Inserting, erasing
+     * and finding the values of the filters matching a topic therefore cost a
+     * number of steps proportional to the number of topic levels, whatever
+     * the number of filters.
+     *
+     * Matching follows matches(): a wildcard does not match an empty last
+     * topic level, `a/#` does not match `a`, and `a/+` matches `a/b/`.
+     * Filters that the levels cannot describe (a wildcard not filling a whole
+     * level, `#` before the last level, or a trailing `+/`) are kept aside
+     * and compared with matches() one by one.
+     *
+     * @tparam T Type of the value stored per filter
+     */
+    template<typename T> class topic_trie
+    {
+        public:
+            /**
+             * @brief Tells if a topic matches a filter
+             *
+             * Supports # (multi-level wildcard) and + (single-level wildcard).
+             */
+            static bool matches(std::string_view sub, std::string_view topic)
+            {
+                auto sub_it          = sub.begin();
+                auto topic_it        = topic.begin();
+                const auto sub_end   = sub.end();
+                const auto topic_end = topic.end();
+
+                while (sub_it != sub_end && topic_it != topic_end) {
+                    if (*sub_it == MULTI_WILDCARD) {
+                        // Multi-level wildcard matches everything from here
+                        return true;
+                    }
+
+                    if (*sub_it == SINGLE_WILDCARD) {
+                        // Single-level wildcard - skip to next separator in both strings
+                        sub_it   = std::find(sub_it, sub_end, TOPIC_SEPARATOR);
+                        topic_it = std::find(topic_it, topic_end, TOPIC_SEPARATOR);
+
+                        // Skip the separator itself if present
+                        if (sub_it != sub_end) {
+                            ++sub_it;
+                        }
+                        if (topic_it != topic_end) {
+                            ++topic_it;
+                        }
+                        continue;
+                    }
+
+                    // Literal character match
+                    if (*sub_it == *topic_it) {
+                        ++sub_it;
+                        ++topic_it;
+                    } else {
+                        return false;
+                    }
+                }
+
+                // Both strings should be exhausted for a match
+                return (sub_it == sub_end && topic_it == topic_end);
+            }
+
+            /**
+             * @brief Returns the value of a filter, inserting a default one if missing
+             */
+            T &operator[](const std::string &filter)
+            {
+                if (!is_well_formed(filter)) {
+                    auto it = std::find_if(irregular.begin(), irregular.end(), [&](const auto &entry) { return entry.first == filter; });
+                    if (it == irregular.end()) {
+                        irregular.emplace_back(filter, T {});
+                        filter_count++;
+                        return irregular.back().second;
+                    }
+                    return it->second;
+                }
+                node *current = &root;
+                for_each_level(filter, [&](std::string_view level) {
+                    std::unique_ptr<node> *child = current->child(level);
+                    if (*child == nullptr) {
+                        *child = std::make_unique<node>();
+                    }
+                    current = child->get();
+                });
+                if (!current->value.has_value()) {
+                    current->value.emplace(filter, T {});
+                    filter_count++;
+                }
+                return current->value->second;
+            }
+
+            /**
+             * @brief Returns the value of a filter, nullptr if the filter is not in the trie
+             */
+            T *find(const std::string &filter)
+            {
+                if (!is_well_formed(filter)) {
+                    auto it = std::find_if(irregular.begin(), irregular.end(), [&](const auto &entry) { return entry.first == filter; });
+                    return (it != irregular.end()) ? &it->second : nullptr;
+                }
+                node *current = &root;
+                bool found    = true;
+                for_each_level(filter, [&](std::string_view level) {
+                    if (found) {
+                        std::unique_ptr<node> *child = current->find_child(level);
+                        found                        = (child != nullptr);
+                        current                      = found ? child->get() : nullptr;
+                    }
+                });
+                return (found && current->value.has_value()) ? &current->value->second : nullptr;
+            }
+
+            /**
+             * @brief Removes a filter and its value
+             *
+             * @return true if the filter was in the trie
+             */
+            bool erase(const std::string &filter)
+            {
+                if (!is_well_formed(filter)) {
+                    auto it = std::find_if(irregular.begin(), irregular.end(), [&](const auto &entry) { return entry.first == filter; });
+                    if (it == irregular.end()) {
+                        return false;
+                    }
+                    irregular.erase(it);
+                    filter_count--;
+                    return true;
+                }
+                // Remember the path to prune the nodes left empty.
+                std::vector<std::pair<node *, std::unique_ptr<node> *>> path;
+                node *current = &root;
+                bool found    = true;
+                for_each_level(filter, [&](std::string_view level) {
+                    if (found) {
+                        std::unique_ptr<node> *child = current->find_child(level);
+                        found                        = (child != nullptr);
+                        if (found) {
+                            path.emplace_back(current, child);
+                            current = child->get();
+                        }
+                    }
+                });
+                if (!found || !current->value.has_value()) {
+                    return false;
+                }
+                current->value.reset();
+                filter_count--;
+                for (auto it = path.rbegin(); it != path.rend(); ++it) {
+                    if (!(*it->second)->empty()) {
+                        break;
+                    }
+                    it->first->remove_child(it->second);
+                }
+                return true;
+            }
+
+            /**
+             * @brief Calls visit(value) for each filter matching a topic
+             */
+            template<typename Visitor> void match(std::string_view topic, Visitor &&visit) const
+            {
+                std::vector<std::string_view> levels;
+                for_each_level(topic, [&](std::string_view level) { levels.push_back(level); });
+                match_from(root, levels, 0, visit);
+                for (const auto &[filter, value]: irregular) {
+                    if (matches(filter, topic)) {
+                        visit(value);
+                    }
+                }
+            }
+
+            /**
+             * @brief Calls visit(filter, value) for each filter in the trie
+             */
+            template<typename Visitor> void for_each(Visitor &&visit) const
+            {
+                for_each_from(root, visit);
+                for (const auto &[filter, value]: irregular) {
+                    visit(filter, value);
+                }
+            }
+
+            /**
+             * @brief Number of filters in the trie
+             */
+            size_t size() const
+            {
+                return filter_count;
+            }
+
+            /**
+             * @brief Tells if the trie holds no filter
+             */
+            bool empty() const
+            {
+                return filter_count == 0;
+            }
+
+        private:
+            static constexpr char MULTI_WILDCARD  = '#';
+            static constexpr char SINGLE_WILDCARD = '+';
+            static constexpr char TOPIC_SEPARATOR = '/';
+
+            struct level_hash {
+                    using is_transparent = void;
+                    size_t operator()(std::string_view level) const
+                    {
+                        return std::hash<std::string_view>()(level);
+                    }
+            };
+
+            struct node {
+                    std::unordered_map<std::string, std::unique_ptr<node>, level_hash, std::equal_to<>> children;
+                    std::unique_ptr<node> single_wildcard;
+                    std::unique_ptr<node> multi_wildcard;
+                    /// Filter ending at this node, and its value.
+                    std::optional<std::pair<std::string, T>> value;
+
+                    std::unique_ptr<node> *child(std::string_view level)
+                    {
+                        if (level.size() == 1 && level[0] == SINGLE_WILDCARD) {
+                            return &single_wildcard;
+                        }
+                        if (level.size() == 1 && level[0] == MULTI_WILDCARD) {
+                            return &multi_wildcard;
+                        }
+                        auto it = children.find(level);
+                        if (it == children.end()) {
+                            it = children.emplace(std::string(level), nullptr).first;
+                        }
+                        return &it->second;
+                    }
+
+                    std::unique_ptr<node> *find_child(std::string_view level)
+                    {
+                        if (level.size() == 1 && level[0] == SINGLE_WILDCARD) {
+                            return single_wildcard ? &single_wildcard : nullptr;
+                        }
+                        if (level.size() == 1 && level[0] == MULTI_WILDCARD) {
+                            return multi_wildcard ? &multi_wildcard : nullptr;
+                        }
+                        auto it = children.find(level);
+                        return (it != children.end()) ? &it->second : nullptr;
+                    }
+
+                    void remove_child(std::unique_ptr<node> *child)
+                    {
+                        if (child == &single_wildcard || child == &multi_wildcard) {
+                            child->reset();
+                            return;
+                        }
+                        for (auto it = children.begin(); it != children.end(); ++it) {
+                            if (&it->second == child) {
+                                children.erase(it);
+                                return;
+                            }
+                        }
+                    }
+
+                    bool empty() const
+                    {
+                        return !value.has_value() && children.empty() && !single_wildcard && !multi_wildcard;
+                    }
+            };
+
+            template<typename Function> static void for_each_level(std::string_view topic, Function &&function)
+            {
+                size_t start = 0;
+                while (true) {
+                    const size_t end = topic.find(TOPIC_SEPARATOR, start);
+                    if (end == std::string_view::npos) {
+                        function(topic.substr(start));
+                        return;
+                    }
+                    function(topic.substr(start, end - start));
+                    start = end + 1;
+                }
+            }
+
+            /// Filters where wildcards fill whole levels, with `#` last only, and
+            /// not ending with `+/` (which matches() also lets match `a/b`).
+            static bool is_well_formed(std::string_view filter)
+            {
+                bool well_formed = true;
+                std::string_view previous;
+                std::string_view last;
+                size_t level_count = 0;
+                for_each_level(filter, [&](std::string_view level) {
+                    if (last == "#" && level_count > 0) {
+                        well_formed = false;
+                    }
+                    if (level.size() > 1 && level.find_first_of("+#") != std::string_view::npos) {
+                        well_formed = false;
+                    }
+                    previous = last;
+                    last     = level;
+                    level_count++;
+                });
+                return well_formed && !(level_count > 1 && last.empty() && previous == "+");
+            }
+
+            template<typename Visitor> static void match_from(const node &current, const std::vector<std::string_view> &levels, size_t depth, Visitor &visit)
+            {
+                if (depth == levels.size()) {
+                    if (current.value.has_value()) {
+                        visit(current.value->second);
+                    }
+                    return;
+                }
+                const std::string_view level = levels[depth];
+                if (auto it = current.children.find(level); it != current.children.end()) {
+                    match_from(*it->second, levels, depth + 1, visit);
+                }
+                // Wildcards do not match an empty last level, see matches().
+                if (depth + 1 == levels.size() && level.empty()) {
+                    return;
+                }
+                if (current.single_wildcard) {
+                    match_from(*current.single_wildcard, levels, depth + 1, visit);
+                    // A trailing + also takes the separator of an empty last level.
+                    if (depth + 2 == levels.size() && levels.back().empty() && current.single_wildcard->value.has_value()) {
+                        visit(current.single_wildcard->value->second);
+                    }
+                }
+                if (current.multi_wildcard && current.multi_wildcard->value.has_value()) {
+                    visit(current.multi_wildcard->value->second);
+                }
+            }
+
+            template<typename Visitor> static void for_each_from(const node &current, Visitor &visit)
+            {
+                if (current.value.has_value()) {
+                    visit(current.value->first, current.value->second);
+                }
+                for (const auto &[level, child]: current.children) {
+                    for_each_from(*child, visit);
+                }
+                if (current.single_wildcard) {
+                    for_each_from(*current.single_wildcard, visit);
+                }
+                if (current.multi_wildcard) {
+                    for_each_from(*current.multi_wildcard, visit);
+                }
+            }
+
+            node root;
+            /// Filters that are not well formed, matched one by one.
+            std::vector<std::pair<std::string, T>> irregular;
+            size_t filter_count = 0;
+    };
+}  // namespace zwave_component
+
+#endif  // MQTT_TOPIC_TRIE_HPP
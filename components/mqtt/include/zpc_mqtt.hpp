@@ -92,6 +92,16 @@ namespace zpc_mqtt
      */
     void register_value_transformation(attribute_store_type_t attribute_type, const mqtt_value_encoder &encoder);
 
+    /**
+     * @brief Forget all the registered attributes and their cached topics
+     *
+     * Call it when shutting down, before the Attribute Store is torn down.
+     * Attributes can be registered again afterwards.
+     *
+     * @return 0 on success
+     */
+    int teardown();
+
 #ifdef __cplusplus
     }
 #endif
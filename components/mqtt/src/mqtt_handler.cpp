@@ -12,6 +12,7 @@
  *****************************************************************************/
 
 #include "mqtt_handler.hpp"
+#include "zpc_mqtt.hpp"  // zpc_mqtt::teardown
 #include "init_builder.hpp"
 #include "threading.hpp"
 #include "log.h"
@@ -29,7 +30,6 @@
 namespace zwave_component
 {
     [[maybe_unused]] static constexpr std::string_view LOG_TAG = "mqtt";
-    static constexpr size_t MQTT_PUBLISH_QUEUE_MAX_DEPTH       = 500;
 
     static std::string stall_diag_topic_snippet(const std::string &topic)
     {
@@ -40,53 +40,6 @@ namespace zwave_component
         return topic.substr(0, max_len);
     }
 
-    // Helper function for MQTT topic matching
-    // Supports # (multi-level wildcard) and + (single-level wildcard)
-    bool mqtt_handler::topic_matches_sub(const std::string &sub, const std::string &topic)
-    {
-        constexpr char MULTI_WILDCARD  = '#';
-        constexpr char SINGLE_WILDCARD = '+';
-        constexpr char TOPIC_SEPARATOR = '/';
-
-        auto sub_it          = sub.begin();
-        auto topic_it        = topic.begin();
-        const auto sub_end   = sub.end();
-        const auto topic_end = topic.end();
-
-        while (sub_it != sub_end && topic_it != topic_end) {
-            if (*sub_it == MULTI_WILDCARD) {
-                // Multi-level wildcard matches everything from here
-                return true;
-            }
-
-            if (*sub_it == SINGLE_WILDCARD) {
-                // Single-level wildcard - skip to next separator in both strings
-                sub_it   = std::find(sub_it, sub_end, TOPIC_SEPARATOR);
-                topic_it = std::find(topic_it, topic_end, TOPIC_SEPARATOR);
-
-                // Skip the separator itself if present
-                if (sub_it != sub_end) {
-                    ++sub_it;
-                }
-                if (topic_it != topic_end) {
-                    ++topic_it;
-                }
-                continue;
-            }
-
-            // Literal character match
-            if (*sub_it == *topic_it) {
-                ++sub_it;
-                ++topic_it;
-            } else {
-                return false;
-            }
-        }
-
-        // Both strings should be exhausted for a match
-        return (sub_it == sub_end && topic_it == topic_end);
-    }
-
     // Paho callback implementation
     void mqtt_handler::mqtt_callback::connected(const std::string &cause)
     {
@@ -185,6 +138,7 @@ namespace zwave_component
             conn_opts.set_clean_session(true);
             conn_opts.set_keep_alive_interval(mqtt_keep_alive_interval);
             conn_opts.set_automatic_reconnect(true);
+            conn_opts.set_max_inflight(static_cast<int>(mqtt_publish_max_in_flight));
 
             // Configure TLS if certificates are provided
             if (!config.cafile.empty() && !config.certfile.empty() && !config.keyfile.empty()) {
@@ -242,7 +196,7 @@ namespace zwave_component
             int shutdown() override
             {
                 mqtt_handler::get_instance().stop();
-                return 0;
+                return zpc_mqtt::teardown();
             }
 
             std::string name() const override
@@ -296,19 +250,29 @@ namespace zwave_component
     void mqtt_handler::run()
     {
         if (!paho_client || !connected_.load()) {
+            // Tokens of publishes in flight when the connection dropped never complete.
+            in_flight_publishes.clear();
+            {
+                std::lock_guard<std::mutex> lock(publish_mutex);
+                publish_stats.in_flight = 0;
+                for (auto &[topic, state]: publish_topics) {
+                    state.statistics.in_flight = 0;
+                }
+            }
             std::this_thread::sleep_for(mqtt_client_poll_interval);
             return;
         }
 
         bool processed_any = false;
 
+        reap_publishes(std::chrono::milliseconds(0));
+
         while (auto msg = reset_queue.try_pop()) {
             reset_subscriptions_internal(msg->new_home_id);
             processed_any = true;
         }
 
-        while (auto msg = publish_queue.try_pop()) {
-            publish_internal(msg->topic, msg->message, msg->retain);
+        if (pump_publish_queue()) {
             processed_any = true;
         }
 
@@ -328,7 +292,11 @@ namespace zwave_component
         }
 
         if (!processed_any) {
-            std::this_thread::sleep_for(mqtt_client_poll_interval);
+            if (in_flight_publishes.empty()) {
+                std::this_thread::sleep_for(mqtt_client_poll_interval);
+            } else {
+                reap_publishes(mqtt_client_poll_interval);
+            }
         }
     }
 
@@ -367,23 +335,158 @@ namespace zwave_component
         // Always queue: callers may be on Paho's I/O thread (e.g. message_arrived
         // → handle_message → callback → publish). Calling paho_client->publish()->wait()
         // on that thread would deadlock because Paho needs the same thread for delivery.
-        if (publish_queue.size() >= MQTT_PUBLISH_QUEUE_MAX_DEPTH) {
-            publish_queue.try_pop();
-            sl_log_debug(LOG_TAG.data(),
-                         "MQTT publish queue overflow: queue_depth=%zu — "
-                         "dropped oldest message to cap queue",
-                         publish_queue.size());
+        enqueue_publish(topic, message, retain);
+    }
+
+    void mqtt_handler::enqueue_publish(const std::string &topic, const std::string &message, bool retain)
+    {
+        std::lock_guard<std::mutex> lock(publish_mutex);
+
+        topic_publish_state &state = publish_topics[topic];
+
+        // Retained topics carry state: if the previous publish for this topic is
+        // still queued, only the newest payload matters. It keeps its place in the
+        // queue so that ordering with other publishes on the topic is unchanged.
+        if (retain && state.last_retained && state.statistics.queued > 0) {
+            publish_message &queued = publish_queue[state.last_sequence - publish_queue.front().sequence];
+            queued.message          = message;
+            state.statistics.coalesced++;
+            publish_stats.coalesced++;
+            return;
+        }
+
+        // Drop the oldest non-retained publish to cap the queue. Retained publishes
+        // are never dropped; coalescing bounds them by the number of topics.
+        if (publish_stats.queue_depth >= mqtt_publish_queue_max_depth) {
+            while (!transient_sequences.empty()) {
+                uint64_t sequence = transient_sequences.front();
+                transient_sequences.pop_front();
+                publish_message &victim = publish_queue[sequence - publish_queue.front().sequence];
+                victim.live             = false;
+                victim.message.clear();
+                publish_topics[victim.topic].statistics.queued--;
+                publish_stats.queue_depth--;
+                publish_stats.dropped++;
+                sl_log_debug(LOG_TAG.data(), "MQTT publish queue overflow: queue_depth=%zu — dropped oldest non-retained message", publish_stats.queue_depth);
+                break;
+            }
         }
 
         publish_message pub_msg;
-        pub_msg.topic   = topic;
-        pub_msg.message = message;
-        pub_msg.retain  = retain;
+        pub_msg.topic    = topic;
+        pub_msg.message  = message;
+        pub_msg.retain   = retain;
+        pub_msg.sequence = next_publish_sequence++;
+        pub_msg.enqueued = std::chrono::steady_clock::now();
+
+        if (!retain) {
+            transient_sequences.push_back(pub_msg.sequence);
+        }
+        state.last_sequence = pub_msg.sequence;
+        state.last_retained = retain;
+        state.statistics.queued++;
+        publish_stats.queue_depth++;
+        publish_stats.max_queue_depth = std::max(publish_stats.max_queue_depth, publish_stats.queue_depth);
+
+        publish_queue.push_back(std::move(pub_msg));
+    }
+
+    std::optional<mqtt_handler::publish_message> mqtt_handler::pop_publish()
+    {
+        std::lock_guard<std::mutex> lock(publish_mutex);
+
+        while (!publish_queue.empty()) {
+            publish_message msg = std::move(publish_queue.front());
+            publish_queue.pop_front();
+            while (!transient_sequences.empty() && transient_sequences.front() <= msg.sequence) {
+                transient_sequences.pop_front();
+            }
+            if (!msg.live) {
+                continue;
+            }
+            publish_topics[msg.topic].statistics.queued--;
+            publish_stats.queue_depth--;
+            return msg;
+        }
+        return std::nullopt;
+    }
+
+    bool mqtt_handler::pump_publish_queue()
+    {
+        bool processed_any = false;
+
+        while (in_flight_publishes.size() < mqtt_publish_max_in_flight) {
+            auto msg = pop_publish();
+            if (!msg) {
+                break;
+            }
+            publish_internal(*msg);
+            processed_any = true;
+        }
+
+        // Window full: wait for the oldest publish instead of spinning.
+        if (in_flight_publishes.size() >= mqtt_publish_max_in_flight) {
+            reap_publishes(mqtt_client_poll_interval);
+        }
+        return processed_any;
+    }
+
+    void mqtt_handler::reap_publishes(std::chrono::milliseconds timeout)
+    {
+        while (!in_flight_publishes.empty()) {
+            in_flight_publish &front = in_flight_publishes.front();
 
-        publish_queue.push(std::move(pub_msg));
+            bool complete  = true;
+            bool delivered = true;
+            try {
+                complete = (timeout.count() > 0) ? front.token->wait_for(timeout) : front.token->is_complete();
+            } catch (const mqtt::exception &exc) {
+                sl_log_error(LOG_TAG.data(), "Error publishing to topic [%s]: %s", front.topic.c_str(), exc.what());
+                delivered = false;
+            }
+            if (!complete) {
+                return;
+            }
+
+            const auto latency_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - front.enqueued).count();
+            const auto latency    = static_cast<uint32_t>(std::min<int64_t>(latency_us, UINT32_MAX));
+            {
+                std::lock_guard<std::mutex> lock(publish_mutex);
+                if (publish_stats.in_flight > 0) {
+                    publish_stats.in_flight--;
+                }
+                if (delivered) {
+                    publish_stats.published++;
+                    publish_stats.last_latency_us = latency;
+                    publish_stats.max_latency_us  = std::max(publish_stats.max_latency_us, latency);
+                } else {
+                    publish_stats.failed++;
+                }
+
+                auto topic_state = publish_topics.find(front.topic);
+                if (topic_state != publish_topics.end()) {
+                    topic_publish_statistics &topic_stats = topic_state->second.statistics;
+                    if (topic_stats.in_flight > 0) {
+                        topic_stats.in_flight--;
+                    }
+                    if (delivered) {
+                        topic_stats.published++;
+                        topic_stats.last_latency_us = latency;
+                        topic_stats.max_latency_us  = std::max(topic_stats.max_latency_us, latency);
+                    }
+                    // The topic is gone from the broker, forget it unless it is in use again
+                    if (delivered && front.clears_topic && topic_stats.queued == 0 && topic_stats.in_flight == 0) {
+                        publish_topics.erase(topic_state);
+                    }
+                }
+            }
+
+            in_flight_publishes.pop_front();
+            timeout = std::chrono::milliseconds(0);
+        }
     }
 
-    void mqtt_handler::publish_internal(const std::string &topic, const std::string &message, bool retain)
+    void mqtt_handler::publish_internal(const publish_message &msg)
     {
         if (!paho_client || !connected_.load()) {
             sl_log_error(LOG_TAG.data(), "MQTT client not connected\n");
@@ -392,40 +495,49 @@ namespace zwave_component
 
         {
             std::lock_guard<std::mutex> lock(client_mutex);
-            if (retain) {
-                if (!message.empty()) {
-                    retained_topics.insert(topic);
-                } else {
-                    retained_topics.erase(topic);
-                }
+            if (msg.retain && !msg.message.empty()) {
+                retained_topics.insert(msg.topic);
             } else {
-                retained_topics.erase(topic);
+                retained_topics.erase(msg.topic);
             }
         }
 
-        const size_t queue_depth        = publish_queue.size();
-        const std::string topic_snippet = stall_diag_topic_snippet(topic);
-        const auto wait_start           = std::chrono::steady_clock::now();
-        if (queue_depth == 0) {
-            sl_log_debug(LOG_TAG.data(), "MQTT publish wait start: topic=%s queue_depth=%zu tid=%lu", topic_snippet.c_str(), queue_depth, sl_log_thread_id());
-        } else {
-            sl_log_debug(LOG_TAG.data(), "MQTT publish wait start: topic=%s queue_depth=%zu tid=%lu", topic_snippet.c_str(), queue_depth, sl_log_thread_id());
-        }
         try {
-            auto pubmsg = mqtt::make_message(topic, message);
+            auto pubmsg = mqtt::make_message(msg.topic, msg.message);
             pubmsg->set_qos(mqtt_qos);
-            pubmsg->set_retained(retain);
-            paho_client->publish(pubmsg)->wait();
-            const auto wait_end = std::chrono::steady_clock::now();
-            const auto wait_ms  = std::chrono::duration_cast<std::chrono::milliseconds>(wait_end - wait_start).count();
-            sl_log_debug(LOG_TAG.data(), "MQTT publish wait done: topic=%s queue_depth=%zu wait_ms=%lld tid=%lu", topic_snippet.c_str(), publish_queue.size(), static_cast<long long>(wait_ms), sl_log_thread_id());
-            sl_log_debug(LOG_TAG.data(), "Published to topic: %s\n", topic.c_str());
+            pubmsg->set_retained(msg.retain);
+
+            in_flight_publish pending;
+            pending.token        = paho_client->publish(pubmsg);
+            pending.topic        = msg.topic;
+            pending.enqueued     = msg.enqueued;
+            pending.clears_topic = msg.retain && msg.message.empty();
+            in_flight_publishes.push_back(std::move(pending));
+
+            std::lock_guard<std::mutex> lock(publish_mutex);
+            publish_topics[msg.topic].statistics.in_flight++;
+            publish_stats.in_flight++;
         } catch (const mqtt::exception &exc) {
-            sl_log_debug(LOG_TAG.data(), "MQTT publish wait fail: topic=%s exc=%s tid=%lu", topic_snippet.c_str(), exc.what(), sl_log_thread_id());
-            sl_log_error(LOG_TAG.data(), "Error publishing to topic [%s]: %s", topic.c_str(), exc.what());
+            sl_log_error(LOG_TAG.data(), "Error publishing to topic [%s]: %s", msg.topic.c_str(), exc.what());
         }
     }
 
+    mqtt_handler::publish_statistics mqtt_handler::get_publish_statistics() const
+    {
+        std::lock_guard<std::mutex> lock(publish_mutex);
+        return publish_stats;
+    }
+
+    std::optional<mqtt_handler::topic_publish_statistics> mqtt_handler::get_topic_publish_statistics(const std::string &topic) const
+    {
+        std::lock_guard<std::mutex> lock(publish_mutex);
+        auto it = publish_topics.find(topic);
+        if (it == publish_topics.end()) {
+            return std::nullopt;
+        }
+        return it->second.statistics;
+    }
+
     void mqtt_handler::subscribe_internal(const std::string &topic, const subscription_callback_t &callback)
     {
         if (!paho_client) {
@@ -439,7 +551,7 @@ namespace zwave_component
             if (callback != nullptr) {
                 subscription_callbacks[topic].push_back(callback);
             }
-            should_subscribe = (subscription_callbacks.contains(topic));
+            should_subscribe = (subscription_callbacks.find(topic) != nullptr);
         }
 
         if (should_subscribe && connected_.load()) {
@@ -461,10 +573,9 @@ namespace zwave_component
 
         {
             std::lock_guard<std::mutex> lock(client_mutex);
-            if (!subscription_callbacks.contains(topic)) {
+            if (!subscription_callbacks.erase(topic)) {
                 return;
             }
-            subscription_callbacks.erase(topic);
         }
 
         if (connected_.load()) {
@@ -484,31 +595,29 @@ namespace zwave_component
             return;
         }
 
-        std::vector<std::string> topics_to_unretain;
+        std::set<std::string> topics_to_unretain;
         {
             std::lock_guard<std::mutex> lock(client_mutex);
             for (const auto &topic: retained_topics) {
                 if (topic.rfind(prefix, 0) == 0) {
-                    topics_to_unretain.push_back(topic);
+                    topics_to_unretain.insert(topic);
                 }
             }
         }
-
-        for (const auto &topic: topics_to_unretain) {
-            if (!connected_.load()) {
-                break;
+        {
+            // Retained state still queued is not in retained_topics yet.
+            std::lock_guard<std::mutex> lock(publish_mutex);
+            for (const auto &[topic, state]: publish_topics) {
+                if (state.last_retained && state.statistics.queued > 0 && topic.rfind(prefix, 0) == 0) {
+                    topics_to_unretain.insert(topic);
+                }
             }
-            try {
-                auto pubmsg = mqtt::make_message(topic, "");
-                pubmsg->set_qos(mqtt_qos);
-                pubmsg->set_retained(true);
-                paho_client->publish(pubmsg)->wait();
+        }
 
-                std::lock_guard<std::mutex> lock(client_mutex);
-                retained_topics.erase(topic);
-            } catch (const mqtt::exception &exc) {
-                sl_log_error(LOG_TAG.data(), "Error unretaining topic [%s]: %s\n", topic.c_str(), exc.what());
-            }
+        // Go through the publish queue so that the clear is ordered after, or
+        // coalesced with, any state still queued for the topic.
+        for (const auto &topic: topics_to_unretain) {
+            enqueue_publish(topic, "", true);
         }
     }
 
@@ -543,16 +652,10 @@ namespace zwave_component
                 return;
             }
 
-            // Match topic against all subscriptions and collect matching callbacks
-            for (const auto &[cb_topic, callbacks]: subscription_callbacks) {
-                bool match_topic_result = topic_matches_sub(cb_topic, topic);
-
-                if (match_topic_result) {
-                    for (const subscription_callback_t &cb: callbacks) {
-                        callbacks_to_invoke.push_back(cb);
-                    }
-                }
-            }
+            // Collect the callbacks of the subscriptions matching the topic
+            subscription_callbacks.match(topic, [&](const std::vector<subscription_callback_t> &callbacks) {
+                callbacks_to_invoke.insert(callbacks_to_invoke.end(), callbacks.begin(), callbacks.end());
+            });
         }
 
         // Release lock before calling callbacks to prevent deadlock
@@ -580,12 +683,12 @@ namespace zwave_component
         // Callbacks are already registered in subscription_callbacks (preserved on disconnect),
         // so we only need to restore broker subscriptions by queuing with nullptr callback
         // This uses the same queue mechanism as subscribe() for consistent processing
-        for (const auto &[topic, callbacks]: subscription_callbacks) {
+        subscription_callbacks.for_each([&](const std::string &topic, const std::vector<subscription_callback_t> &) {
             subscribe_message sub_msg;
             sub_msg.topic    = topic;
             sub_msg.callback = nullptr;  // nullptr indicates broker-only resubscription
             subscribe_queue.push(std::move(sub_msg));
-        }
+        });
 
         // Note: Queued operations (publish, subscribe, unsubscribe, unretain) will be
         // automatically processed by the run() method on the next iteration
@@ -624,7 +727,7 @@ namespace zwave_component
             std::regex regex("zpc/([A-F0-9 ]{8})/");
             std::string converted_home_id = fmt::format("{:8X}", new_home_id);
 
-            for (const auto &[topic, callbacks]: subscription_callbacks) {
+            subscription_callbacks.for_each([&](const std::string &topic, const std::vector<subscription_callback_t> &callbacks) {
                 std::smatch match;
                 if (std::regex_search(topic, match, regex)) {
                     std::string new_topic = topic;
@@ -632,7 +735,7 @@ namespace zwave_component
                     new_topic.replace(pos, match[1].length(), converted_home_id);
                     topic_mappings[topic] = {new_topic, callbacks};
                 }
-            }
+            });
         }
 
         for (const auto &[old_topic, mapping]: topic_mappings) {
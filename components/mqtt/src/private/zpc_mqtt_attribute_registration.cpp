@@ -31,13 +31,16 @@
 #include "utils.hpp"
 #include "zpc_mqtt_utils.hpp"  // zpc_mqtt::utils::get_base_topic_from_attribute
 
-// Json
-#include "nlohmann/json.hpp"
-
 namespace zpc_mqtt
 {
     constexpr char LOG_TAG[] = "zpc_mqtt_attribute_registration";
 
+    namespace
+    {
+        // Returned by reference when there is no topic or payload
+        const std::string empty_string;
+    }  // namespace
+
     void zpc_mqtt_attribute_registration::register_attribute_type(attribute_store_type_t attribute_type, const std::string &command_class_name, const std::string &attribute_name)
     {
         if (mqtt_registration_map.contains(attribute_type)) {
@@ -92,21 +95,51 @@ namespace zpc_mqtt
         }
     }
 
-    std::string zpc_mqtt_attribute_registration::get_complete_attribute_topic(const attribute_store::attribute &attribute, attribute_store_node_value_state_t state) const
+    const std::string &zpc_mqtt_attribute_registration::get_complete_attribute_topic(const attribute_store::attribute &attribute, attribute_store_node_value_state_t state)
     {
-        constexpr std::string_view topic = "{base_topic}{attribute_topic}{state}";
+        auto cached_topics = topic_cache.find(attribute);
+        if (cached_topics == topic_cache.end()) {
+            auto base_topic      = zpc_mqtt::utils::get_base_topic_from_attribute(attribute);
+            auto attribute_topic = get_attribute_topic(attribute);
 
-        auto base_topic      = zpc_mqtt::utils::get_base_topic_from_attribute(attribute);
-        auto attribute_topic = get_attribute_topic(attribute);
+            // Check if the base topic and attribute topic are valid
+            // Error handling are done in their respective functions
+            if (base_topic.empty() || attribute_topic.empty()) {
+                return empty_string;
+            }
 
-        // Check if the base topic and attribute topic are valid
-        // Error handling are done in their respective functions
-        if (base_topic.empty() || attribute_topic.empty()) {
-            return "";
+            const std::string topic = base_topic + attribute_topic;
+            cached_topics           = topic_cache.emplace(attribute, attribute_topics {topic + MQTT_DESIRED_KEYWORD, topic + MQTT_REPORTED_KEYWORD}).first;
+            for (auto parent = attribute.parent(); parent.is_valid(); parent = parent.parent()) {
+                topic_dependencies.insert(parent);
+            }
         }
 
-        auto state_str = (state == DESIRED_ATTRIBUTE) ? MQTT_DESIRED_KEYWORD : MQTT_REPORTED_KEYWORD;
-        return fmt::format(topic, fmt::arg("base_topic", base_topic), fmt::arg("attribute_topic", attribute_topic), fmt::arg("state", state_str));
+        return (state == DESIRED_ATTRIBUTE) ? cached_topics->second.desired : cached_topics->second.reported;
+    }
+
+    void zpc_mqtt_attribute_registration::invalidate_attribute_topics(attribute_store_node_t node, attribute_store_change_t change)
+    {
+        if (change == ATTRIBUTE_CREATED) {
+            return;
+        }
+        // Parent values rarely change once an attribute is published, so all
+        // the topics are rebuilt rather than tracking which ones depend on it.
+        if (topic_dependencies.contains(node)) {
+            topic_cache.clear();
+            topic_dependencies.clear();
+        }
+        if (change == ATTRIBUTE_DELETED) {
+            topic_cache.erase(node);
+        }
+    }
+
+    void zpc_mqtt_attribute_registration::clear()
+    {
+        mqtt_registration_map.clear();
+        encoders.clear();
+        topic_cache.clear();
+        topic_dependencies.clear();
     }
 
     std::string zpc_mqtt_attribute_registration::attribute_value_to_topic(const attribute_store::attribute &attribute) const
@@ -182,74 +215,91 @@ namespace zpc_mqtt
         return "";
     }
 
-    std::string zpc_mqtt_attribute_registration::get_attribute_payload(const attribute_store::attribute &attribute, attribute_store_node_value_state_t state)
+    const std::string &zpc_mqtt_attribute_registration::get_attribute_payload(const attribute_store::attribute &attribute, attribute_store_node_value_state_t state)
     {
         auto storage_type = attribute_store_get_storage_type(attribute.type());
         try {
+            payload_writer.begin_object();
+            payload_writer.key(MQTT_PAYLOAD_VALUE_KEYWORD);
+
             // Check if we have a custom encoder
-            // In that case we let the function handles the conversion and return it
+            // In that case we let the function handles the conversion
             if (is_encoder_available(attribute.type())) {
-                nlohmann::json payload;
-                payload[MQTT_PAYLOAD_VALUE_KEYWORD] = encoders.at(attribute.type())(attribute, state);
-                return payload.dump();
-            }
-
-            // We need a special case for the float type to avoid it being casted to double
-            // See https://github.com/nlohmann/json/issues/1109
-            if (storage_type == FLOAT_STORAGE_TYPE) {
-                using json = nlohmann::basic_json<std::map, std::vector, std::string, bool, std::int64_t, std::uint64_t, float>;
-                json payload;
-                payload[MQTT_PAYLOAD_VALUE_KEYWORD] = attribute.get<float>(state);
-                return payload.dump();
-            }
-
-            nlohmann::json payload;
-            switch (storage_type) {
-                case U8_STORAGE_TYPE:
-                    payload[MQTT_PAYLOAD_VALUE_KEYWORD] = attribute.get<uint8_t>(state);
-                    break;
-                case U16_STORAGE_TYPE:
-                    payload[MQTT_PAYLOAD_VALUE_KEYWORD] = attribute.get<uint16_t>(state);
-                    break;
-                case U32_STORAGE_TYPE:
-                    payload[MQTT_PAYLOAD_VALUE_KEYWORD] = attribute.get<uint32_t>(state);
-                    break;
-                case U64_STORAGE_TYPE:
-                    payload[MQTT_PAYLOAD_VALUE_KEYWORD] = attribute.get<uint64_t>(state);
-                    break;
-                case I8_STORAGE_TYPE:
-                    payload[MQTT_PAYLOAD_VALUE_KEYWORD] = attribute.get<int8_t>(state);
-                    break;
-                case I16_STORAGE_TYPE:
-                    payload[MQTT_PAYLOAD_VALUE_KEYWORD] = attribute.get<int16_t>(state);
-                    break;
-                case I32_STORAGE_TYPE:
-                    payload[MQTT_PAYLOAD_VALUE_KEYWORD] = attribute.get<int32_t>(state);
-                    break;
-                case I64_STORAGE_TYPE:
-                    payload[MQTT_PAYLOAD_VALUE_KEYWORD] = attribute.get<int64_t>(state);
-                    break;
-                case DOUBLE_STORAGE_TYPE:
-                    payload[MQTT_PAYLOAD_VALUE_KEYWORD] = attribute.get<double>(state);
-                    break;
-                case C_STRING_STORAGE_TYPE:
-                    payload[MQTT_PAYLOAD_VALUE_KEYWORD] = attribute.get<std::string>(state);
-                    break;
-                case BYTE_ARRAY_STORAGE_TYPE: {
-                    auto byte_array                     = attribute.get<std::vector<uint8_t>>(state);
-                    payload[MQTT_PAYLOAD_VALUE_KEYWORD] = Utils::byte_array_to_string(byte_array);
-                    break;
+                payload_writer.value(encoders.at(attribute.type())(attribute, state));
+            } else {
+                switch (storage_type) {
+                    case U8_STORAGE_TYPE:
+                        payload_writer.value(attribute.get<uint8_t>(state));
+                        break;
+                    case U16_STORAGE_TYPE:
+                        payload_writer.value(attribute.get<uint16_t>(state));
+                        break;
+                    case U32_STORAGE_TYPE:
+                        payload_writer.value(attribute.get<uint32_t>(state));
+                        break;
+                    case U64_STORAGE_TYPE:
+                        payload_writer.value(attribute.get<uint64_t>(state));
+                        break;
+                    case I8_STORAGE_TYPE:
+                        payload_writer.value(attribute.get<int8_t>(state));
+                        break;
+                    case I16_STORAGE_TYPE:
+                        payload_writer.value(attribute.get<int16_t>(state));
+                        break;
+                    case I32_STORAGE_TYPE:
+                        payload_writer.value(attribute.get<int32_t>(state));
+                        break;
+                    case I64_STORAGE_TYPE:
+                        payload_writer.value(attribute.get<int64_t>(state));
+                        break;
+                    case DOUBLE_STORAGE_TYPE:
+                        payload_writer.value(attribute.get<double>(state));
+                        break;
+                    // Floats are written as floats to avoid them being casted to double
+                    // See https://github.com/nlohmann/json/issues/1109
+                    case FLOAT_STORAGE_TYPE:
+                        payload_writer.value(attribute.get<float>(state));
+                        break;
+                    case C_STRING_STORAGE_TYPE:
+                        payload_writer.value(attribute.get<std::string>(state));
+                        break;
+                    case BYTE_ARRAY_STORAGE_TYPE:
+                        payload_writer.value(Utils::byte_array_to_string(attribute.get<std::vector<uint8_t>>(state)));
+                        break;
+                    default:
+                        sl_log_critical(LOG_TAG, "Unsupported value type for %s. Sending empty payload", attribute.name_and_id().c_str());
+                        return empty_string;
                 }
-                default:
-                    sl_log_critical(LOG_TAG, "Unsupported value type for %s. Sending empty payload", attribute.name_and_id().c_str());
             }
-            return payload.dump();
+
+            payload_writer.end_object();
+            return payload_writer.str();
         } catch (const std::exception &e) {
             sl_log_critical(LOG_TAG, "Failed to get value of %s (%s). Sending empty payload", attribute.name_and_id().c_str(), e.what());
-            return "";
+            return empty_string;
+        }
+    }
+
+    const std::string &zpc_mqtt_attribute_registration::get_encoded_attribute_payload(const std::string &encoded_value)
+    {
+        try {
+            payload_writer.begin_object();
+            payload_writer.key(MQTT_PAYLOAD_VALUE_KEYWORD);
+            payload_writer.value(encoded_value);
+            payload_writer.end_object();
+            return payload_writer.str();
+        } catch (const std::exception &e) {
+            sl_log_critical(LOG_TAG, "Failed to write encoded value (%s). Sending empty payload", e.what());
+            return empty_string;
         }
     }
 
+    mqtt_value_encoder zpc_mqtt_attribute_registration::get_encoder(attribute_store_type_t attribute_type) const
+    {
+        auto encoder = encoders.find(attribute_type);
+        return (encoder != encoders.end()) ? encoder->second : mqtt_value_encoder();
+    }
+
     void zpc_mqtt_attribute_registration::register_encoder(attribute_store_type_t attribute_type, const mqtt_value_encoder &encoder)
     {
         encoders[attribute_type] = encoder;
@@ -21,15 +21,20 @@
 // Cpp
 #include <string>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 
 // Others
 #include "zpc_mqtt_definitions.hpp"  // mqtt_value_encoder
+#include "zpc_mqtt_json_writer.hpp"  // zpc_mqtt_json_writer
 namespace zpc_mqtt
 {
     /**
      * @brief Class to register attributes for the ZPC MQTT component
      *
      * This class is used to register attributes for the ZPC MQTT component.
+     * It is not thread-safe: topics and payloads are returned by reference
+     * into shared buffers, so callers serialize all access to an instance.
      *
      * @see zpc_mqtt_command_registration
      */
@@ -90,10 +95,33 @@ namespace zpc_mqtt
              *
              * zpc/{home_id}/{node_id}/ep{endpoint_id}/Attribute/{attribute_name}/[Desired|Reported]
              *
+             * Topics are cached per attribute until invalidate_attribute_topics()
+             * reports a change that affects them.
+             *
              * @param attribute The attribute to get the complete path from
              * @param state The state of the attribute (DESIRED_ATTRIBUTE or REPORTED_ATTRIBUTE)
+             *
+             * @return The topic, empty in case of error. Valid until the next
+             *         call to invalidate_attribute_topics().
+             */
+            const std::string &get_complete_attribute_topic(const attribute_store::attribute &attribute, attribute_store_node_value_state_t state);
+
+            /**
+             * @brief Forget the cached topics affected by a change of an attribute
+             *
+             * A topic contains the reported values of the parents of its attribute,
+             * so it is dropped when one of them is updated or deleted, as well as
+             * when its own attribute is deleted.
+             *
+             * @param node The attribute that changed
+             * @param change The change of its reported value
+             */
+            void invalidate_attribute_topics(attribute_store_node_t node, attribute_store_change_t change);
+
+            /**
+             * @brief Forget all the registered attribute types, encoders and topics
              */
-            std::string get_complete_attribute_topic(const attribute_store::attribute &attribute, attribute_store_node_value_state_t state) const;
+            void clear();
 
             /**
              * @brief Get the payload for an attribute
@@ -102,8 +130,31 @@ namespace zpc_mqtt
              *
              * @param attribute The attribute to get the payload from
              * @param state The state of the attribute (DESIRED_ATTRIBUTE or REPORTED_ATTRIBUTE)
+             *
+             * @return The payload, empty in case of error. Valid until the next
+             *         call to get_attribute_payload().
              */
-            std::string get_attribute_payload(const attribute_store::attribute &attribute, attribute_store_node_value_state_t state);
+            const std::string &get_attribute_payload(const attribute_store::attribute &attribute, attribute_store_node_value_state_t state);
+
+            /**
+             * @brief Get the payload for a value converted by an encoder
+             *
+             * @param encoded_value The value returned by the encoder
+             *
+             * @return The payload {"value":<encoded_value>}, empty in case of
+             *         error. Valid until the next call to get_attribute_payload().
+             */
+            const std::string &get_encoded_attribute_payload(const std::string &encoded_value);
+
+            /**
+             * @brief Get the encoder registered for an attribute type
+             *
+             * @param attribute_type The attribute type
+             *
+             * @return A copy of the encoder, which can run without access to this
+             *         instance. Empty if none is registered.
+             */
+            mqtt_value_encoder get_encoder(attribute_store_type_t attribute_type) const;
 
         private:
             /**
@@ -134,6 +185,18 @@ namespace zpc_mqtt
             // Attribute encoders
             // Some attributes need transformation into string before being published
             std::map<attribute_store_type_t, mqtt_value_encoder> encoders;
+
+            // Complete topics of an attribute, for both states
+            struct attribute_topics {
+                    std::string desired;
+                    std::string reported;
+            };
+            // Topics of the attributes published so far
+            std::unordered_map<attribute_store_node_t, attribute_topics> topic_cache;
+            // Parents of the cached attributes, whose values are part of the topics
+            std::unordered_set<attribute_store_node_t> topic_dependencies;
+            // Payload of the last get_attribute_payload() call
+            zpc_mqtt_json_writer payload_writer;
     };
 }  // namespace zpc_mqtt
 
@@ -0,0 +1,222 @@
+/******************************************************************************
+ * # License
+ * <b>Copyright 2026 Silicon Laboratories Inc. www.silabs.com</b>
+ ******************************************************************************
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ *****************************************************************************/
+// Base class
+#include "zpc_mqtt_json_writer.hpp"
+
+// Format
+#include <fmt/format.h>
+
+// Cpp
+#include <charconv>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace zpc_mqtt
+{
+    namespace
+    {
+        /**
+         * @brief Returns the length of the UTF-8 sequence starting at index, 0 if it is not valid.
+         *
+         * Overlong encodings, surrogates and code points above U+10FFFF are not valid.
+         */
+        size_t utf8_sequence_length(std::string_view text, size_t index)
+        {
+            const auto byte = static_cast<uint8_t>(text[index]);
+            size_t length;
+            uint8_t second_min = 0x80;
+            uint8_t second_max = 0xBF;
+            if (byte < 0x80) {
+                return 1;
+            } else if (byte >= 0xC2 && byte <= 0xDF) {
+                length = 2;
+            } else if (byte >= 0xE0 && byte <= 0xEF) {
+                length     = 3;
+                second_min = (byte == 0xE0) ? 0xA0 : 0x80;
+                second_max = (byte == 0xED) ? 0x9F : 0xBF;
+            } else if (byte >= 0xF0 && byte <= 0xF4) {
+                length     = 4;
+                second_min = (byte == 0xF0) ? 0x90 : 0x80;
+                second_max = (byte == 0xF4) ? 0x8F : 0xBF;
+            } else {
+                return 0;
+            }
+            if (index + length > text.size()) {
+                return 0;
+            }
+            const auto second = static_cast<uint8_t>(text[index + 1]);
+            if (second < second_min || second > second_max) {
+                return 0;
+            }
+            for (size_t i = 2; i < length; i++) {
+                const auto continuation = static_cast<uint8_t>(text[index + i]);
+                if (continuation < 0x80 || continuation > 0xBF) {
+                    return 0;
+                }
+            }
+            return length;
+        }
+
+        /**
+         * @brief Appends a floating point number the way nlohmann::json::dump() does.
+         *
+         * std::to_chars gives the shortest digits that round-trip, and they
+         * are laid out with the nlohmann rules: fixed notation with a ".0" for
+         * integral values up to digits10 digits, 0.000ddd down to 1e-4, and
+         * otherwise d.ddde+XX with at least two exponent digits. The last
+         * digit can differ where the Grisu2 conversion of nlohmann is not the
+         * shortest or closest one, the number read back is the same.
+         */
+        template<typename Float> void append_float(std::string &buffer, Float number)
+        {
+            if (!std::isfinite(number)) {
+                buffer.append("null");
+                return;
+            }
+            char scientific[64];
+            auto result = std::to_chars(scientific, scientific + sizeof(scientific), number, std::chars_format::scientific);
+            std::string_view text(scientific, result.ptr - scientific);
+
+            if (text.front() == '-') {
+                buffer.push_back('-');
+                text.remove_prefix(1);
+            }
+            const size_t exponent_position = text.find('e');
+            int exponent                   = 0;
+            std::from_chars(text.data() + exponent_position + (text[exponent_position + 1] == '+' ? 2 : 1), text.data() + text.size(), exponent);
+            std::string digits(text.substr(0, exponent_position));
+            if (digits.size() > 1) {
+                digits.erase(1, 1);  // the decimal point
+            }
+
+            // The value is 0.digits * 10^n
+            const int max_exponent = std::numeric_limits<Float>::digits10;
+            const int k            = static_cast<int>(digits.size());
+            const int n            = exponent + 1;
+            if (k <= n && n <= max_exponent) {
+                buffer.append(digits);
+                buffer.append(n - k, '0');
+                buffer.append(".0");
+            } else if (0 < n && n <= max_exponent) {
+                buffer.append(digits, 0, n);
+                buffer.push_back('.');
+                buffer.append(digits, n);
+            } else if (-4 < n && n <= 0) {
+                buffer.append("0.");
+                buffer.append(-n, '0');
+                buffer.append(digits);
+            } else {
+                buffer.push_back(digits[0]);
+                if (k > 1) {
+                    buffer.push_back('.');
+                    buffer.append(digits, 1);
+                }
+                const int e = n - 1;
+                buffer.push_back('e');
+                buffer.push_back(e < 0 ? '-' : '+');
+                const int magnitude = e < 0 ? -e : e;
+                if (magnitude < 10) {
+                    buffer.push_back('0');
+                }
+                char exponent_digits[8];
+                auto exponent_end = std::to_chars(exponent_digits, exponent_digits + sizeof(exponent_digits), magnitude);
+                buffer.append(exponent_digits, exponent_end.ptr);
+            }
+        }
+    }  // namespace
+
+    void zpc_mqtt_json_writer::begin_object()
+    {
+        buffer.clear();
+        buffer.push_back('{');
+        first_member = true;
+    }
+
+    void zpc_mqtt_json_writer::end_object()
+    {
+        buffer.push_back('}');
+    }
+
+    void zpc_mqtt_json_writer::key(std::string_view name)
+    {
+        if (!first_member) {
+            buffer.push_back(',');
+        }
+        first_member = false;
+        buffer.push_back('"');
+        buffer.append(name);
+        buffer.append("\":");
+    }
+
+    void zpc_mqtt_json_writer::value(double number)
+    {
+        append_float(buffer, number);
+    }
+
+    void zpc_mqtt_json_writer::value(float number)
+    {
+        append_float(buffer, number);
+    }
+
+    void zpc_mqtt_json_writer::value(std::string_view text)
+    {
+        buffer.push_back('"');
+        size_t index = 0;
+        while (index < text.size()) {
+            const char c = text[index];
+            switch (c) {
+                case '"':
+                    buffer.append("\\\"");
+                    break;
+                case '\\':
+                    buffer.append("\\\\");
+                    break;
+                case '\b':
+                    buffer.append("\\b");
+                    break;
+                case '\f':
+                    buffer.append("\\f");
+                    break;
+                case '\n':
+                    buffer.append("\\n");
+                    break;
+                case '\r':
+                    buffer.append("\\r");
+                    break;
+                case '\t':
+                    buffer.append("\\t");
+                    break;
+                default:
+                    if (static_cast<uint8_t>(c) < 0x20) {
+                        fmt::format_to(std::back_inserter(buffer), "\\u{:04x}", static_cast<uint8_t>(c));
+                        break;
+                    }
+                    const size_t length = utf8_sequence_length(text, index);
+                    if (length == 0) {
+                        throw std::invalid_argument(fmt::format("invalid UTF-8 byte at index {}: 0x{:02X}", index, static_cast<uint8_t>(c)));
+                    }
+                    buffer.append(text.substr(index, length));
+                    index += length;
+                    continue;
+            }
+            index++;
+        }
+        buffer.push_back('"');
+    }
+
+    void zpc_mqtt_json_writer::null()
+    {
+        buffer.append("null");
+    }
+}  // namespace zpc_mqtt
@@ -0,0 +1,91 @@
+/******************************************************************************
+ * # License
+ * <b>Copyright 2026 Silicon Laboratories Inc. www.silabs.com</b>
+ ******************************************************************************
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ *****************************************************************************/
+
+#ifndef ZPC_MQTT_JSON_WRITER
+#define ZPC_MQTT_JSON_WRITER
+
+// Cpp
+#include <charconv>
+#include <concepts>
+#include <string>
+#include <string_view>
+
+namespace zpc_mqtt
+{
+    /**
+     * @brief Writes flat JSON objects into a reusable buffer
+     *
+     * Used for the payloads published by the ZPC MQTT component, such as
+     * {"value":<value>}. Members are written in the order they are given,
+     * without building a JSON document, and the buffer keeps its capacity
+     * from one payload to the next.
+     *
+     * Values are formatted like nlohmann::json::dump() does: strings are
+     * escaped the same way and must be valid UTF-8, and non-finite floating
+     * point numbers are written as null.
+     */
+    class zpc_mqtt_json_writer
+    {
+        public:
+            /**
+             * @brief Clears the buffer and opens an object.
+             */
+            void begin_object();
+
+            /**
+             * @brief Closes the object opened by begin_object.
+             */
+            void end_object();
+
+            /**
+             * @brief Writes the key of the next member.
+             *
+             * @param name Key of the member, written without escaping
+             */
+            void key(std::string_view name);
+
+            /**
+             * @brief Writes a member value.
+             *
+             * @throws std::invalid_argument if a string is not valid UTF-8
+             */
+            template<std::integral Integer> void value(Integer number)
+            {
+                char digits[24];
+                auto result = std::to_chars(digits, digits + sizeof(digits), number);
+                buffer.append(digits, result.ptr);
+            }
+            void value(double number);
+            void value(float number);
+            void value(std::string_view text);
+
+            /**
+             * @brief Writes a null member value.
+             */
+            void null();
+
+            /**
+             * @brief Returns the JSON written since the last begin_object.
+             */
+            const std::string &str() const
+            {
+                return buffer;
+            }
+
+        private:
+            std::string buffer;
+            bool first_member = true;
+    };
+}  // namespace zpc_mqtt
+
+#endif  // ZPC_MQTT_JSON_WRITER
@@ -25,6 +25,7 @@
 #include "attribute.hpp"                        // attribute_store::attribute
 #include "attribute_callbacks.hpp"              // register_callback_by_type, attribute_store_node_value_state_t, ...
 #include "attribute_store_type_registration.h"  // attribute_store_get_storage_type
+#include "attribute_store_defined_attribute_types.h"  // ATTRIBUTE_HOME_ID, ATTRIBUTE_NODE_ID, ATTRIBUTE_ENDPOINT_ID
 
 // MQTT
 #include "mqtt_handler.hpp"
@@ -33,9 +34,9 @@
 #include <fmt/format.h>
 
 // Cpp
-#include <set>
 #include <map>
 #include <functional>
+#include <mutex>
 namespace zpc_mqtt
 {
     constexpr char LOG_TAG[] = "zpc_mqtt";
@@ -43,11 +44,87 @@ namespace zpc_mqtt
     namespace
     {
         zpc_mqtt_attribute_registration attribute_registration;
+        // Attribute store callbacks run on several threads, and the topics and
+        // payloads of attribute_registration live in shared buffers.
+        std::mutex attribute_registration_mutex;
         zpc_mqtt_command_registration command_registration;
+        // Set once the base topic attributes are watched for the topic cache
+        bool base_topic_callbacks_registered = false;
+        // Payload marking the deletion of an attribute
+        const std::string deletion_payload;
+
+        void publish_attribute(attribute_store_node_t node, attribute_store_change_t change, attribute_store_node_value_state_t value_state)
+        {
+            // Wrapper around the node
+            attribute_store::attribute updated_node(node);
+
+            // When we delete an attribute, we need to publish the deletion for the
+            // desired attribute as well since it is not done automatically.
+            const attribute_store_node_value_state_t value_states[] = {value_state, DESIRED_ATTRIBUTE};
+            const size_t value_state_count                          = (change == ATTRIBUTE_DELETED) ? 2 : 1;
+
+            // Topics and payload are copied out of the shared buffers, so that
+            // value encoders and the MQTT publish run without the lock.
+            std::string attribute_topics[2];
+            // If we have an updated value, create a payload with the value
+            // Otherwise we send an empty payload to mark the deletion
+            std::string payload = deletion_payload;
+            mqtt_value_encoder encoder;
+            {
+                std::lock_guard<std::mutex> lock(attribute_registration_mutex);
+
+                // If wanted value state is not present, there is nothing to publish
+                const bool publish = (change != ATTRIBUTE_UPDATED) || updated_node.exists(value_state);
+                if (publish) {
+                    for (size_t i = 0; i < value_state_count; i++) {
+                        attribute_topics[i] = attribute_registration.get_complete_attribute_topic(updated_node, value_states[i]);
+                    }
+                    if (change == ATTRIBUTE_UPDATED) {
+                        encoder = attribute_registration.get_encoder(updated_node.type());
+                        if (!encoder) {
+                            payload = attribute_registration.get_attribute_payload(updated_node, value_state);
+                        }
+                    }
+                }
+
+                // Topics holding the reported value of the node are stale from now on
+                if (value_state == REPORTED_ATTRIBUTE) {
+                    attribute_registration.invalidate_attribute_topics(node, change);
+                }
+                if (!publish) {
+                    return;
+                }
+            }
+
+            if (encoder) {
+                try {
+                    const std::string encoded_value = encoder(updated_node, value_state);
+                    std::lock_guard<std::mutex> lock(attribute_registration_mutex);
+                    payload = attribute_registration.get_encoded_attribute_payload(encoded_value);
+                } catch (const std::exception &e) {
+                    sl_log_critical(LOG_TAG, "Failed to get value of %s (%s). Sending empty payload", updated_node.name_and_id().c_str(), e.what());
+                }
+            }
+
+            for (size_t i = 0; i < value_state_count; i++) {
+                const std::string &attribute_topic = attribute_topics[i];
+
+                sl_log_debug(LOG_TAG, "MQTT publish : %s %s", attribute_topic.c_str(), payload.c_str());
+
+                if (attribute_topic.empty()) {
+                    sl_log_error(LOG_TAG, "Empty topic. Cannot publish to MQTT.");
+                    return;
+                }
+
+                // Publish mqtt topic with the value
+                zwave_component::mqtt_handler::get_instance().publish(attribute_topic, payload, true);
+            }
+        }
     }  // namespace
 
     void register_value_transformation(attribute_store_type_t attribute_type, const mqtt_value_encoder &encoder)
     {
+        std::lock_guard<std::mutex> lock(attribute_registration_mutex);
         attribute_registration.register_encoder(attribute_type, encoder);
     }
 
@@ -62,42 +139,7 @@ namespace zpc_mqtt
             return;
         }
 
-        // Wrapper around the node
-        attribute_store::attribute updated_node(node);
-        std::string payload_str;
-
-        // If we have an updated value, create a payload with the value
-        // Otherwise we send an empty payload to mark the deletion
-        if (change == ATTRIBUTE_UPDATED) {
-            // If wanted value state is not present, return
-            if (!updated_node.exists(value_state)) {
-                return;
-            }
-
-            // Get the value
-            payload_str = attribute_registration.get_attribute_payload(updated_node, value_state);
-        }
-
-        std::set<attribute_store_node_value_state_t> value_states = {value_state};
-        // When we delete an attribute, we need to publish the deletion for the
-        // desired attribute as well since it is not done automatically.
-        if (change == ATTRIBUTE_DELETED) {
-            value_states.insert(DESIRED_ATTRIBUTE);
-        }
-        for (auto current_value_state: value_states) {
-            auto attribute_topic = attribute_registration.get_complete_attribute_topic(updated_node, current_value_state);
-
-            sl_log_debug(LOG_TAG, "MQTT publish : %s %s", attribute_topic.c_str(), payload_str.c_str());
-
-            if (attribute_topic.empty()) {
-                sl_log_error(LOG_TAG, "Empty topic. Cannot publish to MQTT.");
-                return;
-            }
-
-            // Publish mqtt topic with the value
-
-            zwave_component::mqtt_handler::get_instance().publish(attribute_topic, payload_str, true);
-        }
+        publish_attribute(node, change, value_state);
     }
 
     sl_status_t publish_report(const char *topic, const char *message, size_t message_length, bool retain)
@@ -132,8 +174,29 @@ namespace zpc_mqtt
             return SL_STATUS_FAIL;
         }
 
-        // Register the attribute into the map
-        attribute_registration.register_attribute_type(attribute_type, command_class_name, attribute_name);
+        // Published topics start with the HomeID, NodeID and EndpointID values.
+        // Attribute Store callbacks are registered outside the lock.
+        bool register_base_topic_callbacks = false;
+        {
+            std::lock_guard<std::mutex> lock(attribute_registration_mutex);
+            // Register the attribute into the map
+            attribute_registration.register_attribute_type(attribute_type, command_class_name, attribute_name);
+            register_base_topic_callbacks   = !base_topic_callbacks_registered;
+            base_topic_callbacks_registered = true;
+        }
+
+        if (register_base_topic_callbacks) {
+            const attribute_store_type_t base_topic_types[] = {ATTRIBUTE_HOME_ID, ATTRIBUTE_NODE_ID, ATTRIBUTE_ENDPOINT_ID};
+            for (attribute_store_type_t base_topic_type: base_topic_types) {
+                attribute_store::register_callback_by_type_and_state(
+                    [](attribute_store_node_t node, attribute_store_change_t change) {
+                        std::lock_guard<std::mutex> lock(attribute_registration_mutex);
+                        attribute_registration.invalidate_attribute_topics(node, change);
+                    },
+                    base_topic_type,
+                    REPORTED_ATTRIBUTE);
+            }
+        }
 
         attribute_store::register_callback_by_type_and_state([attribute_name, command_class_name](attribute_store_node_t node, attribute_store_change_t change) { zpc_mqtt::registration_callback(node, change, DESIRED_ATTRIBUTE); }, attribute_type, DESIRED_ATTRIBUTE);
 
@@ -142,6 +205,16 @@ namespace zpc_mqtt
         return SL_STATUS_OK;
     }
 
+    int teardown()
+    {
+        std::lock_guard<std::mutex> lock(attribute_registration_mutex);
+        // The Attribute Store drops all its callbacks at teardown, so they are
+        // registered again by the next register_attribute() calls.
+        attribute_registration.clear();
+        base_topic_callbacks_registered = false;
+        return 0;
+    }
+
     sl_status_t register_command(const std::string &command_class_name, const mqtt_command_callback &callback)
     {
         if (command_class_name.empty()) {
@@ -16,7 +16,9 @@
 
 #include "sl_status.h"
 
+#include <cstddef>
 #include <cstdint>
+#include <optional>
 #include <string>
 #include <vector>
 #include <filesystem>
@@ -64,6 +66,62 @@ namespace ota
              */
             static std::vector<uint8_t> get_image(const std::string &name);
 
+            /**
+             * @brief Start or resume a chunked upload.
+             *
+             * Chunks are appended to "<name>.part" in the cache directory. If
+             * an upload of the same image with the same size is already known
+             * (in memory or as a partial file left on disk), it is resumed.
+             *
+             * @param name             Filename (relative, no path separators).
+             * @param image_size       Total size of the image in bytes.
+             * @param expected_sha256  Hex SHA-256 checked on commit, empty to skip.
+             * @param expected_crc16   CRC16-CCITT checked on commit, if set.
+             * @param offset           Set to the offset the next chunk must start at.
+             * When all upload slots are taken, uploads without activity for 5
+             * minutes are closed to make room. Their partial files are kept.
+             *
+             * @return SL_STATUS_OK on success, SL_STATUS_INVALID_PARAMETER for a
+             *         bad name or size, SL_STATUS_NO_MORE_RESOURCE when too many
+             *         uploads are open.
+             */
+            static sl_status_t begin_upload(const std::string &name, size_t image_size, const std::string &expected_sha256, std::optional<uint16_t> expected_crc16, size_t &offset);
+
+            /**
+             * @brief Append a chunk to an upload started with begin_upload().
+             * @param name         Filename of the upload.
+             * @param image_size   Total image size, must match begin_upload().
+             * @param offset       Offset of the chunk within the image.
+             * @param data         Chunk content.
+             * @param length       Chunk length in bytes.
+             * @param next_offset  Set to the offset the next chunk must start at.
+             * @return SL_STATUS_OK on success, SL_STATUS_NOT_FOUND if no upload is
+             *         open for the name, SL_STATUS_INVALID_PARAMETER if image_size
+             *         differs, SL_STATUS_INVALID_RANGE if the chunk is not at the
+             *         expected offset or runs past the image size.
+             */
+            static sl_status_t write_upload_chunk(const std::string &name, size_t image_size, size_t offset, const uint8_t *data, size_t length, size_t &next_offset);
+
+            /**
+             * @brief Verify a complete upload and move it into the cache.
+             * @param name    Filename of the upload.
+             * @param crc16   Set to the CRC16-CCITT of the image.
+             * @param sha256  Set to the hex SHA-256 of the image.
+             * @return SL_STATUS_OK on success, SL_STATUS_NOT_FOUND if no upload is
+             *         open, SL_STATUS_IN_PROGRESS if bytes are missing,
+             *         SL_STATUS_INVALID_SIGNATURE if a checksum does not match (the
+             *         partial file is discarded).
+             */
+            static sl_status_t commit_upload(const std::string &name, uint16_t &crc16, std::string &sha256);
+            /**
+             * @brief Drop an upload and its partial file.
+             * @param name  Filename of the upload.
+             * @return SL_STATUS_OK on success, SL_STATUS_NOT_FOUND if neither an
+             *         open upload nor a partial file exists for the name,
+             *         SL_STATUS_INVALID_PARAMETER for a bad name.
+             */
+            static sl_status_t abort_upload(const std::string &name);
+
         private:
             /**
              * @brief Build full filesystem path for an image.
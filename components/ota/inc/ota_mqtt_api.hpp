@@ -26,7 +26,7 @@ namespace ota
     /**
      * @brief MQTT API for the OTA Firmware Manager.
      *
-     * Subscribes to 7 command topics and publishes to 7 report topics.
+     * Subscribes to 11 command topics and publishes to 11 report topics.
      * Incoming commands are translated into ota_external_event_data and pushed onto the
      * shared event queue for processing by the state machine thread.
      */
@@ -35,6 +35,14 @@ namespace ota
         public:
             inline static std::string MQTT_API_OTA_UPLOAD_IMAGE_TOPIC                 = "OTA/UploadImage";
             inline static std::string MQTT_API_OTA_UPLOAD_IMAGE_REPORT_TOPIC          = MQTT_API_OTA_UPLOAD_IMAGE_TOPIC + "/Report";
+            inline static std::string MQTT_API_OTA_UPLOAD_BEGIN_TOPIC                 = MQTT_API_OTA_UPLOAD_IMAGE_TOPIC + "/Begin";
+            inline static std::string MQTT_API_OTA_UPLOAD_BEGIN_REPORT_TOPIC          = MQTT_API_OTA_UPLOAD_BEGIN_TOPIC + "/Report";
+            inline static std::string MQTT_API_OTA_UPLOAD_CHUNK_TOPIC                 = MQTT_API_OTA_UPLOAD_IMAGE_TOPIC + "/Chunk";
+            inline static std::string MQTT_API_OTA_UPLOAD_CHUNK_REPORT_TOPIC          = MQTT_API_OTA_UPLOAD_CHUNK_TOPIC + "/Report";
+            inline static std::string MQTT_API_OTA_UPLOAD_COMMIT_TOPIC                = MQTT_API_OTA_UPLOAD_IMAGE_TOPIC + "/Commit";
+            inline static std::string MQTT_API_OTA_UPLOAD_COMMIT_REPORT_TOPIC         = MQTT_API_OTA_UPLOAD_COMMIT_TOPIC + "/Report";
+            inline static std::string MQTT_API_OTA_UPLOAD_ABORT_TOPIC                 = MQTT_API_OTA_UPLOAD_IMAGE_TOPIC + "/Abort";
+            inline static std::string MQTT_API_OTA_UPLOAD_ABORT_REPORT_TOPIC          = MQTT_API_OTA_UPLOAD_ABORT_TOPIC + "/Report";
             inline static std::string MQTT_API_OTA_START_FIRMWARE_UPLOAD_TOPIC        = "OTA/StartFirmwareUpload";
             inline static std::string MQTT_API_OTA_START_FIRMWARE_UPLOAD_REPORT_TOPIC = MQTT_API_OTA_START_FIRMWARE_UPLOAD_TOPIC + "/Report";
             inline static std::string MQTT_API_OTA_LIST_IMAGES_TOPIC                  = "OTA/ListImages";
@@ -62,6 +70,10 @@ namespace ota
         private:
             // ---- Command handlers ----
             static void on_upload_image(const std::string &topic, const std::string &message);
+            static void on_upload_begin(const std::string &topic, const std::string &message);
+            static void on_upload_chunk(const std::string &topic, const std::string &message);
+            static void on_upload_commit(const std::string &topic, const std::string &message);
+            static void on_upload_abort(const std::string &topic, const std::string &message);
             void on_start_firmware_upload(const std::string &topic, const std::string &message);
             static void on_list_images(const std::string &topic, const std::string &message);
             static void on_remove_image(const std::string &topic, const std::string &message);
@@ -45,6 +45,13 @@ namespace ota::mqtt_constants
         constexpr std::string_view INVALID_HARDWARE_VERSION   = "invalid_hardware_version";
         constexpr std::string_view UNKNOWN                    = "unknown";
         constexpr std::string_view UPDATE_ALREADY_IN_PROGRESS = "update_already_in_progress";
+        constexpr std::string_view INVALID_IMAGE              = "invalid_image";
+        constexpr std::string_view INVALID_CHUNK              = "invalid_chunk";
+        constexpr std::string_view UPLOAD_NOT_STARTED         = "upload_not_started";
+        constexpr std::string_view OFFSET_MISMATCH            = "offset_mismatch";
+        constexpr std::string_view INCOMPLETE_UPLOAD          = "incomplete_upload";
+        constexpr std::string_view CHECKSUM_MISMATCH          = "checksum_mismatch";
+        constexpr std::string_view TOO_MANY_UPLOADS           = "too_many_uploads";
     }  // namespace reason
 
     namespace key
@@ -61,6 +68,10 @@ namespace ota::mqtt_constants
         constexpr std::string_view PERCENTAGE          = "percentage";
         constexpr std::string_view WAITTIME            = "waittime";
         constexpr std::string_view STATUS_CODE         = "status_code";
+        constexpr std::string_view OFFSET              = "offset";
+        constexpr std::string_view SEQUENCE            = "sequence";
+        constexpr std::string_view SHA256              = "sha256";
+        constexpr std::string_view CRC16               = "crc16";
     }  // namespace key
 
 }  // namespace ota::mqtt_constants
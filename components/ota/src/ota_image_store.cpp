@@ -14,11 +14,19 @@
 #include "ota_image_store.hpp"
 #include "log.h"
 #include "zpc_config.h"
+#include "zwave_crc16.h"
+
+#include <openssl/evp.h>
 
 #include <filesystem>
 #include <fstream>
 #include <string_view>
 #include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
 
 namespace ota
 {
@@ -26,7 +34,41 @@ namespace ota
     [[maybe_unused]] static constexpr std::string_view LOG_TAG = "ota_image_store";
 
     static constexpr std::string_view allowed_extension = ".gbl";
+    static constexpr std::string_view partial_extension = ".part";
     static constexpr size_t kMaxImageSize               = 10 * 1024 * 1024;
+    static constexpr size_t kMaxOpenUploads             = 4;
+    static constexpr size_t kSha256HexLength            = 64;
+    // An upload without chunks for this long gives its slot to a new upload.
+    static constexpr std::chrono::minutes kUploadIdleTimeout {5};
+
+    namespace
+    {
+        struct EvpMdCtxDeleter {
+                void operator()(EVP_MD_CTX *p) const noexcept
+                {
+                    EVP_MD_CTX_free(p);
+                }
+        };
+
+        using MdCtxPtr = std::unique_ptr<EVP_MD_CTX, EvpMdCtxDeleter>;
+
+        /// State of one chunked upload, kept until it is committed, aborted,
+        /// replaced, or evicted after kUploadIdleTimeout.
+        struct upload_session_t {
+                std::filesystem::path part_path;
+                std::ofstream ofs;
+                size_t image_size = 0;
+                size_t offset     = 0;
+                std::string expected_sha256;
+                std::optional<uint16_t> expected_crc16;
+                zwave_crc16_context_t crc = {};
+                MdCtxPtr sha;
+                std::chrono::steady_clock::time_point last_activity;
+        };
+    }  // namespace
+
+    static std::mutex uploads_mutex;
+    static std::map<std::string, upload_session_t> uploads;
 
     static bool is_gbl(const std::filesystem::path &p)
     {
@@ -40,6 +82,73 @@ namespace ota
         return !name.empty() && name.find('/') == std::string::npos && name.find("..") == std::string::npos;
     }
 
+    static bool valid_sha256_hex(std::string_view hex)
+    {
+        return hex.size() == kSha256HexLength && std::all_of(hex.begin(), hex.end(), [](char c) { return std::isxdigit(static_cast<unsigned char>(c)) != 0; });
+    }
+
+    static std::string to_hex(const uint8_t *data, size_t length)
+    {
+        static constexpr char digits[] = "0123456789abcdef";
+        std::string hex;
+        hex.reserve(length * 2);
+        for (size_t i = 0; i < length; i++) {
+            hex.push_back(digits[data[i] >> 4]);
+            hex.push_back(digits[data[i] & 0x0F]);
+        }
+        return hex;
+    }
+
+    static bool reset_digests(upload_session_t &upload)
+    {
+        zwave_crc16_init(&upload.crc, CRC16_INIT_VALUE);
+        if (!upload.sha) {
+            upload.sha.reset(EVP_MD_CTX_new());
+        }
+        return upload.sha && EVP_DigestInit_ex(upload.sha.get(), EVP_sha256(), nullptr) == 1;
+    }
+
+    static bool update_digests(upload_session_t &upload, const uint8_t *data, size_t length)
+    {
+        zwave_crc16_update(&upload.crc, data, length);
+        return EVP_DigestUpdate(upload.sha.get(), data, length) == 1;
+    }
+
+    /// Feed the first length bytes of an existing partial file to the digests.
+    static bool hash_partial_file(upload_session_t &upload, size_t length)
+    {
+        std::ifstream ifs(upload.part_path, std::ios::binary);
+        if (!ifs) {
+            return false;
+        }
+
+        std::vector<uint8_t> buffer(64 * 1024);
+        while (length > 0) {
+            size_t n = std::min(length, buffer.size());
+            ifs.read(reinterpret_cast<char *>(buffer.data()), static_cast<std::streamsize>(n));
+            if (!ifs || !update_digests(upload, buffer.data(), n)) {
+                return false;
+            }
+            length -= n;
+        }
+        return true;
+    }
+
+    /// Close uploads that had no activity for kUploadIdleTimeout. Their
+    /// partial files stay on disk and can be resumed with the same SHA-256.
+    static void evict_idle_uploads()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        for (auto it = uploads.begin(); it != uploads.end();) {
+            if (now - it->second.last_activity < kUploadIdleTimeout) {
+                ++it;
+                continue;
+            }
+            sl_log_warning(LOG_TAG.data(), "Closing idle upload of '%s' at %zu/%zu bytes", it->first.c_str(), it->second.offset, it->second.image_size);
+            it = uploads.erase(it);
+        }
+    }
+
     std::filesystem::path OTAImageStore::image_path(const std::string &name)
     {
         const zpc_config_t *cfg = zpc_get_config();
@@ -209,4 +318,215 @@ namespace ota
         return data;
     }
 
+    sl_status_t OTAImageStore::begin_upload(const std::string &name, size_t image_size, const std::string &expected_sha256, std::optional<uint16_t> expected_crc16, size_t &offset)
+    {
+        offset = 0;
+
+        if (!valid_name(name) || image_size == 0 || image_size > kMaxImageSize) {
+            sl_log_error(LOG_TAG.data(), "Invalid upload of '%s' (%zu bytes)", name.c_str(), image_size);
+            return SL_STATUS_INVALID_PARAMETER;
+        }
+
+        std::filesystem::path path = image_path(name);
+        if (!is_gbl(path)) {
+            sl_log_error(LOG_TAG.data(), "Only gbl files are allowed: %s", name.c_str());
+            return SL_STATUS_INVALID_PARAMETER;
+        }
+
+        std::string sha256 = expected_sha256;
+        std::transform(sha256.begin(), sha256.end(), sha256.begin(), ::tolower);
+        if (!sha256.empty() && !valid_sha256_hex(sha256)) {
+            sl_log_error(LOG_TAG.data(), "Invalid SHA-256 for upload of '%s'", name.c_str());
+            return SL_STATUS_INVALID_PARAMETER;
+        }
+
+        std::lock_guard<std::mutex> lock(uploads_mutex);
+
+        // A partial file on disk is only resumed when the client gave us a
+        // SHA-256, so that a stale file from another image can never end up
+        // silently spliced into this one.
+        bool may_resume_from_disk = !sha256.empty();
+
+        auto it = uploads.find(name);
+        if (it != uploads.end()) {
+            upload_session_t &existing = it->second;
+            if (existing.image_size == image_size && existing.expected_sha256 == sha256 && existing.expected_crc16 == expected_crc16) {
+                existing.last_activity = std::chrono::steady_clock::now();
+                offset                 = existing.offset;
+                sl_log_info(LOG_TAG.data(), "Resuming upload of '%s' at %zu/%zu bytes", name.c_str(), offset, image_size);
+                return SL_STATUS_OK;
+            }
+            uploads.erase(it);
+            may_resume_from_disk = false;
+        }
+
+        if (uploads.size() >= kMaxOpenUploads) {
+            evict_idle_uploads();
+        }
+        if (uploads.size() >= kMaxOpenUploads) {
+            sl_log_error(LOG_TAG.data(), "Too many uploads in progress, rejecting '%s'", name.c_str());
+            return SL_STATUS_NO_MORE_RESOURCE;
+        }
+
+        std::error_code ec;
+        std::filesystem::create_directories(path.parent_path(), ec);
+        if (ec) {
+            sl_log_error(LOG_TAG.data(), "Failed to create directory %s: %s", path.parent_path().string().c_str(), ec.message().c_str());
+            return SL_STATUS_FAIL;
+        }
+
+        upload_session_t upload;
+        upload.part_path = path;
+        upload.part_path += partial_extension;
+        upload.image_size      = image_size;
+        upload.expected_sha256 = sha256;
+        upload.expected_crc16  = expected_crc16;
+        upload.last_activity   = std::chrono::steady_clock::now();
+
+        if (!reset_digests(upload)) {
+            sl_log_error(LOG_TAG.data(), "Failed to initialize SHA-256 for '%s'", name.c_str());
+            return SL_STATUS_FAIL;
+        }
+
+        if (may_resume_from_disk) {
+            auto part_size = std::filesystem::file_size(upload.part_path, ec);
+            if (!ec && part_size > 0 && part_size <= image_size) {
+                if (hash_partial_file(upload, part_size)) {
+                    upload.offset = part_size;
+                } else if (!reset_digests(upload)) {
+                    return SL_STATUS_FAIL;
+                }
+            }
+        }
+
+        auto mode = std::ios::binary | ((upload.offset > 0) ? std::ios::app : std::ios::trunc);
+        upload.ofs.open(upload.part_path, mode);
+        if (!upload.ofs) {
+            sl_log_error(LOG_TAG.data(), "Failed to open partial file: %s", upload.part_path.string().c_str());
+            return SL_STATUS_FAIL;
+        }
+
+        offset = upload.offset;
+        sl_log_info(LOG_TAG.data(), "Upload of '%s' started at %zu/%zu bytes", name.c_str(), offset, image_size);
+        uploads.emplace(name, std::move(upload));
+        return SL_STATUS_OK;
+    }
+
+    sl_status_t OTAImageStore::write_upload_chunk(const std::string &name, size_t image_size, size_t offset, const uint8_t *data, size_t length, size_t &next_offset)
+    {
+        std::lock_guard<std::mutex> lock(uploads_mutex);
+
+        auto it = uploads.find(name);
+        if (it == uploads.end()) {
+            next_offset = 0;
+            return SL_STATUS_NOT_FOUND;
+        }
+
+        upload_session_t &upload = it->second;
+        next_offset              = upload.offset;
+        upload.last_activity     = std::chrono::steady_clock::now();
+
+        if (image_size != upload.image_size) {
+            sl_log_warning(LOG_TAG.data(), "Chunk for '%s' has image size %zu, expected %zu", name.c_str(), image_size, upload.image_size);
+            return SL_STATUS_INVALID_PARAMETER;
+        }
+
+        if (offset != upload.offset || length > upload.image_size - upload.offset) {
+            sl_log_warning(LOG_TAG.data(), "Chunk for '%s' at %zu (%zu bytes) does not match expected offset %zu", name.c_str(), offset, length, upload.offset);
+            return SL_STATUS_INVALID_RANGE;
+        }
+
+        upload.ofs.write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(length));
+        upload.ofs.flush();
+        if (!upload.ofs || !update_digests(upload, data, length)) {
+            sl_log_error(LOG_TAG.data(), "Write error for file: %s", upload.part_path.string().c_str());
+            uploads.erase(it);
+            return SL_STATUS_FAIL;
+        }
+
+        upload.offset += length;
+        next_offset = upload.offset;
+        return SL_STATUS_OK;
+    }
+
+    sl_status_t OTAImageStore::commit_upload(const std::string &name, uint16_t &crc16, std::string &sha256)
+    {
+        std::lock_guard<std::mutex> lock(uploads_mutex);
+
+        auto it = uploads.find(name);
+        if (it == uploads.end()) {
+            return SL_STATUS_NOT_FOUND;
+        }
+
+        upload_session_t &upload = it->second;
+        if (upload.offset != upload.image_size) {
+            sl_log_warning(LOG_TAG.data(), "Upload of '%s' is incomplete (%zu/%zu bytes)", name.c_str(), upload.offset, upload.image_size);
+            return SL_STATUS_IN_PROGRESS;
+        }
+
+        upload.ofs.close();
+
+        uint8_t digest[EVP_MAX_MD_SIZE];
+        unsigned int digest_length = 0;
+        bool io_ok                 = !upload.ofs.fail() && EVP_DigestFinal_ex(upload.sha.get(), digest, &digest_length) == 1;
+
+        crc16  = zwave_crc16_final(&upload.crc);
+        sha256 = to_hex(digest, digest_length);
+
+        std::filesystem::path part_path = upload.part_path;
+        bool checksum_ok                = (upload.expected_sha256.empty() || upload.expected_sha256 == sha256) && (!upload.expected_crc16.has_value() || *upload.expected_crc16 == crc16);
+        size_t image_size               = upload.image_size;
+        uploads.erase(it);
+
+        std::error_code ec;
+        if (!io_ok || !checksum_ok) {
+            if (io_ok) {
+                sl_log_error(LOG_TAG.data(), "Checksum mismatch for '%s' (crc16=0x%04X, sha256=%s), discarding upload", name.c_str(), crc16, sha256.c_str());
+            } else {
+                sl_log_error(LOG_TAG.data(), "Failed to finalize upload of '%s'", name.c_str());
+            }
+            std::filesystem::remove(part_path, ec);
+            return io_ok ? SL_STATUS_INVALID_SIGNATURE : SL_STATUS_FAIL;
+        }
+
+        std::filesystem::path path = image_path(name);
+        std::filesystem::rename(part_path, path, ec);
+        if (ec) {
+            sl_log_error(LOG_TAG.data(), "Rename failed %s -> %s: %s", part_path.string().c_str(), path.string().c_str(), ec.message().c_str());
+            return SL_STATUS_FAIL;
+        }
+
+        sl_log_info(LOG_TAG.data(), "Stored image '%s' (%zu bytes, crc16=0x%04X)", name.c_str(), image_size, crc16);
+        return SL_STATUS_OK;
+    }
+
+    sl_status_t OTAImageStore::abort_upload(const std::string &name)
+    {
+        if (!valid_name(name)) {
+            return SL_STATUS_INVALID_PARAMETER;
+        }
+
+        std::filesystem::path part_path = image_path(name);
+        if (!is_gbl(part_path)) {
+            return SL_STATUS_INVALID_PARAMETER;
+        }
+        part_path += partial_extension;
+
+        std::lock_guard<std::mutex> lock(uploads_mutex);
+
+        bool was_open = uploads.erase(name) > 0;
+        std::error_code ec;
+        bool had_file = std::filesystem::remove(part_path, ec);
+        if (ec) {
+            sl_log_error(LOG_TAG.data(), "Failed to remove %s: %s", part_path.string().c_str(), ec.message().c_str());
+            return SL_STATUS_FAIL;
+        }
+        if (!was_open && !had_file) {
+            return SL_STATUS_NOT_FOUND;
+        }
+
+        sl_log_info(LOG_TAG.data(), "Aborted upload of '%s'", name.c_str());
+        return SL_STATUS_OK;
+    }
+
 }  // namespace ota
@@ -17,6 +17,7 @@
 #include "log.h"
 #include "nlohmann/json.hpp"
 
+#include <optional>
 #include <string_view>
 
 namespace ota
@@ -26,11 +27,44 @@ namespace ota
 
     [[maybe_unused]] static constexpr std::string_view LOG_TAG = "ota_mqtt_api";
 
+    // Binary chunk header, all fields big-endian:
+    //   offset (4) | total size (4) | sequence (2) | name length (1) | name | data
+    static constexpr size_t kChunkHeaderSize = 11;
+
+    static uint32_t read_be32(const uint8_t *p)
+    {
+        return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) | (static_cast<uint32_t>(p[2]) << 8) | p[3];
+    }
+
+    static std::string_view upload_reason_from_status(sl_status_t status)
+    {
+        switch (status) {
+            case SL_STATUS_INVALID_PARAMETER:
+                return reason::INVALID_IMAGE;
+            case SL_STATUS_NOT_FOUND:
+                return reason::UPLOAD_NOT_STARTED;
+            case SL_STATUS_INVALID_RANGE:
+                return reason::OFFSET_MISMATCH;
+            case SL_STATUS_IN_PROGRESS:
+                return reason::INCOMPLETE_UPLOAD;
+            case SL_STATUS_INVALID_SIGNATURE:
+                return reason::CHECKSUM_MISMATCH;
+            case SL_STATUS_NO_MORE_RESOURCE:
+                return reason::TOO_MANY_UPLOADS;
+            default:
+                return reason::UNKNOWN;
+        }
+    }
+
     OTAMqttApi::OTAMqttApi(::threading::safe_queue<ota_external_event_data> &event_queue) : event_queue(event_queue) {}
 
     void OTAMqttApi::setup_mqtt_api()
     {
         zwave_command_class::MqttApiBase::subscribe_topic(MQTT_API_OTA_UPLOAD_IMAGE_TOPIC, [](const std::string &t, const std::string &m) { on_upload_image(t, m); });
+        zwave_command_class::MqttApiBase::subscribe_topic(MQTT_API_OTA_UPLOAD_BEGIN_TOPIC, [](const std::string &t, const std::string &m) { on_upload_begin(t, m); });
+        zwave_command_class::MqttApiBase::subscribe_topic(MQTT_API_OTA_UPLOAD_CHUNK_TOPIC, [](const std::string &t, const std::string &m) { on_upload_chunk(t, m); });
+        zwave_command_class::MqttApiBase::subscribe_topic(MQTT_API_OTA_UPLOAD_COMMIT_TOPIC, [](const std::string &t, const std::string &m) { on_upload_commit(t, m); });
+        zwave_command_class::MqttApiBase::subscribe_topic(MQTT_API_OTA_UPLOAD_ABORT_TOPIC, [](const std::string &t, const std::string &m) { on_upload_abort(t, m); });
         zwave_command_class::MqttApiBase::subscribe_topic(MQTT_API_OTA_START_FIRMWARE_UPLOAD_TOPIC, [this](const std::string &t, const std::string &m) { on_start_firmware_upload(t, m); });
         zwave_command_class::MqttApiBase::subscribe_topic(MQTT_API_OTA_LIST_IMAGES_TOPIC, [](const std::string &t, const std::string &m) { on_list_images(t, m); });
         zwave_command_class::MqttApiBase::subscribe_topic(MQTT_API_OTA_REMOVE_IMAGE_TOPIC, [](const std::string &t, const std::string &m) { on_remove_image(t, m); });
@@ -76,6 +110,128 @@ namespace ota
         publish_report(MQTT_API_OTA_UPLOAD_IMAGE_REPORT_TOPIC, report.dump(), false);
     }
 
+    void OTAMqttApi::on_upload_begin(const std::string & /*topic*/, const std::string &message)
+    {
+        nlohmann::json report;
+
+        try {
+            auto j = nlohmann::json::parse(message);
+
+            std::string name  = j[key::IMAGE_NAME].get<std::string>();
+            size_t image_size = j[key::IMAGE_SIZE].get<size_t>();
+            std::string sha256 = j.value(key::SHA256, std::string());
+            std::optional<uint16_t> crc16;
+            if (j.contains(key::CRC16)) {
+                crc16 = j[key::CRC16].get<uint16_t>();
+            }
+
+            size_t offset      = 0;
+            sl_status_t status = ota::OTAImageStore::begin_upload(name, image_size, sha256, crc16, offset);
+
+            report[key::IMAGE_NAME] = name;
+            report[key::STATUS]     = (status == SL_STATUS_OK) ? status::OK : status::ERROR;
+            if (status == SL_STATUS_OK) {
+                report[key::OFFSET] = offset;
+            } else {
+                report[key::REASON] = upload_reason_from_status(status);
+            }
+
+        } catch (const std::exception &e) {
+            sl_log_error(LOG_TAG.data(), "Failed to parse UploadImage/Begin: %s", e.what());
+            report[key::STATUS] = status::ERROR;
+            report[key::REASON] = e.what();
+        }
+        publish_report(MQTT_API_OTA_UPLOAD_BEGIN_REPORT_TOPIC, report.dump(), false);
+    }
+
+    void OTAMqttApi::on_upload_chunk(const std::string & /*topic*/, const std::string &message)
+    {
+        nlohmann::json report;
+
+        const auto *raw = reinterpret_cast<const uint8_t *>(message.data());
+        if (message.size() < kChunkHeaderSize || message.size() < kChunkHeaderSize + raw[10]) {
+            sl_log_error(LOG_TAG.data(), "UploadImage/Chunk too short (%zu bytes)", message.size());
+            report[key::STATUS] = status::ERROR;
+            report[key::REASON] = reason::INVALID_CHUNK;
+            publish_report(MQTT_API_OTA_UPLOAD_CHUNK_REPORT_TOPIC, report.dump(), false);
+            return;
+        }
+
+        uint32_t offset     = read_be32(raw);
+        uint32_t total_size = read_be32(raw + 4);
+        uint16_t sequence   = static_cast<uint16_t>((raw[8] << 8) | raw[9]);
+        size_t name_length  = raw[10];
+        std::string name(message.data() + kChunkHeaderSize, name_length);
+        const uint8_t *data = raw + kChunkHeaderSize + name_length;
+        size_t data_length  = message.size() - kChunkHeaderSize - name_length;
+
+        size_t next_offset = 0;
+        sl_status_t status = ota::OTAImageStore::write_upload_chunk(name, total_size, offset, data, data_length, next_offset);
+
+        report[key::IMAGE_NAME] = name;
+        report[key::SEQUENCE]   = sequence;
+        report[key::OFFSET]     = next_offset;
+        report[key::STATUS]     = (status == SL_STATUS_OK) ? status::OK : status::ERROR;
+        if (status != SL_STATUS_OK) {
+            report[key::REASON] = upload_reason_from_status(status);
+        }
+        publish_report(MQTT_API_OTA_UPLOAD_CHUNK_REPORT_TOPIC, report.dump(), false);
+    }
+
+    void OTAMqttApi::on_upload_commit(const std::string & /*topic*/, const std::string &message)
+    {
+        nlohmann::json report;
+
+        try {
+            auto j = nlohmann::json::parse(message);
+
+            std::string name = j[key::IMAGE_NAME].get<std::string>();
+            uint16_t crc16   = 0;
+            std::string sha256;
+            sl_status_t status = ota::OTAImageStore::commit_upload(name, crc16, sha256);
+
+            report[key::IMAGE_NAME] = name;
+            report[key::STATUS]     = (status == SL_STATUS_OK) ? status::OK : status::ERROR;
+            if (!sha256.empty()) {
+                report[key::CRC16]  = crc16;
+                report[key::SHA256] = sha256;
+            }
+            if (status != SL_STATUS_OK) {
+                report[key::REASON] = upload_reason_from_status(status);
+            }
+
+        } catch (const std::exception &e) {
+            sl_log_error(LOG_TAG.data(), "Failed to parse UploadImage/Commit: %s", e.what());
+            report[key::STATUS] = status::ERROR;
+            report[key::REASON] = e.what();
+        }
+        publish_report(MQTT_API_OTA_UPLOAD_COMMIT_REPORT_TOPIC, report.dump(), false);
+    }
+
+    void OTAMqttApi::on_upload_abort(const std::string & /*topic*/, const std::string &message)
+    {
+        nlohmann::json report;
+
+        try {
+            auto j = nlohmann::json::parse(message);
+
+            std::string name   = j[key::IMAGE_NAME].get<std::string>();
+            sl_status_t status = ota::OTAImageStore::abort_upload(name);
+
+            report[key::IMAGE_NAME] = name;
+            report[key::STATUS]     = (status == SL_STATUS_OK) ? status::OK : status::ERROR;
+            if (status != SL_STATUS_OK) {
+                report[key::REASON] = upload_reason_from_status(status);
+            }
+
+        } catch (const std::exception &e) {
+            sl_log_error(LOG_TAG.data(), "Failed to parse UploadImage/Abort: %s", e.what());
+            report[key::STATUS] = status::ERROR;
+            report[key::REASON] = e.what();
+        }
+        publish_report(MQTT_API_OTA_UPLOAD_ABORT_REPORT_TOPIC, report.dump(), false);
+    }
+
     void OTAMqttApi::on_start_firmware_upload(const std::string & /*topic*/, const std::string &message)
     {
         try {
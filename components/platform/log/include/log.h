@@ -25,6 +25,7 @@
 
 #ifndef LOG_H
 #define LOG_H
+#include <stdbool.h>
 #include <stdio.h>
 #include <sl_status.h>
 
@@ -84,6 +85,24 @@ void sl_log_set_tag_level(const char *tag, sl_log_level_t level);
  */
 void sl_log_unset_tag_level(const char *tag);
 
+/**
+ * @brief Enable or disable the asynchronous log sink.
+ *
+ * When enabled, sl_log() formats the message into a bounded ring and a
+ * background thread writes it to stderr. Messages at SL_LOG_ERROR and above
+ * are still on stderr when sl_log() returns. Meant to be set once at
+ * startup; disabled by default. Disabling writes out every message logged so
+ * far before returning.
+ *
+ * @param enable true to write logs from the background thread
+ */
+void sl_log_set_async(bool enable);
+
+/**
+ * @brief Wait until all messages logged so far have been written.
+ */
+void sl_log_flush();
+
 /**
  * @brief Convert sl_log_level as string to sl_log_level_t.
  *
@@ -108,6 +127,18 @@ sl_status_t sl_log_level_from_string(const char *level, sl_log_level_t *result);
  */
 sl_status_t sl_log_apply_config(const char *log_level_str, const char *tag_level_str);
 
+/**
+ * @brief Tells if messages of a level would be written for a tag.
+ *
+ * Lets callers skip building expensive log arguments, such as frame dumps,
+ * when the message would be dropped anyway.
+ *
+ * @param tag Log tag to check
+ * @param level Log level to check
+ * @return true if sl_log() would write the message
+ */
+bool sl_log_is_enabled(const char *tag, sl_log_level_t level);
+
 /**
  * @brief Write to the log
  *
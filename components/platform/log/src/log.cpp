@@ -12,12 +12,17 @@
  *****************************************************************************/
 #include "log.h"
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <cstdarg>
 #include <cstdio>
 #include <cstring>
+#include <ctime>
 #include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -33,10 +38,17 @@ namespace
 
     void init_log_output();
 
-    // Map storing tag specific log levels
+    // Map storing tag specific log levels, guarded by config_mutex
     std::unordered_map<std::string, sl_log_level_t> log_levels;
     // Global log level (default matches config default "i")
-    sl_log_level_t log_level = SL_LOG_INFO;
+    std::atomic<sl_log_level_t> log_level {SL_LOG_INFO};
+    std::shared_mutex config_mutex;
+    // Lowest threshold of the global level and all tag levels. Anything below
+    // it is dropped before looking at the tag or formatting the message.
+    std::atomic<int> min_threshold {SL_LOG_INFO};
+    // Bumped whenever a level changes, invalidates the per-thread tag caches.
+    std::atomic<uint32_t> config_generation {1};
+
     std::mutex log_mutex;
     bool use_color = false;
 
@@ -44,39 +56,365 @@ namespace
     const char *log_level_long[]  = {"debug", "info", "Warning", "Error", "CRITICAL"};
     const char *log_level_color[] = {"\033[34;1m", "\033[32;1m", "\033[33;1m", "\033[31;1m", "\033[37;41;1m"};
 
+    // ---- Level filter ----
+
+    constexpr size_t TAG_CACHE_SIZE     = 16;  // per thread, direct mapped on the tag pointer
+    constexpr size_t TAG_CACHE_NAME_MAX = 32;
+
+    struct tag_cache_entry {
+            const char *tag     = nullptr;
+            uint32_t generation = 0;
+            sl_log_level_t threshold;
+            char name[TAG_CACHE_NAME_MAX];  // tags are not always literals, the pointer alone is not enough
+    };
+
+    thread_local tag_cache_entry tag_cache[TAG_CACHE_SIZE];
+
+    // Must be called with config_mutex held exclusively.
+    void update_min_threshold()
+    {
+        int threshold = log_level.load();
+        for (const auto &[tag, level]: log_levels) {
+            threshold = std::min<int>(threshold, level);
+        }
+        min_threshold.store(threshold);
+        config_generation.fetch_add(1);
+    }
+
+    sl_log_level_t tag_threshold(const char *tag)
+    {
+        std::shared_lock<std::shared_mutex> lock(config_mutex);
+        auto it = log_levels.find(tag);
+        return (it != log_levels.end()) ? it->second : log_level.load();
+    }
+
     bool should_log(const char *tag, sl_log_level_t level)
     {
-        auto it                  = log_levels.find(tag);
-        sl_log_level_t threshold = (it != log_levels.end()) ? it->second : log_level;
+        if (level < min_threshold.load(std::memory_order_relaxed)) {
+            return false;
+        }
+
+        const uint32_t generation = config_generation.load(std::memory_order_acquire);
+        tag_cache_entry &entry    = tag_cache[(reinterpret_cast<uintptr_t>(tag) >> 3) % TAG_CACHE_SIZE];
+        if (entry.tag == tag && entry.generation == generation && std::strcmp(entry.name, tag) == 0) {
+            return level >= entry.threshold;
+        }
+
+        sl_log_level_t threshold = tag_threshold(tag);
+        size_t tag_length        = std::strlen(tag);
+        if (tag_length < TAG_CACHE_NAME_MAX) {
+            std::memcpy(entry.name, tag, tag_length + 1);
+            entry.tag        = tag;
+            entry.generation = generation;
+            entry.threshold  = threshold;
+        }
         return level >= threshold;
     }
 
-    std::string format_timestamp()
+    // ---- Output ----
+
+    using log_clock = std::chrono::system_clock;
+
+    // Appends "<timestamp> <l> [tag] message\n" to out. The timestamp of the
+    // current second is cached by the caller in second/second_text.
+    void append_line(std::string &out, log_clock::time_point time, sl_log_level_t level, const char *tag, const char *msg, size_t msg_length, std::time_t &second, char (&second_text)[32])
+    {
+        const auto since_epoch = time.time_since_epoch();
+        const std::time_t t    = std::chrono::duration_cast<std::chrono::seconds>(since_epoch).count();
+        const int ms           = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(since_epoch).count() % 1000);
+        if (t != second) {
+            std::tm tm_buf;
+            localtime_r(&t, &tm_buf);
+            std::strftime(second_text, sizeof(second_text), "%Y-%m-%d %H:%M:%S", &tm_buf);
+            second = t;
+        }
+
+        char prefix[96];
+        int prefix_length;
+        if (use_color) {
+            prefix_length = std::snprintf(prefix, sizeof(prefix), "%s.%03d %s <%s> [", second_text, ms, log_level_color[level], log_level_short[level]);
+        } else {
+            prefix_length = std::snprintf(prefix, sizeof(prefix), "%s.%03d <%s> [", second_text, ms, log_level_short[level]);
+        }
+        out.append(prefix, static_cast<size_t>(prefix_length));
+        out.append(tag);
+        out.append("] ");
+        if (msg_length > 0 && msg[msg_length - 1] == '\n') {
+            msg_length--;
+        }
+        out.append(msg, msg_length);
+        out.append(use_color ? "\033[0m\n" : "\n");
+    }
+
+    void write_output(const std::string &text)
+    {
+        std::fwrite(text.data(), 1, text.size(), stderr);
+        std::fflush(stderr);
+    }
+
+    // ---- Asynchronous sink ----
+    //
+    // Bounded multi-producer ring (one sequence number per slot, as in Vyukov's
+    // bounded queue) drained by a single writer thread. Callers format straight
+    // into their slot; the writer turns a batch of records into one write().
+
+    std::atomic<bool> async_enabled {false};
+    // Held shared by callers while they enqueue into the sink, and exclusively
+    // to switch the sink off, so that no record lands behind a stopped writer.
+    std::shared_mutex sink_mutex;
+
+    constexpr size_t LOG_RING_SIZE   = 1024;  // power of two
+    constexpr size_t LOG_RECORD_TEXT = 240;
+    constexpr size_t LOG_RECORD_TAG  = 32;
+
+    struct log_record {
+            std::atomic<size_t> sequence;
+            log_clock::time_point time;
+            sl_log_level_t level;
+            size_t length;
+            char tag[LOG_RECORD_TAG];
+            char text[LOG_RECORD_TEXT];
+            std::string overflow;  // used when the message does not fit in text
+    };
+
+    class log_sink
+    {
+        public:
+            log_sink()
+            {
+                for (size_t i = 0; i < LOG_RING_SIZE; i++) {
+                    ring[i].sequence.store(i, std::memory_order_relaxed);
+                }
+            }
+
+            ~log_sink()
+            {
+                // Anything logged from here on (other static destructors) is written synchronously.
+                drain_and_stop();
+            }
+
+            bool is_running() const
+            {
+                return running.load(std::memory_order_acquire);
+            }
+
+            void start()
+            {
+                std::lock_guard<std::mutex> lock(control_mutex);
+                if (running.load()) {
+                    return;
+                }
+                stopping.store(false);
+                writer = std::thread(&log_sink::run, this);
+                running.store(true, std::memory_order_release);
+            }
+
+            // Switches the sink off once everything enqueued so far is written.
+            void drain_and_stop()
+            {
+                std::unique_lock<std::shared_mutex> lock(sink_mutex);
+                async_enabled.store(false);
+                flush_all();
+                stop();
+            }
+
+            void stop()
+            {
+                std::lock_guard<std::mutex> lock(control_mutex);
+                if (!running.load()) {
+                    return;
+                }
+                running.store(false, std::memory_order_release);
+                stopping.store(true);
+                published.fetch_add(1);
+                published.notify_one();
+                writer.join();
+            }
+
+            // Returns the position of the record, to be passed to flush().
+            // Must be called with sink_mutex held shared.
+            size_t log(const char *tag, sl_log_level_t level, log_clock::time_point time, const char *fmtstr, va_list args)
+            {
+                size_t pos        = enqueue_pos.load(std::memory_order_relaxed);
+                log_record *record = nullptr;
+                while (true) {
+                    record          = &ring[pos & (LOG_RING_SIZE - 1)];
+                    size_t sequence = record->sequence.load(std::memory_order_acquire);
+                    intptr_t diff   = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+                    if (diff == 0) {
+                        if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            break;
+                        }
+                    } else if (diff < 0) {
+                        // Ring full: wait for the writer rather than losing the message.
+                        std::this_thread::yield();
+                        pos = enqueue_pos.load(std::memory_order_relaxed);
+                    } else {
+                        pos = enqueue_pos.load(std::memory_order_relaxed);
+                    }
+                }
+
+                record->time  = time;
+                record->level = level;
+                std::strncpy(record->tag, tag, LOG_RECORD_TAG - 1);
+                record->tag[LOG_RECORD_TAG - 1] = '\0';
+
+                va_list args_copy;
+                va_copy(args_copy, args);
+                int length = std::vsnprintf(record->text, LOG_RECORD_TEXT, fmtstr, args);
+                if (length < 0) {
+                    length = 0;
+                }
+                record->length = static_cast<size_t>(length);
+                if (record->length >= LOG_RECORD_TEXT) {
+                    record->overflow.resize(record->length + 1);
+                    std::vsnprintf(record->overflow.data(), record->length + 1, fmtstr, args_copy);
+                    record->overflow.resize(record->length);
+                }
+                va_end(args_copy);
+
+                record->sequence.store(pos + 1, std::memory_order_seq_cst);
+                // Waking the writer is a syscall, only pay for it when it sleeps.
+                if (writer_waiting.load(std::memory_order_seq_cst)) {
+                    published.fetch_add(1, std::memory_order_release);
+                    published.notify_one();
+                }
+                return pos;
+            }
+
+            // Waits until the record at pos, and everything before it, is written.
+            void flush(size_t pos)
+            {
+                size_t done = written.load(std::memory_order_acquire);
+                while (done <= pos && is_running()) {
+                    written.wait(done);
+                    done = written.load(std::memory_order_acquire);
+                }
+            }
+
+            void flush_all()
+            {
+                size_t pos = enqueue_pos.load(std::memory_order_acquire);
+                if (pos > 0) {
+                    flush(pos - 1);
+                }
+            }
+
+        private:
+            void run()
+            {
+                std::string batch;
+                std::time_t second = 0;
+                char second_text[32] = {};
+                // Continue where a previous writer stopped, the ring keeps its positions.
+                size_t pos = written.load(std::memory_order_acquire);
+
+                while (true) {
+                    uint32_t seen = published.load(std::memory_order_acquire);
+
+                    batch.clear();
+                    size_t start = pos;
+                    while (pos - start < LOG_RING_SIZE) {
+                        log_record &record = ring[pos & (LOG_RING_SIZE - 1)];
+                        if (record.sequence.load(std::memory_order_acquire) != pos + 1) {
+                            break;
+                        }
+                        const char *msg = (record.length >= LOG_RECORD_TEXT) ? record.overflow.c_str() : record.text;
+                        append_line(batch, record.time, record.level, record.tag, msg, record.length, second, second_text);
+                        if (record.overflow.capacity() > 4 * LOG_RECORD_TEXT) {
+                            std::string().swap(record.overflow);
+                        }
+                        record.sequence.store(pos + LOG_RING_SIZE, std::memory_order_release);
+                        pos++;
+                    }
+
+                    if (pos != start) {
+                        write_output(batch);
+                        written.store(pos, std::memory_order_release);
+                        written.notify_all();
+                        continue;
+                    }
+
+                    if (stopping.load() && enqueue_pos.load() == pos) {
+                        return;
+                    }
+
+                    // Announce that we are about to sleep, then look once more so
+                    // that a record published in between is not missed.
+                    writer_waiting.store(true, std::memory_order_seq_cst);
+                    if (ring[pos & (LOG_RING_SIZE - 1)].sequence.load(std::memory_order_seq_cst) != pos + 1 && !stopping.load()) {
+                        published.wait(seen, std::memory_order_acquire);
+                    }
+                    writer_waiting.store(false, std::memory_order_relaxed);
+                }
+            }
+
+            log_record ring[LOG_RING_SIZE];
+            alignas(64) std::atomic<size_t> enqueue_pos {0};
+            alignas(64) std::atomic<uint32_t> published {0};
+            std::atomic<bool> writer_waiting {false};
+            alignas(64) std::atomic<size_t> written {0};
+            std::atomic<bool> running {false};
+            std::atomic<bool> stopping {false};
+            std::mutex control_mutex;
+            std::thread writer;
+    };
+
+    log_sink &sink()
     {
-        auto now = std::chrono::system_clock::now();
-        auto t   = std::chrono::system_clock::to_time_t(now);
-        auto ms  = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
-        std::tm tm_buf;
-        localtime_r(&t, &tm_buf);
-        char buf[64];
-        std::snprintf(buf, sizeof(buf), "%04d-%02d-%02d %02d:%02d:%02d.%03d", tm_buf.tm_year + 1900, tm_buf.tm_mon + 1, tm_buf.tm_mday, tm_buf.tm_hour, tm_buf.tm_min, tm_buf.tm_sec, static_cast<int>(ms.count()));
-        return buf;
+        static log_sink instance;
+        return instance;
     }
 
-    void write_log(const char *tag, sl_log_level_t level, const std::string &msg)
+    void write_log_sync(const char *tag, sl_log_level_t level, log_clock::time_point time, const char *fmtstr, va_list args)
     {
-        if (!should_log(tag, level)) {
-            return;
+        char buffer[512];
+        va_list args_copy;
+        va_copy(args_copy, args);
+        int length = std::vsnprintf(buffer, sizeof(buffer), fmtstr, args);
+        std::string overflow;
+        const char *msg = buffer;
+        if (length < 0) {
+            length = 0;
+        } else if (static_cast<size_t>(length) >= sizeof(buffer)) {
+            overflow.resize(static_cast<size_t>(length) + 1);
+            std::vsnprintf(overflow.data(), overflow.size(), fmtstr, args_copy);
+            msg = overflow.c_str();
         }
+        va_end(args_copy);
+
+        std::lock_guard<std::mutex> lock(log_mutex);
+        static std::string line;
+        static std::time_t second = 0;
+        static char second_text[32];
+        line.clear();
+        append_line(line, time, level, tag, msg, static_cast<size_t>(length), second, second_text);
+        write_output(line);
+    }
+
+    void write_log(const char *tag, sl_log_level_t level, const char *fmtstr, va_list args)
+    {
         static bool once = (init_log_output(), true);
         (void)once;
-        std::lock_guard<std::mutex> lock(log_mutex);
-        std::string ts = format_timestamp();
-        if (use_color) {
-            std::fprintf(stderr, "%s %s <%s> [%s] %s\033[0m\n", ts.c_str(), log_level_color[level], log_level_short[level], tag, msg.c_str());
-        } else {
-            std::fprintf(stderr, "%s <%s> [%s] %s\n", ts.c_str(), log_level_short[level], tag, msg.c_str());
+
+        const auto now = log_clock::now();
+        if (async_enabled.load(std::memory_order_relaxed)) {
+            std::shared_lock<std::shared_mutex> lock(sink_mutex);
+            // Look again, the sink may have been switched off meanwhile.
+            if (async_enabled.load(std::memory_order_relaxed)) {
+                log_sink &s = sink();
+                if (!s.is_running()) {
+                    s.start();
+                }
+                size_t pos = s.log(tag, level, now, fmtstr, args);
+                // Errors must be on stderr before the caller goes on, it may be about to abort.
+                if (level >= SL_LOG_ERROR) {
+                    s.flush(pos);
+                }
+                return;
+            }
         }
+        write_log_sync(tag, level, now, fmtstr, args);
     }
 
     void to_lower(std::string &s)
@@ -124,7 +462,11 @@ namespace
 
 void sl_log_set_level(sl_log_level_t level)
 {
-    log_level = level;
+    {
+        std::unique_lock<std::shared_mutex> lock(config_mutex);
+        log_level.store(level);
+        update_min_threshold();
+    }
     sl_log_debug(LOG_TAG, "Setting log level to %s\n", log_level_long[level]);
 }
 
@@ -135,16 +477,40 @@ sl_log_level_t sl_log_get_level()
 
 void sl_log_set_tag_level(const char *tag, sl_log_level_t level)
 {
-    log_levels[tag] = level;
+    {
+        std::unique_lock<std::shared_mutex> lock(config_mutex);
+        log_levels[tag] = level;
+        update_min_threshold();
+    }
     sl_log_debug(LOG_TAG, "Setting log level for '%s' to %s", tag, log_level_long[level]);
 }
 
 void sl_log_unset_tag_level(const char *tag)
 {
-    log_levels.erase(tag);
+    {
+        std::unique_lock<std::shared_mutex> lock(config_mutex);
+        log_levels.erase(tag);
+        update_min_threshold();
+    }
     sl_log_debug(LOG_TAG, "Unsetting log level for '%s'\n", tag);
 }
 
+void sl_log_set_async(bool enable)
+{
+    if (!enable) {
+        sink().drain_and_stop();
+        return;
+    }
+    async_enabled.store(true);
+}
+
+void sl_log_flush()
+{
+    if (sink().is_running()) {
+        sink().flush_all();
+    }
+}
+
 sl_status_t sl_log_level_from_string(const char *level, sl_log_level_t *result)
 {
     std::string level_lower(level);
@@ -211,18 +577,18 @@ sl_status_t sl_log_apply_config(const char *log_level_str, const char *tag_level
     return SL_STATUS_OK;
 }
 
+bool sl_log_is_enabled(const char *tag, sl_log_level_t level)
+{
+    return should_log(tag, level);
+}
+
 void sl_log(const char *const tag, sl_log_level_t level, const char *fmtstr, ...)
 {
+    if (!should_log(tag, level)) {
+        return;
+    }
     va_list myargs;
     va_start(myargs, fmtstr);
-    size_t size = static_cast<size_t>(std::vsnprintf(nullptr, 0, fmtstr, myargs)) + 1;
+    write_log(tag, level, fmtstr, myargs);
     va_end(myargs);
-    std::string mystr(size - 1, '\0');
-    va_start(myargs, fmtstr);
-    std::vsnprintf(mystr.data(), size, fmtstr, myargs);
-    va_end(myargs);
-    if (!mystr.empty() && mystr.back() == '\n') {
-        mystr.pop_back();
-    }
-    write_log(tag, level, mystr);
 }
@@ -0,0 +1,355 @@
+/******************************************************************************
+ * # License
+ * <b>Copyright 2026 Silicon Laboratories Inc. www.silabs.com</b>
+ ******************************************************************************
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by
+ * the sections of the MSLA applicable to Source Code.
+ *
+ *****************************************************************************/
+#ifndef BOUNDED_QUEUE_HPP
+#define BOUNDED_QUEUE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace threading
+{
+    /**
+     * @brief Bounded multi-producer, single-consumer queue with a pollable handle
+     *
+     * Elements live in a fixed ring of slots; producers claim a slot with a
+     * compare-and-swap and never take a lock. Only one thread may consume
+     * (pop, try_pop, drain_into, arm).
+     *
+     * The queue owns an eventfd that becomes readable when an element is
+     * pushed while the consumer is waiting, so a component thread can wait on
+     * its queue and its own file descriptors with a single poll(). The
+     * consumer side of that protocol is:
+     *
+     * @code
+     * if (queue.arm()) {                 // queue is empty, we may sleep
+     *     poll(fds including queue.fd(), ...);
+     *     queue.disarm();
+     * }
+     * queue.drain_into(batch, max);
+     * @endcode
+     *
+     * When the queue is full, push() waits for the consumer and try_push()
+     * fails, leaving the choice of back-pressure to the producer.
+     *
+     * @tparam T The type of elements stored in the queue
+     */
+    template<typename T> class bounded_queue
+    {
+        public:
+            /**
+             * @brief Constructor
+             *
+             * @param capacity Maximum number of queued elements, rounded up to a power of two
+             */
+            explicit bounded_queue(size_t capacity = 1024) : mask_(round_up_pow2(capacity) - 1), slots_(new slot[mask_ + 1])
+            {
+                for (size_t i = 0; i <= mask_; i++) {
+                    slots_[i].sequence.store(i, std::memory_order_relaxed);
+                }
+                event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+                if (event_fd_ < 0) {
+                    throw std::runtime_error("bounded_queue: eventfd() failed");
+                }
+            }
+
+            /**
+             * @brief Destructor
+             */
+            ~bounded_queue()
+            {
+                while (try_pop()) {
+                }
+                close(event_fd_);
+            }
+
+            // Delete copy constructor and assignment operator for thread safety
+            bounded_queue(const bounded_queue &)            = delete;
+            bounded_queue &operator=(const bounded_queue &) = delete;
+
+            /**
+             * @brief Push an element, failing if the queue is full (non-blocking)
+             *
+             * @param value The value to push (moved only on success)
+             * @return true if the element was queued, false if the queue was full
+             */
+            bool try_push(T &&value)
+            {
+                slot *s = claim(false);
+                if (s == nullptr) {
+                    return false;
+                }
+                publish(s, std::move(value));
+                return true;
+            }
+
+            /**
+             * @brief Push an element, failing if the queue is full (non-blocking)
+             *
+             * @param value The value to push
+             * @return true if the element was queued, false if the queue was full
+             */
+            bool try_push(const T &value)
+            {
+                return try_push(T(value));
+            }
+
+            /**
+             * @brief Push an element, waiting for room if the queue is full
+             *
+             * Must not be called from the consumer thread, it would wait for itself.
+             *
+             * @param value The value to push (will be moved)
+             */
+            void push(T &&value)
+            {
+                publish(claim(true), std::move(value));
+            }
+
+            /**
+             * @brief Push an element, waiting for room if the queue is full
+             *
+             * @param value The value to push
+             */
+            void push(const T &value)
+            {
+                push(T(value));
+            }
+
+            /**
+             * @brief Try to pop an element from the front of the queue (non-blocking)
+             *
+             * @return std::optional containing the value if available, empty otherwise
+             */
+            std::optional<T> try_pop()
+            {
+                slot &s = slots_[dequeue_pos_ & mask_];
+                if (s.sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1) {
+                    return std::nullopt;
+                }
+                std::optional<T> value(std::move(*s.value));
+                s.value.reset();
+                s.sequence.store(dequeue_pos_ + mask_ + 1, std::memory_order_release);
+                dequeue_pos_++;
+                dequeued_.store(dequeue_pos_, std::memory_order_release);
+                return value;
+            }
+
+            /**
+             * @brief Pop an element from the front of the queue with a timeout (blocking)
+             *
+             * @param timeout_ms Timeout in milliseconds, negative to wait forever
+             * @return std::optional containing the value if available, empty if timeout expired or woken
+             */
+            std::optional<T> pop(int timeout_ms = 0)
+            {
+                if (timeout_ms != 0 && arm()) {
+                    pollfd pfd = {event_fd_, POLLIN, 0};
+                    poll(&pfd, 1, timeout_ms);
+                    disarm();
+                }
+                return try_pop();
+            }
+
+            /**
+             * @brief Move up to max queued elements to the back of batch (non-blocking)
+             *
+             * @param batch Vector the elements are appended to
+             * @param max Maximum number of elements to move
+             * @return The number of elements moved
+             */
+            size_t drain_into(std::vector<T> &batch, size_t max)
+            {
+                size_t count = 0;
+                while (count < max) {
+                    std::optional<T> value = try_pop();
+                    if (!value) {
+                        break;
+                    }
+                    batch.push_back(std::move(*value));
+                    count++;
+                }
+                return count;
+            }
+
+            /**
+             * @brief Get the number of elements in the queue
+             *
+             * Constant time. Concurrent pushes may not be counted yet.
+             *
+             * @return The number of elements
+             */
+            size_t size() const
+            {
+                size_t dequeued = dequeued_.load(std::memory_order_acquire);
+                size_t enqueued = enqueue_pos_.load(std::memory_order_acquire);
+                return (enqueued > dequeued) ? enqueued - dequeued : 0;
+            }
+
+            /**
+             * @brief Check if the queue is empty
+             *
+             * @return true if queue is empty, false otherwise
+             */
+            bool empty() const
+            {
+                return size() == 0;
+            }
+
+            /**
+             * @brief Maximum number of elements the queue holds
+             */
+            size_t capacity() const
+            {
+                return mask_ + 1;
+            }
+
+            /**
+             * @brief File descriptor that becomes readable when the armed consumer should wake up
+             */
+            int fd() const
+            {
+                return event_fd_;
+            }
+
+            /**
+             * @brief Announce that the consumer is about to wait on fd()
+             *
+             * @return true if the queue is empty and the consumer may wait,
+             *         false if elements are available or about to be
+             */
+            bool arm()
+            {
+                slot &s = slots_[dequeue_pos_ & mask_];
+                if (s.sequence.load(std::memory_order_acquire) == dequeue_pos_ + 1) {
+                    return false;
+                }
+                // Give running producers a chance to queue a batch before paying
+                // for a sleep and an eventfd wake-up per element.
+                std::this_thread::yield();
+                waiting_.store(true, std::memory_order_seq_cst);
+                if (s.sequence.load(std::memory_order_seq_cst) == dequeue_pos_ + 1) {
+                    waiting_.store(false, std::memory_order_relaxed);
+                    return false;
+                }
+                if (enqueue_pos_.load(std::memory_order_seq_cst) != dequeue_pos_) {
+                    // A producer claimed the next slot but has not filled it yet.
+                    // It is about to, so let it run rather than going to sleep.
+                    waiting_.store(false, std::memory_order_relaxed);
+                    std::this_thread::yield();
+                    return false;
+                }
+                return true;
+            }
+
+            /**
+             * @brief Reset the wake-up signal after waiting on fd()
+             */
+            void disarm()
+            {
+                waiting_.store(false, std::memory_order_relaxed);
+                uint64_t counter;
+                while (read(event_fd_, &counter, sizeof(counter)) < 0 && errno == EINTR) {
+                }
+            }
+
+            /**
+             * @brief Wake the consumer without queueing anything, e.g. to make it check a stop flag
+             */
+            void wake()
+            {
+                uint64_t one = 1;
+                while (write(event_fd_, &one, sizeof(one)) < 0 && errno == EINTR) {
+                }
+            }
+
+        private:
+            struct slot {
+                    std::atomic<size_t> sequence;
+                    std::optional<T> value;
+            };
+
+            static size_t round_up_pow2(size_t value)
+            {
+                size_t result = 2;
+                while (result < value) {
+                    result <<= 1;
+                }
+                return result;
+            }
+
+            slot *claim(bool wait_for_room)
+            {
+                size_t pos      = enqueue_pos_.load(std::memory_order_relaxed);
+                unsigned full_spins = 0;
+                while (true) {
+                    slot &s         = slots_[pos & mask_];
+                    size_t sequence = s.sequence.load(std::memory_order_acquire);
+                    intptr_t diff   = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+                    if (diff == 0) {
+                        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            return &s;
+                        }
+                    } else if (diff < 0) {
+                        if (!wait_for_room) {
+                            return nullptr;
+                        }
+                        // Back off harder the longer the consumer lags behind, so that
+                        // waiting producers do not starve it of CPU.
+                        if (full_spins < 16) {
+                            full_spins++;
+                            std::this_thread::yield();
+                        } else {
+                            std::this_thread::sleep_for(std::chrono::microseconds(50));
+                        }
+                        pos = enqueue_pos_.load(std::memory_order_relaxed);
+                    } else {
+                        pos = enqueue_pos_.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            void publish(slot *s, T &&value)
+            {
+                size_t pos = s->sequence.load(std::memory_order_relaxed);
+                s->value.emplace(std::move(value));
+                s->sequence.store(pos + 1, std::memory_order_seq_cst);
+                // Only pay for the eventfd write when the consumer is asleep.
+                if (waiting_.load(std::memory_order_seq_cst) && waiting_.exchange(false)) {
+                    wake();
+                }
+            }
+
+            const size_t mask_;
+            std::unique_ptr<slot[]> slots_;
+            int event_fd_ = -1;
+            alignas(64) std::atomic<size_t> enqueue_pos_ {0};
+            alignas(64) std::atomic<size_t> dequeued_ {0};  ///< Copy of dequeue_pos_ for size() from other threads
+            std::atomic<bool> waiting_ {false};
+            size_t dequeue_pos_ = 0;  ///< Consumer thread only
+    };
+
+}  // namespace threading
+
+#endif  // BOUNDED_QUEUE_HPP
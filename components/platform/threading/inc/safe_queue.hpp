@@ -13,19 +13,21 @@
 #ifndef SAFE_QUEUE_HPP
 #define SAFE_QUEUE_HPP
 
-#include <queue>
+#include <algorithm>
+#include <deque>
 #include <mutex>
 #include <condition_variable>
 #include <optional>
 #include <cstddef>
 #include <chrono>
+#include <vector>
 
 namespace threading
 {
     /**
      * @brief Thread-safe queue template class
      *
-     * This class provides a thread-safe wrapper around std::queue. All operations
+     * This class provides a thread-safe wrapper around std::deque. All operations
      * are protected by a mutex to ensure thread safety. The queue supports
      * blocking and non-blocking operations.
      *
@@ -56,7 +58,7 @@ namespace threading
             void push(const T &value)
             {
                 std::lock_guard<std::mutex> lock(mutex_);
-                queue_.push(value);
+                queue_.push_back(value);
                 condition_.notify_one();
             }
 
@@ -68,7 +70,7 @@ namespace threading
             void push(T &&value)
             {
                 std::lock_guard<std::mutex> lock(mutex_);
-                queue_.push(std::move(value));
+                queue_.push_back(std::move(value));
                 condition_.notify_one();
             }
 
@@ -87,7 +89,7 @@ namespace threading
                 bool has_value = condition_.wait_for(lock, timeout, [this] { return !queue_.empty(); });
                 if (has_value) {
                     T value = std::move(queue_.front());
-                    queue_.pop();
+                    queue_.pop_front();
                     return value;
                 }
                 return std::nullopt;
@@ -106,7 +108,7 @@ namespace threading
                     return false;
                 }
                 value = std::move(queue_.front());
-                queue_.pop();
+                queue_.pop_front();
                 return true;
             }
 
@@ -122,10 +124,30 @@ namespace threading
                     return std::nullopt;
                 }
                 T value = std::move(queue_.front());
-                queue_.pop();
+                queue_.pop_front();
                 return value;
             }
 
+            /**
+             * @brief Move up to max queued elements to the back of batch (non-blocking)
+             *
+             * Takes the lock once for the whole batch.
+             *
+             * @param batch Vector the elements are appended to
+             * @param max Maximum number of elements to move
+             * @return The number of elements moved
+             */
+            size_t drain_into(std::vector<T> &batch, size_t max)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                size_t count = std::min(max, queue_.size());
+                for (size_t i = 0; i < count; i++) {
+                    batch.push_back(std::move(queue_.front()));
+                    queue_.pop_front();
+                }
+                return count;
+            }
+
             /**
              * @brief Check if the queue is empty
              *
@@ -154,9 +176,7 @@ namespace threading
             void clear()
             {
                 std::lock_guard<std::mutex> lock(mutex_);
-                while (!queue_.empty()) {
-                    queue_.pop();
-                }
+                queue_.clear();
             }
 
             /**
@@ -168,21 +188,13 @@ namespace threading
             size_t count(const T &value) const
             {
                 std::lock_guard<std::mutex> lock(mutex_);
-                size_t count             = 0;
-                std::queue<T> temp_queue = queue_;
-                while (!temp_queue.empty()) {
-                    if (temp_queue.front() == value) {
-                        count++;
-                    }
-                    temp_queue.pop();
-                }
-                return count;
+                return static_cast<size_t>(std::count(queue_.begin(), queue_.end(), value));
             }
 
         private:
             mutable std::mutex mutex_;           ///< Mutex for thread synchronization
             std::condition_variable condition_;  ///< Condition variable for blocking operations
-            std::queue<T> queue_;                ///< Underlying queue
+            std::deque<T> queue_;                ///< Underlying queue
     };
 
 }  // namespace threading
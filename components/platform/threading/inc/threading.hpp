@@ -43,6 +43,15 @@ namespace threading
             virtual void run() = 0;
 
         protected:
+            /**
+             * @brief Wake up a run() that is blocked waiting for work
+             *
+             * Called by stop() after the stop flag is set. Derived classes that
+             * block in run() for longer than they can afford to delay a stop
+             * override this to interrupt the wait, e.g. via bounded_queue::wake().
+             */
+            virtual void wake() {}
+
             std::string thread_name;
             std::thread thread;
             std::atomic<bool> should_stop_flag;
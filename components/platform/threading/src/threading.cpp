@@ -47,6 +47,7 @@ namespace threading
 
         // Signal thread to stop
         should_stop_flag = true;
+        wake();
 
         // Wait for thread to finish
         if (thread.joinable()) {
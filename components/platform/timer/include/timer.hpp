@@ -71,16 +71,16 @@ bool timer_running(struct timer_handle_t *t);
 
 #ifdef __cplusplus
 
+#include <algorithm>
 #include <chrono>
 #include <thread>
 #include <atomic>
 #include <mutex>
 #include <condition_variable>
-#include <queue>
 #include <functional>
-#include <memory>
-#include <unordered_map>
+#include <vector>
 #include <cstdint>
+#include <cstddef>
 
 namespace timer
 {
@@ -94,24 +94,138 @@ namespace timer
             TimePoint last_expiration_time;
             std::function<void()> callback;
             Duration interval;
+            size_t heap_index;  // Position in the timer heap, or TimerHeap::npos
             bool is_active;
             bool is_set;
     };
 
-    struct TimerEntryComparator {
-            bool operator()(const std::shared_ptr<TimerEntry> &a, const std::shared_ptr<TimerEntry> &b) const
+    /**
+     * \brief Indexed 4-ary min-heap of timer slots ordered by expiration time.
+     *
+     * The heap stores slot indices into the TimerManager entry pool, and every
+     * entry remembers its own heap position. Re-arming or cancelling a timer is
+     * therefore an in-place sift of a single element, O(log n), instead of a
+     * rebuild of the whole queue.
+     */
+    class TimerHeap
+    {
+        public:
+            static constexpr size_t npos  = SIZE_MAX;
+            static constexpr size_t arity = 4;
+
+            explicit TimerHeap(std::vector<TimerEntry> &entries) : entries_(entries) {}
+
+            bool empty() const
+            {
+                return heap_.empty();
+            }
+
+            uint32_t top() const
+            {
+                return heap_.front();
+            }
+
+            /// Insert the slot, or move it to its new position if already queued.
+            void update(uint32_t slot)
+            {
+                size_t index = entries_[slot].heap_index;
+                if (index == npos) {
+                    index                     = heap_.size();
+                    entries_[slot].heap_index = index;
+                    heap_.push_back(slot);
+                    sift_up(index);
+                    return;
+                }
+                if (index > 0 && less(slot, heap_[(index - 1) / arity])) {
+                    sift_up(index);
+                } else {
+                    sift_down(index);
+                }
+            }
+
+            /// Remove the slot from the heap if it is queued.
+            void remove(uint32_t slot)
             {
-                return a->expiration_time > b->expiration_time;
+                size_t index = entries_[slot].heap_index;
+                if (index == npos) {
+                    return;
+                }
+                entries_[slot].heap_index = npos;
+                uint32_t last             = heap_.back();
+                heap_.pop_back();
+                if (index == heap_.size()) {
+                    return;
+                }
+                place(index, last);
+                update(last);
             }
+
+        private:
+            bool less(uint32_t a, uint32_t b) const
+            {
+                return entries_[a].expiration_time < entries_[b].expiration_time;
+            }
+
+            void place(size_t index, uint32_t slot)
+            {
+                heap_[index]              = slot;
+                entries_[slot].heap_index = index;
+            }
+
+            void sift_up(size_t index)
+            {
+                uint32_t slot = heap_[index];
+                while (index > 0) {
+                    size_t parent = (index - 1) / arity;
+                    if (!less(slot, heap_[parent])) {
+                        break;
+                    }
+                    place(index, heap_[parent]);
+                    index = parent;
+                }
+                place(index, slot);
+            }
+
+            void sift_down(size_t index)
+            {
+                uint32_t slot = heap_[index];
+                size_t size   = heap_.size();
+                while (true) {
+                    size_t first = index * arity + 1;
+                    if (first >= size) {
+                        break;
+                    }
+                    size_t last     = std::min(first + arity, size);
+                    size_t smallest = first;
+                    for (size_t child = first + 1; child < last; ++child) {
+                        if (less(heap_[child], heap_[smallest])) {
+                            smallest = child;
+                        }
+                    }
+                    if (!less(heap_[smallest], slot)) {
+                        break;
+                    }
+                    place(index, heap_[smallest]);
+                    index = smallest;
+                }
+                place(index, slot);
+            }
+
+            std::vector<TimerEntry> &entries_;
+            std::vector<uint32_t> heap_;
     };
 
     /**
      * \brief TimerManager class for managing timers using C++ chrono
+     *
+     * Timer entries live in a pooled slab addressed by slot index. The opaque
+     * timer handle given to C code is the slot index plus one, so a zeroed
+     * \ref timer_handle_t is recognised as "not yet created".
      */
     class TimerManager
     {
         public:
-            TimerManager() : running_(false), next_id_(1) {}
+            TimerManager() : running_(false), queue_(entries_) {}
 
             void init()
             {
@@ -137,109 +251,101 @@ namespace timer
             void *create_timer()
             {
                 std::lock_guard<std::mutex> lock(mutex_);
-                auto entry       = std::make_shared<TimerEntry>();
-                entry->is_active = false;
-                entry->is_set    = false;
-                void *id         = reinterpret_cast<void *>(next_id_++);
-                timers_[id]      = entry;
-                return id;
+                TimerEntry entry {};
+                entry.heap_index = TimerHeap::npos;
+                entry.is_active  = false;
+                entry.is_set     = false;
+                entries_.push_back(std::move(entry));
+                return reinterpret_cast<void *>(static_cast<uintptr_t>(entries_.size()));
             }
 
             void set_timer(void *timer_id, uint64_t interval, std::function<void()> callback)
             {
                 std::lock_guard<std::mutex> lock(mutex_);
-                auto it = timers_.find(timer_id);
-                if (it == timers_.end()) {
+                TimerEntry *entry = find(timer_id);
+                if (entry == nullptr) {
                     return;
                 }
 
-                auto entry                  = it->second;
                 entry->interval             = std::chrono::milliseconds(interval);
                 entry->expiration_time      = Clock::now() + entry->interval;
                 entry->last_expiration_time = entry->expiration_time;
-                entry->callback             = callback;
+                entry->callback             = std::move(callback);
                 entry->is_active            = true;
                 entry->is_set               = true;
 
-                rebuild_queue();
-                condition_.notify_one();
+                schedule(timer_id);
             }
 
             void stop_timer(void *timer_id)
             {
                 std::lock_guard<std::mutex> lock(mutex_);
-                auto it = timers_.find(timer_id);
-                if (it != timers_.end()) {
-                    it->second->is_active = false;
-                    it->second->is_set    = false;
-                    condition_.notify_one();
+                TimerEntry *entry = find(timer_id);
+                if (entry != nullptr) {
+                    entry->is_active = false;
+                    entry->is_set    = false;
+                    queue_.remove(slot_of(timer_id));
                 }
             }
 
             void restart_timer(void *timer_id)
             {
                 std::lock_guard<std::mutex> lock(mutex_);
-                auto it = timers_.find(timer_id);
-                if (it == timers_.end() || !it->second->is_set) {
+                TimerEntry *entry = find(timer_id);
+                if (entry == nullptr || !entry->is_set) {
                     return;
                 }
 
-                auto entry             = it->second;
                 entry->expiration_time = Clock::now() + entry->interval;
                 entry->is_active       = true;
-                rebuild_queue();
-                condition_.notify_one();
+                schedule(timer_id);
             }
 
             void reset_timer(void *timer_id)
             {
                 std::lock_guard<std::mutex> lock(mutex_);
-                auto it = timers_.find(timer_id);
-                if (it == timers_.end() || !it->second->is_set) {
+                TimerEntry *entry = find(timer_id);
+                if (entry == nullptr || !entry->is_set) {
                     return;
                 }
 
-                auto entry = it->second;
-
                 entry->expiration_time = entry->expiration_time + entry->interval;
                 entry->is_active       = true;
 
                 entry->last_expiration_time = entry->expiration_time;
 
-                rebuild_queue();
-                condition_.notify_one();
+                schedule(timer_id);
             }
 
             bool expired_timer(void *timer_id)
             {
                 std::lock_guard<std::mutex> lock(mutex_);
-                auto it = timers_.find(timer_id);
-                if (it == timers_.end()) {
+                TimerEntry *entry = find(timer_id);
+                if (entry == nullptr) {
                     return true;
                 }
-                if (!it->second->is_set) {
+                if (!entry->is_set) {
                     return true;
                 }
-                if (!it->second->is_active) {
+                if (!entry->is_active) {
                     return true;
                 }
-                return (it->second->expiration_time <= Clock::now()) ? true : false;
+                return (entry->expiration_time <= Clock::now()) ? true : false;
             }
 
             bool timer_exists(void *timer_id)
             {
                 std::lock_guard<std::mutex> lock(mutex_);
-                return timers_.find(timer_id) != timers_.end();
+                return find(timer_id) != nullptr;
             }
 
             bool is_timer_running(void *timer_id)
             {
                 std::lock_guard<std::mutex> lock(mutex_);
-                auto it = timers_.find(timer_id);
-                if (it == timers_.end()) {
+                TimerEntry *entry = find(timer_id);
+                if (entry == nullptr) {
                     return false;
                 }
-                auto entry = it->second;
                 if (!entry->is_set || !entry->is_active) {
                     return false;
                 }
@@ -247,53 +353,64 @@ namespace timer
             }
 
         private:
-            void rebuild_queue()
+            static uint32_t slot_of(void *timer_id)
             {
-                std::priority_queue<std::shared_ptr<TimerEntry>, std::vector<std::shared_ptr<TimerEntry>>, TimerEntryComparator> new_queue;
-                for (auto &pair: timers_) {
-                    if (pair.second->is_active && pair.second->is_set) {
-                        new_queue.push(pair.second);
-                    }
+                return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(timer_id) - 1);
+            }
+
+            TimerEntry *find(void *timer_id)
+            {
+                uintptr_t id = reinterpret_cast<uintptr_t>(timer_id);
+                if (id == 0 || id > entries_.size()) {
+                    return nullptr;
+                }
+                return &entries_[id - 1];
+            }
+
+            /// Move the timer to its new position and wake the worker only if
+            /// the earliest deadline changed.
+            void schedule(void *timer_id)
+            {
+                uint32_t slot = slot_of(timer_id);
+                queue_.update(slot);
+                if (queue_.top() == slot) {
+                    condition_.notify_one();
                 }
-                timer_queue_ = std::move(new_queue);
             }
 
             void worker_loop()
             {
+                std::unique_lock<std::mutex> lock(mutex_);
                 while (running_) {
-                    std::unique_lock<std::mutex> lock(mutex_);
-
-                    while (!timer_queue_.empty()) {
-                        auto entry = timer_queue_.top();
-
-                        if (!entry->is_active) {
-                            timer_queue_.pop();
-                            continue;
-                        }
+                    while (!queue_.empty()) {
+                        uint32_t slot     = queue_.top();
+                        TimerEntry *entry = &entries_[slot];
 
                         if (entry->expiration_time > Clock::now()) {
                             break;
                         }
 
-                        timer_queue_.pop();
+                        queue_.remove(slot);
                         entry->last_expiration_time = entry->expiration_time;
                         entry->is_active            = false;
+                        // The callback may re-arm this timer (replacing its
+                        // callback) or create new ones (growing the pool), so
+                        // invoke a copy without holding the lock.
+                        std::function<void()> callback = entry->callback;
                         lock.unlock();
-                        if (entry->callback) {
-                            entry->callback();
+                        if (callback) {
+                            callback();
                         }
                         lock.lock();
-                        rebuild_queue();
                     }
 
-                    if (timer_queue_.empty()) {
+                    if (!running_) {
+                        break;
+                    }
+                    if (queue_.empty()) {
                         condition_.wait(lock);
                     } else {
-                        auto next_expiration = timer_queue_.top()->expiration_time;
-                        auto now             = Clock::now();
-                        if (next_expiration > now) {
-                            condition_.wait_for(lock, next_expiration - now);
-                        }
+                        condition_.wait_until(lock, entries_[queue_.top()].expiration_time);
                     }
                 }
             }
@@ -302,9 +419,8 @@ namespace timer
             std::mutex mutex_;
             std::condition_variable condition_;
             std::thread worker_thread_;
-            std::priority_queue<std::shared_ptr<TimerEntry>, std::vector<std::shared_ptr<TimerEntry>>, TimerEntryComparator> timer_queue_;
-            std::unordered_map<void *, std::shared_ptr<TimerEntry>> timers_;
-            uintptr_t next_id_;
+            std::vector<TimerEntry> entries_;
+            TimerHeap queue_;
     };
 
     void initialize_timer_manager();
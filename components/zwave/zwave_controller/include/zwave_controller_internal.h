@@ -136,6 +136,7 @@ sl_status_t zwave_controller_transport_send_data(const zwave_controller_connecti
  *
  * @param session_id The Z-Wave Tx Session ID to abort.
  * @return SL_STATUS_NOT_FOUND if no abort was performed.
+ *         SL_STATUS_BUSY if a transport could not abort its ongoing session.
  *         SL_STATUS_OK if abort is ongoing.
  */
 sl_status_t zwave_controller_transport_abort_send_data(zwave_tx_session_id_t session_id);
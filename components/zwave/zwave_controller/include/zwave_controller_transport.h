@@ -117,6 +117,8 @@ typedef struct zwave_controller_transport {
          * statuses
          *  - SL_STATUS_OK              indicates that ongoing session are aborted
          *  - SL_STATUS_NOT_FOUND       indicates that no transmission was ongoing
+         *  - SL_STATUS_BUSY            indicates that a transmission is ongoing
+         *                              but cannot be aborted right now
          */
         sl_status_t (*abort_send_data)(zwave_tx_session_id_t session_id);
 
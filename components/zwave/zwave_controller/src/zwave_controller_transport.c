@@ -131,6 +131,7 @@ sl_status_t zwave_controller_transport_send_data(const zwave_controller_connecti
 
 sl_status_t zwave_controller_transport_abort_send_data(zwave_tx_session_id_t session_id)
 {
+    sl_status_t status = SL_STATUS_NOT_FOUND;
     // The transports are arranged in an odered set according to priority,
     // to abort, we want to call them in a Reverse order (lower layers first)
     for (uint32_t i = 0; i < NUMBER_OF_TRANSPORTS; i++) {
@@ -140,9 +141,12 @@ sl_status_t zwave_controller_transport_abort_send_data(zwave_tx_session_id_t ses
             if (abort_status == SL_STATUS_OK) {
                 return SL_STATUS_OK;
             }
+            if (abort_status == SL_STATUS_BUSY) {
+                status = SL_STATUS_BUSY;
+            }
         }
     }
-    return SL_STATUS_NOT_FOUND;
+    return status;
 }
 
 bool zwave_controller_transport_is_busy(void)
@@ -122,16 +122,24 @@ namespace zwave_component
             return;
         }
 
-        pollfd pfd = {zpc_connection_fd, POLLIN, 0};
-        auto value = poll_queue.try_pop();
-
-        bool should_poll = value.has_value();
+        // Poll requests only ask for another zwapi_poll(), so take them all at once.
+        bool should_poll = false;
+        while (poll_queue.try_pop()) {
+            should_poll = true;
+        }
 
-        // If queue is empty, wait for file descriptor to be ready
-        // Use a timeout (100ms) so we can periodically check should_stop()
+        // Frames already buffered by the Z-Wave API do not make the connection
+        // readable, so handle them before sleeping.
         if (!should_poll) {
-            int poll_timeout_ms = 100;  // 100ms timeout to allow checking should_stop()
-            int poll_result     = poll(&pfd, 1, poll_timeout_ms);
+            should_poll = zwapi_has_pending_rx();
+        }
+
+        // If queue is empty, sleep until the connection is readable, a poll is
+        // requested or stop() wakes us up through the queue's eventfd.
+        if (!should_poll && poll_queue.arm()) {
+            pollfd pfds[2] = {{zpc_connection_fd, POLLIN, 0}, {poll_queue.fd(), POLLIN, 0}};
+            int poll_result = poll(pfds, 2, -1);
+            poll_queue.disarm();
 
             // Check if we should stop after poll returns (or was interrupted)
             if (should_stop() || threading::threading::is_kill_switch_activated()) {
@@ -140,26 +148,28 @@ namespace zwave_component
 
             // Handle poll errors (EINTR is expected when signals are received)
             if (poll_result < 0) {
-                if (errno == EINTR) {
-                    // Interrupted by signal, check should_stop and continue
-                    if (should_stop() || threading::threading::is_kill_switch_activated()) {
-                        return;
-                    }
-                } else {
+                if (errno != EINTR) {
                     sl_log_error(LOG_TAG, "poll() failed: %s", strerror(errno));
                 }
-                should_poll = false;
-            } else {
-                should_poll = (poll_result > 0);
+                return;
+            }
+
+            should_poll = (pfds[0].revents != 0);
+            while (poll_queue.try_pop()) {
+                should_poll = true;
             }
         }
 
-        // Process zwapi_poll if queue had a value or file descriptor is ready
+        // Process zwapi_poll if queue had a value or file descriptor is ready.
+        // A full queue already holds a pending poll request.
         if (should_poll && zwapi_poll()) {
-            poll_queue.push(0);
+            poll_queue.try_push(0);
         }
-        // sl_log_critical(LOG_TAG, "zw_rx_process: thread polling %d", zpc_connection_fd);
-        std::this_thread::yield();
+    }
+
+    void zwave_rx_process::wake()
+    {
+        poll_queue.wake();
     }
 }  // namespace zwave_component
 
@@ -207,7 +217,7 @@ sl_status_t zwave_rx_process_stop_and_cleanup(void)
 void zwave_rx_process_request_poll(void)
 {
     if (zwave_rx_process_instance != nullptr) {
-        zwave_rx_process_instance->poll_queue.push(0);
+        zwave_rx_process_instance->poll_queue.try_push(0);
     }
 }
 
@@ -16,7 +16,7 @@
 
 #include "threading.hpp"
 #include <mutex>
-#include "safe_queue.hpp"
+#include "bounded_queue.hpp"
 #include "init_builder.hpp"
 
 namespace zwave_component
@@ -32,10 +32,13 @@ namespace zwave_component
             int shutdown() override;
             std::string name() const override;
 
-            ::threading::safe_queue<int> poll_queue;
+            // Poll requests, each entry asks run() to call zwapi_poll() once more.
+            // Its eventfd is polled together with the serial connection.
+            ::threading::bounded_queue<int> poll_queue {64};
 
         private:
             void run() override;
+            void wake() override;
 
         protected:
             int zpc_connection_fd;
@@ -39,6 +39,7 @@ void s0_abort_all_tx_sessions();
  * @brief Free all S0 RX sessions
  *
  * Sets the state of all MAX_RXSESSIONS S0 receive sessions to RX_SESSION_DONE
+ * and empties the RX session hash table
  */
 void free_all_rx_session();
 /**
@@ -58,6 +59,14 @@ void free_nonce_block_list();
  */
 void reset_block_next_elem();
 
+/**
+ * @brief Free all nonces of the S0 nonce table
+ *
+ * Forgets all nonces sent and received, together with their expiry in the
+ * nonce timer wheel
+ */
+void free_nonce_table();
+
 /**
  * @brief Reset nonce timer
  */
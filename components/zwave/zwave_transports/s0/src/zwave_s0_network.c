@@ -36,6 +36,7 @@ sl_status_t zwave_s0_network_init()
     free_all_rx_session();
     free_all_tx_sessions();
     free_nonce_block_list();
+    free_nonce_table();
 
     reset_block_next_elem();
     reset_s0_timers();
@@ -45,13 +45,29 @@
 #define LOG_TAG "zwave_s0_transport"
 
 // Constants for the transport.
-#define NONCE_TABLE_SIZE       5 * 3
-#define NUM_TX_SESSIONS        2
 #define MAX_ENCRYPTED_MSG_SIZE 128
-#define MAX_NONCES             10
-#define MAX_RXSESSIONS         2
 
+// Capacity of the transport. They can be set at build time, e.g. for networks
+// with many S0 nodes talking at the same time.
+#ifndef NONCE_TABLE_SIZE
+#define NONCE_TABLE_SIZE 256
+#endif
+#ifndef NUM_TX_SESSIONS
+#define NUM_TX_SESSIONS 64
+#endif
+#ifndef MAX_RXSESSIONS
+#define MAX_RXSESSIONS 64
+#endif
+// Maximum number of nonces kept for a source and destination, so that a single
+// node cannot use up the nonce table.
+#ifndef MAX_NONCES
+#define MAX_NONCES 10
+#endif
+
+// Nonce lifetime, in ticks of the 1 second nonce timer
 #define NONCE_TIMEOUT 10
+// Slots of the nonce timer wheel, one per tick of the nonce lifetime
+#define NONCE_WHEEL_SIZE (NONCE_TIMEOUT + 1)
 
 /*
  * Nonce request timer SHOULD be started by a node sending a Nonce Get Command.
@@ -71,7 +87,8 @@
  */
 #define NONCE_REPORT_DISCARD_TIMEOUT 20000
 
-#define NONCE_BLOCK_LIST_SIZE 10
+// Last nonces received in Nonce Reports, 5 for each TX session
+#define NONCE_BLOCK_LIST_SIZE (5 * NUM_TX_SESSIONS)
 // The size of the nonce field in a Nonce Report
 #define RECEIVERS_NONCE_SIZE 8
 
@@ -96,6 +113,9 @@
 //  23 - 3
 #define S0_ENCAP_HEADER_LEN 20
 
+// The nonce and session tables are linked with entry index + 1, 0 is no entry.
+#define S0_NO_ENTRY 0
+
 #ifndef UNUSED
 #define UNUSED(x) x = x;
 #endif
@@ -165,6 +185,8 @@ typedef struct sec_tx_session {
         // Extended TX status, most notably IMA information
         const zwapi_tx_report_t *tx_ext_status;
         zwave_tx_session_id_t session_id;
+        // Next session in the hash bucket or in the free list
+        uint16_t next;
 } sec_tx_session_t;
 
 typedef struct _authdata_ {
@@ -175,6 +197,13 @@ typedef struct _authdata_ {
 } auth_data_t;
 
 static sec_tx_session_t tx_sessions[NUM_TX_SESSIONS];
+// Sessions in use, hashed by local and remote NodeID
+static uint16_t tx_session_buckets[NUM_TX_SESSIONS];
+// Sessions that are free again, reused in the order they were freed
+static uint16_t tx_session_free_head;
+static uint16_t tx_session_free_tail;
+// Sessions that were never used
+static uint16_t tx_sessions_used;
 
 /* Nonce block type*/
 typedef struct {
@@ -233,6 +262,16 @@ static void aes_cbc_mac(const uint8_t *data, uint8_t len, uint8_t *mac)
     }
 }
 
+/**
+ * Hash bucket of a source and destination NodeID, in a table with bucket_count
+ * buckets. NodeIDs are allocated in sequence, so the peers of a node are
+ * spread over consecutive buckets.
+ */
+static uint16_t s0_hash(zwave_node_id_t src, zwave_node_id_t dst, uint16_t bucket_count)
+{
+    return (uint16_t)((src * 2654435761u + dst) % bucket_count);
+}
+
 /***************** Nonce Blocked list **************************************/
 /**
  * Test if an S0 nonce with particular source and destination is blocked.
@@ -242,7 +281,7 @@ static void aes_cbc_mac(const uint8_t *data, uint8_t len, uint8_t *mac)
 static unsigned int s0_is_nonce_blocked(const uint8_t src, const uint8_t dst, const uint8_t *nonce)
 {
     for (unsigned int i = 0; i < NONCE_BLOCK_LIST_SIZE; i++) {
-        if (nonce_block[i].in_use && (0 == memcmp(nonce_block[i].nonce, nonce, 8)) && (nonce_block[i].src == src) && (nonce_block[i].dst == dst)) {
+        if (nonce_block[i].in_use && (nonce_block[i].src == src) && (nonce_block[i].dst == dst) && (0 == memcmp(nonce_block[i].nonce, nonce, 8))) {
             return 1;
         }
     }
@@ -267,47 +306,158 @@ static void s0_block_nonce(const uint8_t src, const uint8_t dst, const uint8_t *
 typedef struct nonce {
         zwave_node_id_t src;
         zwave_node_id_t dst;
-        uint8_t timeout;
         uint8_t reply_nonce;  // indicate if this nonce from a enc message sent by me
         uint8_t nonce[RECEIVERS_NONCE_SIZE];
+        // Next nonce in the hash bucket or in the free list
+        uint16_t next;
+        // Neighbours in the timer wheel slot where the nonce expires
+        uint16_t wheel_prev;
+        uint16_t wheel_next;
+        uint8_t wheel_slot;
 } nonce_t;
 
 static nonce_t nonce_table[NONCE_TABLE_SIZE];  // Nonces received or sent
+// Nonces hashed by source and destination, the most recent first
+static uint16_t nonce_buckets[NONCE_TABLE_SIZE];
+// Nonces expiring at each tick of the nonce timer
+static uint16_t nonce_wheel[NONCE_WHEEL_SIZE];
+static uint8_t nonce_wheel_position;
+static uint16_t nonce_free_list;
+static uint16_t nonce_table_used;  // Entries that were never used
+static uint16_t nonce_count;
 struct timer_handle_t nonce_timer = {NULL};
 
+static nonce_t *nonce_entry(uint16_t ref)
+{
+    return &nonce_table[ref - 1];
+}
+
+static void nonce_wheel_insert(uint16_t ref)
+{
+    nonce_t *n    = nonce_entry(ref);
+    n->wheel_slot = (nonce_wheel_position + NONCE_TIMEOUT) % NONCE_WHEEL_SIZE;
+    n->wheel_prev = S0_NO_ENTRY;
+    n->wheel_next = nonce_wheel[n->wheel_slot];
+    if (n->wheel_next != S0_NO_ENTRY) {
+        nonce_entry(n->wheel_next)->wheel_prev = ref;
+    }
+    nonce_wheel[n->wheel_slot] = ref;
+}
+
+static void nonce_wheel_remove(uint16_t ref)
+{
+    const nonce_t *n = nonce_entry(ref);
+    if (n->wheel_prev != S0_NO_ENTRY) {
+        nonce_entry(n->wheel_prev)->wheel_next = n->wheel_next;
+    } else {
+        nonce_wheel[n->wheel_slot] = n->wheel_next;
+    }
+    if (n->wheel_next != S0_NO_ENTRY) {
+        nonce_entry(n->wheel_next)->wheel_prev = n->wheel_prev;
+    }
+}
+
 /**
- * Register a new nonce from sent from src to dst
+ * Remove a nonce from the table. link is the reference to it in its hash bucket.
  */
-static uint8_t register_nonce(uint8_t src, uint8_t dst, uint8_t reply_nonce, const uint8_t nonce[8])
+static void nonce_remove(uint16_t *link)
 {
-    if (reply_nonce) {
-        /*Only one reply nonce is allowed*/
-        for (uint8_t i = 0; i < NONCE_TABLE_SIZE; i++) {
-            if (nonce_table[i].reply_nonce && nonce_table[i].timeout > 0 && nonce_table[i].src == src && nonce_table[i].dst == dst) {
-                sl_log_debug(LOG_TAG, "Reply nonce overwritten %d->%d slot:%d\n", src, dst, i);
-                memcpy(nonce_table[i].nonce, nonce, 8);
-                nonce_table[i].timeout = NONCE_TIMEOUT;
-                restart_s0_timer();
-                return 1;
+    uint16_t ref = *link;
+    nonce_t *n   = nonce_entry(ref);
+    *link        = n->next;
+    nonce_wheel_remove(ref);
+    n->next         = nonce_free_list;
+    nonce_free_list = ref;
+    nonce_count--;
+}
+
+/**
+ * Find the reference to a nonce in its hash bucket.
+ */
+static uint16_t *nonce_link(uint16_t ref)
+{
+    const nonce_t *n = nonce_entry(ref);
+    uint16_t *link   = &nonce_buckets[s0_hash(n->src, n->dst, NONCE_TABLE_SIZE)];
+    while (*link != ref) {
+        link = &nonce_entry(*link)->next;
+    }
+    return link;
+}
+
+/**
+ * Get an unused nonce entry. If the table is full, the nonce closest to
+ * expiring is dropped.
+ */
+static uint16_t nonce_allocate()
+{
+    uint16_t ref = S0_NO_ENTRY;
+    if (nonce_free_list != S0_NO_ENTRY) {
+        ref             = nonce_free_list;
+        nonce_free_list = nonce_entry(ref)->next;
+    } else if (nonce_table_used < NONCE_TABLE_SIZE) {
+        ref = ++nonce_table_used;
+    } else {
+        for (uint8_t i = 1; i <= NONCE_WHEEL_SIZE; i++) {
+            uint16_t oldest = nonce_wheel[(nonce_wheel_position + i) % NONCE_WHEEL_SIZE];
+            if (oldest != S0_NO_ENTRY) {
+                sl_log_warning(LOG_TAG, "Nonce table is full, dropping nonce %d->%d\n", nonce_entry(oldest)->src, nonce_entry(oldest)->dst);
+                nonce_remove(nonce_link(oldest));
+                return nonce_allocate();
             }
         }
     }
+    return ref;
+}
 
-    for (uint8_t i = 0; i < NONCE_TABLE_SIZE; i++) {
-        if (nonce_table[i].timeout == 0) {
-            nonce_table[i].src         = src;
-            nonce_table[i].dst         = dst;
-            nonce_table[i].reply_nonce = reply_nonce;
-            memcpy(nonce_table[i].nonce, nonce, 8);
-            nonce_table[i].timeout = NONCE_TIMEOUT;
+/**
+ * Register a new nonce from sent from src to dst
+ */
+static uint8_t register_nonce(uint8_t src, uint8_t dst, uint8_t reply_nonce, const uint8_t nonce[8])
+{
+    uint16_t *bucket        = &nonce_buckets[s0_hash(src, dst, NONCE_TABLE_SIZE)];
+    uint16_t *oldest_link   = NULL;
+    uint8_t nonces_for_pair = 0;
+
+    for (uint16_t *link = bucket; *link != S0_NO_ENTRY; link = &nonce_entry(*link)->next) {
+        nonce_t *n = nonce_entry(*link);
+        if ((n->src != src) || (n->dst != dst)) {
+            continue;
+        }
+        /*Only one reply nonce is allowed*/
+        if (reply_nonce && n->reply_nonce) {
+            sl_log_debug(LOG_TAG, "Reply nonce overwritten %d->%d\n", src, dst);
+            memcpy(n->nonce, nonce, 8);
+            nonce_wheel_remove(*link);
+            nonce_wheel_insert(*link);
             restart_s0_timer();
-            sl_log_debug(LOG_TAG, "Nonce registered %d->%d slot:%d\n", src, dst, i);
             return 1;
         }
+        nonces_for_pair++;
+        oldest_link = link;
     }
 
-    sl_log_error(LOG_TAG, "Nonce table is full\n");
-    return 0;
+    if (nonces_for_pair >= MAX_NONCES) {
+        sl_log_debug(LOG_TAG, "Too many nonces %d->%d, dropping the oldest one\n", src, dst);
+        nonce_remove(oldest_link);
+    }
+
+    uint16_t ref = nonce_allocate();
+    if (ref == S0_NO_ENTRY) {
+        sl_log_error(LOG_TAG, "Nonce table is full\n");
+        return 0;
+    }
+    nonce_t *n     = nonce_entry(ref);
+    n->src         = src;
+    n->dst         = dst;
+    n->reply_nonce = reply_nonce;
+    memcpy(n->nonce, nonce, 8);
+    n->next = *bucket;
+    *bucket = ref;
+    nonce_wheel_insert(ref);
+    nonce_count++;
+    restart_s0_timer();
+    sl_log_debug(LOG_TAG, "Nonce registered %d->%d\n", src, dst);
+    return 1;
 }
 
 /**
@@ -315,13 +465,15 @@ static uint8_t register_nonce(uint8_t src, uint8_t dst, uint8_t reply_nonce, con
  * is found, then remove all entries from that src->dst combination
  * from the table.
  *
- * If any_nonce is set then ri is ignored
+ * If any_nonce is set then ri is ignored, and the most recent nonce is returned.
  */
 static uint8_t get_s0_nonce(uint8_t src, uint8_t dst, uint8_t ri, uint8_t nonce[RECEIVERS_NONCE_SIZE], uint8_t any_nonce)
 {
-    for (uint8_t i = 0; i < NONCE_TABLE_SIZE; i++) {
-        if ((nonce_table[i].timeout > 0) && (nonce_table[i].src == src) && (nonce_table[i].dst == dst) && (any_nonce || (nonce_table[i].nonce[0] == ri))) {
-            memcpy(nonce, nonce_table[i].nonce, RECEIVERS_NONCE_SIZE);
+    uint16_t ref = nonce_buckets[s0_hash(src, dst, NONCE_TABLE_SIZE)];
+    for (; ref != S0_NO_ENTRY; ref = nonce_entry(ref)->next) {
+        const nonce_t *n = nonce_entry(ref);
+        if ((n->src == src) && (n->dst == dst) && (any_nonce || (n->nonce[0] == ri))) {
+            memcpy(nonce, n->nonce, RECEIVERS_NONCE_SIZE);
             return 1;
         }
     }
@@ -336,10 +488,14 @@ static uint8_t get_s0_nonce(uint8_t src, uint8_t dst, uint8_t ri, uint8_t nonce[
 static void nonce_clear(uint8_t src, uint8_t dst)
 {
     /*Remove entries from table from that source dest combination */
-    for (uint8_t i = 0; i < NONCE_TABLE_SIZE; i++) {
-        if ((nonce_table[i].timeout) && (nonce_table[i].src == src) && (nonce_table[i].dst == dst)) {
-            nonce_table[i].timeout = 0;
-            sl_log_debug(LOG_TAG, "%d -> %d nonce cleared slot: %d\n", nonce_table[i].src, nonce_table[i].dst, i);
+    uint16_t *link = &nonce_buckets[s0_hash(src, dst, NONCE_TABLE_SIZE)];
+    while (*link != S0_NO_ENTRY) {
+        const nonce_t *n = nonce_entry(*link);
+        if ((n->src == src) && (n->dst == dst)) {
+            sl_log_debug(LOG_TAG, "%d -> %d nonce cleared\n", src, dst);
+            nonce_remove(link);
+        } else {
+            link = &nonce_entry(*link)->next;
         }
     }
 }
@@ -347,18 +503,15 @@ static void nonce_clear(uint8_t src, uint8_t dst)
 static void nonce_timer_timeout(void *data)
 {
     (void)data;
-    bool restartTimer = false;
-    for (uint8_t i = 0; i < NONCE_TABLE_SIZE; i++) {
-        if (nonce_table[i].timeout > 0) {
-            nonce_table[i].timeout--;
-            if (nonce_table[i].timeout == 0) {
-                sl_log_debug(LOG_TAG, "%d -> %d nonce timed out slot: %d\n", nonce_table[i].src, nonce_table[i].dst, i);
-            } else {
-                restartTimer = true;
-            }
-        }
+    // Nonces in the next slot were registered NONCE_TIMEOUT ticks ago
+    nonce_wheel_position = (nonce_wheel_position + 1) % NONCE_WHEEL_SIZE;
+    while (nonce_wheel[nonce_wheel_position] != S0_NO_ENTRY) {
+        uint16_t ref     = nonce_wheel[nonce_wheel_position];
+        const nonce_t *n = nonce_entry(ref);
+        sl_log_debug(LOG_TAG, "%d -> %d nonce timed out\n", n->src, n->dst);
+        nonce_remove(nonce_link(ref));
     }
-    if (restartTimer) {
+    if (nonce_count > 0) {
         timer_set(&nonce_timer, 1000, nonce_timer_timeout, 0);
     }
 }
@@ -387,6 +540,8 @@ void s0_set_key(const uint8_t *network_key)
     } else {
         sl_log_debug(LOG_TAG, "Setting S0 key to the network key.\n");
     }
+    // The previous S0 keys must not stay in the AES key cache.
+    AES128_key_cache_clear();
 
     memcpy(aes_key, network_key, 16);
     memset(p, 0x55, 16);
@@ -409,19 +564,75 @@ static void s0_timeout(void *user)
     tx_session_state_set(s, TX_DONE);
 }
 
+static sec_tx_session_t *tx_session_entry(uint16_t ref)
+{
+    return &tx_sessions[ref - 1];
+}
+
 /**
  * Lookup a tx session by nodeid
  */
 static sec_tx_session_t *get_tx_session_by_node(uint8_t snode, uint8_t dnode)
 {
-    for (uint8_t i = 0; i < NUM_TX_SESSIONS; i++) {
-        if (tx_sessions[i].conn_info.remote.node_id == dnode && tx_sessions[i].conn_info.local.node_id == snode) {
-            return &tx_sessions[i];
+    uint16_t ref = tx_session_buckets[s0_hash(snode, dnode, NUM_TX_SESSIONS)];
+    for (; ref != S0_NO_ENTRY; ref = tx_session_entry(ref)->next) {
+        sec_tx_session_t *s = tx_session_entry(ref);
+        if (s->conn_info.remote.node_id == dnode && s->conn_info.local.node_id == snode) {
+            return s;
         }
     }
     return 0;
 }
 
+/**
+ * Get a free tx session for a source and destination. Sessions are reused in
+ * the order they were freed, so that late callbacks of a session are unlikely
+ * to reach a new one.
+ */
+static sec_tx_session_t *new_tx_session(zwave_node_id_t snode, zwave_node_id_t dnode)
+{
+    uint16_t ref = S0_NO_ENTRY;
+    if (tx_session_free_head != S0_NO_ENTRY) {
+        ref                  = tx_session_free_head;
+        tx_session_free_head = tx_session_entry(ref)->next;
+        if (tx_session_free_head == S0_NO_ENTRY) {
+            tx_session_free_tail = S0_NO_ENTRY;
+        }
+    } else if (tx_sessions_used < NUM_TX_SESSIONS) {
+        ref = ++tx_sessions_used;
+    } else {
+        return 0;
+    }
+    uint16_t *bucket            = &tx_session_buckets[s0_hash(snode, dnode, NUM_TX_SESSIONS)];
+    sec_tx_session_t *s         = tx_session_entry(ref);
+    s->conn_info.local.node_id  = snode;
+    s->conn_info.remote.node_id = dnode;
+    s->next                     = *bucket;
+    *bucket                     = ref;
+    return s;
+}
+
+static void free_tx_session(sec_tx_session_t *s)
+{
+    uint16_t ref   = (uint16_t)(s - tx_sessions) + 1;
+    uint16_t *link = &tx_session_buckets[s0_hash(s->conn_info.local.node_id, s->conn_info.remote.node_id, NUM_TX_SESSIONS)];
+    while ((*link != S0_NO_ENTRY) && (*link != ref)) {
+        link = &tx_session_entry(*link)->next;
+    }
+    if (*link == S0_NO_ENTRY) {
+        // Not in use
+        return;
+    }
+    *link   = s->next;
+    s->next = S0_NO_ENTRY;
+    if (tx_session_free_tail != S0_NO_ENTRY) {
+        tx_session_entry(tx_session_free_tail)->next = ref;
+    } else {
+        tx_session_free_head = ref;
+    }
+    tx_session_free_tail = ref;
+}
+
 /**
  * Get the maximum MAC-layer payload that can be delivered to a node.
  *
@@ -462,9 +673,11 @@ static uint8_t s0_encrypt_message(sec_tx_session_t *s, uint8_t pass2)
     assert((len + S0_ENCAP_HEADER_LEN) <= sizeof(s->crypted_msg));
     /* Make the IV */
 
+    /* The IV is registered as a reply nonce (local->remote) below, so it must
+     * not share its nonce identifier with the nonces we sent to the remote */
     do {
         AES_CTR_DRBG_Generate(&s2_ctr_drbg, iv);
-    } while (get_s0_nonce(s->conn_info.remote.node_id, s->conn_info.local.node_id, iv[0], tmp, false));
+    } while (get_s0_nonce(s->conn_info.local.node_id, s->conn_info.remote.node_id, iv[0], tmp, false));
 
     /*Choose a nonce from sender */
     /* Find the nonce (remote->local) which the remote node must have sent and use it in encryption for sending from (local->remote) */
@@ -565,6 +778,7 @@ static uint8_t s0_encrypt_message(sec_tx_session_t *s, uint8_t pass2)
  */
 static void reset_tx_session_data(sec_tx_session_t *s)
 {
+    free_tx_session(s);
     memset(&s->conn_info, 0, sizeof(zwave_controller_connection_info_t));
     s->data_len      = 0;
     s->callback      = NULL;
@@ -766,20 +980,14 @@ sl_status_t zwave_s0_send_data(const zwave_controller_connection_info_t *conn_in
         return SL_STATUS_BUSY;
     }
 
-    for (uint8_t i = 0; i < NUM_TX_SESSIONS; i++) {
-        if (tx_sessions[i].conn_info.remote.node_id == 0) {
-            s                         = &tx_sessions[i];
-            tx_sessions[i].session_id = parent_session_id;
-            break;
-        }
-    }
-
+    s = new_tx_session(conn_info->local.node_id, conn_info->remote.node_id);
     if (!s) {
         sl_log_error(LOG_TAG, "No more s0 TX sessions available\n");
         return SL_STATUS_BUSY;
     }
 
-    s->conn_info = *conn_info;
+    s->conn_info  = *conn_info;
+    s->session_id = parent_session_id;
     memcpy(s->buf, cmd_data, data_length);
     s->data     = &s->buf[0];
     s->data_len = data_length;
@@ -831,6 +1039,8 @@ typedef struct {
         uint8_t msg[MAX_ENCRYPTED_MSG_SIZE];
         uint8_t msg_len;
         clock_time_t timeout;
+        // Next session in the hash bucket or in the free list
+        uint16_t next;
 } rx_session_t;
 
 uint8_t is_free(const rx_session_t *e)
@@ -839,32 +1049,75 @@ uint8_t is_free(const rx_session_t *e)
 }
 
 rx_session_t rxsessions[MAX_RXSESSIONS];
+// Sessions in use, hashed by source and destination NodeID
+static uint16_t rx_session_buckets[MAX_RXSESSIONS];
+static uint16_t rx_session_free_list;
+// Sessions that were never used
+static uint16_t rx_sessions_used;
+
+static rx_session_t *rx_session_entry(uint16_t ref)
+{
+    return &rxsessions[ref - 1];
+}
+
+static void free_rx_session(rx_session_t *s)
+{
+    uint16_t ref   = (uint16_t)(s - rxsessions) + 1;
+    uint16_t *link = &rx_session_buckets[s0_hash(s->snode, s->dnode, MAX_RXSESSIONS)];
+    s->state       = RX_SESSION_DONE;
+    while ((*link != S0_NO_ENTRY) && (*link != ref)) {
+        link = &rx_session_entry(*link)->next;
+    }
+    if (*link == S0_NO_ENTRY) {
+        // Not in use
+        return;
+    }
+    *link                = s->next;
+    s->next              = rx_session_free_list;
+    rx_session_free_list = ref;
+}
 
 /**
  * Get a new free RX session.
  */
 rx_session_t *new_rx_session(uint8_t snode, uint8_t dnode)
 {
-    for (uint8_t i = 0; i < MAX_RXSESSIONS; i++) {
-        if (is_free(&rxsessions[i])) {
-            rxsessions[i].snode   = snode;
-            rxsessions[i].dnode   = dnode;
-            rxsessions[i].timeout = clock_time() + (CLOCK_SECOND * 10);  // Timeout in 10s
-
-            return &rxsessions[i];
+    uint16_t ref = S0_NO_ENTRY;
+    if (rx_session_free_list == S0_NO_ENTRY) {
+        if (rx_sessions_used < MAX_RXSESSIONS) {
+            ref = ++rx_sessions_used;
+        } else {
+            // Sessions expire without being freed, reclaim one of them
+            for (uint16_t i = 0; i < MAX_RXSESSIONS; i++) {
+                if (is_free(&rxsessions[i])) {
+                    free_rx_session(&rxsessions[i]);
+                    break;
+                }
+            }
         }
     }
-    return 0;
-}
+    if (ref == S0_NO_ENTRY) {
+        if (rx_session_free_list == S0_NO_ENTRY) {
+            return 0;
+        }
+        ref                  = rx_session_free_list;
+        rx_session_free_list = rx_session_entry(ref)->next;
+    }
 
-static void free_rx_session(rx_session_t *s)
-{
-    s->state = RX_SESSION_DONE;
+    uint16_t *bucket = &rx_session_buckets[s0_hash(snode, dnode, MAX_RXSESSIONS)];
+    rx_session_t *s  = rx_session_entry(ref);
+    s->snode         = snode;
+    s->dnode         = dnode;
+    s->state         = RX_INIT;
+    s->timeout       = clock_time() + (CLOCK_SECOND * 10);  // Timeout in 10s
+    s->next          = *bucket;
+    *bucket          = ref;
+    return s;
 }
 
 void s0_abort_all_tx_sessions()
 {
-    for (uint8_t i = 0; i < NUM_TX_SESSIONS; i++) {
+    for (uint16_t i = 0; i < NUM_TX_SESSIONS; i++) {
         if (tx_sessions[i].conn_info.remote.node_id) {
             tx_sessions[i].tx_code = TRANSMIT_COMPLETE_FAIL;
             tx_session_state_set(&tx_sessions[i], TX_DONE);
@@ -874,9 +1127,13 @@ void s0_abort_all_tx_sessions()
 
 void free_all_rx_session()
 {
-    for (uint8_t i = 0; i < MAX_RXSESSIONS; i++) {
-        free_rx_session(&rxsessions[i]);
+    memset(rxsessions, 0, sizeof(rxsessions));
+    for (uint16_t i = 0; i < MAX_RXSESSIONS; i++) {
+        rxsessions[i].state = RX_SESSION_DONE;
     }
+    memset(rx_session_buckets, 0, sizeof(rx_session_buckets));
+    rx_session_free_list = S0_NO_ENTRY;
+    rx_sessions_used     = 0;
 }
 
 /**
@@ -884,10 +1141,14 @@ void free_all_rx_session()
  */
 rx_session_t *get_rx_session_by_nodes(uint8_t snode, uint8_t dnode)
 {
-    rx_session_t *e;
-    for (uint8_t i = 0; i < MAX_RXSESSIONS; i++) {
-        e = &rxsessions[i];
-        if (!is_free(e) && e->dnode == dnode && e->snode == snode) {
+    uint16_t ref = rx_session_buckets[s0_hash(snode, dnode, MAX_RXSESSIONS)];
+    for (; ref != S0_NO_ENTRY; ref = rx_session_entry(ref)->next) {
+        rx_session_t *e = rx_session_entry(ref);
+        if (e->dnode == dnode && e->snode == snode) {
+            if (is_free(e)) {
+                free_rx_session(e);
+                return 0;
+            }
             return e;
         }
     }
@@ -981,22 +1242,13 @@ static uint8_t s0_decrypt_message(const zwave_controller_connection_info_t *conn
        * and its copied in local structure */
     nonce_clear(connection_info->local.node_id, connection_info->remote.node_id);
 
-    /*TODO don't create sessions for single fragment frames*/
+    // Sessions are only created for sequenced messages, when receiving their first frame
     s = get_rx_session_by_nodes(connection_info->remote.node_id, connection_info->local.node_id);
-    if (!s) {
-        s = new_rx_session(connection_info->remote.node_id, connection_info->local.node_id);
-        if (s) {
-            s->state = RX_INIT;
-        } else {
-            sl_log_warning(LOG_TAG, "No more RX sessions available\n");
-            return 0;
-        }
-    }
 
     // When we get a session that's in progress, verify the size of the data we have and the data we're about
     // to add do not go over our total output buffer size. If it does, drop the frame and the session pool will free up the
     // invalid session in a little bit.
-    if (s->state != RX_INIT && (s->msg_len + frame_length - S0_ENCAP_HEADER_LEN) > decrypted_frame_len) {
+    if (s && s->state != RX_INIT && (s->msg_len + frame_length - S0_ENCAP_HEADER_LEN) > decrypted_frame_len) {
         sl_log_error(LOG_TAG, "Combined data for encrypted message is too long\n");
         return 0;
     }
@@ -1028,12 +1280,23 @@ static uint8_t s0_decrypt_message(const zwave_controller_connection_info_t *conn
     if (flags & SECURITY_MESSAGE_ENCAPSULATION_PROPERTIES1_SEQUENCED_BIT_MASK) {
         if ((flags & SECURITY_MESSAGE_ENCAPSULATION_PROPERTIES1_SECOND_FRAME_BIT_MASK) == 0) {
             // First frame
+            if (!s) {
+                s = new_rx_session(connection_info->remote.node_id, connection_info->local.node_id);
+            }
+            if (!s) {
+                sl_log_warning(LOG_TAG, "No more RX sessions available\n");
+                return 0;
+            }
             s->seq_nr  = flags & 0xF;
             s->msg_len = frame_length - S0_ENCAP_HEADER_LEN;
             s->state   = RX_ENC1;
             memcpy(s->msg, enc_payload + 1, s->msg_len);
             return 0;
         }  // Second frame
+        if (!s) {
+            sl_log_error(LOG_TAG, "Received the second frame of a sequence from NodeID %d without the first one\n", connection_info->remote.node_id);
+            goto state_error;
+        }
         if ((s->state != RX_ENC1) || (flags & 0xF) != s->seq_nr) {
             sl_log_error(LOG_TAG, "State is %d, received sequence number is %u while we expected %u\n", (int)s->state, flags & 0xF, s->seq_nr);
             goto state_error;
@@ -1048,7 +1311,9 @@ static uint8_t s0_decrypt_message(const zwave_controller_connection_info_t *conn
 
     } /* Single frame message */
     memcpy(decrypted_frame, enc_payload + 1, frame_length - S0_ENCAP_HEADER_LEN);
-    free_rx_session(s);
+    if (s) {
+        free_rx_session(s);
+    }
     return (frame_length - S0_ENCAP_HEADER_LEN);
 
 state_error:
@@ -1161,15 +1426,19 @@ sl_status_t zwave_s0_on_frame_received(const zwave_controller_connection_info_t
 
 void free_all_tx_sessions()
 {
-    for (uint8_t i = 0; i < NUM_TX_SESSIONS; i++) {
+    for (uint16_t i = 0; i < NUM_TX_SESSIONS; i++) {
         timer_stop(&tx_sessions[i].timer);
         memset(&tx_sessions[i], 0, sizeof(sec_tx_session_t));
     }
+    memset(tx_session_buckets, 0, sizeof(tx_session_buckets));
+    tx_session_free_head = S0_NO_ENTRY;
+    tx_session_free_tail = S0_NO_ENTRY;
+    tx_sessions_used     = 0;
 }
 
 void free_nonce_block_list()
 {
-    for (uint8_t i = 0; i < NONCE_BLOCK_LIST_SIZE; i++) {
+    for (uint16_t i = 0; i < NONCE_BLOCK_LIST_SIZE; i++) {
         memset(&nonce_block[i], 0, sizeof(nonce_block_t));
     }
 }
@@ -1178,6 +1447,17 @@ void reset_block_next_elem()
     block_next_elem = 0;
 }
 
+void free_nonce_table()
+{
+    memset(nonce_table, 0, sizeof(nonce_table));
+    memset(nonce_buckets, 0, sizeof(nonce_buckets));
+    memset(nonce_wheel, 0, sizeof(nonce_wheel));
+    nonce_wheel_position = 0;
+    nonce_free_list      = S0_NO_ENTRY;
+    nonce_table_used     = 0;
+    nonce_count          = 0;
+}
+
 void reset_s0_timers()
 {
     timer_stop(&nonce_timer);
@@ -1187,8 +1467,8 @@ void reset_s0_timers()
 sl_status_t zwave_s0_on_abort_send_data(zwave_tx_session_id_t session_id)
 {
     sl_log_debug(LOG_TAG, "Aborting S0 send session for frame id=%p", session_id);
-    for (uint8_t i = 0; i < NUM_TX_SESSIONS; i++) {
-        if (tx_sessions[i].session_id == session_id) {
+    for (uint16_t i = 0; i < NUM_TX_SESSIONS; i++) {
+        if ((tx_sessions[i].conn_info.remote.node_id != 0) && (tx_sessions[i].session_id == session_id)) {
             callback(TRANSMIT_COMPLETE_FAIL, tx_sessions[i].tx_ext_status, &tx_sessions[i]);
             return SL_STATUS_OK;
         }
@@ -35,6 +35,7 @@ NOTE:   String length must be evenly divisible by 16byte (str_len % 16 == 0)
 /*****************************************************************************/
 /* Includes:                                                                 */
 /*****************************************************************************/
+#include <stdbool.h>
 #include <stdint.h>
 #include <string.h>  // CBC mode, for memset
 #include "aes.h"
@@ -51,6 +52,35 @@ NOTE:   String length must be evenly divisible by 16byte (str_len % 16 == 0)
 // The number of rounds in AES Cipher.
 #define Nr 10
 
+// Number of expanded keys kept in the cache. S2 uses a handful of keys at a
+// time (one per security class, plus MPAN and S0 keys).
+#ifndef AES_KEY_CACHE_SIZE
+#define AES_KEY_CACHE_SIZE 8
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define AES_THREAD_LOCAL __thread
+// The key cache is shared between threads, so that it can be wiped from any
+// of them. The lock is only held for the duration of one block.
+#define AES_KEY_CACHE_LOCK()                                           \
+    while (__atomic_test_and_set(&key_cache_lock, __ATOMIC_ACQUIRE)) { \
+    }
+#define AES_KEY_CACHE_UNLOCK() __atomic_clear(&key_cache_lock, __ATOMIC_RELEASE)
+#else
+#define AES_THREAD_LOCAL
+#define AES_KEY_CACHE_LOCK()
+#define AES_KEY_CACHE_UNLOCK()
+#endif
+
+// Use AES-NI when the CPU has it. The check is done at runtime, so the
+// binary still runs on CPUs without it.
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__)) && !defined(AES_NO_HW)
+#define AES_USE_AESNI 1
+#include <wmmintrin.h>
+#else
+#define AES_USE_AESNI 0
+#endif
+
 // jcallan@github points out that declaring Multiply as a function
 // reduces code size considerably with the Keil ARM compiler.
 // See this link for more information: https://github.com/kokke/tiny-AES128-C/pull/3
@@ -63,17 +93,33 @@ NOTE:   String length must be evenly divisible by 16byte (str_len % 16 == 0)
 /*****************************************************************************/
 // state - array holding the intermediate results during decryption.
 typedef uint8_t state_t[4][4];
-static state_t *state;
 
-// The array that stores the round keys.
-static uint8_t RoundKey[176];
-
-// The Key input to the AES Program
-static const uint8_t *Key;
+// Expanded AES-128 key
+typedef struct {
+        uint8_t round_key[176];
+} AES128_key_schedule_t;
+
+// Expanded keys of the most recently used keys, so that encrypting several
+// blocks with the same key does not run KeyExpansion() every time.
+// Protected by key_cache_lock, wiped by AES128_key_cache_clear().
+typedef struct {
+        uint8_t key[KEYLEN];
+        AES128_key_schedule_t schedule;
+} aes_key_cache_entry_t;
+
+static aes_key_cache_entry_t key_cache[AES_KEY_CACHE_SIZE];
+static uint8_t key_cache_used;  // Number of valid entries
+static uint8_t key_cache_next;  // Next entry to replace
+static uint8_t key_cache_last;  // Last entry that was hit
+#if defined(__GNUC__) || defined(__clang__)
+static bool key_cache_lock;
+#endif
 
 #if defined(CBC) && CBC
-// Initial Vector used only for CBC mode
-static uint8_t *Iv;
+// Key schedule and Initial Vector used only for CBC mode, so that
+// consecutive calls can continue a chain.
+static AES_THREAD_LOCAL AES128_key_schedule_t cbc_schedule;
+static AES_THREAD_LOCAL const uint8_t *Iv;
 #endif
 
 // The lookup-tables are marked const so they can be placed in read-only storage instead of RAM
@@ -119,7 +165,7 @@ static uint8_t getSBoxInvert(uint8_t num)
 }
 
 // This function produces Nb(Nr+1) round keys. The round keys are used in each round to decrypt the states.
-static void KeyExpansion(void)
+static void KeyExpansion(uint8_t *RoundKey, const uint8_t *Key)
 {
     uint32_t i;
     uint32_t j;
@@ -185,7 +231,7 @@ static void KeyExpansion(void)
 
 // This function adds the round key to state.
 // The round key is added to the state by an XOR function.
-static void AddRoundKey(uint8_t round)
+static void AddRoundKey(state_t *state, const uint8_t *RoundKey, uint8_t round)
 {
     uint8_t i;
     uint8_t j;
@@ -198,7 +244,7 @@ static void AddRoundKey(uint8_t round)
 
 // The SubBytes Function Substitutes the values in the
 // state matrix with values in an S-box.
-static void SubBytes(void)
+static void SubBytes(state_t *state)
 {
     uint8_t i;
     uint8_t j;
@@ -212,7 +258,7 @@ static void SubBytes(void)
 // The ShiftRows() function shifts the rows in the state to the left.
 // Each row is shifted with different offset.
 // Offset = Row number. So the first row is not shifted.
-static void ShiftRows(void)
+static void ShiftRows(state_t *state)
 {
     uint8_t temp;
 
@@ -246,7 +292,7 @@ static uint8_t xtime(uint8_t x)
 }
 
 // MixColumns function mixes the columns of the state matrix
-static void MixColumns(void)
+static void MixColumns(state_t *state)
 {
     uint8_t i;
     uint8_t Tmp;
@@ -284,7 +330,7 @@ static uint8_t Multiply(uint8_t x, uint8_t y)
 // MixColumns function mixes the columns of the state matrix.
 // The method used to multiply may be difficult to understand for the inexperienced.
 // Please use the references to gain more information.
-static void InvMixColumns(void)
+static void InvMixColumns(state_t *state)
 {
     int i;
     uint8_t a;
@@ -306,7 +352,7 @@ static void InvMixColumns(void)
 
 // The SubBytes Function Substitutes the values in the
 // state matrix with values in an S-box.
-static void InvSubBytes(void)
+static void InvSubBytes(state_t *state)
 {
     uint8_t i;
     uint8_t j;
@@ -317,7 +363,7 @@ static void InvSubBytes(void)
     }
 }
 
-static void InvShiftRows(void)
+static void InvShiftRows(state_t *state)
 {
     uint8_t temp;
 
@@ -346,52 +392,84 @@ static void InvShiftRows(void)
 }
 
 // Cipher is the main function that encrypts the PlainText.
-static void Cipher(void)
+static void Cipher(state_t *state, const uint8_t *RoundKey)
 {
     uint8_t round = 0;
 
     // Add the First round key to the state before starting the rounds.
-    AddRoundKey(0);
+    AddRoundKey(state, RoundKey, 0);
 
     // There will be Nr rounds.
     // The first Nr-1 rounds are identical.
     // These Nr-1 rounds are executed in the loop below.
     for (round = 1; round < Nr; ++round) {
-        SubBytes();
-        ShiftRows();
-        MixColumns();
-        AddRoundKey(round);
+        SubBytes(state);
+        ShiftRows(state);
+        MixColumns(state);
+        AddRoundKey(state, RoundKey, round);
     }
 
     // The last round is given below.
     // The MixColumns function is not here in the last round.
-    SubBytes();
-    ShiftRows();
-    AddRoundKey(Nr);
+    SubBytes(state);
+    ShiftRows(state);
+    AddRoundKey(state, RoundKey, Nr);
 }
 
-static void InvCipher(void)
+static void InvCipher(state_t *state, const uint8_t *RoundKey)
 {
     uint8_t round = 0;
 
     // Add the First round key to the state before starting the rounds.
-    AddRoundKey(Nr);
+    AddRoundKey(state, RoundKey, Nr);
 
     // There will be Nr rounds.
     // The first Nr-1 rounds are identical.
     // These Nr-1 rounds are executed in the loop below.
     for (round = Nr - 1; round > 0; round--) {
-        InvShiftRows();
-        InvSubBytes();
-        AddRoundKey(round);
-        InvMixColumns();
+        InvShiftRows(state);
+        InvSubBytes(state);
+        AddRoundKey(state, RoundKey, round);
+        InvMixColumns(state);
     }
 
     // The last round is given below.
     // The MixColumns function is not here in the last round.
-    InvShiftRows();
-    InvSubBytes();
-    AddRoundKey(0);
+    InvShiftRows(state);
+    InvSubBytes(state);
+    AddRoundKey(state, RoundKey, 0);
+}
+
+#if AES_USE_AESNI
+// AES-NI uses the same round key layout as KeyExpansion(), so the expanded
+// keys are shared between both implementations.
+__attribute__((target("aes,sse2"))) static void CipherAesNi(uint8_t *block, const uint8_t *RoundKey)
+{
+    __m128i m = _mm_loadu_si128((const __m128i *)block);
+    m         = _mm_xor_si128(m, _mm_loadu_si128((const __m128i *)RoundKey));
+    for (uint8_t round = 1; round < Nr; ++round) {
+        m = _mm_aesenc_si128(m, _mm_loadu_si128((const __m128i *)(RoundKey + (round * KEYLEN))));
+    }
+    m = _mm_aesenclast_si128(m, _mm_loadu_si128((const __m128i *)(RoundKey + (Nr * KEYLEN))));
+    _mm_storeu_si128((__m128i *)block, m);
+}
+
+static uint8_t has_aesni(void)
+{
+    return __builtin_cpu_supports("aes") ? 1 : 0;
+}
+#endif  // AES_USE_AESNI
+
+// Encrypts a block in place
+static void EncryptBlock(uint8_t *block, const uint8_t *RoundKey)
+{
+#if AES_USE_AESNI
+    if (has_aesni()) {
+        CipherAesNi(block, RoundKey);
+        return;
+    }
+#endif
+    Cipher((state_t *)block, RoundKey);
 }
 
 static void BlockCopy(uint8_t *output, const uint8_t *input)
@@ -402,35 +480,65 @@ static void BlockCopy(uint8_t *output, const uint8_t *input)
     }
 }
 
+// Returns the expanded key for key, from the cache if possible.
+// Must be called with key_cache_lock held.
+static const uint8_t *CachedRoundKey(const uint8_t *key)
+{
+    if (key_cache_used > 0 && memcmp(key_cache[key_cache_last].key, key, KEYLEN) == 0) {
+        return key_cache[key_cache_last].schedule.round_key;
+    }
+    for (uint8_t i = 0; i < key_cache_used; ++i) {
+        if (memcmp(key_cache[i].key, key, KEYLEN) == 0) {
+            key_cache_last = i;
+            return key_cache[i].schedule.round_key;
+        }
+    }
+
+    aes_key_cache_entry_t *entry = &key_cache[key_cache_next];
+    memcpy(entry->key, key, KEYLEN);
+    KeyExpansion(entry->schedule.round_key, key);
+    key_cache_last = key_cache_next;
+    key_cache_next = (key_cache_next + 1) % AES_KEY_CACHE_SIZE;
+    if (key_cache_used < AES_KEY_CACHE_SIZE) {
+        key_cache_used++;
+    }
+    return entry->schedule.round_key;
+}
+
 /*****************************************************************************/
 /* Public functions:                                                         */
 /*****************************************************************************/
+void AES128_key_cache_clear(void)
+{
+    AES_KEY_CACHE_LOCK();
+    memset(key_cache, 0, sizeof(key_cache));
+    key_cache_used = 0;
+    key_cache_next = 0;
+    key_cache_last = 0;
+    AES_KEY_CACHE_UNLOCK();
+}
+
 #if defined(ECB) && ECB
 
 void AES128_ECB_encrypt(uint8_t *input, const uint8_t *key, uint8_t *output)
 {
     // Copy input to output, and work in-memory on output
     BlockCopy(output, input);
-    state = (state_t *)output;
-
-    Key = key;
-    KeyExpansion();
 
     // The next function call encrypts the PlainText with the Key using AES algorithm.
-    Cipher();
+    AES_KEY_CACHE_LOCK();
+    EncryptBlock(output, CachedRoundKey(key));
+    AES_KEY_CACHE_UNLOCK();
 }
 
 void AES128_ECB_decrypt(uint8_t *input, const uint8_t *key, uint8_t *output)
 {
     // Copy input to output, and work in-memory on output
     BlockCopy(output, input);
-    state = (state_t *)output;
-
-    // The KeyExpansion routine must be called before encryption.
-    Key = key;
-    KeyExpansion();
 
-    InvCipher();
+    AES_KEY_CACHE_LOCK();
+    InvCipher((state_t *)output, CachedRoundKey(key));
+    AES_KEY_CACHE_UNLOCK();
 }
 
 #endif  // #if defined(ECB) && ECB
@@ -451,23 +559,20 @@ void AES128_CBC_encrypt_buffer(uint8_t *output, uint8_t *input, uint32_t length,
     uint8_t remainders = length % KEYLEN; /* Remaining bytes in the last non-full block */
 
     BlockCopy(output, input);
-    state = (state_t *)output;
 
     // Skip the key expansion if key is passed as 0
     if (0 != key) {
-        Key = key;
-        KeyExpansion();
+        KeyExpansion(cbc_schedule.round_key, key);
     }
 
     if (iv != 0) {
-        Iv = (uint8_t *)iv;
+        Iv = iv;
     }
 
     for (i = 0; i < length; i += KEYLEN) {
         XorWithIv(input);
         BlockCopy(output, input);
-        state = (state_t *)output;
-        Cipher();
+        EncryptBlock(output, cbc_schedule.round_key);
         Iv = output;
         input += KEYLEN;
         output += KEYLEN;
@@ -476,8 +581,7 @@ void AES128_CBC_encrypt_buffer(uint8_t *output, uint8_t *input, uint32_t length,
     if (remainders) {
         BlockCopy(output, input);
         memset(output + remainders, 0, KEYLEN - remainders); /* add 0-padding */
-        state = (state_t *)output;
-        Cipher();
+        EncryptBlock(output, cbc_schedule.round_key);
     }
 }
 
@@ -487,23 +591,20 @@ void AES128_CBC_decrypt_buffer(uint8_t *output, uint8_t *input, uint32_t length,
     uint8_t remainders = length % KEYLEN; /* Remaining bytes in the last non-full block */
 
     BlockCopy(output, input);
-    state = (state_t *)output;
 
     // Skip the key expansion if key is passed as 0
     if (0 != key) {
-        Key = key;
-        KeyExpansion();
+        KeyExpansion(cbc_schedule.round_key, key);
     }
 
     // If iv is passed as 0, we continue to encrypt without re-setting the Iv
     if (iv != 0) {
-        Iv = (uint8_t *)iv;
+        Iv = iv;
     }
 
     for (i = 0; i < length; i += KEYLEN) {
         BlockCopy(output, input);
-        state = (state_t *)output;
-        InvCipher();
+        InvCipher((state_t *)output, cbc_schedule.round_key);
         XorWithIv(output);
         Iv = input;
         input += KEYLEN;
@@ -513,8 +614,7 @@ void AES128_CBC_decrypt_buffer(uint8_t *output, uint8_t *input, uint32_t length,
     if (remainders) {
         BlockCopy(output, input);
         memset(output + remainders, 0, KEYLEN - remainders); /* add 0-padding */
-        state = (state_t *)output;
-        InvCipher();
+        InvCipher((state_t *)output, cbc_schedule.round_key);
     }
 }
 
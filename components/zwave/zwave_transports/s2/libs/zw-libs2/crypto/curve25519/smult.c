@@ -19,6 +19,289 @@ Derived from public domain code by D. J. Bernstein.
 #endif
 #endif
 
+#if defined(__SIZEOF_INT128__) && !defined(CURVE25519_REFERENCE)
+/*
+ * Field arithmetic in radix 2^51 for hosts with a 64x64->128 bit multiply.
+ * A field element is five 51 bit limbs, so a multiplication takes 25 word
+ * products where the reference code below needs 1024 byte products. Limbs
+ * may grow a few bits past 51 between carries; fe_mul() and fe_sq() accept
+ * inputs of up to 54 bits per limb.
+ */
+#include <stdint.h>
+
+__extension__ typedef unsigned __int128 uint128_t;
+typedef uint64_t fe51[5];
+
+#define MASK51 0x7FFFFFFFFFFFFULL
+
+static uint64_t load64(const unsigned char *in)
+{
+    uint64_t r = 0;
+    unsigned int i;
+    for (i = 0; i < 8; ++i) {
+        r |= (uint64_t)in[i] << (8 * i);
+    }
+    return r;
+}
+
+/* Bit 255 of the input is ignored, as RFC 7748 section 5 requires. */
+static void fe_load(fe51 h, const unsigned char s[32])
+{
+    h[0] = load64(s) & MASK51;
+    h[1] = (load64(s + 6) >> 3) & MASK51;
+    h[2] = (load64(s + 12) >> 6) & MASK51;
+    h[3] = (load64(s + 19) >> 1) & MASK51;
+    h[4] = (load64(s + 24) >> 12) & MASK51;
+}
+
+static void fe_carry(fe51 h)
+{
+    h[1] += h[0] >> 51;
+    h[0] &= MASK51;
+    h[2] += h[1] >> 51;
+    h[1] &= MASK51;
+    h[3] += h[2] >> 51;
+    h[2] &= MASK51;
+    h[4] += h[3] >> 51;
+    h[3] &= MASK51;
+    h[0] += 19 * (h[4] >> 51);
+    h[4] &= MASK51;
+}
+
+/* Writes the canonical encoding of f, i.e. f fully reduced modulo p. */
+static void fe_store(unsigned char s[32], const fe51 f)
+{
+    fe51 h;
+    uint64_t w[4];
+    uint64_t q;
+    unsigned int i;
+    for (i = 0; i < 5; ++i) {
+        h[i] = f[i];
+    }
+    fe_carry(h);
+    fe_carry(h);
+    /* h < 2^255 now; q is 1 when h >= p */
+    q = (h[0] + 19) >> 51;
+    q = (h[1] + q) >> 51;
+    q = (h[2] + q) >> 51;
+    q = (h[3] + q) >> 51;
+    q = (h[4] + q) >> 51;
+    h[0] += 19 * q;
+    h[1] += h[0] >> 51;
+    h[0] &= MASK51;
+    h[2] += h[1] >> 51;
+    h[1] &= MASK51;
+    h[3] += h[2] >> 51;
+    h[2] &= MASK51;
+    h[4] += h[3] >> 51;
+    h[3] &= MASK51;
+    h[4] &= MASK51;
+
+    w[0] = h[0] | (h[1] << 51);
+    w[1] = (h[1] >> 13) | (h[2] << 38);
+    w[2] = (h[2] >> 26) | (h[3] << 25);
+    w[3] = (h[3] >> 39) | (h[4] << 12);
+    for (i = 0; i < 32; ++i) {
+        s[i] = (unsigned char)(w[i / 8] >> (8 * (i % 8)));
+    }
+}
+
+static void fe_add(fe51 h, const fe51 f, const fe51 g)
+{
+    unsigned int i;
+    for (i = 0; i < 5; ++i) {
+        h[i] = f[i] + g[i];
+    }
+}
+
+/* h = f + 2p - g, so the limbs never underflow for g below 2p. */
+static void fe_sub(fe51 h, const fe51 f, const fe51 g)
+{
+    h[0] = (f[0] + 0xFFFFFFFFFFFDAULL) - g[0];
+    h[1] = (f[1] + 0xFFFFFFFFFFFFEULL) - g[1];
+    h[2] = (f[2] + 0xFFFFFFFFFFFFEULL) - g[2];
+    h[3] = (f[3] + 0xFFFFFFFFFFFFEULL) - g[3];
+    h[4] = (f[4] + 0xFFFFFFFFFFFFEULL) - g[4];
+}
+
+static void fe_reduce128(fe51 h, uint128_t t[5])
+{
+    uint64_t c;
+    t[1] += (uint64_t)(t[0] >> 51);
+    h[0] = (uint64_t)t[0] & MASK51;
+    t[2] += (uint64_t)(t[1] >> 51);
+    h[1] = (uint64_t)t[1] & MASK51;
+    t[3] += (uint64_t)(t[2] >> 51);
+    h[2] = (uint64_t)t[2] & MASK51;
+    t[4] += (uint64_t)(t[3] >> 51);
+    h[3] = (uint64_t)t[3] & MASK51;
+    c    = (uint64_t)(t[4] >> 51);
+    h[4] = (uint64_t)t[4] & MASK51;
+    h[0] += c * 19;
+    h[1] += h[0] >> 51;
+    h[0] &= MASK51;
+}
+
+static void fe_mul(fe51 h, const fe51 f, const fe51 g)
+{
+    uint128_t t[5];
+    uint64_t g1_19 = 19 * g[1];
+    uint64_t g2_19 = 19 * g[2];
+    uint64_t g3_19 = 19 * g[3];
+    uint64_t g4_19 = 19 * g[4];
+
+    t[0] = (uint128_t)f[0] * g[0] + (uint128_t)f[1] * g4_19 + (uint128_t)f[2] * g3_19 + (uint128_t)f[3] * g2_19 + (uint128_t)f[4] * g1_19;
+    t[1] = (uint128_t)f[0] * g[1] + (uint128_t)f[1] * g[0] + (uint128_t)f[2] * g4_19 + (uint128_t)f[3] * g3_19 + (uint128_t)f[4] * g2_19;
+    t[2] = (uint128_t)f[0] * g[2] + (uint128_t)f[1] * g[1] + (uint128_t)f[2] * g[0] + (uint128_t)f[3] * g4_19 + (uint128_t)f[4] * g3_19;
+    t[3] = (uint128_t)f[0] * g[3] + (uint128_t)f[1] * g[2] + (uint128_t)f[2] * g[1] + (uint128_t)f[3] * g[0] + (uint128_t)f[4] * g4_19;
+    t[4] = (uint128_t)f[0] * g[4] + (uint128_t)f[1] * g[3] + (uint128_t)f[2] * g[2] + (uint128_t)f[3] * g[1] + (uint128_t)f[4] * g[0];
+    fe_reduce128(h, t);
+}
+
+static void fe_sq(fe51 h, const fe51 f)
+{
+    uint128_t t[5];
+    uint64_t f0_2  = 2 * f[0];
+    uint64_t f1_2  = 2 * f[1];
+    uint64_t f1_38 = 38 * f[1];
+    uint64_t f2_38 = 38 * f[2];
+    uint64_t f3_38 = 38 * f[3];
+    uint64_t f3_19 = 19 * f[3];
+    uint64_t f4_19 = 19 * f[4];
+
+    t[0] = (uint128_t)f[0] * f[0] + (uint128_t)f1_38 * f[4] + (uint128_t)f2_38 * f[3];
+    t[1] = (uint128_t)f0_2 * f[1] + (uint128_t)f2_38 * f[4] + (uint128_t)f3_19 * f[3];
+    t[2] = (uint128_t)f0_2 * f[2] + (uint128_t)f[1] * f[1] + (uint128_t)f3_38 * f[4];
+    t[3] = (uint128_t)f0_2 * f[3] + (uint128_t)f1_2 * f[2] + (uint128_t)f4_19 * f[4];
+    t[4] = (uint128_t)f0_2 * f[4] + (uint128_t)f1_2 * f[3] + (uint128_t)f[2] * f[2];
+    fe_reduce128(h, t);
+}
+
+static void fe_mul121665(fe51 h, const fe51 f)
+{
+    uint128_t t[5];
+    unsigned int i;
+    for (i = 0; i < 5; ++i) {
+        t[i] = (uint128_t)f[i] * 121665;
+    }
+    fe_reduce128(h, t);
+}
+
+/* Swaps f and g when b is 1, without branching on b. */
+static void fe_cswap(fe51 f, fe51 g, uint64_t b)
+{
+    uint64_t mask = (uint64_t)0 - b;
+    uint64_t x;
+    unsigned int i;
+    for (i = 0; i < 5; ++i) {
+        x = mask & (f[i] ^ g[i]);
+        f[i] ^= x;
+        g[i] ^= x;
+    }
+}
+
+static void fe_sqn(fe51 h, const fe51 f, unsigned int n)
+{
+    fe_sq(h, f);
+    while (--n) {
+        fe_sq(h, h);
+    }
+}
+
+/* out = z^(p-2), with the same addition chain as recip() below. */
+static void fe_invert(fe51 out, const fe51 z)
+{
+    fe51 z2, z9, z11, z2_5_0, z2_10_0, z2_20_0, z2_50_0, z2_100_0, t;
+
+    fe_sq(z2, z);
+    fe_sqn(t, z2, 2);
+    fe_mul(z9, t, z);
+    fe_mul(z11, z9, z2);
+    fe_sq(t, z11);
+    fe_mul(z2_5_0, t, z9);
+    fe_sqn(t, z2_5_0, 5);
+    fe_mul(z2_10_0, t, z2_5_0);
+    fe_sqn(t, z2_10_0, 10);
+    fe_mul(z2_20_0, t, z2_10_0);
+    fe_sqn(t, z2_20_0, 20);
+    fe_mul(t, t, z2_20_0);
+    fe_sqn(t, t, 10);
+    fe_mul(z2_50_0, t, z2_10_0);
+    fe_sqn(t, z2_50_0, 50);
+    fe_mul(z2_100_0, t, z2_50_0);
+    fe_sqn(t, z2_100_0, 100);
+    fe_mul(t, t, z2_100_0);
+    fe_sqn(t, t, 50);
+    fe_mul(t, t, z2_50_0);
+    fe_sqn(t, t, 5);
+    fe_mul(out, t, z11);
+}
+
+int crypto_scalarmult_curve25519(unsigned char *q, const unsigned char *n, const unsigned char *p)
+{
+    unsigned char e[32];
+    fe51 x1, x2, z2, x3, z3;
+    fe51 a, aa, b, bb, c, d, da, cb, ee;
+    uint64_t swap = 0;
+    uint64_t bit;
+    int pos;
+    unsigned int i;
+
+    for (i = 0; i < 32; ++i) {
+        e[i] = n[i];
+    }
+    e[0] &= 248;
+    e[31] &= 127;
+    e[31] |= 64;
+
+    fe_load(x1, p);
+    for (i = 0; i < 5; ++i) {
+        x2[i] = 0;
+        z2[i] = 0;
+        x3[i] = x1[i];
+        z3[i] = 0;
+    }
+    x2[0] = 1;
+    z3[0] = 1;
+
+    /* Montgomery ladder, RFC 7748 section 5 */
+    for (pos = 254; pos >= 0; --pos) {
+        bit = (e[pos >> 3] >> (pos & 7)) & 1;
+        swap ^= bit;
+        fe_cswap(x2, x3, swap);
+        fe_cswap(z2, z3, swap);
+        swap = bit;
+
+        fe_add(a, x2, z2);
+        fe_sq(aa, a);
+        fe_sub(b, x2, z2);
+        fe_sq(bb, b);
+        fe_sub(ee, aa, bb);
+        fe_add(c, x3, z3);
+        fe_sub(d, x3, z3);
+        fe_mul(da, d, a);
+        fe_mul(cb, c, b);
+        fe_add(x3, da, cb);
+        fe_sq(x3, x3);
+        fe_sub(z3, da, cb);
+        fe_sq(z3, z3);
+        fe_mul(z3, z3, x1);
+        fe_mul(x2, aa, bb);
+        fe_mul121665(z2, ee);
+        fe_add(z2, z2, aa);
+        fe_mul(z2, z2, ee);
+    }
+    fe_cswap(x2, x3, swap);
+    fe_cswap(z2, z3, swap);
+
+    fe_invert(z2, z2);
+    fe_mul(x2, x2, z2);
+    fe_store(q, x2);
+    return 0;
+}
+
+#else
+
 static void add(unsigned int out[32], const unsigned int a[32], const unsigned int b[32])
 {
     unsigned int j;
@@ -331,6 +614,7 @@ int crypto_scalarmult_curve25519(unsigned char *q, const unsigned char *n, const
     for (i = 0; i < 32; ++i) {
         work[i] = p[i];
     }
+    work[31] &= 127;
     mainloop(work, e);
     recip(work + 32, work + 32);
     mult(work + 64, work, work + 32);
@@ -341,6 +625,8 @@ int crypto_scalarmult_curve25519(unsigned char *q, const unsigned char *n, const
     return 0;
 }
 
+#endif /* __SIZEOF_INT128__ && !CURVE25519_REFERENCE */
+
 #ifndef NDEBUG
 #ifdef EFR32ZG
 #pragma GCC pop_options
@@ -26,6 +26,13 @@
 #define ECB 1
 #endif
 
+/**
+ * Wipes the keys and expanded keys cached by AES128_ECB_encrypt() and
+ * AES128_ECB_decrypt(), for all threads. Call it when keys are replaced or
+ * removed so that they do not stay in memory.
+ */
+DllExport void AES128_key_cache_clear(void);
+
 #if defined(ECB) && ECB
 
 DllExport void AES128_ECB_encrypt(uint8_t *input, const uint8_t *key, uint8_t *output);
@@ -25,14 +25,34 @@
 #define S2_SEQ_DUPL_WINDOW_SIZE_NONCE_GET ((uint8_t)1)
 
 #define UNENCRYPTED_CLASS 0xFF
+/*
+ * Number of entries in the SPAN and MPAN tables. They can be set at build
+ * time, and must then be the same for everything including this file.
+ */
 #if defined(ZW_CONTROLLER) && !defined(HOST_SECURITY_INCLUDED)
-/* Largest size that fits in uint8_t (minus 1). */
-#define SPAN_TABLE_SIZE 254
+#ifndef SPAN_TABLE_SIZE
+/* One SPAN per Z-Wave and Z-Wave Long Range NodeID. */
+#define SPAN_TABLE_SIZE 4096
+#endif
+#ifndef MPAN_TABLE_SIZE
 #define MPAN_TABLE_SIZE 254
+#endif
 #else
+#ifndef SPAN_TABLE_SIZE
 #define SPAN_TABLE_SIZE 10
+#endif
+#ifndef MPAN_TABLE_SIZE
 #define MPAN_TABLE_SIZE 10
 #endif
+#endif
+/*
+ * The SPAN and MPAN tables are open-addressed hash tables. An entry is looked
+ * up among this many consecutive entries, starting at the one its key hashes
+ * to. When all of them are used, the least recently used one is replaced.
+ */
+#ifndef S2_TABLE_PROBE_LENGTH
+#define S2_TABLE_PROBE_LENGTH 16
+#endif
 #define MOS_LIST_LENGTH 3
 #if defined(EFR32ZG) || defined(ZW050x)
 #define WORKBUF_SIZE 200
@@ -92,6 +112,7 @@ struct SPAN {
 
         security_class_t class_id;  // The id of the security group in which this span is negotiated.
         span_state_t state;
+        uint32_t last_used;  // Value of the table clock when this entry was last looked up
 };
 
 struct MPAN {
@@ -101,6 +122,7 @@ struct MPAN {
         security_class_t class_id;
 
         enum { MPAN_NOT_USED, MPAN_SET, MPAN_MOS } state;  // State of this entry
+        uint32_t last_used;                                // Value of the table clock when this entry was last looked up
 };
 
 struct MOS_LIST {
@@ -145,6 +167,57 @@ typedef enum {
     SEND_FOLLOW_UP,
 } event_t;
 
+#ifdef ZW_CONTROLLER
+/* This structure stores flags that are associated to some NLS related
+commands that are used to retransmit the frames that cannot be sent due
+to the S2 state machine not being IDLE. */
+struct S2_delayed_transmission_flags {
+        uint8_t send_nls_node_list_get : 1;
+        uint8_t send_nls_node_list_report : 1;
+        uint8_t reserved : 6;
+};
+
+/* This union stores some parameters that are associated to some NLS related
+commands. They are used to cache information to be sent later on using the flags
+above. */
+union S2_delayed_transmission_cache {
+        struct {
+                uint8_t is_last_node;
+                uint8_t granted_keys;
+                uint16_t node_id;
+                uint8_t nls_state;
+        } nls_node_report;
+        struct {
+                uint8_t request;  // 0: first node, 1: next node
+        } get_nls_node_list;
+};
+#endif
+
+/**
+ * Transmission state of a context, for one peer.
+ *
+ * A context runs one transmission at a time. \ref S2_session_save moves it out
+ * of the context, so that transmissions to other peers can run meanwhile on the
+ * same SPAN and MPAN tables, and \ref S2_session_restore moves it back before
+ * an event concerning the peer is passed to the context.
+ *
+ * The current SPAN is not part of it: the state machine looks the SPAN up by
+ * peer on each use. NLS frames delayed while the transmission runs are, as
+ * they are sent to the same peer once the transmission is done.
+ */
+struct S2_session {
+        states_t fsm;
+        uint8_t retry;
+        s2_connection_t peer;
+        const uint8_t *buf;
+        uint16_t length;
+        struct MPAN *mpan;
+#ifdef ZW_CONTROLLER
+        struct S2_delayed_transmission_flags delayed_transmission_flags;
+        union S2_delayed_transmission_cache delayed_transmission_cache;
+#endif
+};
+
 typedef enum {
     AUTH_OK,
     PARSE_FAIL,
@@ -197,6 +270,7 @@ struct S2 {
         struct MPAN mpan_table[MPAN_TABLE_SIZE];
         struct MOS_LIST mos_list[MOS_LIST_LENGTH];
 #endif
+        uint32_t table_clock;  // Incremented on each SPAN or MPAN table lookup, for the LRU replacement
         states_t fsm;
         uint8_t retry;
         s2_inclusion_state_t inclusion_state;
@@ -214,29 +288,8 @@ struct S2 {
         bool is_keys_restored;
 
 #ifdef ZW_CONTROLLER
-        /* This structure stores flags that are associated to some NLS related
-        commands that are used to retransmit the frames that cannot be sent due
-        to the S2 state machine not being IDLE. */
-        struct {
-                uint8_t send_nls_node_list_get : 1;
-                uint8_t send_nls_node_list_report : 1;
-                uint8_t reserved : 6;
-        } delayed_transmission_flags;
-
-        /* This union stores some parameters that are associated to some NLS related
-        commands. They are used to cache information to be sent later on using the flags
-        above. */
-        union {
-                struct {
-                        uint8_t is_last_node;
-                        uint8_t granted_keys;
-                        uint16_t node_id;
-                        uint8_t nls_state;
-                } nls_node_report;
-                struct {
-                        uint8_t request;  // 0: first node, 1: next node
-                } get_nls_node_list;
-        } delayed_transmission_cache;
+        struct S2_delayed_transmission_flags delayed_transmission_flags;
+        union S2_delayed_transmission_cache delayed_transmission_cache;
 #endif
         // network_key_t temp_network_key;
         uint8_t nls_state;
@@ -296,4 +349,74 @@ void s2_restore_keys(struct S2 *p_context, bool make_keys_persist_se);
  */
 uint8_t S2_network_key_update(struct S2 *p_context, uint32_t key_id, security_class_t class_id, const network_key_t net_key, uint8_t temp_key_expand, bool make_keys_persist_se);
 
+/**
+ * Find the SPAN entry of a local and a remote node.
+ *
+ * \param p_context the S2 context
+ * \param lnode     local NodeID
+ * \param rnode     remote NodeID
+ * \return the entry, or NULL if there is no entry in use for the pair.
+ */
+struct SPAN *S2_find_span(struct S2 *p_context, node_t lnode, node_t rnode);
+
+/**
+ * Allocate a SPAN entry for a local and a remote node.
+ *
+ * Must only be called when \ref S2_find_span finds no entry for the pair. If the
+ * table has no unused entry for the pair, the least recently used entry it could
+ * have been stored in is replaced.
+ *
+ * \param p_context the S2 context
+ * \param lnode     local NodeID
+ * \param rnode     remote NodeID
+ * \return a cleared entry with the NodeIDs set, in the SPAN_NOT_USED state.
+ */
+struct SPAN *S2_allocate_span(struct S2 *p_context, node_t lnode, node_t rnode);
+
+/**
+ * Find the MPAN entry of a multicast group.
+ *
+ * \param p_context the S2 context
+ * \param owner_id  NodeID of the node maintaining the group, 0 for our own groups
+ * \param group_id  Group ID
+ * \return the entry, or NULL if there is no entry in use for the group.
+ */
+struct MPAN *S2_find_mpan(struct S2 *p_context, node_t owner_id, uint8_t group_id);
+
+/**
+ * Allocate an MPAN entry for a multicast group.
+ *
+ * Must only be called when \ref S2_find_mpan finds no entry for the group. If
+ * the table has no unused entry for the group, the least recently used entry it
+ * could have been stored in is replaced.
+ *
+ * \param p_context the S2 context
+ * \param owner_id  NodeID of the node maintaining the group, 0 for our own groups
+ * \param group_id  Group ID
+ * \return a cleared entry with the owner and group set, in the MPAN_NOT_USED state.
+ */
+struct MPAN *S2_allocate_mpan(struct S2 *p_context, node_t owner_id, uint8_t group_id);
+
+/**
+ * Move the transmission in progress out of a context.
+ *
+ * The context is IDLE afterwards. The buffer being sent is not copied, it must
+ * stay valid until the session is restored and completes.
+ *
+ * \param p_context the S2 context
+ * \param session   receives the transmission state
+ */
+void S2_session_save(struct S2 *p_context, struct S2_session *session);
+
+/**
+ * Move a transmission saved with \ref S2_session_save back into a context.
+ *
+ * Must only be called when the context is IDLE, i.e. after its own
+ * transmission has been saved or has completed.
+ *
+ * \param p_context the S2 context
+ * \param session   transmission state to restore
+ */
+void S2_session_restore(struct S2 *p_context, const struct S2_session *session);
+
 #endif /* PROTOCOL_S2_PROTOCOL_H_ */
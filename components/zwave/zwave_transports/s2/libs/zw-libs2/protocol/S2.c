@@ -121,86 +121,163 @@ static uint32_t convert_key_slot_to_keyid(uint8_t slot_id)
 }
 #endif
 
+/* The tables are searched over at most S2_TABLE_PROBE_LENGTH entries, or all of them if they are smaller. */
+#define SPAN_PROBE_LENGTH ((SPAN_TABLE_SIZE < S2_TABLE_PROBE_LENGTH) ? SPAN_TABLE_SIZE : S2_TABLE_PROBE_LENGTH)
+#define MPAN_PROBE_LENGTH ((MPAN_TABLE_SIZE < S2_TABLE_PROBE_LENGTH) ? MPAN_TABLE_SIZE : S2_TABLE_PROBE_LENGTH)
+
 /**
- * Find or allocate an mpan by group_id id no match can be found
- * we use a new entry.
+ * Index of the first SPAN or MPAN table entry to look at for a key.
+ * NodeIDs are allocated in sequence, so the peers of a node are spread
+ * over consecutive entries.
  */
-static struct MPAN *find_mpan_by_group_id(struct S2 *p_context, node_t owner_id, uint8_t group_id, uint8_t create_new)
+static uint32_t table_index(uint32_t owner, uint32_t id, uint32_t table_size)
+{
+    return (owner * 2654435761u + id) % table_size;
+}
+
+/**
+ * Tell if entry a was used less recently than entry b, according to the table clock.
+ */
+static int used_before(struct S2 *p_context, uint32_t a, uint32_t b)
 {
     CTX_DEF
-    uint8_t rnd[RANDLEN];
+    return (uint32_t)(ctxt->table_clock - a) > (uint32_t)(ctxt->table_clock - b);
+}
+
+struct SPAN *S2_find_span(struct S2 *p_context, node_t lnode, node_t rnode)
+{
+    CTX_DEF
+    uint32_t index = table_index(lnode, rnode, SPAN_TABLE_SIZE);
     int i;
 
-    for (i = 0; i < MPAN_TABLE_SIZE; i++) {
-        if ((ctxt->mpan_table[i].state != MPAN_NOT_USED) && (ctxt->mpan_table[i].group_id == group_id) && (ctxt->mpan_table[i].owner_id == owner_id) && ((1 << ctxt->mpan_table[i].class_id) & ctxt->loaded_keys)) {
-            return &ctxt->mpan_table[i];
+    for (i = 0; i < SPAN_PROBE_LENGTH; i++) {
+        struct SPAN *span = &ctxt->span_table[index];
+        if (span->state != SPAN_NOT_USED && (span->lnode == lnode) && (span->rnode == rnode)) {
+            span->last_used = ++ctxt->table_clock;
+            return span;
         }
+        index = (index + 1) % SPAN_TABLE_SIZE;
     }
-    if (!create_new) {
-        return 0;
-    }
-    /*We need to be find an unused group handle */
-    AES_CTR_DRBG_Generate(&s2_ctr_drbg, rnd);
+    return 0;
+}
 
-    /*Allocate new entry if possible */
-    for (i = 0; i < MPAN_TABLE_SIZE; i++) {
-        if (ctxt->mpan_table[i].state == MPAN_NOT_USED) {
+struct SPAN *S2_allocate_span(struct S2 *p_context, node_t lnode, node_t rnode)
+{
+    CTX_DEF
+    uint32_t index    = table_index(lnode, rnode, SPAN_TABLE_SIZE);
+    struct SPAN *span = &ctxt->span_table[index];
+    int i;
+
+    /* Use the first unused entry, or else the least recently used one */
+    for (i = 0; i < SPAN_PROBE_LENGTH; i++) {
+        struct SPAN *candidate = &ctxt->span_table[index];
+        if (candidate->state == SPAN_NOT_USED) {
+            span = candidate;
             break;
         }
+        if (used_before(ctxt, candidate->last_used, span->last_used)) {
+            span = candidate;
+        }
+        index = (index + 1) % SPAN_TABLE_SIZE;
     }
 
-    /*Just select a random entry Note this will overwrite existing entries
-     * TODO we should really select the oldest entry
-     * */
-    if (i == MPAN_TABLE_SIZE) {
-        // dropping random span entry
-        i = rnd[0] % MPAN_TABLE_SIZE;
-    }
-
-    ctxt->mpan_table[i].state    = owner_id ? MPAN_MOS : MPAN_SET;
-    ctxt->mpan_table[i].group_id = group_id;
-    ctxt->mpan_table[i].owner_id = owner_id;
-    ctxt->mpan_table[i].class_id = ctxt->peer.class_id;  // Here we assume that peer is set...
-
-    AES_CTR_DRBG_Generate(&s2_ctr_drbg, ctxt->mpan_table[i].inner_state);
-    ;
-
-    return &ctxt->mpan_table[i];
+    memset(span, 0, sizeof(struct SPAN));
+    span->lnode     = lnode;
+    span->rnode     = rnode;
+    span->last_used = ++ctxt->table_clock;
+    return span;
 }
 
-static struct SPAN *find_span_by_node(struct S2 *p_context, const s2_connection_t *con)
+struct MPAN *S2_find_mpan(struct S2 *p_context, node_t owner_id, uint8_t group_id)
 {
     CTX_DEF
-    uint8_t rnd[RANDLEN];
+    uint32_t index = table_index(owner_id, group_id, MPAN_TABLE_SIZE);
     int i;
-    /* Locate existing entry */
-    for (i = 0; i < SPAN_TABLE_SIZE; i++) {
-        if (ctxt->span_table[i].state != SPAN_NOT_USED && (ctxt->span_table[i].lnode == con->l_node) && (ctxt->span_table[i].rnode == con->r_node)) {
-            return &ctxt->span_table[i];
+
+    for (i = 0; i < MPAN_PROBE_LENGTH; i++) {
+        struct MPAN *mpan = &ctxt->mpan_table[index];
+        if ((mpan->state != MPAN_NOT_USED) && (mpan->group_id == group_id) && (mpan->owner_id == owner_id)) {
+            mpan->last_used = ++ctxt->table_clock;
+            return mpan;
         }
+        index = (index + 1) % MPAN_TABLE_SIZE;
     }
+    return 0;
+}
 
-    AES_CTR_DRBG_Generate(&s2_ctr_drbg, rnd);
+struct MPAN *S2_allocate_mpan(struct S2 *p_context, node_t owner_id, uint8_t group_id)
+{
+    CTX_DEF
+    uint32_t index    = table_index(owner_id, group_id, MPAN_TABLE_SIZE);
+    struct MPAN *mpan = &ctxt->mpan_table[index];
+    int i;
 
-    /*Allocate new entry if possible */
-    for (i = 0; i < SPAN_TABLE_SIZE; i++) {
-        if (ctxt->span_table[i].state == SPAN_NOT_USED) {
+    /* Use the first unused entry, or else the least recently used one */
+    for (i = 0; i < MPAN_PROBE_LENGTH; i++) {
+        struct MPAN *candidate = &ctxt->mpan_table[index];
+        if (candidate->state == MPAN_NOT_USED) {
+            mpan = candidate;
             break;
         }
+        if (used_before(ctxt, candidate->last_used, mpan->last_used)) {
+            mpan = candidate;
+        }
+        index = (index + 1) % MPAN_TABLE_SIZE;
     }
 
-    /*Just select a random entry Note this will overwrite existing entries*/
-    if (i == SPAN_TABLE_SIZE) {
-        // dropping random span entry
-        i = rnd[0] % SPAN_TABLE_SIZE;
+    memset(mpan, 0, sizeof(struct MPAN));
+    mpan->owner_id  = owner_id;
+    mpan->group_id  = group_id;
+    mpan->last_used = ++ctxt->table_clock;
+    return mpan;
+}
+
+/**
+ * Find or allocate an mpan by group_id id no match can be found
+ * we use a new entry.
+ */
+static struct MPAN *find_mpan_by_group_id(struct S2 *p_context, node_t owner_id, uint8_t group_id, uint8_t create_new)
+{
+    CTX_DEF
+    struct MPAN *mpan = S2_find_mpan(ctxt, owner_id, group_id);
+
+    if (mpan && ((1 << mpan->class_id) & ctxt->loaded_keys)) {
+        return mpan;
+    }
+    if (!create_new) {
+        return 0;
+    }
+
+    /* An entry of a security class we no longer have is replaced in place */
+    if (!mpan) {
+        mpan = S2_allocate_mpan(ctxt, owner_id, group_id);
     }
 
-    ctxt->span_table[i].state  = SPAN_NO_SEQ;
-    ctxt->span_table[i].lnode  = con->l_node;
-    ctxt->span_table[i].rnode  = con->r_node;
-    ctxt->span_table[i].tx_seq = rnd[1];
+    mpan->state    = owner_id ? MPAN_MOS : MPAN_SET;
+    mpan->class_id = ctxt->peer.class_id;  // Here we assume that peer is set...
+
+    AES_CTR_DRBG_Generate(&s2_ctr_drbg, mpan->inner_state);
 
-    return &ctxt->span_table[i];
+    return mpan;
+}
+
+static struct SPAN *find_span_by_node(struct S2 *p_context, const s2_connection_t *con)
+{
+    CTX_DEF
+    uint8_t rnd[RANDLEN];
+    struct SPAN *span = S2_find_span(ctxt, con->l_node, con->r_node);
+
+    if (span) {
+        return span;
+    }
+
+    AES_CTR_DRBG_Generate(&s2_ctr_drbg, rnd);
+
+    span         = S2_allocate_span(ctxt, con->l_node, con->r_node);
+    span->state  = SPAN_NO_SEQ;
+    span->tx_seq = rnd[1];
+
+    return span;
 }
 
 /**
@@ -559,11 +636,9 @@ void S2_free_mpan(struct S2 *p_context, node_t owner_id, uint8_t group_id)
 {
     CTX_DEF
     // Search for a MPAN with the Group ID / owner ID, and if found, set it back to NOT USED.
-    for (uint8_t i = 0; i < MPAN_TABLE_SIZE; i++) {
-        if ((ctxt->mpan_table[i].group_id == group_id) && (ctxt->mpan_table[i].owner_id == owner_id)) {
-            ctxt->mpan_table[i].state = MPAN_NOT_USED;
-            return;
-        }
+    struct MPAN *mpan = S2_find_mpan(ctxt, owner_id, group_id);
+    if (mpan) {
+        mpan->state = MPAN_NOT_USED;
     }
 }
 
@@ -593,7 +668,7 @@ static void S2_send_raw(struct S2 *p_context, uint8_t *buf, uint16_t len)
 static uint8_t S2_is_mos(struct S2 *p_context, node_t node_id, uint8_t clear)
 {
     CTX_DEF
-    uint8_t i;
+    int i;
     for (i = 0; i < MPAN_TABLE_SIZE; i++) {
         if ((ctxt->mpan_table[i].owner_id == node_id) && (ctxt->mpan_table[i].state == MPAN_MOS)) {
             if (clear) {
@@ -1100,6 +1175,41 @@ uint8_t S2_is_send_data_busy(struct S2 *p_context)
     return (ctxt->fsm != IDLE) && (ctxt->fsm != IS_MOS_WAIT_REPLY);
 }
 
+void S2_session_save(struct S2 *p_context, struct S2_session *session)
+{
+    CTX_DEF
+    session->fsm    = ctxt->fsm;
+    session->retry  = ctxt->retry;
+    session->peer   = ctxt->peer;
+    session->buf    = ctxt->buf;
+    session->length = ctxt->length;
+    session->mpan   = ctxt->mpan;
+#ifdef ZW_CONTROLLER
+    session->delayed_transmission_flags = ctxt->delayed_transmission_flags;
+    session->delayed_transmission_cache = ctxt->delayed_transmission_cache;
+    memset(&ctxt->delayed_transmission_flags, 0, sizeof(ctxt->delayed_transmission_flags));
+#endif
+    /* The rest of the state is kept, as an IDLE context leaves it. ctxt->span
+     * is not used by the state machine, which looks SPANs up by peer. */
+    ctxt->fsm = IDLE;
+}
+
+void S2_session_restore(struct S2 *p_context, const struct S2_session *session)
+{
+    CTX_DEF
+    assert(ctxt->fsm == IDLE);
+    ctxt->fsm    = session->fsm;
+    ctxt->retry  = session->retry;
+    ctxt->peer   = session->peer;
+    ctxt->buf    = session->buf;
+    ctxt->length = session->length;
+    ctxt->mpan   = session->mpan;
+#ifdef ZW_CONTROLLER
+    ctxt->delayed_transmission_flags = session->delayed_transmission_flags;
+    ctxt->delayed_transmission_cache = session->delayed_transmission_cache;
+#endif
+}
+
 void S2_init_prng(void)
 {
     uint8_t entropy[32] = {0};
@@ -1160,6 +1270,8 @@ uint8_t S2_network_key_update(struct S2 *p_context, uint32_t key_id, security_cl
     if (class_id >= N_SEC_CLASS) {
         return 0;
     }
+    // The keys being replaced must not stay in the AES key cache.
+    AES128_key_cache_clear();
     if (temp_key_expand) {
         tempkey_expand(key_id, net_key, ctxt->sg[class_id].enc_key, ctxt->sg[class_id].nonce_key, ctxt->sg[class_id].mpan_key);
     } else {
@@ -1185,6 +1297,7 @@ uint8_t S2_network_key_update(struct S2 *p_context, uint32_t key_id, security_cl
 void S2_destroy(struct S2 *p_context)
 {
     CTX_DEF
+    AES128_key_cache_clear();
     // Erase sensitive memory safely
 #if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 202311L
     void *result = memset_explicit(ctxt, 0, sizeof(struct S2));
@@ -0,0 +1,609 @@
+/* © 2026 Silicon Laboratories Inc.
+ */
+/**
+ * @file test_s2_session.c
+ * @brief Test suite for S2 sessions running concurrently on one context
+ *
+ * A controller context sends S2 encapsulated messages with Verify Delivery to
+ * 1, 10 and 100 destinations, and a second context plays the part of all the
+ * destinations, which reply to every message. Each context keeps one
+ * struct S2_session per peer, saved with S2_session_save() and restored with
+ * S2_session_restore() around every event concerning the peer.
+ *
+ * Frames go through a simulated radio: a single channel, on which a frame takes
+ * FRAME_AIRTIME_MS, and destinations that take PEER_RESPONSE_TIME_MS to reply.
+ * Frames of the destinations get the channel before the frames queued by the
+ * controller, like replies that do not wait for the controller's next frame.
+ * The suite measures the secure frames per second sent by the controller, in
+ * simulated time, when it runs one session at a time and when it runs one
+ * session per destination.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "unity.h"
+
+#include "S2.h"
+#include "s2_protocol.h"
+#include "S2_external.h"
+
+#define HOME_ID            0xCAFEBABE
+#define CONTROLLER_NODE_ID 1
+#define FIRST_PEER_NODE_ID 2
+#define MAX_NODE_ID        128
+
+#define MESSAGES_PER_DESTINATION 10
+#define FRAME_AIRTIME_MS         5
+#define PEER_RESPONSE_TIME_MS    30
+// Time to wait for the reply once a frame is acknowledged, as the ZPC uses
+#define NONCE_REP_TIME 250
+
+// Context sending to the destinations, and context playing all the destinations
+static struct S2 controller;
+static struct S2 network;
+
+/*******************************************************************************
+ * Sessions
+ ******************************************************************************/
+
+static struct S2_session sessions[2][MAX_NODE_ID];
+// Peer of the session restored in each context, 0 if none
+static node_t active_peer[2];
+
+static int context_index(const struct S2 *ctxt)
+{
+    return (ctxt == &controller) ? 0 : 1;
+}
+
+// The peer of a connection is the destination, whatever its direction
+static node_t peer_of(const struct S2 *ctxt, const s2_connection_t *connection)
+{
+    return (ctxt == &controller) ? connection->r_node : connection->l_node;
+}
+
+static void session_enter(struct S2 *ctxt, node_t peer)
+{
+    TEST_ASSERT_TRUE(peer < MAX_NODE_ID);
+    TEST_ASSERT_EQUAL(0, active_peer[context_index(ctxt)]);
+    S2_session_restore(ctxt, &sessions[context_index(ctxt)][peer]);
+    active_peer[context_index(ctxt)] = peer;
+}
+
+static void session_leave(struct S2 *ctxt)
+{
+    node_t peer = active_peer[context_index(ctxt)];
+    S2_session_save(ctxt, &sessions[context_index(ctxt)][peer]);
+    active_peer[context_index(ctxt)] = 0;
+}
+
+/*******************************************************************************
+ * Simulated radio
+ ******************************************************************************/
+
+typedef enum {
+    EVENT_FRAME,      // A frame reaches its receiver
+    EVENT_SEND_DONE,  // A transmission is acknowledged
+    EVENT_TIMEOUT,    // The timer of a session expires
+    EVENT_REPLY,      // A destination replies to a message
+    EVENT_START,      // The controller sends its next message to a destination
+    EVENT_CHANNEL,    // The channel is free for the next frame
+} event_type_t;
+
+typedef struct {
+        uint32_t time;
+        uint32_t sequence;  // Orders the events of the same time
+        event_type_t type;
+        struct S2 *context;
+        node_t peer;
+        uint16_t tx_time;
+        s2_connection_t connection;
+        uint8_t frame[WORKBUF_SIZE];
+        uint16_t length;
+} sim_event_t;
+
+#define MAX_EVENTS 1024
+static sim_event_t events[MAX_EVENTS];
+static uint32_t event_count;
+static uint32_t event_sequence;
+static uint32_t now;
+static uint32_t finish_time;  // Time at which the controller completed its last message
+
+// Frames waiting for the channel, for each context
+typedef struct {
+        struct S2 *sender;
+        node_t peer;
+        bool send_done;  // Notify the sender when the frame is acknowledged
+        uint32_t request_time;
+        s2_connection_t connection;
+        uint8_t frame[WORKBUF_SIZE];
+        uint16_t length;
+} radio_frame_t;
+
+#define RADIO_QUEUE_SIZE 256
+static radio_frame_t radio_queues[2][RADIO_QUEUE_SIZE];
+static uint32_t radio_queue_head[2];
+static uint32_t radio_queue_count[2];
+static bool channel_busy;
+
+// Destinations
+static uint32_t messages_left[MAX_NODE_ID];
+static uint32_t messages_received[MAX_NODE_ID];
+static node_t waiting_destinations[MAX_NODE_ID];
+static uint32_t waiting_head;
+static uint32_t waiting_count;
+static uint32_t session_limit;
+static uint32_t active_session_count;
+
+// Counters
+static uint32_t g_frame_count;     // Frames transmitted over the radio
+static uint32_t g_completed_count; // Messages completed by the controller
+static uint32_t g_verified_count;  // Messages for which the controller received the reply
+
+static sim_event_t *schedule(uint32_t time, event_type_t type, struct S2 *ctxt, node_t peer)
+{
+    TEST_ASSERT_TRUE(event_count < MAX_EVENTS);
+    sim_event_t *event = &events[event_count++];
+    memset(event, 0, offsetof(sim_event_t, frame));
+    event->time     = time;
+    event->sequence = event_sequence++;
+    event->type     = type;
+    event->context  = ctxt;
+    event->peer     = peer;
+    return event;
+}
+
+static bool next_event(sim_event_t *event)
+{
+    if (event_count == 0) {
+        return false;
+    }
+    uint32_t first = 0;
+    for (uint32_t i = 1; i < event_count; i++) {
+        if (events[i].time < events[first].time || (events[i].time == events[first].time && events[i].sequence < events[first].sequence)) {
+            first = i;
+        }
+    }
+    memcpy(event, &events[first], sizeof(sim_event_t));
+    events[first] = events[--event_count];
+    now           = event->time;
+    return true;
+}
+
+static void cancel_timeout(struct S2 *ctxt, node_t peer)
+{
+    for (uint32_t i = 0; i < event_count; i++) {
+        if (events[i].type == EVENT_TIMEOUT && events[i].context == ctxt && events[i].peer == peer) {
+            events[i] = events[--event_count];
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Transmits the next frame waiting for the channel, if any
+ */
+static void channel_transmit_next(void)
+{
+    int side = (radio_queue_count[1] > 0) ? 1 : 0;
+    if (radio_queue_count[side] == 0) {
+        channel_busy = false;
+        return;
+    }
+    radio_frame_t *frame   = &radio_queues[side][radio_queue_head[side]];
+    radio_queue_head[side] = (radio_queue_head[side] + 1) % RADIO_QUEUE_SIZE;
+    radio_queue_count[side]--;
+    channel_busy = true;
+
+    const uint32_t done_time = now + FRAME_AIRTIME_MS;
+    struct S2 *receiver      = (frame->sender == &controller) ? &network : &controller;
+    sim_event_t *event       = schedule(done_time, EVENT_FRAME, receiver, frame->peer);
+    // The receiver sees the connection from the other end
+    event->connection.l_node = frame->connection.r_node;
+    event->connection.r_node = frame->connection.l_node;
+    memcpy(event->frame, frame->frame, frame->length);
+    event->length = frame->length;
+    if (frame->send_done) {
+        event          = schedule(done_time, EVENT_SEND_DONE, frame->sender, frame->peer);
+        event->tx_time = (uint16_t)(done_time - frame->request_time + NONCE_REP_TIME);
+    }
+    schedule(done_time, EVENT_CHANNEL, NULL, 0);
+    g_frame_count++;
+}
+
+static void radio_transmit(struct S2 *ctxt, const s2_connection_t *connection, const uint8_t *buf, uint16_t len, bool send_done)
+{
+    TEST_ASSERT_TRUE(len <= WORKBUF_SIZE);
+    const int side = context_index(ctxt);
+    TEST_ASSERT_TRUE(radio_queue_count[side] < RADIO_QUEUE_SIZE);
+    radio_frame_t *frame = &radio_queues[side][(radio_queue_head[side] + radio_queue_count[side]) % RADIO_QUEUE_SIZE];
+    radio_queue_count[side]++;
+    frame->sender       = ctxt;
+    frame->peer         = peer_of(ctxt, connection);
+    frame->send_done    = send_done;
+    frame->request_time = now;
+    frame->connection   = *connection;
+    memcpy(frame->frame, buf, len);
+    frame->length = len;
+    if (!channel_busy) {
+        channel_transmit_next();
+    }
+}
+
+static void start_waiting_destinations(void)
+{
+    while (active_session_count < session_limit && waiting_count > 0) {
+        node_t peer  = waiting_destinations[waiting_head];
+        waiting_head = (waiting_head + 1) % MAX_NODE_ID;
+        waiting_count--;
+        active_session_count++;
+        schedule(now, EVENT_START, &controller, peer);
+    }
+}
+
+static void wait_for_session(node_t peer)
+{
+    waiting_destinations[(waiting_head + waiting_count) % MAX_NODE_ID] = peer;
+    waiting_count++;
+}
+
+static void send_message(node_t peer)
+{
+    static const uint8_t message[] = {0x20, 0x01, 0xFF};  // Basic Set
+    s2_connection_t connection;
+
+    memset(&connection, 0, sizeof(s2_connection_t));
+    connection.l_node     = CONTROLLER_NODE_ID;
+    connection.r_node     = peer;
+    connection.class_id   = 0;
+    connection.tx_options = S2_TXOPTION_VERIFY_DELIVERY;
+
+    messages_left[peer]--;
+    session_enter(&controller, peer);
+    TEST_ASSERT_EQUAL(1, S2_send_data(&controller, &connection, message, sizeof(message)));
+    session_leave(&controller);
+}
+
+static void send_reply(node_t peer)
+{
+    static const uint8_t reply[] = {0x20, 0x03, 0xFF};  // Basic Report
+    s2_connection_t connection;
+
+    memset(&connection, 0, sizeof(s2_connection_t));
+    connection.l_node   = peer;
+    connection.r_node   = CONTROLLER_NODE_ID;
+    connection.class_id = 0;
+
+    session_enter(&network, peer);
+    TEST_ASSERT_EQUAL(1, S2_send_data(&network, &connection, reply, sizeof(reply)));
+    session_leave(&network);
+}
+
+static void run_event(sim_event_t *event)
+{
+    switch (event->type) {
+        case EVENT_FRAME:
+            session_enter(event->context, event->peer);
+            S2_application_command_handler(event->context, &event->connection, event->frame, event->length);
+            session_leave(event->context);
+            break;
+        case EVENT_SEND_DONE:
+            session_enter(event->context, event->peer);
+            S2_send_frame_done_notify(event->context, S2_TRANSMIT_COMPLETE_OK, event->tx_time);
+            session_leave(event->context);
+            break;
+        case EVENT_TIMEOUT:
+            session_enter(event->context, event->peer);
+            S2_timeout_notify(event->context);
+            session_leave(event->context);
+            break;
+        case EVENT_REPLY:
+            send_reply(event->peer);
+            break;
+        case EVENT_START:
+            send_message(event->peer);
+            break;
+        case EVENT_CHANNEL:
+            channel_transmit_next();
+            break;
+    }
+}
+
+/**
+ * @brief Sends MESSAGES_PER_DESTINATION messages to each destination
+ *
+ * @param destination_count Number of destinations
+ * @param concurrent        Run one session per destination, else one session at a time
+ * @returns the secure frames sent per second of simulated time
+ */
+static double measure_throughput(uint32_t destination_count, bool concurrent)
+{
+    session_limit = concurrent ? destination_count : 1;
+    for (node_t peer = FIRST_PEER_NODE_ID; peer < FIRST_PEER_NODE_ID + destination_count; peer++) {
+        messages_left[peer] = MESSAGES_PER_DESTINATION;
+        wait_for_session(peer);
+    }
+    start_waiting_destinations();
+
+    sim_event_t event;
+    while (next_event(&event)) {
+        run_event(&event);
+    }
+
+    const uint32_t message_count = destination_count * MESSAGES_PER_DESTINATION;
+    TEST_ASSERT_EQUAL(message_count, g_completed_count);
+    for (node_t peer = FIRST_PEER_NODE_ID; peer < FIRST_PEER_NODE_ID + destination_count; peer++) {
+        TEST_ASSERT_EQUAL(MESSAGES_PER_DESTINATION, messages_received[peer]);
+        TEST_ASSERT_EQUAL(IDLE, sessions[0][peer].fsm);
+        TEST_ASSERT_EQUAL(IDLE, sessions[1][peer].fsm);
+    }
+    TEST_ASSERT_EQUAL(0, active_session_count);
+
+    const double frames_per_second = message_count * 1000.0 / finish_time;
+    printf("%3u destinations, %s: %4u messages (%u verified), %5u radio frames in %6u ms, %6.1f secure frames/s\n",
+           (unsigned)destination_count,
+           concurrent ? "one session per destination" : "one session at a time      ",
+           (unsigned)message_count,
+           (unsigned)g_verified_count,
+           (unsigned)g_frame_count,
+           (unsigned)finish_time,
+           frames_per_second);
+    return frames_per_second;
+}
+
+/*******************************************************************************
+ * External Function Stubs
+ ******************************************************************************/
+
+void S2_msg_received_event(struct S2 *ctxt, s2_connection_t *peer, uint8_t *buf, uint16_t len)
+{
+    if (ctxt == &network) {
+        messages_received[peer->l_node]++;
+        schedule(now + PEER_RESPONSE_TIME_MS, EVENT_REPLY, &network, peer->l_node);
+    }
+}
+
+void S2_send_done_event(struct S2 *ctxt, s2_tx_status_t status)
+{
+    if (ctxt != &controller) {
+        TEST_ASSERT_EQUAL(S2_TRANSMIT_COMPLETE_OK, status);
+        return;
+    }
+    TEST_ASSERT_TRUE(status == S2_TRANSMIT_COMPLETE_OK || status == S2_TRANSMIT_COMPLETE_VERIFIED);
+    g_completed_count++;
+    finish_time = now;
+    if (status == S2_TRANSMIT_COMPLETE_VERIFIED) {
+        g_verified_count++;
+    }
+
+    node_t peer = active_peer[0];
+    active_session_count--;
+    if (messages_left[peer] > 0) {
+        wait_for_session(peer);
+    }
+    start_waiting_destinations();
+}
+
+uint8_t S2_send_frame(struct S2 *ctxt, const s2_connection_t *peer, uint8_t *buf, uint16_t len)
+{
+    radio_transmit(ctxt, peer, buf, len, true);
+    return 1;
+}
+
+uint8_t S2_send_frame_no_cb(struct S2 *ctxt, const s2_connection_t *peer, uint8_t *buf, uint16_t len)
+{
+    radio_transmit(ctxt, peer, buf, len, false);
+    return 1;
+}
+
+uint8_t S2_send_frame_multi(struct S2 *ctxt, s2_connection_t *peer, uint8_t *buf, uint16_t len)
+{
+    return 1;
+}
+
+void S2_set_timeout(struct S2 *ctxt, uint32_t interval)
+{
+    S2_stop_timeout(ctxt);
+    schedule(now + interval, EVENT_TIMEOUT, ctxt, active_peer[context_index(ctxt)]);
+}
+
+void S2_stop_timeout(struct S2 *ctxt)
+{
+    cancel_timeout(ctxt, active_peer[context_index(ctxt)]);
+}
+
+void S2_get_hw_random(uint8_t *buf, uint8_t len)
+{
+    for (uint8_t i = 0; i < len; i++) {
+        buf[i] = i + 0x42;
+    }
+}
+
+void S2_get_commands_supported(node_t lnode, uint8_t class_id, const uint8_t **cmdClasses, uint8_t *length)
+{
+    static const uint8_t empty_list[] = {};
+    *cmdClasses                       = empty_list;
+    *length                           = 0;
+}
+
+void S2_notify_nls_state_report(node_t srcNode, uint8_t class_id, bool nls_capability, bool nls_state)
+{
+}
+
+int8_t S2_get_nls_node_list(node_t srcNode, bool request, bool *is_last_node, uint16_t *node_id, uint8_t *granted_keys, bool *nls_state)
+{
+    return -1;
+}
+
+int8_t S2_notify_nls_node_list_report(node_t srcNode, uint16_t id_of_node, uint8_t keys_node_bitmask, bool nls_state)
+{
+    return 0;
+}
+
+void S2_resynchronization_event(node_t remote_node, sos_event_reason_t reason, uint8_t seqno, node_t local_node)
+{
+}
+
+void S2_save_nls_state(void)
+{
+}
+
+uint32_t clock_time(void)
+{
+    return now;
+}
+
+/*******************************************************************************
+ * Test Helper Functions
+ ******************************************************************************/
+
+static void init_context(struct S2 *ctxt)
+{
+    static const uint8_t network_key[16] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10};
+
+    memset(ctxt, 0, sizeof(struct S2));
+    memcpy(ctxt->sg[0].enc_key, network_key, sizeof(ctxt->sg[0].enc_key));
+    memcpy(ctxt->sg[0].nonce_key, network_key, sizeof(network_key));
+    memcpy(ctxt->sg[0].nonce_key + sizeof(network_key), network_key, sizeof(network_key));
+    ctxt->loaded_keys = 0x01;  // Security class 0 loaded
+    ctxt->my_home_id  = HOME_ID;
+    ctxt->fsm         = IDLE;
+}
+
+static void reset_simulation(void)
+{
+    init_context(&controller);
+    init_context(&network);
+    memset(sessions, 0, sizeof(sessions));
+    memset(active_peer, 0, sizeof(active_peer));
+    memset(messages_left, 0, sizeof(messages_left));
+    memset(messages_received, 0, sizeof(messages_received));
+    event_count          = 0;
+    event_sequence       = 0;
+    now                  = 0;
+    finish_time          = 0;
+    channel_busy         = false;
+    memset(radio_queue_head, 0, sizeof(radio_queue_head));
+    memset(radio_queue_count, 0, sizeof(radio_queue_count));
+    waiting_head         = 0;
+    waiting_count        = 0;
+    active_session_count = 0;
+    g_frame_count        = 0;
+    g_completed_count    = 0;
+    g_verified_count     = 0;
+}
+
+/*******************************************************************************
+ * Test Setup and Teardown
+ ******************************************************************************/
+
+void setUp(void)
+{
+    S2_init_prng();
+    reset_simulation();
+}
+
+void tearDown(void)
+{
+}
+
+/*******************************************************************************
+ * Tests
+ ******************************************************************************/
+
+/**
+ * @brief A saved session leaves the context IDLE, and is restored as it was
+ */
+void test_s2_session_save_and_restore(void)
+{
+    static const uint8_t message[] = {0x20, 0x01, 0xFF};
+    s2_connection_t connection;
+    struct S2_session first;
+    struct S2_session second;
+
+    memset(&connection, 0, sizeof(s2_connection_t));
+    connection.l_node     = CONTROLLER_NODE_ID;
+    connection.r_node     = FIRST_PEER_NODE_ID;
+    connection.tx_options = S2_TXOPTION_VERIFY_DELIVERY;
+
+    // No SPAN with the peer: the context waits for a Nonce Report
+    TEST_ASSERT_EQUAL(1, S2_send_data(&controller, &connection, message, sizeof(message)));
+    TEST_ASSERT_EQUAL(WAIT_NONCE_RAPORT, controller.fsm);
+    TEST_ASSERT_EQUAL(0, S2_send_data(&controller, &connection, message, sizeof(message)));
+#ifdef ZW_CONTROLLER
+    // An NLS frame delayed until this transmission is done
+    controller.delayed_transmission_flags.send_nls_node_list_get    = 1;
+    controller.delayed_transmission_cache.get_nls_node_list.request = 1;
+#endif
+
+    S2_session_save(&controller, &first);
+    TEST_ASSERT_EQUAL(IDLE, controller.fsm);
+    TEST_ASSERT_EQUAL(WAIT_NONCE_RAPORT, first.fsm);
+    TEST_ASSERT_EQUAL(FIRST_PEER_NODE_ID, first.peer.r_node);
+    TEST_ASSERT_EQUAL_PTR(message, first.buf);
+    TEST_ASSERT_EQUAL(sizeof(message), first.length);
+#ifdef ZW_CONTROLLER
+    TEST_ASSERT_EQUAL(1, first.delayed_transmission_flags.send_nls_node_list_get);
+    TEST_ASSERT_EQUAL(0, controller.delayed_transmission_flags.send_nls_node_list_get);
+#endif
+
+    // Another peer can be sent to meanwhile
+    connection.r_node = FIRST_PEER_NODE_ID + 1;
+    TEST_ASSERT_EQUAL(1, S2_send_data(&controller, &connection, message, sizeof(message)));
+    S2_session_save(&controller, &second);
+    TEST_ASSERT_EQUAL(FIRST_PEER_NODE_ID + 1, second.peer.r_node);
+#ifdef ZW_CONTROLLER
+    TEST_ASSERT_EQUAL(0, second.delayed_transmission_flags.send_nls_node_list_get);
+#endif
+
+    S2_session_restore(&controller, &first);
+    TEST_ASSERT_EQUAL(WAIT_NONCE_RAPORT, controller.fsm);
+    TEST_ASSERT_EQUAL(FIRST_PEER_NODE_ID, controller.peer.r_node);
+    TEST_ASSERT_EQUAL(first.retry, controller.retry);
+#ifdef ZW_CONTROLLER
+    TEST_ASSERT_EQUAL(1, controller.delayed_transmission_flags.send_nls_node_list_get);
+    TEST_ASSERT_EQUAL(1, controller.delayed_transmission_cache.get_nls_node_list.request);
+#endif
+}
+
+/**
+ * @brief Secure frames/s with a single destination
+ *
+ * With one destination, there is nothing to run concurrently: both ways of
+ * running the sessions give the same throughput.
+ */
+void test_s2_session_throughput_1_destination(void)
+{
+    const double serialized = measure_throughput(1, false);
+    reset_simulation();
+    const double concurrent = measure_throughput(1, true);
+    TEST_ASSERT_TRUE(concurrent == serialized);
+}
+
+/**
+ * @brief Secure frames/s with 10 destinations
+ *
+ * While a destination prepares its reply, the radio serves the other sessions.
+ */
+void test_s2_session_throughput_10_destinations(void)
+{
+    const double serialized = measure_throughput(10, false);
+    reset_simulation();
+    const double concurrent = measure_throughput(10, true);
+    TEST_ASSERT_TRUE(concurrent > 2 * serialized);
+}
+
+/**
+ * @brief Secure frames/s with 100 destinations
+ *
+ * The radio is the bottleneck, concurrent sessions keep it busy.
+ */
+void test_s2_session_throughput_100_destinations(void)
+{
+    const double serialized = measure_throughput(100, false);
+    reset_simulation();
+    const double concurrent = measure_throughput(100, true);
+    TEST_ASSERT_TRUE(concurrent > 2 * serialized);
+}
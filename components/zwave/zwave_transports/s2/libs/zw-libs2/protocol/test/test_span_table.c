@@ -0,0 +1,375 @@
+/* © 2026 Silicon Laboratories Inc.
+ */
+/**
+ * @file test_span_table.c
+ * @brief Test suite for the SPAN table with many S2 peers
+ *
+ * Runs 1,000 simulated S2 peers through the REAL S2 implementation (S2.c).
+ * A controller context sends S2 encapsulated messages to every peer, and a
+ * second context plays the part of all the peers. Frames are exchanged
+ * through a simulated radio, so that every SPAN synchronization takes the
+ * Nonce Get / Nonce Report round trip it takes on a real network.
+ *
+ * The suite counts these resynchronizations and reports the CPU time spent
+ * per frame. It is built with SPAN_TABLE_SIZE set to 1024, see CMakeLists.txt.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include "unity.h"
+
+#include "S2.h"
+#include "s2_protocol.h"
+#include "S2_external.h"
+
+#define HOME_ID            0xCAFEBABE
+#define CONTROLLER_NODE_ID 1
+#define FIRST_PEER_NODE_ID 2
+#define PEER_COUNT         1000
+#define ROUND_COUNT        4
+
+// Context sending to the peers, and context playing all the peers
+static struct S2 controller;
+static struct S2 network;
+
+/*******************************************************************************
+ * Simulated radio
+ ******************************************************************************/
+
+typedef struct {
+        struct S2 *context;  // Context receiving the frame, or notified of the transmission
+        bool send_done;      // True for a transmission complete notification
+        s2_connection_t connection;
+        uint8_t frame[WORKBUF_SIZE];
+        uint16_t length;
+} radio_event_t;
+
+#define RADIO_QUEUE_SIZE 8
+static radio_event_t radio_queue[RADIO_QUEUE_SIZE];
+static uint8_t radio_queue_head;
+static uint8_t radio_queue_count;
+
+// Counters
+static uint32_t g_frame_count;        // Frames transmitted over the radio
+static uint32_t g_resync_count;       // Nonce Reports, one per SPAN synchronization
+static uint32_t g_delivered_count;    // Messages decrypted by the peers
+static node_t g_last_delivered_peer;  // Peer that decrypted the last message
+
+static radio_event_t *radio_push(struct S2 *context)
+{
+    TEST_ASSERT_TRUE(radio_queue_count < RADIO_QUEUE_SIZE);
+    radio_event_t *event = &radio_queue[(radio_queue_head + radio_queue_count) % RADIO_QUEUE_SIZE];
+    radio_queue_count++;
+    memset(event, 0, sizeof(radio_event_t));
+    event->context = context;
+    return event;
+}
+
+static void radio_transmit(struct S2 *ctxt, const s2_connection_t *peer, const uint8_t *buf, uint16_t len)
+{
+    TEST_ASSERT_TRUE(len <= WORKBUF_SIZE);
+    radio_event_t *event = radio_push((ctxt == &controller) ? &network : &controller);
+    // The receiver sees the connection from the other end
+    event->connection.l_node = peer->r_node;
+    event->connection.r_node = peer->l_node;
+    memcpy(event->frame, buf, len);
+    event->length = len;
+    g_frame_count++;
+    if (len >= 2 && buf[0] == COMMAND_CLASS_SECURITY_2 && buf[1] == SECURITY_2_NONCE_REPORT) {
+        g_resync_count++;
+    }
+}
+
+/**
+ * @brief Delivers frames and transmission notifications until the radio is idle
+ */
+static void radio_run(void)
+{
+    radio_event_t event;
+    while (radio_queue_count > 0) {
+        memcpy(&event, &radio_queue[radio_queue_head], sizeof(radio_event_t));
+        radio_queue_head = (radio_queue_head + 1) % RADIO_QUEUE_SIZE;
+        radio_queue_count--;
+        if (event.send_done) {
+            S2_send_frame_done_notify(event.context, S2_TRANSMIT_COMPLETE_OK, 0);
+        } else {
+            S2_application_command_handler(event.context, &event.connection, event.frame, event.length);
+        }
+    }
+}
+
+/*******************************************************************************
+ * External Function Stubs
+ ******************************************************************************/
+
+void S2_msg_received_event(struct S2 *ctxt, s2_connection_t *peer, uint8_t *buf, uint16_t len)
+{
+    if (ctxt == &network) {
+        g_delivered_count++;
+        g_last_delivered_peer = peer->l_node;
+    }
+}
+
+void S2_send_done_event(struct S2 *ctxt, s2_tx_status_t status)
+{
+    TEST_ASSERT_EQUAL(S2_TRANSMIT_COMPLETE_OK, status);
+}
+
+uint8_t S2_send_frame(struct S2 *ctxt, const s2_connection_t *peer, uint8_t *buf, uint16_t len)
+{
+    radio_transmit(ctxt, peer, buf, len);
+    radio_push(ctxt)->send_done = true;
+    return 1;
+}
+
+uint8_t S2_send_frame_no_cb(struct S2 *ctxt, const s2_connection_t *peer, uint8_t *buf, uint16_t len)
+{
+    radio_transmit(ctxt, peer, buf, len);
+    return 1;
+}
+
+uint8_t S2_send_frame_multi(struct S2 *ctxt, s2_connection_t *peer, uint8_t *buf, uint16_t len)
+{
+    return 1;
+}
+
+void S2_set_timeout(struct S2 *ctxt, uint32_t interval)
+{
+    // The simulated radio never loses frames
+}
+
+void S2_stop_timeout(struct S2 *ctxt)
+{
+}
+
+void S2_get_hw_random(uint8_t *buf, uint8_t len)
+{
+    for (uint8_t i = 0; i < len; i++) {
+        buf[i] = i + 0x42;
+    }
+}
+
+void S2_get_commands_supported(node_t lnode, uint8_t class_id, const uint8_t **cmdClasses, uint8_t *length)
+{
+    static const uint8_t empty_list[] = {};
+    *cmdClasses                       = empty_list;
+    *length                           = 0;
+}
+
+void S2_notify_nls_state_report(node_t srcNode, uint8_t class_id, bool nls_capability, bool nls_state)
+{
+}
+
+int8_t S2_get_nls_node_list(node_t srcNode, bool request, bool *is_last_node, uint16_t *node_id, uint8_t *granted_keys, bool *nls_state)
+{
+    return -1;
+}
+
+int8_t S2_notify_nls_node_list_report(node_t srcNode, uint16_t id_of_node, uint8_t keys_node_bitmask, bool nls_state)
+{
+    return 0;
+}
+
+void S2_resynchronization_event(node_t remote_node, sos_event_reason_t reason, uint8_t seqno, node_t local_node)
+{
+}
+
+void S2_save_nls_state(void)
+{
+}
+
+uint32_t clock_time(void)
+{
+    return 0;
+}
+
+/*******************************************************************************
+ * Test Helper Functions
+ ******************************************************************************/
+
+static void init_context(struct S2 *ctxt)
+{
+    static const uint8_t network_key[16] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10};
+
+    memset(ctxt, 0, sizeof(struct S2));
+    memcpy(ctxt->sg[0].enc_key, network_key, sizeof(ctxt->sg[0].enc_key));
+    memcpy(ctxt->sg[0].nonce_key, network_key, sizeof(network_key));
+    memcpy(ctxt->sg[0].nonce_key + sizeof(network_key), network_key, sizeof(network_key));
+    ctxt->loaded_keys = 0x01;  // Security class 0 loaded
+    ctxt->my_home_id  = HOME_ID;
+    ctxt->fsm         = IDLE;
+}
+
+/**
+ * @brief Sends a message from the controller to a peer and runs the radio until it is delivered
+ */
+static void send_to_peer(node_t peer)
+{
+    static const uint8_t message[] = {0x20, 0x01, 0xFF};  // Basic Set
+    s2_connection_t connection;
+
+    memset(&connection, 0, sizeof(s2_connection_t));
+    connection.l_node   = CONTROLLER_NODE_ID;
+    connection.r_node   = peer;
+    connection.class_id = 0;
+
+    const uint32_t delivered_count = g_delivered_count;
+    TEST_ASSERT_EQUAL(1, S2_send_data(&controller, &connection, message, sizeof(message)));
+    radio_run();
+    TEST_ASSERT_EQUAL(delivered_count + 1, g_delivered_count);
+    TEST_ASSERT_EQUAL(peer, g_last_delivered_peer);
+    TEST_ASSERT_EQUAL(IDLE, controller.fsm);
+}
+
+static double elapsed_us(clock_t start)
+{
+    return (double)(clock() - start) * 1e6 / CLOCKS_PER_SEC;
+}
+
+/*******************************************************************************
+ * Test Setup and Teardown
+ ******************************************************************************/
+
+void setUp(void)
+{
+    S2_init_prng();
+    init_context(&controller);
+    init_context(&network);
+    radio_queue_head      = 0;
+    radio_queue_count     = 0;
+    g_frame_count         = 0;
+    g_resync_count        = 0;
+    g_delivered_count     = 0;
+    g_last_delivered_peer = 0;
+}
+
+void tearDown(void)
+{
+}
+
+/*******************************************************************************
+ * Tests
+ ******************************************************************************/
+
+/**
+ * @brief Every peer is synchronized once, and keeps its SPAN afterwards
+ *
+ * The controller sends ROUND_COUNT messages to each of 1,000 peers, one peer
+ * after the other. Only the first message to a peer needs a Nonce Get / Nonce
+ * Report round trip: the SPAN tables hold all the peers, so no SPAN is
+ * replaced by the SPAN of another peer.
+ */
+void test_span_table_1000_peers_synchronize_once(void)
+{
+    clock_t start = clock();
+    for (node_t peer = FIRST_PEER_NODE_ID; peer < FIRST_PEER_NODE_ID + PEER_COUNT; peer++) {
+        send_to_peer(peer);
+    }
+    const double first_round_us     = elapsed_us(start);
+    const uint32_t first_round_frames = g_frame_count;
+    TEST_ASSERT_EQUAL(PEER_COUNT, g_resync_count);
+
+    start = clock();
+    for (int round = 1; round < ROUND_COUNT; round++) {
+        for (node_t peer = FIRST_PEER_NODE_ID; peer < FIRST_PEER_NODE_ID + PEER_COUNT; peer++) {
+            send_to_peer(peer);
+        }
+    }
+    const double next_rounds_us     = elapsed_us(start);
+    const uint32_t next_rounds_frames = g_frame_count - first_round_frames;
+
+    TEST_ASSERT_EQUAL(PEER_COUNT, g_resync_count);
+    TEST_ASSERT_EQUAL(PEER_COUNT * ROUND_COUNT, g_delivered_count);
+    // Once synchronized, a message is a single frame
+    TEST_ASSERT_EQUAL(PEER_COUNT * (ROUND_COUNT - 1), next_rounds_frames);
+
+    printf("%d peers: %u resynchronizations, %u frames for %u messages\n", PEER_COUNT, (unsigned)g_resync_count, (unsigned)g_frame_count, (unsigned)g_delivered_count);
+    printf("First round: %.2f us CPU per frame, next rounds: %.2f us CPU per frame\n", first_round_us / first_round_frames, next_rounds_us / next_rounds_frames);
+
+    // Cost of the table lookups alone, once all the peers have a SPAN
+    const int lookup_rounds = 100;
+    start                   = clock();
+    for (int round = 0; round < lookup_rounds; round++) {
+        for (node_t peer = FIRST_PEER_NODE_ID; peer < FIRST_PEER_NODE_ID + PEER_COUNT; peer++) {
+            TEST_ASSERT_NOT_NULL(S2_find_span(&controller, CONTROLLER_NODE_ID, peer));
+        }
+    }
+    printf("SPAN lookup: %.1f ns\n", elapsed_us(start) * 1000 / (lookup_rounds * PEER_COUNT));
+}
+
+/**
+ * @brief When a SPAN must be replaced, the least recently used one is
+ *
+ * Peers whose NodeIDs differ by SPAN_TABLE_SIZE are looked up from the same
+ * table entry, so S2_TABLE_PROBE_LENGTH + 1 of them do not fit in the table.
+ */
+void test_span_table_replaces_least_recently_used(void)
+{
+    const node_t first_peer = FIRST_PEER_NODE_ID;
+    node_t peers[S2_TABLE_PROBE_LENGTH + 1];
+    for (int i = 0; i <= S2_TABLE_PROBE_LENGTH; i++) {
+        peers[i] = first_peer + i * SPAN_TABLE_SIZE;
+    }
+
+    for (int i = 0; i < S2_TABLE_PROBE_LENGTH; i++) {
+        send_to_peer(peers[i]);
+    }
+    TEST_ASSERT_EQUAL(S2_TABLE_PROBE_LENGTH, g_resync_count);
+
+    // Use all of them again, except the first one
+    for (int i = 1; i < S2_TABLE_PROBE_LENGTH; i++) {
+        send_to_peer(peers[i]);
+    }
+    TEST_ASSERT_EQUAL(S2_TABLE_PROBE_LENGTH, g_resync_count);
+
+    // The new peer takes the SPAN entry of the first one
+    send_to_peer(peers[S2_TABLE_PROBE_LENGTH]);
+    TEST_ASSERT_EQUAL(S2_TABLE_PROBE_LENGTH + 1, g_resync_count);
+    TEST_ASSERT_NULL(S2_find_span(&controller, CONTROLLER_NODE_ID, peers[0]));
+
+    for (int i = 1; i <= S2_TABLE_PROBE_LENGTH; i++) {
+        send_to_peer(peers[i]);
+    }
+    TEST_ASSERT_EQUAL(S2_TABLE_PROBE_LENGTH + 1, g_resync_count);
+
+    // The first peer must be synchronized again
+    send_to_peer(peers[0]);
+    TEST_ASSERT_EQUAL(S2_TABLE_PROBE_LENGTH + 2, g_resync_count);
+}
+
+/**
+ * @brief SPANs of different local nodes are kept apart
+ */
+void test_span_table_find_and_allocate(void)
+{
+    TEST_ASSERT_NULL(S2_find_span(&controller, 1, 2));
+
+    struct SPAN *span = S2_allocate_span(&controller, 1, 2);
+    TEST_ASSERT_NOT_NULL(span);
+    TEST_ASSERT_EQUAL(SPAN_NOT_USED, span->state);
+    TEST_ASSERT_EQUAL(1, span->lnode);
+    TEST_ASSERT_EQUAL(2, span->rnode);
+    // Entries are found once in use only
+    TEST_ASSERT_NULL(S2_find_span(&controller, 1, 2));
+
+    span->state = SPAN_NEGOTIATED;
+    TEST_ASSERT_EQUAL_PTR(span, S2_find_span(&controller, 1, 2));
+    TEST_ASSERT_NULL(S2_find_span(&controller, 3, 2));
+    TEST_ASSERT_NULL(S2_find_span(&controller, 2, 1));
+
+    struct SPAN *other = S2_allocate_span(&controller, 3, 2);
+    other->state       = SPAN_NEGOTIATED;
+    TEST_ASSERT_TRUE(other != span);
+    TEST_ASSERT_EQUAL_PTR(other, S2_find_span(&controller, 3, 2));
+    TEST_ASSERT_EQUAL_PTR(span, S2_find_span(&controller, 1, 2));
+
+    struct MPAN *mpan = S2_allocate_mpan(&controller, 0, 7);
+    mpan->state       = MPAN_SET;
+    TEST_ASSERT_EQUAL_PTR(mpan, S2_find_mpan(&controller, 0, 7));
+    TEST_ASSERT_NULL(S2_find_mpan(&controller, 5, 7));
+    S2_free_mpan(&controller, 0, 7);
+    TEST_ASSERT_NULL(S2_find_mpan(&controller, 0, 7));
+}
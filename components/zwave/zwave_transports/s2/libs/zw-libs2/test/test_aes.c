@@ -0,0 +1,107 @@
+/* © 2024 Silicon Laboratories Inc.
+ */
+#include <string.h>
+#include <stdint.h>
+#include <unity.h>
+#include "aes.h"
+
+// NIST SP 800-38A, F.1.1 ECB-AES128
+static const uint8_t nist_key[16] = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c};
+
+static const uint8_t nist_plain[4][16] = {
+  {0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a},
+  {0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51},
+  {0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef},
+  {0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10},
+};
+
+static const uint8_t nist_cipher[4][16] = {
+  {0x3a, 0xd7, 0x7b, 0xb4, 0x0d, 0x7a, 0x36, 0x60, 0xa8, 0x9e, 0xca, 0xf3, 0x24, 0x66, 0xef, 0x97},
+  {0xf5, 0xd3, 0xd5, 0x85, 0x03, 0xb9, 0x69, 0x9d, 0xe7, 0x85, 0x89, 0x5a, 0x96, 0xfd, 0xba, 0xaf},
+  {0x43, 0xb1, 0xcd, 0x7f, 0x59, 0x8e, 0xce, 0x23, 0x88, 0x1b, 0x00, 0xe3, 0xed, 0x03, 0x06, 0x88},
+  {0x7b, 0x0c, 0x78, 0x5e, 0x27, 0xe8, 0xad, 0x3f, 0x82, 0x23, 0x20, 0x71, 0x04, 0x72, 0x5d, 0xd4},
+};
+
+// FIPS-197, Appendix C.1
+static const uint8_t fips_key[16]    = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+static const uint8_t fips_plain[16]  = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff};
+static const uint8_t fips_cipher[16] = {0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a};
+
+void setUp(void)
+{
+    AES128_key_cache_clear();
+}
+
+void tearDown(void) {}
+
+void test_ecb_encrypt_decrypt_nist_vectors(void)
+{
+    uint8_t buffer[16];
+    for (int i = 0; i < 4; i++) {
+        AES128_ECB_encrypt((uint8_t *)nist_plain[i], nist_key, buffer);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(nist_cipher[i], buffer, 16);
+        AES128_ECB_decrypt((uint8_t *)nist_cipher[i], nist_key, buffer);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(nist_plain[i], buffer, 16);
+    }
+}
+
+void test_ecb_encrypt_in_place(void)
+{
+    uint8_t buffer[16];
+    memcpy(buffer, fips_plain, sizeof(buffer));
+    AES128_ECB_encrypt(buffer, fips_key, buffer);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(fips_cipher, buffer, 16);
+}
+
+void test_ecb_key_cache_eviction(void)
+{
+    // Cycle through more keys than the cache holds, and make sure that keys
+    // that were evicted and keys still cached give the same results.
+    uint8_t keys[20][16];
+    uint8_t first_pass[20][16];
+    uint8_t buffer[16];
+    for (int i = 0; i < 20; i++) {
+        memcpy(keys[i], nist_key, 16);
+        keys[i][0] ^= (uint8_t)i;
+        AES128_ECB_encrypt((uint8_t *)fips_plain, keys[i], first_pass[i]);
+    }
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(nist_key, keys[0], 16);
+
+    for (int i = 19; i >= 0; i--) {
+        AES128_ECB_encrypt((uint8_t *)fips_plain, keys[i], buffer);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(first_pass[i], buffer, 16);
+    }
+
+    // Key 0 is the NIST key, it must still give the NIST results.
+    AES128_ECB_encrypt((uint8_t *)nist_plain[0], keys[0], buffer);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(nist_cipher[0], buffer, 16);
+}
+
+void test_ecb_same_key_buffer_new_content(void)
+{
+    // Callers such as the S0 transport reuse the same key buffer with a new
+    // key, the cache must not return the old schedule.
+    uint8_t key[16];
+    uint8_t buffer[16];
+    memcpy(key, nist_key, sizeof(key));
+    AES128_ECB_encrypt((uint8_t *)nist_plain[0], key, buffer);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(nist_cipher[0], buffer, 16);
+
+    memcpy(key, fips_key, sizeof(key));
+    AES128_ECB_encrypt((uint8_t *)fips_plain, key, buffer);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(fips_cipher, buffer, 16);
+}
+
+void test_ecb_key_cache_clear(void)
+{
+    uint8_t buffer[16];
+    AES128_ECB_encrypt((uint8_t *)nist_plain[0], nist_key, buffer);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(nist_cipher[0], buffer, 16);
+
+    // Keys are expanded again after the cache was wiped.
+    AES128_key_cache_clear();
+    AES128_ECB_encrypt((uint8_t *)nist_plain[1], nist_key, buffer);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(nist_cipher[1], buffer, 16);
+    AES128_ECB_decrypt((uint8_t *)nist_cipher[1], nist_key, buffer);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(nist_plain[1], buffer, 16);
+}
@@ -9,6 +9,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include "unity.h"
 #include <curve25519.h>
 
@@ -102,6 +103,94 @@ void test_bigint_calc(void)
     }
 }
 
+/* RFC 7748 section 5.2, first test vector */
+void test_rfc7748_vector_1(void)
+{
+    const uint8_t scalar[KEY_SIZE]   = {0xa5, 0x46, 0xe3, 0x6b, 0xf0, 0x52, 0x7c, 0x9d, 0x3b, 0x16, 0x15, 0x4b, 0x82, 0x46, 0x5e, 0xdd, 0x62, 0x14, 0x4c, 0x0a, 0xc1, 0xfc, 0x5a, 0x18, 0x50, 0x6a, 0x22, 0x44, 0xba, 0x44, 0x9a, 0xc4};
+    const uint8_t u[KEY_SIZE]        = {0xe6, 0xdb, 0x68, 0x67, 0x58, 0x30, 0x30, 0xdb, 0x35, 0x94, 0xc1, 0xa4, 0x24, 0xb1, 0x5f, 0x7c, 0x72, 0x66, 0x24, 0xec, 0x26, 0xb3, 0x35, 0x3b, 0x10, 0xa9, 0x03, 0xa6, 0xd0, 0xab, 0x1c, 0x4c};
+    const uint8_t expected[KEY_SIZE] = {0xc3, 0xda, 0x55, 0x37, 0x9d, 0xe9, 0xc6, 0x90, 0x8e, 0x94, 0xea, 0x4d, 0xf2, 0x8d, 0x08, 0x4f, 0x32, 0xec, 0xcf, 0x03, 0x49, 0x1c, 0x71, 0xf7, 0x54, 0xb4, 0x07, 0x55, 0x77, 0xa2, 0x85, 0x52};
+    uint8_t out[KEY_SIZE];
+
+    crypto_scalarmult_curve25519(out, scalar, u);
+
+    UNITY_TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, out, KEY_SIZE, __LINE__, "");
+}
+
+/* RFC 7748 section 5.2, second test vector. The u-coordinate has bit 255 set, which must be ignored. */
+void test_rfc7748_vector_2(void)
+{
+    const uint8_t scalar[KEY_SIZE]   = {0x4b, 0x66, 0xe9, 0xd4, 0xd1, 0xb4, 0x67, 0x3c, 0x5a, 0xd2, 0x26, 0x91, 0x95, 0x7d, 0x6a, 0xf5, 0xc1, 0x1b, 0x64, 0x21, 0xe0, 0xea, 0x01, 0xd4, 0x2c, 0xa4, 0x16, 0x9e, 0x79, 0x18, 0xba, 0x0d};
+    const uint8_t u[KEY_SIZE]        = {0xe5, 0x21, 0x0f, 0x12, 0x78, 0x68, 0x11, 0xd3, 0xf4, 0xb7, 0x95, 0x9d, 0x05, 0x38, 0xae, 0x2c, 0x31, 0xdb, 0xe7, 0x10, 0x6f, 0xc0, 0x3c, 0x3e, 0xfc, 0x4c, 0xd5, 0x49, 0xc7, 0x15, 0xa4, 0x93};
+    const uint8_t expected[KEY_SIZE] = {0x95, 0xcb, 0xde, 0x94, 0x76, 0xe8, 0x90, 0x7d, 0x7a, 0xad, 0xe4, 0x5c, 0xb4, 0xb8, 0x73, 0xf8, 0x8b, 0x59, 0x5a, 0x68, 0x79, 0x9f, 0xa1, 0x52, 0xe6, 0xf8, 0xf7, 0x64, 0x7a, 0xac, 0x79, 0x57};
+    uint8_t out[KEY_SIZE];
+
+    crypto_scalarmult_curve25519(out, scalar, u);
+
+    UNITY_TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, out, KEY_SIZE, __LINE__, "");
+}
+
+/* RFC 7748 section 5.2, iterated test: k and u start at 9 and each output becomes the next scalar */
+void test_rfc7748_iterated(void)
+{
+    const uint8_t expected_1[KEY_SIZE]    = {0x42, 0x2c, 0x8e, 0x7a, 0x62, 0x27, 0xd7, 0xbc, 0xa1, 0x35, 0x0b, 0x3e, 0x2b, 0xb7, 0x27, 0x9f, 0x78, 0x97, 0xb8, 0x7b, 0xb6, 0x85, 0x4b, 0x78, 0x3c, 0x60, 0xe8, 0x03, 0x11, 0xae, 0x30, 0x79};
+    const uint8_t expected_1000[KEY_SIZE] = {0x68, 0x4c, 0xf5, 0x9b, 0xa8, 0x33, 0x09, 0x55, 0x28, 0x00, 0xef, 0x56, 0x6f, 0x2f, 0x4d, 0x3c, 0x1c, 0x38, 0x87, 0xc4, 0x93, 0x60, 0xe3, 0x87, 0x5f, 0x2e, 0xb9, 0x4d, 0x99, 0x53, 0x2c, 0x51};
+    uint8_t k[KEY_SIZE]                   = {9};
+    uint8_t u[KEY_SIZE]                   = {9};
+    uint8_t out[KEY_SIZE];
+    uint16_t i;
+
+    for (i = 1; i <= 1000; i++) {
+        crypto_scalarmult_curve25519(out, k, u);
+        memcpy(u, k, KEY_SIZE);
+        memcpy(k, out, KEY_SIZE);
+        if (i == 1) {
+            UNITY_TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_1, k, KEY_SIZE, __LINE__, "");
+        }
+    }
+    UNITY_TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_1000, k, KEY_SIZE, __LINE__, "");
+}
+
+/* RFC 7748 section 6.1 */
+void test_rfc7748_diffie_hellman(void)
+{
+    const uint8_t bob_secret[KEY_SIZE]            = {0x5d, 0xab, 0x08, 0x7e, 0x62, 0x4a, 0x8a, 0x4b, 0x79, 0xe1, 0x7f, 0x8b, 0x83, 0x80, 0x0e, 0xe6, 0x6f, 0x3b, 0xb1, 0x29, 0x26, 0x18, 0xb6, 0xfd, 0x1c, 0x2f, 0x8b, 0x27, 0xff, 0x88, 0xe0, 0xeb};
+    const uint8_t expected_alice_public[KEY_SIZE] = {0x85, 0x20, 0xf0, 0x09, 0x89, 0x30, 0xa7, 0x54, 0x74, 0x8b, 0x7d, 0xdc, 0xb4, 0x3e, 0xf7, 0x5a, 0x0d, 0xbf, 0x3a, 0x0d, 0x26, 0x38, 0x1a, 0xf4, 0xeb, 0xa4, 0xa9, 0x8e, 0xaa, 0x9b, 0x4e, 0x6a};
+    const uint8_t expected_bob_public[KEY_SIZE]   = {0xde, 0x9e, 0xdb, 0x7d, 0x7b, 0x7d, 0xc1, 0xb4, 0xd3, 0x5b, 0x61, 0xc2, 0xec, 0xe4, 0x35, 0x37, 0x3f, 0x83, 0x43, 0xc8, 0x5b, 0x78, 0x67, 0x4d, 0xad, 0xfc, 0x7e, 0x14, 0x6f, 0x88, 0x2b, 0x4f};
+    const uint8_t expected_shared[KEY_SIZE]       = {0x4a, 0x5d, 0x9d, 0x5b, 0xa4, 0xce, 0x2d, 0xe1, 0x72, 0x8e, 0x3b, 0xf4, 0x80, 0x35, 0x0f, 0x25, 0xe0, 0x7e, 0x21, 0xc9, 0x47, 0xd1, 0x9e, 0x33, 0x76, 0xf0, 0x9b, 0x3c, 0x1e, 0x16, 0x17, 0x42};
+    uint8_t alice_public[KEY_SIZE];
+    uint8_t bob_public[KEY_SIZE];
+    uint8_t shared[KEY_SIZE];
+
+    crypto_scalarmult_curve25519_base(alice_public, alice_secret_key);
+    UNITY_TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_alice_public, alice_public, KEY_SIZE, __LINE__, "");
+    crypto_scalarmult_curve25519_base(bob_public, bob_secret);
+    UNITY_TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_bob_public, bob_public, KEY_SIZE, __LINE__, "");
+
+    crypto_scalarmult_curve25519(shared, alice_secret_key, bob_public);
+    UNITY_TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_shared, shared, KEY_SIZE, __LINE__, "");
+    crypto_scalarmult_curve25519(shared, bob_secret, alice_public);
+    UNITY_TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_shared, shared, KEY_SIZE, __LINE__, "");
+}
+
+/* Prints how many public keys per second the host can generate. Each key feeds the next one. */
+void test_keygen_benchmark(void)
+{
+    uint8_t key[KEY_SIZE];
+    clock_t start;
+    double seconds;
+    uint16_t count = 0;
+
+    memcpy(key, alice_secret_key, KEY_SIZE);
+    start = clock();
+    do {
+        crypto_scalarmult_curve25519_base(key, key);
+        count++;
+        seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    } while (seconds < 0.5 && count < 10000);
+
+    printf("curve25519: %u key generations in %.3f s, %.0f per second\n", count, seconds, count / seconds);
+}
+
 #ifdef NOT_USED
 
 // void test_bob_calculation_of_public_key(void)
@@ -35,9 +35,12 @@ extern struct S2 *s2_ctx;
 void zwave_s2_transport_lock(void);
 void zwave_s2_transport_unlock(void);
 
-/** True when an application S2 send session is active (for TX queue scheduling). */
+/** True when any application S2 send session is active (for TX queue scheduling). */
 bool zwave_s2_transport_is_busy(void);
 
+/** Drop all S2 transport sessions, failing their pending send callbacks. */
+void zwave_s2_transport_abort_sessions(void);
+
 /** Mark S2 inclusion bootstrap active (set on start, clear on terminal events). */
 void zwave_s2_transport_set_inclusion_in_progress(bool active);
 
@@ -48,8 +51,8 @@ void zwave_s2_transport_set_inclusion_in_progress(bool active);
  * @brief Sending an S2 encapsulated frame.
  *
  * This function will encrypt a data payload and encapsupate it into an
- * Security 2 message. This function wraps S2_send_data. This function can
- * only handle one transmit session at a time.
+ * Security 2 message. This function wraps S2_send_data. This function
+ * handles one transmit session per NodeID or multicast group at a time.
  *
  * @param connection        Contains information about target node.
  * @param data_length       Length of un-encrypted data.
@@ -62,7 +65,7 @@ void zwave_s2_transport_set_inclusion_in_progress(bool active);
  * @return sl_status_t
  *   - SL_STATUS_OK             on success
  *   - SL_STATUS_NOT_SUPPORTED  if unknown encapuslation scheme is applied.
- *   - SL_STATUS_BUSY           if a tranmission is ongoing.
+ *   - SL_STATUS_BUSY           if a tranmission to the destination is ongoing.
  *   - SL_STATUS_WOULD_OVERFLOW if we cannot handle the frame and it should just be dropped.
  */
 sl_status_t zwave_s2_send_data(const zwave_controller_connection_info_t *connection, uint16_t data_length, const uint8_t *cmd_data, const zwave_tx_options_t *tx_options, const on_zwave_tx_send_data_complete_t on_send_complete, void *user, zwave_tx_session_id_t parent_session_id);
@@ -96,6 +99,8 @@ void zwave_s2_on_on_multicast_group_deleted(zwave_multicast_group_id_t group_id)
  *
  * @return SL_STATUS_OK to indicate that ongoing session are aborted.
  * @return SL_STATUS_NOT_FOUND to indicate that no transmission was ongoing.
+ * @return SL_STATUS_BUSY to indicate that a transmission is ongoing but
+ *         cannot be aborted while S2 runs another session.
  */
 sl_status_t zwave_s2_abort_send_data(zwave_tx_session_id_t session_id);
 
@@ -115,6 +115,7 @@ void zwave_s2_network_init()
     sl_log_debug(LOG_TAG, "Initializing S2 engine for the current network");
 
     if (s2_ctx) {
+        zwave_s2_transport_abort_sessions();
         S2_destroy(s2_ctx);
     }
 
@@ -73,92 +73,70 @@ static void zwave_s2_configure_mpan_table_entry(struct MPAN *entry, const mpan_e
 ///////////////////////////////////////////////////////////////////////////////
 sl_status_t zwave_s2_get_span_data(zwave_node_id_t node_id, span_entry_t *span_data)
 {
-    for (size_t i = 0; i < SPAN_TABLE_SIZE; i++) {
-        if (s2_ctx->span_table[i].state == SPAN_NEGOTIATED && s2_ctx->span_table[i].rnode == node_id) {
-            span_data->df = s2_ctx->span_table[i].d.rng.df;
-            memcpy(span_data->key, s2_ctx->span_table[i].d.rng.k, CTR_DRBG_KEY_LENGTH);
-            memcpy(span_data->working_state, s2_ctx->span_table[i].d.rng.v, CTR_DRBG_INTERNAL_STATE_LENGTH);
-            span_data->rx_sequence = s2_ctx->span_table[i].rx_seq;
-            span_data->tx_sequence = s2_ctx->span_table[i].tx_seq;
-            span_data->class_id    = s2_ctx->span_table[i].class_id;
-            return SL_STATUS_OK;
-        }
+    const struct SPAN *span = S2_find_span(s2_ctx, zwave_network_management_get_node_id(), node_id);
+    if (span == NULL || span->state != SPAN_NEGOTIATED) {
+        return SL_STATUS_NOT_FOUND;
     }
-    return SL_STATUS_NOT_FOUND;
+    span_data->df = span->d.rng.df;
+    memcpy(span_data->key, span->d.rng.k, CTR_DRBG_KEY_LENGTH);
+    memcpy(span_data->working_state, span->d.rng.v, CTR_DRBG_INTERNAL_STATE_LENGTH);
+    span_data->rx_sequence = span->rx_seq;
+    span_data->tx_sequence = span->tx_seq;
+    span_data->class_id    = span->class_id;
+    return SL_STATUS_OK;
 }
 
 void zwave_s2_reset_span(zwave_node_id_t node_id)
 {
-    for (size_t i = 0; i < SPAN_TABLE_SIZE; i++) {
-        if (s2_ctx->span_table[i].rnode == node_id) {
-            s2_ctx->span_table[i].state = SPAN_NOT_USED;
-            sl_log_debug(LOG_TAG, "Success with reset of SPAN with NodeID: %d\n", node_id);
-            return;
-        }
+    struct SPAN *span = S2_find_span(s2_ctx, zwave_network_management_get_node_id(), node_id);
+    if (span != NULL) {
+        span->state = SPAN_NOT_USED;
+        sl_log_debug(LOG_TAG, "Success with reset of SPAN with NodeID: %d\n", node_id);
     }
 }
 
 void zwave_s2_reset_mpan(zwave_node_id_t owner_node_id, zwave_multicast_group_id_t group_id)
 {
-    for (size_t i = 0; i < MPAN_TABLE_SIZE; i++) {
-        if (s2_ctx->mpan_table[i].owner_id == owner_node_id && s2_ctx->mpan_table[i].group_id == group_id) {
-            s2_ctx->mpan_table[i].state = MPAN_NOT_USED;
-            sl_log_debug(LOG_TAG, "Success with reset of MPAN with NodeID: %d and GroupID: %d\n", owner_node_id, group_id);
-            return;
-        }
+    struct MPAN *mpan = S2_find_mpan(s2_ctx, owner_node_id, group_id);
+    if (mpan != NULL) {
+        mpan->state = MPAN_NOT_USED;
+        sl_log_debug(LOG_TAG, "Success with reset of MPAN with NodeID: %d and GroupID: %d\n", owner_node_id, group_id);
     }
 }
 
 void zwave_s2_set_span_table(zwave_node_id_t node_id, const span_entry_t *span_data)
 {
-    for (size_t i = 0; i < SPAN_TABLE_SIZE; i++) {
-        if (s2_ctx->span_table[i].rnode == node_id) {
-            zwave_s2_configure_span_table_entry(&s2_ctx->span_table[i], span_data, node_id);
-            return;
-        }
+    const zwave_node_id_t my_node_id = zwave_network_management_get_node_id();
+    struct SPAN *span                = S2_find_span(s2_ctx, my_node_id, node_id);
+    // If we did not find an entry with the NodeID we are looking for,
+    // allocate one. It may replace the least recently used SPAN.
+    if (span == NULL) {
+        span = S2_allocate_span(s2_ctx, my_node_id, node_id);
     }
-    // If we did not find an entry with the NodeID we are looking,
-    // use an empty slot
-    for (size_t i = 0; i < SPAN_TABLE_SIZE; i++) {
-        if (s2_ctx->span_table[i].state == SPAN_NOT_USED) {
-            zwave_s2_configure_span_table_entry(&s2_ctx->span_table[i], span_data, node_id);
-            return;
-        }
-    }
-
-    // If we get here, we cannot accept more resources.
+    zwave_s2_configure_span_table_entry(span, span_data, node_id);
 }
 
 sl_status_t zwave_s2_get_mpan_data(zwave_node_id_t owner_node_id, zwave_multicast_group_id_t group_id, mpan_entry_t *mpan_data)
 {
-    for (size_t i = 0; i < MPAN_TABLE_SIZE; i++) {
-        if ((s2_ctx->mpan_table[i].state == MPAN_SET) && (s2_ctx->mpan_table[i].group_id == group_id) && (s2_ctx->mpan_table[i].owner_id == owner_node_id)) {
-            mpan_data->class_id      = s2_ctx->mpan_table[i].class_id;
-            mpan_data->group_id      = s2_ctx->mpan_table[i].group_id;
-            mpan_data->owner_node_id = s2_ctx->mpan_table[i].owner_id;
-
-            memcpy(mpan_data->inner_state, s2_ctx->mpan_table[i].inner_state, MPAN_INNER_STATE_LENGTH);
-            return SL_STATUS_OK;
-        }
+    const struct MPAN *mpan = S2_find_mpan(s2_ctx, owner_node_id, group_id);
+    if (mpan == NULL || mpan->state != MPAN_SET) {
+        return SL_STATUS_NOT_FOUND;
     }
-    return SL_STATUS_NOT_FOUND;
+    mpan_data->class_id      = mpan->class_id;
+    mpan_data->group_id      = mpan->group_id;
+    mpan_data->owner_node_id = mpan->owner_id;
+
+    memcpy(mpan_data->inner_state, mpan->inner_state, MPAN_INNER_STATE_LENGTH);
+    return SL_STATUS_OK;
 }
 
 void zwave_s2_set_mpan_data(zwave_node_id_t owner_node_id, zwave_multicast_group_id_t group_id, const mpan_entry_t *mpan_data)
 {
-    for (size_t i = 0; i < MPAN_TABLE_SIZE; i++) {
-        if ((s2_ctx->mpan_table[i].group_id == group_id) && (s2_ctx->mpan_table[i].owner_id == owner_node_id)) {
-            zwave_s2_configure_mpan_table_entry(&s2_ctx->mpan_table[i], mpan_data, owner_node_id);
-            return;
-        }
-    }
+    struct MPAN *mpan = S2_find_mpan(s2_ctx, owner_node_id, group_id);
     // If we did not find an entry with the GroupID/Owner ID that we are looking for,
-    // use an empty slot
-    for (size_t i = 0; i < MPAN_TABLE_SIZE; i++) {
-        if (s2_ctx->mpan_table[i].state == MPAN_NOT_USED) {
-            zwave_s2_configure_mpan_table_entry(&s2_ctx->mpan_table[i], mpan_data, owner_node_id);
-            return;
-        }
+    // allocate one. It may replace the least recently used MPAN.
+    if (mpan == NULL) {
+        mpan = S2_allocate_mpan(s2_ctx, owner_node_id, group_id);
     }
-    // If we get here, we cannot accept more resources.
+    zwave_s2_configure_mpan_table_entry(mpan, mpan_data, owner_node_id);
 }
@@ -22,7 +22,6 @@
 
 #define LOG_TAG "zwave_s2_process"
 
-static struct timer_handle_t s2_timer;
 static struct timer_handle_t s2_inclusion_timer;
 
 static void s2_inclusion_timer_callback(void *ptr)
@@ -33,14 +32,6 @@ static void s2_inclusion_timer_callback(void *ptr)
     zwave_s2_transport_unlock();
 }
 
-static void s2_timer_callback(void *ptr)
-{
-    sl_log_debug(LOG_TAG, "S2 send data timer has now expired\n");
-    zwave_s2_transport_lock();
-    S2_timeout_notify(s2_ctx);
-    zwave_s2_transport_unlock();
-}
-
 uint8_t s2_inclusion_set_timeout(struct S2 *ctxt, uint32_t timeout)
 {
     (void)ctxt;
@@ -54,19 +45,6 @@ void s2_inclusion_stop_timeout(void)
     timer_stop(&s2_inclusion_timer);
 }
 
-void S2_stop_timeout(struct S2 *ctxt)
-{
-    (void)ctxt;
-    timer_stop(&s2_timer);
-}
-
-void S2_set_timeout(struct S2 *ctxt, uint32_t interval)
-{
-    (void)ctxt;
-    sl_log_debug(LOG_TAG, "Setting S2 Send Data timeout to: %i ms\n", interval);
-    timer_set(&s2_timer, interval, s2_timer_callback, NULL);
-}
-
 static void zwave_s2_on_network_address_update(zwave_home_id_t home_id, zwave_node_id_t node_id)
 {
     (void)node_id;
@@ -109,7 +87,6 @@ static void zwave_s2_init()
 
 void zwave_s2_process_init(void)
 {
-    timer_stop(&s2_timer);
     timer_stop(&s2_inclusion_timer);
     zwave_s2_init();
 }
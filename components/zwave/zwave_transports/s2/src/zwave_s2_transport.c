@@ -39,6 +39,7 @@
 #include "zwave_tx_groups.h"
 #include "zwave_utils.h"
 #include "clock_platform.h"
+#include "timer.hpp"
 
 #include "log.h"
 #define LOG_TAG "zwave_s2_transport"
@@ -60,12 +61,30 @@
 // Number of nodes per byte in NLS state node mask
 #define NLS_ENABLED_NODES_PER_BYTE 8
 
+// Number of S2 transmissions in progress at the same time, each with its own
+// NodeID or multicast group.
+#define S2_TRANSPORT_SESSION_COUNT 16
+
 struct S2 *s2_ctx;
 
 typedef enum { SINGLECAST, MULTICAST } zwave_s2_current_transmission_type_t;
 
-// Session data for send data call
+// Session data for send data call, one per remote NodeID or multicast group.
+// LibS2 keeps the SPANs, MPANs and keys of all sessions in s2_ctx, and the
+// state of its state machine in s2_session while the session is not running.
 typedef struct s2_transport_session_state {
+        // First member, so that the session is also the user pointer of the
+        // protocol frames sent by S2_send_frame.
+        protocol_metadata_t protocol_metadata;
+        bool in_use;
+        zwave_node_id_t remote_node_id;  // NodeID, or Group ID for multicast
+        bool is_multicast;
+        struct S2_session s2_session;
+        struct timer_handle_t timer;
+        // Frames given to zwave_tx with send_frame_callback and not completed yet
+        uint8_t frames_in_flight;
+        // Multicast or singlecast follow-up, which use an MPAN
+        bool uses_mpan;
         on_zwave_tx_send_data_complete_t s2_send_callback;
         void *s2_send_user;
         /* Holds the TX_STATUS_TYPE of ZW_SendDataXX() callback for the most recent S2 frame */
@@ -76,13 +95,14 @@ typedef struct s2_transport_session_state {
         bool valid_parent_session_id;
         uint8_t last_frame_data[ZWAVE_MAX_FRAME_SIZE];
         uint16_t last_frame_data_length;
-        protocol_metadata_t protocol_metadata;
         zwave_tx_options_t tx_options;
-        bool inclusion_in_progress;
 } s2_transport_session_state_t;
 
 // Z-Wave TX settings
-static s2_transport_session_state_t state = {};
+static s2_transport_session_state_t sessions[S2_TRANSPORT_SESSION_COUNT] = {};
+// Session restored in s2_ctx, NULL if none
+static s2_transport_session_state_t *active_session = NULL;
+static bool inclusion_in_progress                   = false;
 
 // Secure NIF contents
 static uint8_t secure_nif[ZWAVE_MAX_FRAME_SIZE];
@@ -101,6 +121,10 @@ static s2_node_nls_context_t node_nls_context = {0};
 
 static pthread_mutex_t s2_transport_mutex;
 static pthread_once_t s2_transport_mutex_once = PTHREAD_ONCE_INIT;
+// Nesting depth of zwave_s2_transport_lock, protected by the mutex
+static int s2_transport_lock_depth = 0;
+
+static void session_suspend(void);
 
 static void s2_transport_mutex_init_once(void)
 {
@@ -115,22 +139,218 @@ void zwave_s2_transport_lock(void)
 {
     pthread_once(&s2_transport_mutex_once, s2_transport_mutex_init_once);
     pthread_mutex_lock(&s2_transport_mutex);
+    s2_transport_lock_depth++;
 }
 
 void zwave_s2_transport_unlock(void)
 {
+    // Leaving the outermost lock, s2_ctx goes back to IDLE so that the next
+    // caller can restore the session of its own peer.
+    if (s2_transport_lock_depth == 1) {
+        session_suspend();
+    }
+    s2_transport_lock_depth--;
     pthread_mutex_unlock(&s2_transport_mutex);
 }
 
+/******************************* Sessions *************************************/
+
+static s2_transport_session_state_t *session_find(zwave_node_id_t remote_node_id, bool is_multicast)
+{
+    for (size_t i = 0; i < S2_TRANSPORT_SESSION_COUNT; i++) {
+        if (sessions[i].in_use && (sessions[i].remote_node_id == remote_node_id) && (sessions[i].is_multicast == is_multicast)) {
+            return &sessions[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Finds the session of a NodeID or multicast group, allocating it if needed.
+ *
+ * @returns the session, or NULL if all sessions are in use.
+ */
+static s2_transport_session_state_t *session_get(zwave_node_id_t remote_node_id, bool is_multicast)
+{
+    s2_transport_session_state_t *session = session_find(remote_node_id, is_multicast);
+    if (session != NULL) {
+        return session;
+    }
+    for (size_t i = 0; i < S2_TRANSPORT_SESSION_COUNT; i++) {
+        if (!sessions[i].in_use) {
+            session = &sessions[i];
+            memset(session, 0, sizeof(s2_transport_session_state_t));
+            session->in_use         = true;
+            session->remote_node_id = remote_node_id;
+            session->is_multicast   = is_multicast;
+            // Start from the state an IDLE s2_ctx is left in
+            if ((active_session == NULL) && (s2_ctx != NULL) && (s2_ctx->fsm == IDLE)) {
+                S2_session_save(s2_ctx, &session->s2_session);
+            }
+            return session;
+        }
+    }
+    sl_log_warning(LOG_TAG, "All %d S2 sessions are in use, cannot start a session with NodeID/GroupID %d", S2_TRANSPORT_SESSION_COUNT, remote_node_id);
+    return NULL;
+}
+
+static void session_free(s2_transport_session_state_t *session)
+{
+    timer_stop(&session->timer);
+    session->in_use = false;
+}
+
+/**
+ * @brief Restores the state machine of a session in s2_ctx.
+ *
+ * @returns false if s2_ctx is busy with another session, which happens when
+ *          called back from libS2.
+ */
+static bool session_resume(s2_transport_session_state_t *session)
+{
+    if (active_session == session) {
+        return true;
+    }
+    if ((s2_ctx == NULL) || (active_session != NULL) || (s2_ctx->fsm != IDLE)) {
+        return false;
+    }
+    S2_session_restore(s2_ctx, &session->s2_session);
+    active_session = session;
+    return true;
+}
+
+/**
+ * @brief Returns the session running in s2_ctx.
+ *
+ * LibS2 also sends frames on its own, e.g. during inclusion. These run in the
+ * session of the peer they are sent to.
+ */
+static s2_transport_session_state_t *session_current(void)
+{
+    if ((active_session == NULL) && (s2_ctx != NULL)) {
+        s2_transport_session_state_t *session = session_get(s2_ctx->peer.r_node, false);
+        if ((session != NULL) && (session->s2_session.fsm != IDLE)) {
+            sl_log_error(LOG_TAG, "LibS2 transmission to NodeID %d while a session with it is suspended", s2_ctx->peer.r_node);
+            return NULL;
+        }
+        active_session = session;
+    }
+    return active_session;
+}
+
+/**
+ * @brief Saves the state machine running in s2_ctx in its session, and frees
+ * the session if it has nothing left to do.
+ */
+static void session_suspend(void)
+{
+    if (s2_ctx == NULL) {
+        return;
+    }
+    s2_transport_session_state_t *session = active_session;
+    if ((session == NULL) && (s2_ctx->fsm != IDLE)) {
+        session = session_current();
+    }
+    if (session == NULL) {
+        if (s2_ctx->fsm != IDLE) {
+            struct S2_session dropped;
+            S2_session_save(s2_ctx, &dropped);
+            sl_log_error(LOG_TAG, "No S2 session available for the transmission to NodeID %d. Dropping it.", dropped.peer.r_node);
+        }
+        return;
+    }
+    S2_session_save(s2_ctx, &session->s2_session);
+    active_session = NULL;
+    if ((session->s2_session.fsm == IDLE) && (session->s2_send_callback == NULL) && (session->frames_in_flight == 0)) {
+        session_free(session);
+    }
+}
+
+static void session_timer_callback(void *ptr)
+{
+    s2_transport_session_state_t *session = (s2_transport_session_state_t *)ptr;
+    sl_log_debug(LOG_TAG, "S2 send data timer has now expired\n");
+    zwave_s2_transport_lock();
+    if (session->in_use && session_resume(session)) {
+        S2_timeout_notify(s2_ctx);
+    }
+    zwave_s2_transport_unlock();
+}
+
+void S2_set_timeout(struct S2 *ctxt, uint32_t interval)
+{
+    (void)ctxt;
+    s2_transport_session_state_t *session = session_current();
+    if (session == NULL) {
+        return;
+    }
+    sl_log_debug(LOG_TAG, "Setting S2 Send Data timeout to: %i ms\n", interval);
+    timer_set(&session->timer, interval, session_timer_callback, session);
+}
+
+void S2_stop_timeout(struct S2 *ctxt)
+{
+    (void)ctxt;
+    s2_transport_session_state_t *session = session_current();
+    if (session != NULL) {
+        timer_stop(&session->timer);
+    }
+}
+
+/**
+ * @brief Tells if another session uses an MPAN.
+ *
+ * The MPAN of a group moves on with each multicast frame and with the first
+ * singlecast follow-up, so group transmissions keep their order.
+ */
+static bool session_group_send_in_progress(const s2_transport_session_state_t *except)
+{
+    for (size_t i = 0; i < S2_TRANSPORT_SESSION_COUNT; i++) {
+        if ((&sessions[i] != except) && sessions[i].in_use && sessions[i].uses_mpan && (sessions[i].s2_send_callback != NULL)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void zwave_s2_transport_abort_sessions(void)
+{
+    zwave_s2_transport_lock();
+    for (size_t i = 0; i < S2_TRANSPORT_SESSION_COUNT; i++) {
+        s2_transport_session_state_t *session = &sessions[i];
+        if (!session->in_use) {
+            continue;
+        }
+        on_zwave_tx_send_data_complete_t cb_save   = session->s2_send_callback;
+        void *user_save                            = session->s2_send_user;
+        zwapi_tx_report_t tx_status_for_completion = session->s2_send_tx_status;
+        if (active_session == session) {
+            struct S2_session dropped;
+            S2_session_save(s2_ctx, &dropped);
+            active_session = NULL;
+        }
+        session_free(session);
+        if (cb_save) {
+            cb_save(TRANSMIT_COMPLETE_FAIL, &tx_status_for_completion, user_save);
+        }
+    }
+    zwave_s2_transport_unlock();
+}
+
 bool zwave_s2_transport_is_busy(void)
 {
     bool busy = false;
 
     zwave_s2_transport_lock();
-    // Active application S2 send session only. Do not use S2_is_busy() here:
+    // Active application S2 send sessions only. Do not use S2_is_busy() here:
     // inclusion bootstrap also sets that, which blocks TX backoff preemption and
     // strands inclusion egress frames until their discard timer expires.
-    busy = (state.s2_send_callback != NULL);
+    for (size_t i = 0; i < S2_TRANSPORT_SESSION_COUNT; i++) {
+        if (sessions[i].in_use && (sessions[i].s2_send_callback != NULL)) {
+            busy = true;
+            break;
+        }
+    }
     zwave_s2_transport_unlock();
     return busy;
 }
@@ -138,19 +358,32 @@ bool zwave_s2_transport_is_busy(void)
 void zwave_s2_transport_set_inclusion_in_progress(bool active)
 {
     zwave_s2_transport_lock();
-    state.inclusion_in_progress = active;
+    inclusion_in_progress = active;
     zwave_s2_transport_unlock();
 }
 
-static bool s2_application_send_is_blocked(const zwave_tx_options_t *tx_options)
+/**
+ * @brief Tells if an application frame must wait for the session to be free.
+ *
+ * To be called with the session restored in s2_ctx.
+ */
+static bool s2_application_send_is_blocked(const s2_transport_session_state_t *session, const zwave_controller_connection_info_t *connection, const zwave_tx_options_t *tx_options)
 {
+    // The state machine of the peer is busy, whatever the frame.
+    if (S2_is_send_data_busy(s2_ctx) != 0) {
+        return true;
+    }
     if (tx_options->transport.is_protocol_frame) {
         return false;
     }
-    if (state.s2_send_callback != NULL) {
+    if (session->s2_send_callback != NULL) {
+        return true;
+    }
+    // S2 inclusion bootstrapping is done one node at a time, on its own.
+    if (S2_is_busy(s2_ctx) != 0) {
         return true;
     }
-    if (s2_ctx != NULL && S2_is_busy(s2_ctx) != 0) {
+    if ((connection->remote.is_multicast || (tx_options->transport.group_id != ZWAVE_TX_INVALID_GROUP)) && session_group_send_in_progress(session)) {
         return true;
     }
     return false;
@@ -158,7 +391,7 @@ static bool s2_application_send_is_blocked(const zwave_tx_options_t *tx_options)
 
 static bool s2_is_inclusion_bootstrap_egress(void)
 {
-    return state.inclusion_in_progress;
+    return inclusion_in_progress;
 }
 
 static uint8_t encapsulation_to_class(zwave_controller_encapsulation_scheme_t encap)
@@ -242,14 +475,26 @@ static zwave_s2_keyset_t get_s2_keyset_from_group(zwave_multicast_group_id_t gro
 
 static void send_frame_callback(uint8_t status, const zwapi_tx_report_t *tx_info, void *user)
 {
-    (void)user;
+    s2_transport_session_state_t *session = (s2_transport_session_state_t *)user;
+    uint16_t tx_time                      = NONCE_REP_TIME;
+
     zwave_s2_transport_lock();
-    if (tx_info) {
-        state.s2_send_tx_status = *tx_info;
-    }
-    uint16_t tx_time = (uint16_t)(clock_time() - state.transmit_start_time);
-    if (state.current_transmission_type == SINGLECAST) {
-        tx_time += NONCE_REP_TIME;
+    if (session != NULL) {
+        if (!session->in_use || !session_resume(session)) {
+            sl_log_warning(LOG_TAG, "Dropping S2 frame transmission status for a session that is not running");
+            zwave_s2_transport_unlock();
+            return;
+        }
+        if (session->frames_in_flight > 0) {
+            session->frames_in_flight--;
+        }
+        if (tx_info) {
+            session->s2_send_tx_status = *tx_info;
+        }
+        tx_time = (uint16_t)(clock_time() - session->transmit_start_time);
+        if (session->current_transmission_type == SINGLECAST) {
+            tx_time += NONCE_REP_TIME;
+        }
     }
     S2_send_frame_done_notify(s2_ctx, status == TRANSMIT_COMPLETE_OK ? S2_TRANSMIT_COMPLETE_OK : S2_TRANSMIT_COMPLETE_NO_ACK, tx_time);
     zwave_s2_transport_unlock();
@@ -324,18 +569,22 @@ void S2_send_done_event(struct S2 *ctxt, s2_tx_status_t status)
 
     zwave_s2_transport_lock();
     S2_stop_timeout(ctxt);
-    cb_save                  = state.s2_send_callback;
-    user_save                = state.s2_send_user;
-    state.s2_send_callback   = NULL;
-    state.s2_send_user       = NULL;
-    tx_status_for_completion = state.s2_send_tx_status;
-
-    // Forget about the parent frame if it triggered the transmission
-    state.valid_parent_session_id = false;
-    memset(&state.s2_send_tx_status, 0, sizeof(state.s2_send_tx_status));
-    if (state.tx_options.transport.is_protocol_frame) {
-        memset(&state.protocol_metadata, 0, sizeof(state.protocol_metadata));
-        state.tx_options.transport.is_protocol_frame = false;
+    s2_transport_session_state_t *session = session_current();
+    if (session != NULL) {
+        cb_save                   = session->s2_send_callback;
+        user_save                 = session->s2_send_user;
+        session->s2_send_callback = NULL;
+        session->s2_send_user     = NULL;
+        session->uses_mpan        = false;
+        tx_status_for_completion  = session->s2_send_tx_status;
+
+        // Forget about the parent frame if it triggered the transmission
+        session->valid_parent_session_id = false;
+        memset(&session->s2_send_tx_status, 0, sizeof(session->s2_send_tx_status));
+        if (session->tx_options.transport.is_protocol_frame) {
+            memset(&session->protocol_metadata, 0, sizeof(session->protocol_metadata));
+            session->tx_options.transport.is_protocol_frame = false;
+        }
     }
     zwave_s2_transport_unlock();
 
@@ -369,10 +618,15 @@ uint8_t S2_send_frame(struct S2 *ctxt, const s2_connection_t *conn, uint8_t *buf
     (void)ctxt;
     zwave_controller_connection_info_t info = {};
     zwave_tx_options_t options              = {};
+    s2_transport_session_state_t *session   = session_current();
+    s2_transport_session_state_t no_session = {};
+    if (session == NULL) {
+        session = &no_session;
+    }
 
-    if (state.tx_options.transport.is_protocol_frame) {
+    if (session->tx_options.transport.is_protocol_frame) {
         // TX options provided to zwave_s2_send_data can be used now at libS2 exit
-        options = state.tx_options;
+        options = session->tx_options;
     }
 
     info.encapsulation  = ZWAVE_CONTROLLER_ENCAPSULATION_NONE;
@@ -385,9 +639,9 @@ uint8_t S2_send_frame(struct S2 *ctxt, const s2_connection_t *conn, uint8_t *buf
     options.discard_timeout_ms  = 0;
 
     // If the call initiated from outside S2, the parent frame options will take precedence.
-    options.transport.valid_parent_session_id = state.valid_parent_session_id;
-    options.transport.parent_session_id       = state.parent_session_id;
-    if (state.valid_parent_session_id == true) {
+    options.transport.valid_parent_session_id = session->valid_parent_session_id;
+    options.transport.parent_session_id       = session->parent_session_id;
+    if (session->valid_parent_session_id == true) {
         options.number_of_responses = 0;
     }
 
@@ -405,7 +659,7 @@ uint8_t S2_send_frame(struct S2 *ctxt, const s2_connection_t *conn, uint8_t *buf
         // To skip the back-off, the TX process requires the frame to
         // be standalone (valid_parent_session_id = false) and to
         // enable the bypass (ignore_incoming_frames_back_off = true).
-        // When an application send is in flight, `state` carries
+        // When an application send is in flight, the session carries
         // valid_parent_session_id = true, so we override it here.
         // Without the override the frame stays blocked and gets
         // dropped when its discard_timeout_ms expires.
@@ -422,12 +676,14 @@ uint8_t S2_send_frame(struct S2 *ctxt, const s2_connection_t *conn, uint8_t *buf
         options.discard_timeout_ms                        = 0;
     }
 
-    void *user = NULL;
-    if (options.transport.is_protocol_frame) {
-        user = (void *)&state.protocol_metadata;
+    // The session is the user pointer, and its protocol metadata for protocol frames.
+    void *user = (session != &no_session) ? session : NULL;
+    session->transmit_start_time = clock_time();
+    if (SL_STATUS_OK != zwave_tx_send_data(&info, len, buf, &options, send_frame_callback, user, 0)) {
+        return 0;
     }
-    state.transmit_start_time = clock_time();
-    return SL_STATUS_OK == zwave_tx_send_data(&info, len, buf, &options, send_frame_callback, user, 0);
+    session->frames_in_flight++;
+    return 1;
 }
 
 uint8_t S2_send_frame_no_cb(struct S2 *ctxt, const s2_connection_t *conn, uint8_t *buf, uint16_t len)
@@ -435,6 +691,9 @@ uint8_t S2_send_frame_no_cb(struct S2 *ctxt, const s2_connection_t *conn, uint8_
     (void)ctxt;
     zwave_controller_connection_info_t info = {};
     zwave_tx_options_t options              = {};
+    // Nonce Reports are sent on behalf of the session with their destination, if any
+    const s2_transport_session_state_t *session = (active_session != NULL) ? active_session : session_find(conn->r_node, false);
+    const bool valid_parent_session_id          = (session != NULL) && session->valid_parent_session_id;
 
     info.encapsulation          = ZWAVE_CONTROLLER_ENCAPSULATION_NONE;
     info.local.node_id          = conn->l_node;
@@ -445,9 +704,9 @@ uint8_t S2_send_frame_no_cb(struct S2 *ctxt, const s2_connection_t *conn, uint8_
     // above an S2 bootstrapping. They take precedence over anything else.
     options.qos_priority = ZWAVE_TX_QOS_RECOMMENDED_TIMING_CRITICAL_PRIORITY + (10 * ZWAVE_TX_RECOMMENDED_QOS_GAP);
 
-    options.transport.valid_parent_session_id = state.valid_parent_session_id;
-    options.transport.parent_session_id       = state.parent_session_id;
-    if (state.valid_parent_session_id == true) {
+    options.transport.valid_parent_session_id = valid_parent_session_id;
+    options.transport.parent_session_id       = valid_parent_session_id ? session->parent_session_id : NULL;
+    if (valid_parent_session_id == true) {
         options.number_of_responses = 0;
     }
 
@@ -465,7 +724,7 @@ uint8_t S2_send_frame_no_cb(struct S2 *ctxt, const s2_connection_t *conn, uint8_
         // To skip the back-off, the TX process requires the frame to
         // be standalone (valid_parent_session_id = false) and to
         // enable the bypass (ignore_incoming_frames_back_off = true).
-        // When an application send is in flight, `state` carries
+        // When an application send is in flight, the session carries
         // valid_parent_session_id = true, so we override it here.
         // Without the override the frame stays blocked and gets
         // dropped when its discard_timeout_ms expires.
@@ -494,13 +753,22 @@ uint8_t S2_send_frame_multi(struct S2 *ctxt, s2_connection_t *conn, uint8_t *buf
     info.remote.node_id      = conn->r_node;
     info.remote.is_multicast = true;
 
+    s2_transport_session_state_t *session = active_session;
+    if (session == NULL) {
+        return 0;
+    }
+
     // Set the Z-Wave TX Options
     options.transport.group_id                = (zwave_multicast_group_id_t)conn->r_node;
-    options.transport.valid_parent_session_id = state.valid_parent_session_id;
-    options.transport.parent_session_id       = state.parent_session_id;
+    options.transport.valid_parent_session_id = session->valid_parent_session_id;
+    options.transport.parent_session_id       = session->parent_session_id;
 
-    state.transmit_start_time = clock_time();
-    return SL_STATUS_OK == zwave_tx_send_data(&info, len, buf, &options, send_frame_callback, 0, 0);
+    session->transmit_start_time = clock_time();
+    if (SL_STATUS_OK != zwave_tx_send_data(&info, len, buf, &options, send_frame_callback, session, 0)) {
+        return 0;
+    }
+    session->frames_in_flight++;
+    return 1;
 }
 
 void S2_notify_nls_state_report(node_t srcNode, uint8_t class_id, bool nls_capability, bool nls_state)
@@ -696,44 +964,47 @@ sl_status_t zwave_s2_send_data(const zwave_controller_connection_info_t *connect
 
     zwave_s2_transport_lock();
 
-    if (s2_application_send_is_blocked(tx_options)) {
+    // Transmissions to other NodeIDs and groups run in their own session.
+    const zwave_node_id_t remote_node_id  = connection->remote.is_multicast ? connection->remote.multicast_group : connection->remote.node_id;
+    s2_transport_session_state_t *session = session_get(remote_node_id, connection->remote.is_multicast);
+    if ((session == NULL) || !session_resume(session) || s2_application_send_is_blocked(session, connection, tx_options)) {
         sl_log_debug(LOG_TAG, "zwave_s2_send_data: application send blocked (S2 busy or session active); returning BUSY");
         zwave_s2_transport_unlock();
         return SL_STATUS_BUSY;
     }
 
-    cb_save   = state.s2_send_callback;
-    user_save = state.s2_send_user;
+    cb_save   = session->s2_send_callback;
+    user_save = session->s2_send_user;
 
     // Call for sending data comes from outside S2, so we use the parent frame functionality
-    state.parent_session_id       = parent_session_id;
-    state.valid_parent_session_id = true;
+    session->parent_session_id       = parent_session_id;
+    session->valid_parent_session_id = true;
 
     // save the frame data
-    state.last_frame_data_length = data_length;
-    memcpy(state.last_frame_data, cmd_data, state.last_frame_data_length);
+    session->last_frame_data_length = data_length;
+    memcpy(session->last_frame_data, cmd_data, session->last_frame_data_length);
 
-    state.s2_send_callback = on_send_complete;
-    state.s2_send_user     = user;
+    session->s2_send_callback = on_send_complete;
+    session->s2_send_user     = user;
 
     // Protocol metadata can be used now libS2 exit
     if (tx_options->transport.is_protocol_frame == true) {
         protocol_metadata_t *protocol_metadata = (protocol_metadata_t *)user;
-        state.protocol_metadata.session_id     = protocol_metadata->session_id;
-        state.protocol_metadata.data_length    = protocol_metadata->data_length;
-        memcpy(state.protocol_metadata.data, protocol_metadata->data, state.protocol_metadata.data_length);
+        session->protocol_metadata.session_id  = protocol_metadata->session_id;
+        session->protocol_metadata.data_length = protocol_metadata->data_length;
+        memcpy(session->protocol_metadata.data, protocol_metadata->data, session->protocol_metadata.data_length);
 
         s2_connection.tx_options |= S2_TXOPTION_VERIFY_DELIVERY;
 
         // TX options metadata can be used now libS2 exit
-        state.tx_options = *tx_options;
+        session->tx_options = *tx_options;
     }
 
     if (connection->remote.is_multicast == false) {
         // Singlecast message.
-        state.current_transmission_type = SINGLECAST;
-        s2_connection.r_node            = connection->remote.node_id;
-        s2_connection.zw_tx_options     = 0;  // Z-Wave TX Queue takes the decision here
+        session->current_transmission_type = SINGLECAST;
+        s2_connection.r_node               = connection->remote.node_id;
+        s2_connection.zw_tx_options        = 0;  // Z-Wave TX Queue takes the decision here
 
         zwave_s2_keyset_t keyset = get_s2_keyset_from_node(connection->remote.node_id);
         if (keyset == UNKNOWN_KEYSET) {
@@ -742,14 +1013,15 @@ sl_status_t zwave_s2_send_data(const zwave_controller_connection_info_t *connect
             // completion callback that will never fire (libS2 never starts a
             // transmission for an UNKNOWN_KEYSET). Fail fast instead so the
             // resolver can fail the rule immediately.
-            state.s2_send_callback = cb_save;
-            state.s2_send_user     = user_save;
-            result                 = SL_STATUS_FAIL;
+            session->s2_send_callback = cb_save;
+            session->s2_send_user     = user_save;
+            result                    = SL_STATUS_FAIL;
             goto done;
         }
 
         // Is it a Singlecast follow-up ?
         if (tx_options->transport.group_id != ZWAVE_TX_INVALID_GROUP) {
+            session->uses_mpan = true;
             s2_connection.tx_options |= S2_TXOPTION_SINGLECAST_FOLLOWUP;
             s2_connection.mgrp_group_id = tx_options->transport.group_id;
             if (tx_options->transport.is_first_follow_up == true) {
@@ -759,47 +1031,48 @@ sl_status_t zwave_s2_send_data(const zwave_controller_connection_info_t *connect
             // Always ask for verify delivery on those follow-up frames.
             s2_connection.tx_options |= S2_TXOPTION_VERIFY_DELIVERY;
 
-            if (S2_send_data_singlecast_follow_up_with_keyset(s2_ctx, &s2_connection, keyset, state.last_frame_data, state.last_frame_data_length)) {
+            if (S2_send_data_singlecast_follow_up_with_keyset(s2_ctx, &s2_connection, keyset, session->last_frame_data, session->last_frame_data_length)) {
                 result = SL_STATUS_OK;
                 goto done;
             } else {
-                state.s2_send_callback = cb_save;
-                state.s2_send_user     = user_save;
-                result                 = SL_STATUS_BUSY;
+                session->s2_send_callback = cb_save;
+                session->s2_send_user     = user_save;
+                result                    = SL_STATUS_BUSY;
                 goto done;
             }
         }
 
         // Else it is a regular singlecast frame
-        if (S2_send_data_singlecast_with_keyset(s2_ctx, &s2_connection, keyset, state.last_frame_data, state.last_frame_data_length)) {
+        if (S2_send_data_singlecast_with_keyset(s2_ctx, &s2_connection, keyset, session->last_frame_data, session->last_frame_data_length)) {
             result = SL_STATUS_OK;
             goto done;
         } else {
-            state.s2_send_callback = cb_save;
-            state.s2_send_user     = user_save;
-            result                 = SL_STATUS_BUSY;
+            session->s2_send_callback = cb_save;
+            session->s2_send_user     = user_save;
+            result                    = SL_STATUS_BUSY;
             goto done;
         }
     } else {
         // Multicast message.
-        s2_connection.r_node            = connection->remote.multicast_group;
-        state.current_transmission_type = MULTICAST;
+        s2_connection.r_node               = connection->remote.multicast_group;
+        session->current_transmission_type = MULTICAST;
+        session->uses_mpan                 = true;
 
         zwave_s2_keyset_t keyset = get_s2_keyset_from_group(connection->remote.multicast_group);
         if (keyset == UNKNOWN_KEYSET) {
-            state.s2_send_callback = cb_save;
-            state.s2_send_user     = user_save;
-            result                 = SL_STATUS_FAIL;
+            session->s2_send_callback = cb_save;
+            session->s2_send_user     = user_save;
+            result                    = SL_STATUS_FAIL;
             goto done;
         }
 
-        if (S2_send_data_multicast_with_keyset(s2_ctx, &s2_connection, keyset, state.last_frame_data, state.last_frame_data_length)) {
+        if (S2_send_data_multicast_with_keyset(s2_ctx, &s2_connection, keyset, session->last_frame_data, session->last_frame_data_length)) {
             result = SL_STATUS_OK;
             goto done;
         } else {
-            state.s2_send_callback = cb_save;
-            state.s2_send_user     = user_save;
-            result                 = SL_STATUS_BUSY;
+            session->s2_send_callback = cb_save;
+            session->s2_send_user     = user_save;
+            result                    = SL_STATUS_BUSY;
             goto done;
         }
     }
@@ -838,6 +1111,14 @@ sl_status_t zwave_s2_on_frame_received(const zwave_controller_connection_info_t
     memcpy(frame_buffer, frame_data, frame_length);
 
     zwave_s2_transport_lock();
+    // The frame goes to the state machine of the session with the sender.
+    // Without a free session, it is handled by the IDLE state machine.
+    s2_transport_session_state_t *session = session_get(s2_connection.r_node, false);
+    if ((session != NULL) && !session_resume(session)) {
+        sl_log_warning(LOG_TAG, "S2 frame from NodeID %d received while S2 is busy. Dropping.", s2_connection.r_node);
+        zwave_s2_transport_unlock();
+        return SL_STATUS_BUSY;
+    }
     // Note that the S2_msg_received_event may be called directly by
     // S2_application_command_handler
     S2_application_command_handler(s2_ctx, &s2_connection, frame_buffer, frame_length);
@@ -859,13 +1140,12 @@ sl_status_t zwave_s2_set_secure_nif(const uint8_t *nif, uint8_t nif_length)
 void zwave_s2_transport_init()
 {
     zwave_s2_transport_lock();
-    state.s2_send_callback        = NULL;
-    state.parent_session_id       = NULL;
-    state.valid_parent_session_id = false;
-    memset(state.last_frame_data, 0, sizeof(state.last_frame_data));
-    state.last_frame_data_length    = 0;
-    state.current_transmission_type = SINGLECAST;
-    state.inclusion_in_progress     = false;
+    for (size_t i = 0; i < S2_TRANSPORT_SESSION_COUNT; i++) {
+        timer_stop(&sessions[i].timer);
+    }
+    memset(sessions, 0, sizeof(sessions));
+    active_session        = NULL;
+    inclusion_in_progress = false;
     zwave_s2_transport_unlock();
 }
 
@@ -891,32 +1171,40 @@ void zwave_s2_on_on_multicast_group_deleted(zwave_multicast_group_id_t group_id)
 
 sl_status_t zwave_s2_abort_send_data(zwave_tx_session_id_t session_id)
 {
-    sl_status_t status                                     = SL_STATUS_NOT_FOUND;
-    on_zwave_tx_send_data_complete_t cb_save               = NULL;
-    void *user_save                                        = NULL;
-    zwapi_tx_report_t tx_status_for_completion             = {};
-    clock_time_t transmit_start_time                       = 0;
-    zwave_s2_current_transmission_type_t transmission_type = SINGLECAST;
+    sl_status_t status                         = SL_STATUS_NOT_FOUND;
+    on_zwave_tx_send_data_complete_t cb_save   = NULL;
+    void *user_save                            = NULL;
+    zwapi_tx_report_t tx_status_for_completion = {};
 
     zwave_s2_transport_lock();
-    if (state.parent_session_id == session_id) {
+    for (size_t i = 0; i < S2_TRANSPORT_SESSION_COUNT; i++) {
+        s2_transport_session_state_t *session = &sessions[i];
+        if (!session->in_use || !session->valid_parent_session_id || (session->parent_session_id != session_id)) {
+            continue;
+        }
+        if (!session_resume(session)) {
+            // Called back from libS2 while another session runs in s2_ctx
+            sl_log_debug(LOG_TAG, "Cannot abort S2 send session for frame id=%p now, S2 is busy", session_id);
+            status = SL_STATUS_BUSY;
+            break;
+        }
         sl_log_debug(LOG_TAG, "Aborting S2 send session for frame id=%p", session_id);
-        state.parent_session_id       = NULL;
-        state.valid_parent_session_id = false;
-        cb_save                       = state.s2_send_callback;
-        user_save                     = state.s2_send_user;
-        state.s2_send_callback        = NULL;
-        state.s2_send_user            = NULL;
-        tx_status_for_completion      = state.s2_send_tx_status;
-        transmit_start_time           = state.transmit_start_time;
-        transmission_type             = state.current_transmission_type;
-        status                        = SL_STATUS_OK;
-
-        uint16_t tx_time = (uint16_t)(clock_time() - transmit_start_time);
-        if (transmission_type == SINGLECAST) {
+        session->parent_session_id       = NULL;
+        session->valid_parent_session_id = false;
+        cb_save                          = session->s2_send_callback;
+        user_save                        = session->s2_send_user;
+        session->s2_send_callback        = NULL;
+        session->s2_send_user            = NULL;
+        session->uses_mpan               = false;
+        tx_status_for_completion         = session->s2_send_tx_status;
+        status                           = SL_STATUS_OK;
+
+        uint16_t tx_time = (uint16_t)(clock_time() - session->transmit_start_time);
+        if (session->current_transmission_type == SINGLECAST) {
             tx_time += NONCE_REP_TIME;
         }
         S2_send_frame_done_notify(s2_ctx, S2_TRANSMIT_COMPLETE_NO_ACK, tx_time);
+        break;
     }
     zwave_s2_transport_unlock();
 
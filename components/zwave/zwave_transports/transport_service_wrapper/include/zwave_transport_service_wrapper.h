@@ -46,7 +46,8 @@ sl_status_t zwave_transport_service_transport_init();
  * @param parent_session_id Parent session id of this session
  * @return sl_status_t
  *   - SL_STATUS_OK             on success
- *   - SL_STATUS_BUSY           if a tranmission is ongoing.
+ *   - SL_STATUS_BUSY           if a transmission to the same NodeID is ongoing,
+ *                              or if all sessions are in use.
  *   - SL_STATUS_WOULD_OVERFLOW if we cannot handle the frame and it should
  *                              just be dropped.
  */
@@ -13,6 +13,7 @@
 #include "transport_service.h"
 
 #include <stdint.h>
+#include <string.h>
 
 #include "zwave_controller_internal.h"
 #include "zwave_controller_callbacks.h"
@@ -29,13 +30,25 @@
 #include "log.h"
 #define LOG_TAG "zwave_transport_service_wrapper"
 
-// Send data stuff
-static bool transport_service_busy                                                       = false;
-static on_zwave_tx_send_data_complete_t intercepted_on_zwave_tx_send_data_complete       = 0;
-static on_lower_layer_send_data_complete_t intercepted_on_lower_layer_send_data_complete = 0;
+// Send data stuff, one per datagram given to Transport service
+typedef struct transport_service_send_session {
+        bool in_use;
+        zwave_node_id_t remote_node_id;
+        on_zwave_tx_send_data_complete_t on_send_complete;
+        zwave_tx_session_id_t parent_session_id;
+} transport_service_send_session_t;
 
-static zwave_tx_session_id_t zwave_tx_parent_session_id = NULL;
-static bool zwave_tx_valid_parent_session_id            = false;
+static transport_service_send_session_t send_sessions[TRANSPORT_SERVICE_TX_SESSION_COUNT] = {};
+
+static transport_service_send_session_t *send_session_find(zwave_node_id_t remote_node_id)
+{
+    for (size_t i = 0; i < TRANSPORT_SERVICE_TX_SESSION_COUNT; i++) {
+        if (send_sessions[i].in_use && (send_sessions[i].remote_node_id == remote_node_id)) {
+            return &send_sessions[i];
+        }
+    }
+    return NULL;
+}
 
 static void upper_layer_command_handler(ts_node_id_t source, ts_node_id_t dest, const uint8_t *frame, uint16_t frame_len)
 {
@@ -51,48 +64,28 @@ static void upper_layer_command_handler(ts_node_id_t source, ts_node_id_t dest,
 static void on_zwave_tx_send_data_complete(uint8_t status, const zwapi_tx_report_t *tx_info, void *user)
 {
     (void)tx_info;
-    (void)user;
-    if (!intercepted_on_lower_layer_send_data_complete) {
-        sl_log_debug(LOG_TAG,
-                     "No callback resistered by transport service for "
-                     "this transmission\n");
-        return;
-    }
-    if (status == TRANSMIT_COMPLETE_OK) {
-        intercepted_on_lower_layer_send_data_complete(0, 0);
-    } else {
-        intercepted_on_lower_layer_send_data_complete(1, 0);
-    }
+    // user is the one given by Transport service to send_data()
+    transport_service_on_send_data_complete((status == TRANSMIT_COMPLETE_OK) ? 0 : 1, user);
 }
 
-static uint8_t send_data(ts_node_id_t source, ts_node_id_t dest, const uint8_t *payload, const uint16_t payload_len, uint8_t no_of_expected_responses, const on_lower_layer_send_data_complete_t cb)
+static uint8_t send_data(ts_node_id_t source, ts_node_id_t dest, const uint8_t *payload, const uint16_t payload_len, uint8_t no_of_expected_responses, void *user)
 {
     zwave_controller_connection_info_t conn = {};
     zwave_tx_options_t options              = {};
-    /* Transport service is asking to send a frame. Save the callback sent
-     * by Transport service here in wrapper at
-     * intercepted_on_lower_layer_send_data_complete
-     * and send new function on_zwave_tx_send_data_complete() as callback to
-     * zwave_tx_send_data(). When on_zwave_tx_send_data_complete() called by
-     * zwave_tx_send_data() wrapper will call
-     * intercepted_on_lower_layer_send_data_complete()
-     */
-    intercepted_on_lower_layer_send_data_complete = cb;
-    conn.local.node_id                            = source;
-    conn.remote.node_id                           = dest;
-    conn.encapsulation                            = ZWAVE_CONTROLLER_ENCAPSULATION_NONE;
+    conn.local.node_id                      = source;
+    conn.remote.node_id                     = dest;
+    conn.encapsulation                      = ZWAVE_CONTROLLER_ENCAPSULATION_NONE;
 
     options.number_of_responses                       = no_of_expected_responses;
-    options.transport.valid_parent_session_id         = zwave_tx_valid_parent_session_id;
-    options.transport.parent_session_id               = zwave_tx_parent_session_id;
     options.transport.ignore_incoming_frames_back_off = true;
 
-    // FIXME: Here the concept of parent session id is quite dangerous
-    // in this context, the thing is that tranport service can
-    // start receiving instead of sending due to the tie breaking rules.
-    if (transport_service_busy) {
+    // Frames to a node we are sending a datagram to go out as part of that
+    // datagram's session. Losing a tie break ends the send session first, so
+    // the frames answering the node's datagram are not held behind it.
+    const transport_service_send_session_t *send_session = send_session_find(dest);
+    if (send_session != NULL) {
         options.transport.valid_parent_session_id = true;
-        options.transport.parent_session_id       = zwave_tx_parent_session_id;
+        options.transport.parent_session_id       = send_session->parent_session_id;
     } else {
         // Frames sent by Transport service as part of the protocol should have more
         // priority than responses to get frames which transport service assembled.
@@ -103,7 +96,7 @@ static uint8_t send_data(ts_node_id_t source, ts_node_id_t dest, const uint8_t *
         options.qos_priority = ZWAVE_TX_QOS_RECOMMENDED_GET_ANSWER_PRIORITY + (ZWAVE_TX_RECOMMENDED_QOS_GAP * 2);
     }
 
-    if (zwave_tx_send_data(&conn, payload_len, payload, &options, on_zwave_tx_send_data_complete, 0, 0) == SL_STATUS_OK) {
+    if (zwave_tx_send_data(&conn, payload_len, payload, &options, on_zwave_tx_send_data_complete, user, 0) == SL_STATUS_OK) {
         return 0;
     }
     return 1;
@@ -111,16 +104,13 @@ static uint8_t send_data(ts_node_id_t source, ts_node_id_t dest, const uint8_t *
 
 static void on_transport_service_send_data_complete(uint8_t status, void *user)
 {
-    (void)user;
-    transport_service_busy = false;
-    if (!intercepted_on_zwave_tx_send_data_complete) {
+    transport_service_send_session_t *send_session = (transport_service_send_session_t *)user;
+    on_zwave_tx_send_data_complete_t on_send_complete = send_session->on_send_complete;
+    send_session->in_use                              = false;
+    if (!on_send_complete) {
         return;
     }
-    if (status == 0) {
-        intercepted_on_zwave_tx_send_data_complete(TRANSMIT_COMPLETE_OK, 0, zwave_tx_parent_session_id);
-    } else {
-        intercepted_on_zwave_tx_send_data_complete(TRANSMIT_COMPLETE_FAIL, 0, zwave_tx_parent_session_id);
-    }
+    on_send_complete((status == 0) ? TRANSMIT_COMPLETE_OK : TRANSMIT_COMPLETE_FAIL, 0, send_session->parent_session_id);
 }
 
 sl_status_t
@@ -153,31 +143,42 @@ sl_status_t
     }
 
     transport_service_send_data_return_code_t ret;
-    if (transport_service_busy) {
-        sl_log_warning(LOG_TAG, "Transport service is busy. Cannot service frame (parent_id=%p)", parent_session_id);
+    transport_service_send_session_t *send_session = NULL;
+    if (send_session_find(conn_info->remote.node_id) == NULL) {
+        for (size_t i = 0; i < TRANSPORT_SERVICE_TX_SESSION_COUNT; i++) {
+            if (!send_sessions[i].in_use) {
+                send_session = &send_sessions[i];
+                break;
+            }
+        }
+    }
+    if (send_session == NULL) {
+        sl_log_warning(LOG_TAG, "Transport service is busy with NodeID %d. Cannot service frame (parent_id=%p)", conn_info->remote.node_id, parent_session_id);
         return SL_STATUS_BUSY;
     }
 
-    /* This is a request for Transport service to send payload
-     * Intercept the callback (intercepted_on_zwave_tx_send_data_complete)
-     * and send on_transport_service_send_data_complete() as new callback to
-     * transport service. When transport service will call
-     * on_transport_service_send_data_complete(), the wrapper will call
-     * intercepted_on_zwave_tx_send_data_complete()
+    /* This is a request for Transport service to send payload. Transport
+     * service calls on_transport_service_send_data_complete() with the send
+     * session, and the wrapper calls on_zwave_tx_send_data_complete() of the
+     * session.
      */
-    intercepted_on_zwave_tx_send_data_complete = on_zwave_tx_send_data_complete;
-    zwave_tx_parent_session_id                 = parent_session_id;
-    zwave_tx_valid_parent_session_id           = true;
+    send_session->in_use            = true;
+    send_session->remote_node_id    = conn_info->remote.node_id;
+    send_session->on_send_complete  = on_zwave_tx_send_data_complete;
+    send_session->parent_session_id = parent_session_id;
 
-    ret = transport_service_send_data(conn_info->local.node_id, conn_info->remote.node_id, cmd_data, data_length, maximum_payload, on_transport_service_send_data_complete);
+    ret = transport_service_send_data(conn_info->local.node_id, conn_info->remote.node_id, cmd_data, data_length, maximum_payload, on_transport_service_send_data_complete, send_session);
 
     if (ret == TRANSPORT_SERVICE_SEND_SUCCESS) {
-        transport_service_busy = true;
         return SL_STATUS_OK;
     }
+    send_session->in_use = false;
     if (ret == TRANSPORT_SERVICE_WILL_OVERFLOW) {
         return SL_STATUS_WOULD_OVERFLOW;
     }
+    if (ret == TRANSPORT_SERVICE_BUSY) {
+        return SL_STATUS_BUSY;
+    }
     return SL_STATUS_FAIL;
 }
 
@@ -235,6 +236,6 @@ sl_status_t zwave_transport_service_transport_init()
       .on_frame_received = zwave_transport_service_on_frame_received,
     };
 
-    transport_service_busy = false;
+    memset(send_sessions, 0, sizeof(send_sessions));
     return zwave_controller_transport_register(&transport);
 }
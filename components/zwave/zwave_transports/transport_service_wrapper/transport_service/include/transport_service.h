@@ -31,6 +31,17 @@ extern "C" {
 
 typedef zwave_node_id_t ts_node_id_t;
 #define COMMAND_CLASS_TRANSPORT_SERVICE_V2 0x55
+
+/// Number of datagrams that can be sent at the same time, each to a different NodeID
+#ifndef TRANSPORT_SERVICE_TX_SESSION_COUNT
+#define TRANSPORT_SERVICE_TX_SESSION_COUNT 16
+#endif
+
+/// Number of datagrams that can be received at the same time, each from a different NodeID
+#ifndef TRANSPORT_SERVICE_RX_SESSION_COUNT
+#define TRANSPORT_SERVICE_RX_SESSION_COUNT 16
+#endif
+
 /**
  * @brief
  * Transport service calls this callback to notify upper layers of
@@ -40,27 +51,24 @@ typedef zwave_node_id_t ts_node_id_t;
  */
 typedef void (*on_transport_service_send_data_complete_t)(uint8_t status, void *user);
 
-/**
- * @brief
- * This callback is sent to lower layers and should be called when the
- * transmission of what Transport service asked is either success or failure
- * @param status 0 for success 1 for failure
- * @param user user data to send back
- */
-typedef void (*on_lower_layer_send_data_complete_t)(uint8_t status, void *user);
-
 /**
  * @brief
  * Lower layer Send Data function which Transport service should use for
  * transmitting broken down smaller fragments
+ *
+ * When the frame is transmitted, or fails, the lower layer calls
+ * \ref transport_service_on_send_data_complete with user.
+ *
  * @param source            Source node id
  * @param dest              Destination node id
  * @param payload           payload.
  * @param payload_len       Length of payload.
  * @param no_of_expected_responses
- * @param on_lower_layer_send_data_complete
+ * @param user              User data to pass back, NULL if Transport service
+ *                          does not need to know when the frame is sent
+ * @returns 0 if the frame was accepted, 1 otherwise
  */
-typedef uint8_t (*send_data_t)(ts_node_id_t source, ts_node_id_t dest, const uint8_t *payload, uint16_t payload_len, uint8_t no_of_expected_responses, const on_lower_layer_send_data_complete_t on_lower_layer_send_data_complete);
+typedef uint8_t (*send_data_t)(ts_node_id_t source, ts_node_id_t dest, const uint8_t *payload, uint16_t payload_len, uint8_t no_of_expected_responses, void *user);
 
 /**
  * @brief
@@ -96,7 +104,8 @@ typedef enum { TRANSPORT_SERVICE_SEND_SUCCESS, TRANSPORT_SERVICE_SEND_FAILURE, T
  * @brief Sending a long frame with Transport service
  *
  * This function will break the data payload and send it with Transport service
- * protocol
+ * protocol. Datagrams to different NodeIDs are sent at the same time, each in
+ * its own session.
  *
  * @param source            Source NodeID
  * @param dest              Destination NodeID
@@ -109,8 +118,20 @@ typedef enum { TRANSPORT_SERVICE_SEND_SUCCESS, TRANSPORT_SERVICE_SEND_FAILURE, T
  *                          upper layers of completion of transmit of whole
  *                          payload
  *                          \ref on_transport_service_send_data_complete_t
+ * @param user              User data passed to on_send_complete
+ *
+ * @returns TRANSPORT_SERVICE_BUSY if a datagram is already being sent to dest,
+ *          or if all \ref TRANSPORT_SERVICE_TX_SESSION_COUNT sessions are in use
+ */
+transport_service_send_data_return_code_t transport_service_send_data(ts_node_id_t source, ts_node_id_t dest, const uint8_t *payload, uint16_t payload_len, uint16_t max_frame_len, const on_transport_service_send_data_complete_t on_send_complete, void *user);
+
+/**
+ * @brief Lower layer callback for a frame sent with \ref send_data_t
+ *
+ * @param status 0 for success 1 for failure
+ * @param user   user data given to \ref send_data_t
  */
-transport_service_send_data_return_code_t transport_service_send_data(ts_node_id_t source, ts_node_id_t dest, const uint8_t *payload, uint16_t payload_len, uint16_t max_frame_len, const on_transport_service_send_data_complete_t c);
+void transport_service_on_send_data_complete(uint8_t status, void *user);
 
 /**
  * @brief Transport service RX function
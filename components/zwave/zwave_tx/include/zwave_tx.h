@@ -44,6 +44,24 @@
 #define ZWAVE_TX_ROUTE_CACHE_BUFFER_SIZE 50
 #endif
 
+#ifndef ZWAVE_TX_SCHEDULER_QUANTUM_MS
+// Airtime, in ms, credited to a destination for each round of the
+// round-robin between destinations with frames of the same QoS priority.
+#define ZWAVE_TX_SCHEDULER_QUANTUM_MS 100
+#endif
+
+#ifndef ZWAVE_TX_SCHEDULER_SICK_FAILURE_COUNT
+// Number of consecutive failed transmissions after which a destination is
+// considered sick, and only gets a fraction of the quantum until a
+// transmission to it succeeds again.
+#define ZWAVE_TX_SCHEDULER_SICK_FAILURE_COUNT 3
+#endif
+
+#ifndef ZWAVE_TX_SCHEDULER_SICK_QUANTUM_DIVISOR
+// Fraction of the quantum granted to sick destinations.
+#define ZWAVE_TX_SCHEDULER_SICK_QUANTUM_DIVISOR 8
+#endif
+
 /**
  * @defgroup zwave_tx Z-Wave TX
  * @ingroup zwave_controller
@@ -53,8 +71,10 @@
  * transmissions, including back-off to wait for responses.
  *
  * The component features a prioritized queue by QoS. Frames with the highest
- * QoS are transmitted first. There is no guarantee over the order of elements
- * with identical QoS.
+ * QoS are transmitted first. Destinations with frames of identical QoS share
+ * the radio with a deficit round-robin weighted by their measured
+ * transmission times, and destinations that keep failing get a smaller share
+ * (see \ref zwave_tx_scheduler).
  * The low-level encapsulation control frames,
  * such as nonce report etc, must be given the highest priority.
  *
@@ -76,6 +96,8 @@
  * interfacing with \ref zwave_transports.
  * - \ref zwave_tx_queue is the data model definition for the Z-Wave TX
  * queue ands its elements.
+ * - \ref zwave_tx_scheduler picks the next frame to transmit among
+ * destinations with frames of identical QoS.
  *
  * The component interactions during frame transmission is depicted in
  * the figure below:
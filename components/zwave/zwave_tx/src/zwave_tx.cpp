@@ -158,9 +158,9 @@ sl_status_t zwave_tx_send_data(const zwave_controller_connection_info_t *connect
     // asynchronous TX-thread cleanup path.  The slot is freed synchronously
     // (via pop), so the retry enqueue below can succeed.
     //
-    // If no unsent frame exists (all 64 slots are in-flight) the queue is
+    // If no unsent frame exists (all slots are in-flight) the queue is
     // genuinely full and the incoming frame is rejected without eviction.
-    if (tx_queue.size() >= ZWAVE_TX_QUEUE_BUFFER_SIZE) {
+    if (tx_queue.size() >= tx_queue.capacity()) {
         zwave_tx_queue_element_t evicted = {};
         if (tx_queue.find_worst_unsent_by_qos(&evicted) == SL_STATUS_OK) {
             sl_log_warning(LOG_TAG,
@@ -18,6 +18,7 @@
 #include "zwave_tx_callbacks.h"
 #include "zwave_tx_route_cache.h"
 #include "zwave_tx_queue.hpp"
+#include "zwave_tx_scheduler.hpp"
 #include "zwave_tx_state_logging.h"
 #include "zwave_tx_incoming_frames.hpp"
 
@@ -88,6 +89,17 @@ namespace
     // replies" wedge.
     std::vector<zwave_tx_session_id_t> preempted_backoff_stack;
 
+    // Picks the next frame among destinations with frames of the same QoS.
+    zwave_tx_scheduler tx_scheduler;
+    // Scratch buffer for the scheduler candidates, kept to reuse its capacity.
+    std::vector<zwave_tx_queue_destination_head_t> scheduler_heads;
+
+    // Destination of a frame for the scheduler, 0 for multicast.
+    zwave_node_id_t scheduler_destination(const zwave_tx_queue_element_t &e)
+    {
+        return e.connection_info.remote.is_multicast ? 0 : e.connection_info.remote.node_id;
+    }
+
     /**
      * @brief Returns true if the Z-Wave frame is an S2 transport-internal
      * frame (S2 NONCE_GET or S2 NONCE_REPORT).
@@ -194,6 +206,7 @@ static void zwave_tx_finalize_element(zwave_tx_session_id_t session_id)
     // We are done (for ever!) with the element, so we delete it from the queue.
     sl_log_debug(LOG_TAG, "Removing id=%p from the queue", session_id);
     tx_queue.pop(session_id);
+    tx_scheduler.on_session_removed(session_id);
 
     // If the element we just popped was on the pre-empted-restore stack
     // (e.g. aborted, dropped, or fast-track failed), remove it so we do
@@ -361,6 +374,25 @@ static bool idle_head_waiting_for_chip_completion(const zwave_tx_queue_element_t
     return (h.transmission_timestamp != 0) && (h.transmission_time == 0);
 }
 
+// Unsent frame without parent that does not bypass back-offs: its place is decided by the scheduler.
+static bool idle_head_is_schedulable(const zwave_tx_queue_element_t &h)
+{
+    return (h.transmission_timestamp == 0) && (!h.options.transport.valid_parent_session_id) && (!h.options.transport.ignore_incoming_frames_back_off);
+}
+
+/**
+ * @brief Asks the scheduler for the next unsent frame to transmit.
+ *
+ * @param element  Copy of the selected frame.
+ * @returns true if a frame was selected, false if no frame is waiting.
+ */
+static bool zwave_tx_process_select_scheduled_element(zwave_tx_queue_element_t *element)
+{
+    tx_queue.collect_unsent_destination_heads(scheduler_heads);
+    zwave_tx_session_id_t session_id = nullptr;
+    return (tx_scheduler.select(scheduler_heads, &session_id) == SL_STATUS_OK) && (tx_queue.get_by_id(element, session_id) == SL_STATUS_OK);
+}
+
 static sl_status_t zwave_tx_process_fetch_next_element_for_ongoing_transmission(zwave_tx_queue_element_t *next_element)
 {
     // Prefer the highest priority child of the current session. This is the
@@ -467,7 +499,7 @@ static void zwave_tx_process_send_next_message_step()
         current_element                    = *tx_queue.first_in_queue();
         zwave_tx_queue_element_t alternate = {};
         if (idle_head_only_waiting_for_replies(current_element)) {
-            if (tx_queue.find_best_unsent_by_qos(&alternate) == SL_STATUS_OK) {
+            if (zwave_tx_process_select_scheduled_element(&alternate)) {
                 sl_log_debug(LOG_TAG, "IDLE: queue head id=%p is waiting for replies; dispatching best unsent id=%p instead.", current_element.zwave_tx_session_id, alternate.zwave_tx_session_id);
                 current_element = alternate;
             }
@@ -476,6 +508,9 @@ static void zwave_tx_process_send_next_message_step()
                 sl_log_debug(LOG_TAG, "IDLE: queue head id=%p is waiting for a transport callback; dispatching back-off-bypass frame id=%p instead.", current_element.zwave_tx_session_id, alternate.zwave_tx_session_id);
                 current_element = alternate;
             }
+        } else if (idle_head_is_schedulable(current_element) && zwave_tx_process_select_scheduled_element(&alternate)) {
+            // Share the radio between the destinations of the head's QoS class.
+            current_element = alternate;
         }
     } else {
         // Other tx queue states should not try to call this function!
@@ -515,6 +550,9 @@ static void zwave_tx_process_send_next_message_step()
     sl_status_t transport_status = zwave_controller_transport_send_data(&(current_element.connection_info), current_element.data_length, current_element.data, &(current_element.options), &on_zwave_transport_send_data_complete, user, current_tx_session_id);
 
     if (transport_status == SL_STATUS_OK) {
+        if (!current_element.options.transport.valid_parent_session_id) {
+            tx_scheduler.on_transmission_started(current_tx_session_id, scheduler_destination(current_element));
+        }
         // Cancel any retry timer armed on a prior SL_STATUS_BUSY defer (preempted
         // safety timer or non-preempted poll). If the frame goes out before the
         // timer fires, leaving it armed would run zwave_tx_resume_from_backoff_step
@@ -625,6 +663,12 @@ static void zwave_tx_message_transmission_completed_step(zwave_tx_session_id_t s
         return;
     }
 
+    // Let the scheduler charge the destination for the time the session took.
+    // Frames dropped before being handed to the transports are not charged.
+    if ((!completed_element.options.transport.valid_parent_session_id) && (completed_element.transmission_timestamp != 0)) {
+        tx_scheduler.on_transmission_completed(session_id, scheduler_destination(completed_element), IS_TRANSMISSION_SUCCESSFUL(completed_element.send_data_status), completed_element.transmission_time);
+    }
+
     // Did the element fail and need to be requeued ? (fasttrack)
     if ((completed_element.send_data_status != TRANSMIT_COMPLETE_OK) && (completed_element.send_data_status != TRANSMIT_COMPLETE_VERIFIED) && (completed_element.options.fasttrack) && (!zwave_tx_process_queue_flush_is_ongoing())) {
         sl_log_debug(LOG_TAG,
@@ -1028,6 +1072,7 @@ namespace zwave_component
     {
         state = ZWAVE_TX_STATE_IDLE;
         tx_queue.clear();
+        tx_scheduler.clear();
         expected_incoming_frames.clear();
         zwave_tx_init();
         zwave_tx_route_cache_init();
@@ -32,11 +32,6 @@
 
 namespace
 {
-    bool parent_session_id_equals(const zwave_tx_queue_element_t &element, const zwave_tx_session_id_t parent_session)
-    {
-        return (element.options.transport.valid_parent_session_id) && (element.options.transport.parent_session_id == parent_session);
-    }
-
     // Hex-dump a byte buffer as "AA BB CC " (uppercase, space-separated).
     // Returns the result by value; each caller gets its own buffer so logging
     // is safe to use from multiple threads.
@@ -51,17 +46,23 @@ namespace
     }
 }  // namespace
 
+zwave_tx_queue::zwave_tx_queue(size_t capacity) : slots(capacity)
+{
+    heap.reserve(capacity);
+    session_index.reserve(capacity);
+    clear();
+}
+
 sl_status_t zwave_tx_queue::enqueue(const zwave_tx_queue_element_t &new_element, zwave_tx_session_id_t *user_session_id)
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    zwave_tx_queue_element_t e = new_element;
 
     // Enforce per-node queue cap for singlecast frames to prevent a single
     // slow or misbehaving node from monopolising all queue slots.
-    if (!e.connection_info.remote.is_multicast) {
-        const zwave_node_id_t node_id = e.connection_info.remote.node_id;
-        const auto it                 = per_node_frame_count_.find(node_id);
-        const int current_count       = (it != per_node_frame_count_.end()) ? it->second : 0;
+    if (!new_element.connection_info.remote.is_multicast) {
+        const zwave_node_id_t node_id = new_element.connection_info.remote.node_id;
+        const auto it                 = node_frames.find(node_id);
+        const int current_count       = (it != node_frames.end()) ? it->second.count : 0;
         if (current_count >= ZWAVE_TX_QUEUE_MAX_FRAMES_PER_NODE) {
             sl_log_warning(LOG_TAG,
                            "Per-node queue limit (%d) reached for NodeID %d. "
@@ -72,6 +73,20 @@ sl_status_t zwave_tx_queue::enqueue(const zwave_tx_queue_element_t &new_element,
         }
     }
 
+    if (free_slots == INVALID_HANDLE) {
+        sl_log_error(LOG_TAG, "Cannot insert a new item since the max capacity of %d is reached!", capacity());
+        return SL_STATUS_FULL;
+    }
+    const handle_t handle = free_slots;
+    slot &s               = slots[handle];
+    free_slots            = s.heap_index_or_next_free;
+    s.in_use              = true;
+    s.sequence            = sequence_counter++;
+    s.element             = new_element;
+    s.destination         = {};
+    s.siblings            = {};
+
+    zwave_tx_queue_element_t &e = s.element;
     // Assign a session ID and provide it back to the user.
     e.zwave_tx_session_id = (zwave_tx_session_id_t)(uintptr_t)this->zwave_tx_session_id_counter++;
     if (user_session_id != nullptr) {
@@ -88,63 +103,101 @@ sl_status_t zwave_tx_queue::enqueue(const zwave_tx_queue_element_t &new_element,
     e.transport_completion_step_pending = false;
     e.queue_timestamp                   = clock_time();
 
-    bool insert_status = queue.insert(std::move(e));
+    session_index[e.zwave_tx_session_id] = handle;
+    slot_list &destination = *destination_list(e);
+    list_push_back(destination, handle, &slot::destination);
+    offer_unsent_head(destination, handle);
+    if (e.options.transport.valid_parent_session_id) {
+        list_push_back(child_frames[e.options.transport.parent_session_id], handle, &slot::siblings);
+    }
+    heap.push_back(handle);
+    heap_sift_up(heap.size() - 1);
 
     // Make a console message about our new frame
     this->simple_log(&e);
 
-    if (!insert_status) {
-        return SL_STATUS_FULL;
-    }
-
-    if (!new_element.connection_info.remote.is_multicast) {
-        per_node_frame_count_[new_element.connection_info.remote.node_id]++;
-    }
     return SL_STATUS_OK;
 }
 
 sl_status_t zwave_tx_queue::pop(const zwave_tx_session_id_t session_id)
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    if (auto *const it = find(session_id); it != queue.end()) {
-        if (!it->connection_info.remote.is_multicast) {
-            const zwave_node_id_t node_id = it->connection_info.remote.node_id;
-            auto count_it                 = per_node_frame_count_.find(node_id);
-            if (count_it != per_node_frame_count_.end()) {
-                if (--(count_it->second) <= 0) {
-                    per_node_frame_count_.erase(count_it);
-                }
-            }
+    auto index_it = session_index.find(session_id);
+    if (index_it == session_index.end()) {
+        return SL_STATUS_NOT_FOUND;
+    }
+    const handle_t handle = index_it->second;
+    session_index.erase(index_it);
+
+    slot &s                           = slots[handle];
+    const zwave_tx_queue_element_t &e = s.element;
+    slot_list &destination            = *destination_list(e);
+    list_remove(destination, handle, &slot::destination);
+    withdraw_unsent_head(destination, handle);
+    if (!e.connection_info.remote.is_multicast && destination.count == 0) {
+        node_frames.erase(e.connection_info.remote.node_id);
+    }
+    if (e.options.transport.valid_parent_session_id) {
+        auto children_it = child_frames.find(e.options.transport.parent_session_id);
+        list_remove(children_it->second, handle, &slot::siblings);
+        if (children_it->second.count == 0) {
+            child_frames.erase(children_it);
         }
-        queue.erase(it);
-        return SL_STATUS_OK;
     }
-    return SL_STATUS_NOT_FOUND;
+
+    // Move the last heap entry into the hole and restore the heap order.
+    const size_t index = s.heap_index_or_next_free;
+    const handle_t moved = heap.back();
+    heap.pop_back();
+    if (moved != handle) {
+        heap_place(index, moved);
+        heap_sift_up(index);
+        heap_sift_down(slots[moved].heap_index_or_next_free);
+    }
+
+    s.in_use                  = false;
+    s.heap_index_or_next_free = free_slots;
+    free_slots                = handle;
+    return SL_STATUS_OK;
 }
 
 zwave_tx_queue_element_t *zwave_tx_queue::first_in_queue()
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    return queue.begin();
+    return heap.empty() ? nullptr : &slots[heap.front()].element;
 }
 
 void zwave_tx_queue::clear()
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    queue.clear();
-    per_node_frame_count_.clear();
+    heap.clear();
+    session_index.clear();
+    node_frames.clear();
+    child_frames.clear();
+    multicast_frames = {};
+    free_slots       = INVALID_HANDLE;
+    for (size_t i = slots.size(); i > 0; i--) {
+        slots[i - 1].in_use                  = false;
+        slots[i - 1].heap_index_or_next_free = free_slots;
+        free_slots                           = static_cast<handle_t>(i - 1);
+    }
 }
 
 bool zwave_tx_queue::empty() const
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    return queue.empty();
+    return heap.empty();
 }
 
 int zwave_tx_queue::size() const noexcept
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    return queue.size();
+    return static_cast<int>(heap.size());
+}
+
+int zwave_tx_queue::capacity() const noexcept
+{
+    return static_cast<int>(slots.size());
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -153,13 +206,13 @@ int zwave_tx_queue::size() const noexcept
 bool zwave_tx_queue::contains(const zwave_tx_session_id_t session_id) const
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    return find(session_id) != queue.end();
+    return find(session_id) != nullptr;
 }
 
 sl_status_t zwave_tx_queue::get_by_id(zwave_tx_queue_element_t *element, const zwave_tx_session_id_t session_id) const
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    if (const auto *it = find(session_id); it != queue.end()) {
+    if (const auto *it = find(session_id); it != nullptr) {
         memcpy(element, &(*it), sizeof(zwave_tx_queue_element_t));
         return SL_STATUS_OK;
     }
@@ -170,22 +223,19 @@ sl_status_t zwave_tx_queue::get_by_id(zwave_tx_queue_element_t *element, const z
 sl_status_t zwave_tx_queue::get_highest_priority_child(zwave_tx_queue_element_t *element, const zwave_tx_session_id_t session_id) const
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    sl_status_t status                    = SL_STATUS_NOT_FOUND;
-    const_queue_iterator highest_priority = queue.end();
-
-    const auto *it = queue.begin();
-    while (it != queue.end()) {
-        if (parent_session_id_equals(*it, session_id) && (highest_priority == queue.end() || queue_element_qos_compare()(*it, *highest_priority))) {
-            highest_priority = it;
-        }
-        ++it;
+    const auto children_it = child_frames.find(session_id);
+    if (children_it == child_frames.end()) {
+        return SL_STATUS_NOT_FOUND;
     }
 
-    if (highest_priority != queue.end()) {
-        memcpy(element, highest_priority, sizeof(zwave_tx_queue_element_t));
-        status = SL_STATUS_OK;
+    handle_t highest_priority = children_it->second.first;
+    for (handle_t child = slots[highest_priority].siblings.next; child != INVALID_HANDLE; child = slots[child].siblings.next) {
+        if (is_higher_priority(child, highest_priority)) {
+            highest_priority = child;
+        }
     }
-    return status;
+    memcpy(element, &slots[highest_priority].element, sizeof(zwave_tx_queue_element_t));
+    return SL_STATUS_OK;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -194,7 +244,7 @@ sl_status_t zwave_tx_queue::get_highest_priority_child(zwave_tx_queue_element_t
 sl_status_t zwave_tx_queue::set_transmissions_results(const zwave_tx_session_id_t session_id, uint8_t status, zwapi_tx_report_t *tx_status)
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    if (auto *it = find(session_id); it != queue.end()) {
+    if (auto *it = find(session_id); it != nullptr) {
         it->send_data_status = status;
         if (nullptr != tx_status) {
             it->send_data_tx_status = *tx_status;
@@ -220,7 +270,7 @@ sl_status_t zwave_tx_queue::set_transmissions_results(const zwave_tx_session_id_
 sl_status_t zwave_tx_queue::decrement_expected_responses(const zwave_tx_session_id_t session_id)
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    if (auto *it = find(session_id); it != queue.end()) {
+    if (auto *it = find(session_id); it != nullptr) {
         if (it->options.number_of_responses > 0) {
             it->options.number_of_responses--;
 
@@ -251,7 +301,7 @@ uint8_t zwave_tx_queue::get_number_of_responses(const zwave_tx_session_id_t sess
 const uint8_t *zwave_tx_queue::get_frame(const zwave_tx_session_id_t session_id)
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    if (auto *it = find(session_id); it != queue.end()) {
+    if (auto *it = find(session_id); it != nullptr) {
         return it->data;
     }
 
@@ -261,7 +311,7 @@ const uint8_t *zwave_tx_queue::get_frame(const zwave_tx_session_id_t session_id)
 uint16_t zwave_tx_queue::get_frame_length(const zwave_tx_session_id_t session_id)
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    if (auto *it = find(session_id); it != queue.end()) {
+    if (auto *it = find(session_id); it != nullptr) {
         return it->data_length;
     }
 
@@ -271,9 +321,11 @@ uint16_t zwave_tx_queue::get_frame_length(const zwave_tx_session_id_t session_id
 sl_status_t zwave_tx_queue::set_transmission_timestamp(const zwave_tx_session_id_t session_id)
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    auto *it = find(session_id);
-    if (it != queue.end()) {
-        it->transmission_timestamp = clock_time();
+    const auto index_it = session_index.find(session_id);
+    if (index_it != session_index.end()) {
+        zwave_tx_queue_element_t &e = slots[index_it->second].element;
+        e.transmission_timestamp    = clock_time();
+        withdraw_unsent_head(*destination_list(e), index_it->second);
         return SL_STATUS_OK;
     }
     return SL_STATUS_NOT_FOUND;
@@ -282,10 +334,12 @@ sl_status_t zwave_tx_queue::set_transmission_timestamp(const zwave_tx_session_id
 sl_status_t zwave_tx_queue::reset_transmission_timestamp(const zwave_tx_session_id_t session_id)
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    auto *it = find(session_id);
-    if (it != queue.end()) {
-        it->transmission_timestamp = 0;
-        it->transmission_time      = 0;
+    const auto index_it = session_index.find(session_id);
+    if (index_it != session_index.end()) {
+        zwave_tx_queue_element_t &e = slots[index_it->second].element;
+        e.transmission_timestamp    = 0;
+        e.transmission_time         = 0;
+        offer_unsent_head(*destination_list(e), index_it->second);
         return SL_STATUS_OK;
     }
     return SL_STATUS_NOT_FOUND;
@@ -294,7 +348,7 @@ sl_status_t zwave_tx_queue::reset_transmission_timestamp(const zwave_tx_session_
 bool zwave_tx_queue::consume_transport_completion_step_pending(const zwave_tx_session_id_t session_id)
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    if (auto *it = find(session_id); it != queue.end()) {
+    if (auto *it = find(session_id); it != nullptr) {
         if (!it->transport_completion_step_pending) {
             return false;
         }
@@ -307,68 +361,35 @@ bool zwave_tx_queue::consume_transport_completion_step_pending(const zwave_tx_se
 bool zwave_tx_queue::transport_completion_step_is_pending(const zwave_tx_session_id_t session_id) const
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    if (const auto *const it = find(session_id); it != queue.end()) {
+    if (const auto *const it = find(session_id); it != nullptr) {
         return it->transport_completion_step_pending;
     }
     return false;
 }
 
-sl_status_t zwave_tx_queue::find_best_unsent_by_qos(zwave_tx_queue_element_t *element) const
-{
-    std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    if (empty() || (element == nullptr)) {
-        return SL_STATUS_NOT_FOUND;
-    }
-    const queue_element_qos_compare better;
-    bool found                    = false;
-    zwave_tx_queue_element_t best = {};
-    for (const auto *it = queue.begin(); it != queue.end(); ++it) {
-        if (it->transmission_timestamp != 0) {
-            continue;
-        }
-        // Skip child frames as they are tied to their parent session and must
-        // only be dispatched through the parent's transmission context via
-        // get_highest_priority_child().
-        if (it->options.transport.valid_parent_session_id) {
-            continue;
-        }
-        if (!found || better(*it, best)) {
-            best  = *it;
-            found = true;
-        }
-    }
-    if (!found) {
-        return SL_STATUS_NOT_FOUND;
-    }
-    *element = best;
-    return SL_STATUS_OK;
-}
-
 sl_status_t zwave_tx_queue::find_best_unsent_backoff_bypass(zwave_tx_queue_element_t *element) const
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
     if (empty() || (element == nullptr)) {
         return SL_STATUS_NOT_FOUND;
     }
-    const queue_element_qos_compare better;
-    bool found                    = false;
-    zwave_tx_queue_element_t best = {};
-    for (const auto *it = queue.begin(); it != queue.end(); ++it) {
+    handle_t best = INVALID_HANDLE;
+    for (handle_t handle: heap) {
+        const zwave_tx_queue_element_t *it = &slots[handle].element;
         if (it->transmission_timestamp != 0) {
             continue;
         }
         if ((!it->options.transport.ignore_incoming_frames_back_off) || (it->options.transport.valid_parent_session_id)) {
             continue;
         }
-        if (!found || better(*it, best)) {
-            best  = *it;
-            found = true;
+        if (best == INVALID_HANDLE || is_higher_priority(handle, best)) {
+            best = handle;
         }
     }
-    if (!found) {
+    if (best == INVALID_HANDLE) {
         return SL_STATUS_NOT_FOUND;
     }
-    *element = best;
+    *element = slots[best].element;
     return SL_STATUS_OK;
 }
 
@@ -378,27 +399,25 @@ sl_status_t zwave_tx_queue::find_worst_unsent_by_qos(zwave_tx_queue_element_t *e
     if (empty() || (element == nullptr)) {
         return SL_STATUS_NOT_FOUND;
     }
-    const queue_element_qos_compare better;
-    bool found                     = false;
-    zwave_tx_queue_element_t worst = {};
-    for (const auto *it = queue.begin(); it != queue.end(); ++it) {
+    handle_t worst = INVALID_HANDLE;
+    for (handle_t handle: heap) {
+        const zwave_tx_queue_element_t *it = &slots[handle].element;
         if (it->transmission_timestamp != 0) {
             continue;
         }
         if (it->options.transport.valid_parent_session_id) {
             continue;
         }
-        // Keep the element with the *lowest* QoS: replace when current worst
-        // has higher priority than *it (i.e. *it is a worse candidate).
-        if (!found || better(worst, *it)) {
-            worst = *it;
-            found = true;
+        // Keep the element with the *lowest* priority: replace when current
+        // worst has higher priority than *it (i.e. *it is a worse candidate).
+        if (worst == INVALID_HANDLE || is_higher_priority(worst, handle)) {
+            worst = handle;
         }
     }
-    if (!found) {
+    if (worst == INVALID_HANDLE) {
         return SL_STATUS_NOT_FOUND;
     }
-    *element = worst;
+    *element = slots[worst].element;
     return SL_STATUS_OK;
 }
 
@@ -406,7 +425,7 @@ sl_status_t zwave_tx_queue::disable_fasttack(const zwave_tx_session_id_t session
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
     auto *it = find(session_id);
-    if (it != queue.end()) {
+    if (it != nullptr) {
         it->options.fasttrack = false;
         return SL_STATUS_OK;
     }
@@ -416,19 +435,17 @@ sl_status_t zwave_tx_queue::disable_fasttack(const zwave_tx_session_id_t session
 bool zwave_tx_queue::zwave_tx_has_frames_for_node(const zwave_node_id_t node_id)
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    for (auto *it = queue.begin(); it != queue.end(); ++it) {
-        // If singlecast, just check the NodeID
-        if ((!it->connection_info.remote.is_multicast) && (it->connection_info.remote.node_id == node_id)) {
+    // If singlecast, just check the NodeID
+    if (node_frames.contains(node_id)) {
+        return true;
+    }
+    // If multicast, check if the NodeID is part of the group
+    for (handle_t handle = multicast_frames.first; handle != INVALID_HANDLE; handle = slots[handle].destination.next) {
+        zwave_nodemask_t nodes = {};
+        zwave_tx_get_nodes(nodes, slots[handle].element.connection_info.remote.multicast_group);
+        if (ZW_IS_NODE_IN_MASK(node_id, nodes)) {
             return true;
         }
-        // If multicast, check if the NodeID is part of the group
-        if (it->connection_info.remote.is_multicast) {
-            zwave_nodemask_t nodes = {};
-            zwave_tx_get_nodes(nodes, it->connection_info.remote.multicast_group);
-            if (ZW_IS_NODE_IN_MASK(node_id, nodes)) {
-                return true;
-            }
-        }
     }
     return false;
 }
@@ -436,44 +453,63 @@ bool zwave_tx_queue::zwave_tx_has_frames_for_node(const zwave_node_id_t node_id)
 void zwave_tx_queue::collect_session_ids_for_node(const zwave_node_id_t node_id, std::vector<zwave_tx_session_id_t> &ids) const
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    for (const auto *it = queue.begin(); it != queue.end(); ++it) {
-        if ((!it->connection_info.remote.is_multicast) && (it->connection_info.remote.node_id == node_id)) {
-            ids.push_back(it->zwave_tx_session_id);
-        }
+    const auto frames_it = node_frames.find(node_id);
+    if (frames_it == node_frames.end()) {
+        return;
+    }
+    for (handle_t handle = frames_it->second.first; handle != INVALID_HANDLE; handle = slots[handle].destination.next) {
+        ids.push_back(slots[handle].element.zwave_tx_session_id);
     }
 }
 
 void zwave_tx_queue::collect_all_session_ids(std::vector<zwave_tx_session_id_t> &ids) const
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    for (const auto *it = queue.begin(); it != queue.end(); ++it) {
+    for (handle_t handle: heap) {
+        const zwave_tx_queue_element_t *it = &slots[handle].element;
         ids.push_back(it->zwave_tx_session_id);
     }
 }
 
+void zwave_tx_queue::collect_unsent_destination_heads(std::vector<zwave_tx_queue_destination_head_t> &heads) const
+{
+    std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
+    heads.clear();
+    std::vector<handle_t> best_handles;
+    best_handles.reserve(node_frames.size() + 1);
+    for (const auto &entry: node_frames) {
+        if (handle_t best = unsent_head(entry.second); best != INVALID_HANDLE) {
+            best_handles.push_back(best);
+        }
+    }
+    if (handle_t best = unsent_head(multicast_frames); best != INVALID_HANDLE) {
+        best_handles.push_back(best);
+    }
+
+    std::sort(best_handles.begin(), best_handles.end(), [this](handle_t lhs, handle_t rhs) { return is_higher_priority(lhs, rhs); });
+    for (handle_t handle: best_handles) {
+        const zwave_tx_queue_element_t &e = slots[handle].element;
+        heads.push_back({e.zwave_tx_session_id, e.connection_info.remote.is_multicast ? (zwave_node_id_t)0 : e.connection_info.remote.node_id, e.options.qos_priority});
+    }
+}
+
 void zwave_tx_queue::collect_descendants(const zwave_tx_session_id_t root, std::vector<zwave_tx_session_id_t> &ids) const
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    if (find(root) == queue.end()) {
+    if (find(root) == nullptr) {
         return;
     }
+    // Breadth-first walk of the child lists. Parents are therefore always
+    // added before their children.
+    size_t next = ids.size();
     ids.push_back(root);
-
-    // Repeatedly sweep the queue, adding any element whose parent is already
-    // collected, until no more descendants are found. Parents are therefore
-    // always added before their children.
-    bool added = true;
-    while (added) {
-        added = false;
-        for (const auto *it = queue.begin(); it != queue.end(); ++it) {
-            const zwave_tx_session_id_t id = it->zwave_tx_session_id;
-            if (std::find(ids.begin(), ids.end(), id) != ids.end()) {
-                continue;
-            }
-            if (it->options.transport.valid_parent_session_id && (std::find(ids.begin(), ids.end(), it->options.transport.parent_session_id) != ids.end())) {
-                ids.push_back(id);
-                added = true;
-            }
+    while (next < ids.size()) {
+        const auto children_it = child_frames.find(ids[next++]);
+        if (children_it == child_frames.end()) {
+            continue;
+        }
+        for (handle_t child = children_it->second.first; child != INVALID_HANDLE; child = slots[child].siblings.next) {
+            ids.push_back(slots[child].element.zwave_tx_session_id);
         }
     }
 }
@@ -482,7 +518,7 @@ zwave_tx_session_id_t zwave_tx_queue::find_root(const zwave_tx_session_id_t sess
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
     const auto *it = find(session_id);
-    if (it == queue.end()) {
+    if (it == nullptr) {
         return session_id;
     }
 
@@ -490,9 +526,9 @@ zwave_tx_session_id_t zwave_tx_queue::find_root(const zwave_tx_session_id_t sess
     // hops is bounded by the queue size so a corrupted parent link can never
     // spin forever.
     zwave_tx_session_id_t root = session_id;
-    for (int hops = 0; (hops < queue.size()) && it->options.transport.valid_parent_session_id; hops++) {
+    for (int hops = 0; (hops < size()) && it->options.transport.valid_parent_session_id; hops++) {
         const auto *parent_it = find(it->options.transport.parent_session_id);
-        if (parent_it == queue.end()) {
+        if (parent_it == nullptr) {
             break;
         }
         root = it->options.transport.parent_session_id;
@@ -508,8 +544,9 @@ zwave_tx_session_id_t zwave_tx_queue::find_root(const zwave_tx_session_id_t sess
 void zwave_tx_queue::log(bool log_messages_payload) const
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    sl_log_debug(LOG_TAG, "Queue size: %lu\n", (unsigned long)queue.size());
-    for (const auto *it = queue.begin(); it != queue.end(); ++it) {
+    sl_log_debug(LOG_TAG, "Queue size: %lu\n", (unsigned long)size());
+    for (handle_t handle: heap) {
+        const zwave_tx_queue_element_t *it = &slots[handle].element;
         sl_log_debug(LOG_TAG, "Entry (id=%p): (address %p)\n", it->zwave_tx_session_id, &(*it));
         sl_log_debug(LOG_TAG, "\tCallback: %p, user pointer: %p \n", it->callback_function, it->user);
         sl_log_debug(LOG_TAG, "\tAddresses: (NodeID:Endpoint) %d:%d -> %d:%d, is_multicast: %d\n", it->connection_info.local.node_id, it->connection_info.local.endpoint_id, it->connection_info.remote.node_id, it->connection_info.remote.endpoint_id, it->connection_info.remote.is_multicast);
@@ -540,36 +577,34 @@ void zwave_tx_queue::log(bool log_messages_payload) const
 void zwave_tx_queue::log_element(const zwave_tx_session_id_t session_id, bool log_frame_payload) const
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    for (const auto *it = queue.begin(); it != queue.end(); ++it) {
-        if (it->zwave_tx_session_id == session_id) {
-            sl_log_debug(LOG_TAG,
-                         "Entry (id=%p): (address %p), Qos: %u, discard timeout: %d ms, responses: %d\
+    if (const auto *it = find(session_id); it != nullptr) {
+        sl_log_debug(LOG_TAG,
+                     "Entry (id=%p): (address %p), Qos: %u, discard timeout: %d ms, responses: %d\
  Addresses: (NodeID:Endpoint) %d:%d -> %d:%d. Multicast = %d\
  Parent frame: %p, parent frame valid: %d Ignore back-off: %d\
  fasttrack: %d, Queue timestamp: %lu, transmission timestamp: %lu, transmission time (ms): %lu\n",
-                         it->zwave_tx_session_id,
-                         &(*it),
-                         it->options.qos_priority,
-                         it->options.discard_timeout_ms,
-                         it->options.number_of_responses,
-                         it->connection_info.local.node_id,
-                         it->connection_info.local.endpoint_id,
-                         it->connection_info.remote.node_id,
-                         it->connection_info.remote.endpoint_id,
-                         it->connection_info.remote.is_multicast,
-                         it->options.transport.parent_session_id,
-                         it->options.transport.valid_parent_session_id,
-                         it->options.transport.ignore_incoming_frames_back_off,
-                         it->options.fasttrack,
-                         it->queue_timestamp,
-                         it->transmission_timestamp,
-                         it->transmission_time);
-            if (log_frame_payload) {
-                const std::string payload = to_hex_string(it->data, it->data_length);
-                sl_log_debug(LOG_TAG, "Frame payload (hex): %s\n", payload.c_str());
-            }
-            return;
+                     it->zwave_tx_session_id,
+                     &(*it),
+                     it->options.qos_priority,
+                     it->options.discard_timeout_ms,
+                     it->options.number_of_responses,
+                     it->connection_info.local.node_id,
+                     it->connection_info.local.endpoint_id,
+                     it->connection_info.remote.node_id,
+                     it->connection_info.remote.endpoint_id,
+                     it->connection_info.remote.is_multicast,
+                     it->options.transport.parent_session_id,
+                     it->options.transport.valid_parent_session_id,
+                     it->options.transport.ignore_incoming_frames_back_off,
+                     it->options.fasttrack,
+                     it->queue_timestamp,
+                     it->transmission_timestamp,
+                     it->transmission_time);
+        if (log_frame_payload) {
+            const std::string payload = to_hex_string(it->data, it->data_length);
+            sl_log_debug(LOG_TAG, "Frame payload (hex): %s\n", payload.c_str());
         }
+        return;
     }
     sl_log_warning(LOG_TAG, "Element (id=%p) is not in the queue\n", session_id);
 }
@@ -593,35 +628,158 @@ void zwave_tx_queue::simple_log(zwave_tx_queue_element_t *e) const
 
     oss << "Encapsulation " << e->connection_info.encapsulation << " - Payload (" << e->data_length << " bytes) [" << to_hex_string(e->data, e->data_length) << "]";
 
-    sl_log_debug(LOG_TAG, "%s - Tx Queue size: %d\n", oss.str().c_str(), queue.size());
+    sl_log_debug(LOG_TAG, "%s - Tx Queue size: %d\n", oss.str().c_str(), size());
 }
 
 void zwave_tx_queue::log_per_node_distribution() const
 {
     std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-    if (per_node_frame_count_.empty()) {
-        sl_log_debug(LOG_TAG, "TX queue node distribution: total=%d (no singlecast frames)\n", queue.size());
+    if (node_frames.empty()) {
+        sl_log_debug(LOG_TAG, "TX queue node distribution: total=%d (no singlecast frames)\n", size());
         return;
     }
     std::ostringstream oss;
-    for (const auto &entry: per_node_frame_count_) {
-        oss << " node=" << entry.first << ":" << entry.second;
+    for (const auto &entry: node_frames) {
+        oss << " node=" << entry.first << ":" << entry.second.count;
+    }
+    sl_log_debug(LOG_TAG, "TX queue node distribution: total=%d limit_per_node=%d%s\n", size(), ZWAVE_TX_QUEUE_MAX_FRAMES_PER_NODE, oss.str().c_str());
+}
+
+zwave_tx_queue_element_t *zwave_tx_queue::find(const zwave_tx_session_id_t key)
+{
+    const auto it = session_index.find(key);
+    return (it != session_index.end()) ? &slots[it->second].element : nullptr;
+}
+
+const zwave_tx_queue_element_t *zwave_tx_queue::find(const zwave_tx_session_id_t key) const
+{
+    const auto it = session_index.find(key);
+    return (it != session_index.end()) ? &slots[it->second].element : nullptr;
+}
+
+bool zwave_tx_queue::is_higher_priority(handle_t lhs, handle_t rhs) const
+{
+    const slot &l = slots[lhs];
+    const slot &r = slots[rhs];
+    if (l.element.options.qos_priority != r.element.options.qos_priority) {
+        return l.element.options.qos_priority > r.element.options.qos_priority;
+    }
+    return l.sequence < r.sequence;
+}
+
+void zwave_tx_queue::heap_place(size_t index, handle_t handle)
+{
+    heap[index]                           = handle;
+    slots[handle].heap_index_or_next_free = static_cast<handle_t>(index);
+}
+
+void zwave_tx_queue::heap_sift_up(size_t index)
+{
+    const handle_t handle = heap[index];
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!is_higher_priority(handle, heap[parent])) {
+            break;
+        }
+        heap_place(index, heap[parent]);
+        index = parent;
+    }
+    heap_place(index, handle);
+}
+
+void zwave_tx_queue::heap_sift_down(size_t index)
+{
+    const handle_t handle = heap[index];
+    while (true) {
+        size_t child = 2 * index + 1;
+        if (child >= heap.size()) {
+            break;
+        }
+        if (child + 1 < heap.size() && is_higher_priority(heap[child + 1], heap[child])) {
+            child++;
+        }
+        if (!is_higher_priority(heap[child], handle)) {
+            break;
+        }
+        heap_place(index, heap[child]);
+        index = child;
     }
-    sl_log_debug(LOG_TAG, "TX queue node distribution: total=%d limit_per_node=%d%s\n", queue.size(), ZWAVE_TX_QUEUE_MAX_FRAMES_PER_NODE, oss.str().c_str());
+    heap_place(index, handle);
 }
 
-zwave_tx_queue::queue_iterator zwave_tx_queue::find(const zwave_tx_session_id_t key)
+void zwave_tx_queue::list_push_back(slot_list &list, handle_t handle, slot_links slot::*links)
 {
-    // TODO: Linear search of elements is rather slow. this can easily be
-    // optimized to a constant complexity without excessive more memory. e.g. by
-    // implementing a lookup inside the priority queue.
-    return std::find_if(queue.begin(), queue.end(), [&key](const zwave_tx_queue_element_t &item) { return item.zwave_tx_session_id == key; });
+    (slots[handle].*links).previous = list.last;
+    (slots[handle].*links).next     = INVALID_HANDLE;
+    if (list.last != INVALID_HANDLE) {
+        (slots[list.last].*links).next = handle;
+    } else {
+        list.first = handle;
+    }
+    list.last = handle;
+    list.count++;
 }
 
-zwave_tx_queue::const_queue_iterator zwave_tx_queue::find(const zwave_tx_session_id_t key) const
+void zwave_tx_queue::list_remove(slot_list &list, handle_t handle, slot_links slot::*links)
 {
-    // TODO: Linear search of elements is rather slow. this can easily be
-    // optimized to a constant complexity without excessive more memory. e.g. by
-    // implementing a lookup inside the priority queue.
-    return std::find_if(queue.begin(), queue.end(), [&key](const zwave_tx_queue_element_t &item) { return item.zwave_tx_session_id == key; });
+    const slot_links &l = slots[handle].*links;
+    if (l.previous != INVALID_HANDLE) {
+        (slots[l.previous].*links).next = l.next;
+    } else {
+        list.first = l.next;
+    }
+    if (l.next != INVALID_HANDLE) {
+        (slots[l.next].*links).previous = l.previous;
+    } else {
+        list.last = l.previous;
+    }
+    list.count--;
+}
+
+zwave_tx_queue::slot_list *zwave_tx_queue::destination_list(const zwave_tx_queue_element_t &element)
+{
+    if (element.connection_info.remote.is_multicast) {
+        return &multicast_frames;
+    }
+    return &node_frames[element.connection_info.remote.node_id];
+}
+
+void zwave_tx_queue::offer_unsent_head(slot_list &list, handle_t handle)
+{
+    const zwave_tx_queue_element_t &e = slots[handle].element;
+    if (list.unsent_head_stale || (e.transmission_timestamp != 0) || e.options.transport.valid_parent_session_id) {
+        return;
+    }
+    if ((list.unsent_head == INVALID_HANDLE) || is_higher_priority(handle, list.unsent_head)) {
+        list.unsent_head = handle;
+    }
+}
+
+void zwave_tx_queue::withdraw_unsent_head(slot_list &list, handle_t handle)
+{
+    if (list.unsent_head == handle) {
+        list.unsent_head       = INVALID_HANDLE;
+        list.unsent_head_stale = true;
+    }
+}
+
+zwave_tx_queue::handle_t zwave_tx_queue::unsent_head(const slot_list &list) const
+{
+    if (!list.unsent_head_stale) {
+        return list.unsent_head;
+    }
+    // Only the destination whose head was sent or removed is walked again.
+    handle_t best = INVALID_HANDLE;
+    for (handle_t handle = list.first; handle != INVALID_HANDLE; handle = slots[handle].destination.next) {
+        const zwave_tx_queue_element_t &e = slots[handle].element;
+        if ((e.transmission_timestamp != 0) || e.options.transport.valid_parent_session_id) {
+            continue;
+        }
+        if ((best == INVALID_HANDLE) || is_higher_priority(handle, best)) {
+            best = handle;
+        }
+    }
+    list.unsent_head       = best;
+    list.unsent_head_stale = false;
+    return best;
 }
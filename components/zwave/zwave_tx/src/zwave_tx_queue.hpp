@@ -23,8 +23,6 @@
 // Common component
 #include "clock_platform.h"
 
-#include "priority_queue.hpp"
-
 #include <mutex>
 #include <unordered_map>
 #include <vector>
@@ -89,12 +87,18 @@ typedef struct zwave_tx_queue_element {
         uint8_t send_data_status;
 } zwave_tx_queue_element_t;
 
-struct queue_element_qos_compare {
-        bool operator()(const zwave_tx_queue_element_t &lhs, const zwave_tx_queue_element_t &rhs) const
-        {
-            return lhs.options.qos_priority > rhs.options.qos_priority;
-        }
-};
+/**
+ * @brief Next unsent frame of a destination, see
+ * zwave_tx_queue::collect_unsent_destination_heads.
+ */
+typedef struct zwave_tx_queue_destination_head {
+        /// Session ID of the frame.
+        zwave_tx_session_id_t session_id;
+        /// Destination NodeID, 0 for multicast frames.
+        zwave_node_id_t destination;
+        /// QoS priority of the frame.
+        uint32_t qos_priority;
+} zwave_tx_queue_destination_head_t;
 
 /** Z-Wave TX Queue class
  *
@@ -108,19 +112,84 @@ struct queue_element_qos_compare {
  *
  * Setters are available for changing elements properties.
  *
+ * Elements are stored in a slab allocated once, and never move while they
+ * are queued. They are referenced by their slot index (handle) from:
+ * - a binary heap ordered by QoS priority, then by queueing order,
+ * - a hash index by session ID,
+ * - intrusive lists of the frames queued per destination NodeID, of the
+ *   multicast frames and of the child frames of each parent session.
+ *
+ * Lookups by session ID, NodeID or parent session therefore do not depend on
+ * the number of queued frames. Each destination list also caches its highest
+ * priority unsent frame, so that the TX scheduler gets the heads of all
+ * destinations without walking their frames.
  */
 class zwave_tx_queue
 {
     private:
+        /// Index of an element in the slab.
+        using handle_t                           = uint32_t;
+        static constexpr handle_t INVALID_HANDLE = UINT32_MAX;
+
+        /// Intrusive doubly-linked list of slots.
+        struct slot_list {
+                handle_t first = INVALID_HANDLE;
+                handle_t last  = INVALID_HANDLE;
+                int count      = 0;
+                /// Highest priority unsent frame without parent session, for
+                /// destination lists. Looked up again only when stale.
+                mutable handle_t unsent_head   = INVALID_HANDLE;
+                mutable bool unsent_head_stale = false;
+        };
+
+        struct slot_links {
+                handle_t previous = INVALID_HANDLE;
+                handle_t next     = INVALID_HANDLE;
+        };
+
+        struct slot {
+                zwave_tx_queue_element_t element;
+                /// Queueing order, breaks QoS priority ties.
+                uint64_t sequence;
+                /// Position in the heap, or the next free slot when not in use.
+                handle_t heap_index_or_next_free;
+                bool in_use = false;
+                /// Links in the destination list (NodeID or multicast).
+                slot_links destination;
+                /// Links in the list of children of the parent session.
+                slot_links siblings;
+        };
+
         // Global variable used to get new session IDs.
         uint32_t zwave_tx_session_id_counter = 0;
+        uint64_t sequence_counter            = 0;
         mutable std::recursive_mutex queue_mutex_;
-        // Tracks the number of queued singlecast frames per remote NodeID.
-        // Only top-level and child singlecast frames are counted; multicast
-        // frames are excluded.  Used to enforce ZWAVE_TX_QUEUE_MAX_FRAMES_PER_NODE.
-        std::unordered_map<zwave_node_id_t, int> per_node_frame_count_;
+
+        std::vector<slot> slots;
+        handle_t free_slots = INVALID_HANDLE;
+        std::vector<handle_t> heap;
+        std::unordered_map<zwave_tx_session_id_t, handle_t> session_index;
+        // Singlecast frames (top-level and children) per remote NodeID. The
+        // list sizes enforce ZWAVE_TX_QUEUE_MAX_FRAMES_PER_NODE.
+        std::unordered_map<zwave_node_id_t, slot_list> node_frames;
+        slot_list multicast_frames;
+        // Child frames per parent session ID. Children stay listed under their
+        // parent session ID even if the parent left the queue first.
+        std::unordered_map<zwave_tx_session_id_t, slot_list> child_frames;
 
     public:
+        /**
+         * @brief Constructor
+         *
+         * @param capacity Maximum number of frames in the queue.
+         */
+        explicit zwave_tx_queue(size_t capacity = ZWAVE_TX_QUEUE_BUFFER_SIZE);
+
+        /**
+         * @returns The maximum number of elements in the Tx Queue
+         */
+        int capacity() const noexcept;
+
         /**
          * @brief Adds a new element into the queue.
          *
@@ -318,23 +387,14 @@ class zwave_tx_queue
         bool transport_completion_step_is_pending(const zwave_tx_session_id_t session_id) const;
 
         /**
-         * @brief Highest-QoS element that has not yet been handed to a transport
-         *        (`transmission_timestamp == 0`).
-         *
-         * Used when the queue head is only waiting for application replies (transmission
-         * already completed) so lower-priority unsent frames must not stall behind it.
+         * @brief Highest-QoS back-off-bypass element that has not yet been
+         *        handed to a transport (`transmission_timestamp == 0`).
          *
          * Child frames (`options.transport.valid_parent_session_id == true`) are
          * excluded: they must only be dispatched through their parent's
          * transmission context (see \ref get_highest_priority_child) so that the
          * parent-child ordering is preserved.
          */
-        sl_status_t find_best_unsent_by_qos(zwave_tx_queue_element_t *element) const;
-
-        /**
-         * @brief Like \ref find_best_unsent_by_qos but restricted to back-off-bypass
-         *        frames
-         */
         sl_status_t find_best_unsent_backoff_bypass(zwave_tx_queue_element_t *element) const;
 
         /**
@@ -346,7 +406,7 @@ class zwave_tx_queue
          * sacrificing the highest-priority head of the queue.
          *
          * Child frames and multicast frames are excluded by the same rules as
-         * \ref find_best_unsent_by_qos.
+         * \ref find_best_unsent_backoff_bypass.
          */
         sl_status_t find_worst_unsent_by_qos(zwave_tx_queue_element_t *element) const;
 
@@ -395,6 +455,18 @@ class zwave_tx_queue
          */
         void collect_all_session_ids(std::vector<zwave_tx_session_id_t> &ids) const;
 
+        /**
+         * @brief Collects the highest priority unsent frame of each destination.
+         *
+         * Only frames without a parent session are considered, child frames
+         * are sent within the transmission of their parent. Multicast frames
+         * share a single destination (0).
+         *
+         * @param heads  Vector that will be filled with one entry per
+         *               destination, ordered by priority then queueing order.
+         */
+        void collect_unsent_destination_heads(std::vector<zwave_tx_queue_destination_head_t> &heads) const;
+
         /**
          * @brief Collects a session and all its transitive encapsulation
          *        descendants (children, grand-children, ...).
@@ -469,13 +541,25 @@ class zwave_tx_queue
         void log_per_node_distribution() const;
 
     private:
-        using queue_iterator       = priority_queue<zwave_tx_queue_element_t, ZWAVE_TX_QUEUE_BUFFER_SIZE, queue_element_qos_compare>::iterator;
-        using const_queue_iterator = priority_queue<zwave_tx_queue_element_t, ZWAVE_TX_QUEUE_BUFFER_SIZE, queue_element_qos_compare>::const_iterator;
-
-        queue_iterator find(const zwave_tx_session_id_t key);
-        const_queue_iterator find(const zwave_tx_session_id_t key) const;
-
-        priority_queue<zwave_tx_queue_element_t, ZWAVE_TX_QUEUE_BUFFER_SIZE, queue_element_qos_compare> queue;
+        zwave_tx_queue_element_t *find(const zwave_tx_session_id_t key);
+        const zwave_tx_queue_element_t *find(const zwave_tx_session_id_t key) const;
+
+        bool is_higher_priority(handle_t lhs, handle_t rhs) const;
+        void heap_place(size_t index, handle_t handle);
+        void heap_sift_up(size_t index);
+        void heap_sift_down(size_t index);
+
+        void list_push_back(slot_list &list, handle_t handle, slot_links slot::*links);
+        void list_remove(slot_list &list, handle_t handle, slot_links slot::*links);
+        slot_list *destination_list(const zwave_tx_queue_element_t &element);
+
+        /// Updates the unsent head of a destination list with a frame that
+        /// was queued or became unsent.
+        void offer_unsent_head(slot_list &list, handle_t handle);
+        /// Marks the unsent head of a destination list stale if it is the
+        /// given frame, which was sent or removed.
+        void withdraw_unsent_head(slot_list &list, handle_t handle);
+        handle_t unsent_head(const slot_list &list) const;
 };
 
 /** @} end of zwave_tx_queue */
@@ -0,0 +1,150 @@
+/******************************************************************************
+ * # License
+ * <b>Copyright 2026 Silicon Laboratories Inc. www.silabs.com</b>
+ ******************************************************************************
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ *****************************************************************************/
+// Includes from this component
+#include "zwave_tx_scheduler.hpp"
+
+// ZPC components
+#include "log.h"
+
+// Standard includes
+#include <algorithm>
+
+#define LOG_TAG "zwave_tx_scheduler"
+
+sl_status_t zwave_tx_scheduler::select(const std::vector<zwave_tx_queue_destination_head_t> &heads, zwave_tx_session_id_t *session_id)
+{
+    if (heads.empty()) {
+        return SL_STATUS_NOT_FOUND;
+    }
+
+    // Heads are ordered by priority, the served class is the one of the first.
+    // Their session is kept in the destination state, tagged with this
+    // selection, so that no container is built on each call.
+    const uint32_t served_priority = heads.front().qos_priority;
+    selection++;
+    for (const auto &head: heads) {
+        if (head.qos_priority != served_priority) {
+            break;
+        }
+        destination_state &state  = destinations[head.destination];
+        state.candidate           = head.session_id;
+        state.candidate_selection = selection;
+    }
+
+    // Destinations without frames in the served class leave the round-robin.
+    // They keep their debt, but not their unused credit.
+    auto it = round_robin.begin();
+    while (it != round_robin.end()) {
+        destination_state &state = destinations[*it];
+        if (state.candidate_selection == selection) {
+            ++it;
+            continue;
+        }
+        state.active             = false;
+        state.deficit            = std::min(state.deficit, 0);
+        it                       = round_robin.erase(it);
+    }
+    // New destinations join at the back, in queueing order.
+    for (const auto &head: heads) {
+        if (head.qos_priority != served_priority) {
+            break;
+        }
+        destination_state &state = destinations[head.destination];
+        if (!state.active) {
+            state.active = true;
+            round_robin.push_back(head.destination);
+        }
+    }
+
+    // The destination at the front is served as long as it has credit left.
+    // Otherwise it gets a quantum and waits for its next turn.
+    while (true) {
+        const zwave_node_id_t destination = round_robin.front();
+        destination_state &state          = destinations[destination];
+        if (state.deficit > 0) {
+            *session_id = state.candidate;
+            return SL_STATUS_OK;
+        }
+        state.deficit += quantum(state);
+        round_robin.pop_front();
+        round_robin.push_back(destination);
+    }
+}
+
+void zwave_tx_scheduler::on_transmission_started(zwave_tx_session_id_t session_id, zwave_node_id_t destination)
+{
+    destination_state &state  = destinations[destination];
+    const clock_time_t charge = std::max<clock_time_t>(state.transmission_time_estimate, 1);
+    if (!charges.emplace(session_id, charge).second) {
+        // Sent again (e.g. fasttrack retry), already charged.
+        return;
+    }
+    state.deficit -= static_cast<int32_t>(charge);
+}
+
+void zwave_tx_scheduler::on_transmission_completed(zwave_tx_session_id_t session_id, zwave_node_id_t destination, bool success, clock_time_t transmission_time)
+{
+    destination_state &state = destinations[destination];
+
+    // Replace the estimate by what the transmission actually took.
+    clock_time_t charged = 0;
+    const auto charge    = charges.find(session_id);
+    if (charge != charges.end()) {
+        charged = charge->second;
+        charges.erase(charge);
+    }
+    state.deficit += static_cast<int32_t>(charged) - static_cast<int32_t>(transmission_time);
+    if (transmission_time > 0) {
+        state.transmission_time_estimate = (3 * state.transmission_time_estimate + transmission_time) / 4;
+    }
+
+    const bool was_sick = is_sick(destination);
+    if (success) {
+        state.consecutive_failures = 0;
+    } else if (state.consecutive_failures < UINT8_MAX) {
+        state.consecutive_failures++;
+    }
+    if (was_sick != is_sick(destination)) {
+        if (was_sick) {
+            sl_log_info(LOG_TAG, "Transmissions to NodeID %d succeed again, restoring its share of the radio.", destination);
+        } else {
+            sl_log_info(LOG_TAG, "%d consecutive transmissions to NodeID %d failed, reducing its share of the radio.", state.consecutive_failures, destination);
+        }
+    }
+}
+
+bool zwave_tx_scheduler::is_sick(zwave_node_id_t destination) const
+{
+    const auto it = destinations.find(destination);
+    return (it != destinations.end()) && (it->second.consecutive_failures >= ZWAVE_TX_SCHEDULER_SICK_FAILURE_COUNT);
+}
+
+void zwave_tx_scheduler::on_session_removed(zwave_tx_session_id_t session_id)
+{
+    charges.erase(session_id);
+}
+
+void zwave_tx_scheduler::clear()
+{
+    destinations.clear();
+    charges.clear();
+    round_robin.clear();
+}
+
+int32_t zwave_tx_scheduler::quantum(const destination_state &state) const
+{
+    if (state.consecutive_failures >= ZWAVE_TX_SCHEDULER_SICK_FAILURE_COUNT) {
+        return std::max(ZWAVE_TX_SCHEDULER_QUANTUM_MS / ZWAVE_TX_SCHEDULER_SICK_QUANTUM_DIVISOR, 1);
+    }
+    return ZWAVE_TX_SCHEDULER_QUANTUM_MS;
+}
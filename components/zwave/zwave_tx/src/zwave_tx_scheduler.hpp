@@ -0,0 +1,134 @@
+/******************************************************************************
+ * # License
+ * <b>Copyright 2026 Silicon Laboratories Inc. www.silabs.com</b>
+ ******************************************************************************
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ *****************************************************************************/
+
+/**
+ * @defgroup zwave_tx_scheduler Z-Wave TX scheduler
+ * @ingroup zwave_tx
+ * @brief Shares the radio between destinations with frames of the same QoS.
+ *
+ * Among the destinations whose next unsent frame has the highest QoS
+ * priority, frames are picked with a deficit round-robin: each destination
+ * is credited a quantum of airtime per round, and charged the time its
+ * transmissions actually took. A destination that needs long transmissions
+ * (routed, waking up, retrying) therefore gets fewer frames out per round
+ * than one that answers quickly, instead of holding the radio in front of
+ * everyone else.
+ *
+ * Destinations with ZWAVE_TX_SCHEDULER_SICK_FAILURE_COUNT consecutive failed
+ * transmissions are sick, and are credited only a fraction of the quantum
+ * until a transmission to them succeeds again.
+ *
+ * @{
+ */
+
+#ifndef ZWAVE_TX_SCHEDULER_HPP
+#define ZWAVE_TX_SCHEDULER_HPP
+
+#include "zwave_tx_queue.hpp"
+#include "clock_platform.h"
+
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+class zwave_tx_scheduler
+{
+    public:
+        /**
+         * @brief Picks the next frame to transmit.
+         *
+         * @param heads       Next unsent frame of each destination, as
+         *                    returned by
+         *                    zwave_tx_queue::collect_unsent_destination_heads.
+         * @param session_id  Set to the session ID of the frame to transmit.
+         * @returns SL_STATUS_OK if a frame was selected,
+         *          SL_STATUS_NOT_FOUND if heads is empty.
+         */
+        sl_status_t select(const std::vector<zwave_tx_queue_destination_head_t> &heads, zwave_tx_session_id_t *session_id);
+
+        /**
+         * @brief Charges a destination for a frame handed to the transports.
+         *
+         * The destination is charged its estimated transmission time, which
+         * is corrected by on_transmission_completed.
+         *
+         * @param session_id   Session ID of the frame.
+         * @param destination  NodeID of the frame, 0 for multicast.
+         */
+        void on_transmission_started(zwave_tx_session_id_t session_id, zwave_node_id_t destination);
+
+        /**
+         * @brief Records the outcome of a transmission to a destination.
+         *
+         * @param session_id         Session ID of the frame.
+         * @param destination        NodeID of the frame, 0 for multicast.
+         * @param success            True if the transmission succeeded.
+         * @param transmission_time  Time the transmission took, in ms.
+         */
+        void on_transmission_completed(zwave_tx_session_id_t session_id, zwave_node_id_t destination, bool success, clock_time_t transmission_time);
+
+        /**
+         * @brief Forgets the charge of a frame removed from the queue.
+         *
+         * A frame can leave the queue without on_transmission_completed,
+         * e.g. a pre-empted session that is finalized. Its estimate stays
+         * charged to the destination.
+         *
+         * @param session_id  Session ID of the frame.
+         */
+        void on_session_removed(zwave_tx_session_id_t session_id);
+
+        /**
+         * @brief Tells if a destination is currently considered sick.
+         *
+         * @param destination  NodeID, 0 for multicast.
+         */
+        bool is_sick(zwave_node_id_t destination) const;
+
+        /**
+         * @brief Forgets everything known about destinations.
+         */
+        void clear();
+
+    private:
+        struct destination_state {
+                /// Airtime left to the destination in the current round, in ms.
+                int32_t deficit = 0;
+                /// Running average of the transmission times, in ms.
+                clock_time_t transmission_time_estimate = ZWAVE_TX_SCHEDULER_QUANTUM_MS / 4;
+                /// Number of failed transmissions since the last success.
+                uint8_t consecutive_failures = 0;
+                /// True while the destination is part of the round-robin.
+                bool active = false;
+                /// Head of the destination in the served class, valid when
+                /// candidate_selection matches the current selection.
+                zwave_tx_session_id_t candidate = nullptr;
+                uint32_t candidate_selection    = 0;
+        };
+
+        int32_t quantum(const destination_state &state) const;
+
+        std::unordered_map<zwave_node_id_t, destination_state> destinations;
+        /// Estimate charged for each frame handed to the transports and not
+        /// completed yet.
+        std::unordered_map<zwave_tx_session_id_t, clock_time_t> charges;
+        /// Destinations with frames in the served priority class, in
+        /// round-robin order. The front is the one being served.
+        std::deque<zwave_node_id_t> round_robin;
+        /// Incremented by each select(), tags the candidates it collected.
+        uint32_t selection = 0;
+};
+
+/** @} end zwave_tx_scheduler */
+
+#endif  // ZWAVE_TX_SCHEDULER_HPP
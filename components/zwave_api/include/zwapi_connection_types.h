@@ -43,6 +43,7 @@ typedef struct zwapi_connection_interface {
         int (*get_buffer)(uint8_t *c, int len);
         void (*put_buffer)(uint8_t *c, int len);
         bool (*is_file_available)();
+        int (*read_available)(uint8_t *c, int len, int timeout_ms);
         void (*drain_buffer)();
 } zwapi_connection_interface_t;
 
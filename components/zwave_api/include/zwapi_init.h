@@ -332,6 +332,17 @@ sl_status_t zwapi_log_to_file_disable();
  */
 bool zwapi_poll(void);
 
+/**
+ * @brief Tells if received data waits to be handled by zwapi_poll()
+ *
+ * Received bytes may already be buffered by the Z-Wave API, in which case
+ * the connection file descriptor does not become readable for them. Check
+ * this before waiting on the file descriptor.
+ *
+ * @returns true if zwapi_poll() should be called before waiting.
+ */
+bool zwapi_has_pending_rx(void);
+
 /**
  * @brief Check if a command is supported by the connected Z-Wave module.
  *
@@ -24,6 +24,7 @@
 #include <limits.h>
 #include <time.h>
 #include <sys/time.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -173,6 +174,29 @@ bool zwapi_ip_is_file_available(void)
     return false;
 }
 
+int zwapi_ip_read_available(uint8_t *c, int len, int timeout_ms)
+{
+    struct pollfd pfd = {.fd = socket_fd, .events = POLLIN, .revents = 0};
+    int ret           = 0;
+    do {
+        ret = poll(&pfd, 1, timeout_ms);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret < 0) {
+        sl_log_warning(LOG_TAG, "IP poll error: %s\n", strerror(errno));
+        return -1;
+    }
+    if (ret == 0) {
+        return 0;
+    }
+    int res = recv(socket_fd, c, len, 0);
+    if (res <= 0) {
+        sl_log_error(LOG_TAG, "IP Read Error: %s | Returned %d", strerror(errno), res);
+        exit(1);
+    }
+    return res;
+}
+
 void zwapi_ip_drain_buffer(void)
 {
     // IP was written with blocking send, so no need to drain buffer
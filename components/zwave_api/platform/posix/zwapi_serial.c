@@ -24,6 +24,7 @@
 #include <limits.h>
 #include <time.h>
 #include <sys/time.h>
+#include <poll.h>
 #include "zwapi_serial.h"
 // #include "clock.h"
 #include "log.h"
@@ -213,6 +214,31 @@ bool zwapi_serial_is_file_available(void)
     return false;
 }
 
+int zwapi_serial_read_available(uint8_t *c, int len, int timeout_ms)
+{
+    struct pollfd pfd = {.fd = serial_fd, .events = POLLIN, .revents = 0};
+    int ret           = 0;
+    do {
+        ret = poll(&pfd, 1, timeout_ms);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret < 0) {
+        sl_log_warning(LOG_TAG, "Serial poll error: %s\n", strerror(errno));
+        return -1;
+    }
+    if (ret == 0) {
+        return 0;
+    }
+    // The port is readable, so read() returns what is buffered (VMIN=1)
+    // without blocking.
+    int res = read(serial_fd, c, len);
+    if (res < 0) {
+        sl_log_warning(LOG_TAG, "Serial read error: %s\n", strerror(errno));
+        return -1;
+    }
+    return res;
+}
+
 void zwapi_serial_drain_buffer(void)
 {
     if (tcdrain(serial_fd)) {
@@ -38,3 +38,15 @@ bool zwapi_is_timestamp_elapsed(const zwapi_timestamp_t *timestamp_1)
     }
     return timestamp_1->tm.tv_sec < now.tv_sec;
 }
+
+int zwapi_timestamp_remaining_ms(const zwapi_timestamp_t *timestamp)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    long long remaining_ns = (long long)(timestamp->tm.tv_sec - now.tv_sec) * 1000000000LL + (timestamp->tm.tv_nsec - now.tv_nsec);
+    if (remaining_ns <= 0) {
+        return 0;
+    }
+    return (int)((remaining_ns + 999999LL) / 1000000LL);
+}
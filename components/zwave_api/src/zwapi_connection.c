@@ -32,10 +32,21 @@
 
 #define LOG_TAG "zwapi_connection"
 
+// Size of the receive ring buffer. Must be a power of 2.
+#define RX_RING_SIZE 1024
+#define RX_RING_MASK (RX_RING_SIZE - 1)
+
 // Our private frame rx buffer. Used to store the last received frame
 static uint8_t rx_buffer[FRAME_LENGTH_MAX];
 static uint8_t rx_buffer_length;
 
+// Bytes read from the connection but not parsed yet. The connection is only
+// read from and parsed by the thread holding the session lock, so head and
+// tail need no further synchronization.
+static uint8_t rx_ring[RX_RING_SIZE];
+static uint32_t rx_ring_head;  // Next position to write
+static uint32_t rx_ring_tail;  // Next position to read
+
 static uint8_t zwapi_connection_state;
 static zwapi_timestamp_t timeOutACK;
 static zwapi_timestamp_t timeOutRX;
@@ -91,6 +102,74 @@ static const char *zwapi_frame_to_string(const uint8_t *buffer, uint16_t buffer_
     return message;
 }
 
+static void rx_ring_reset(void)
+{
+    rx_ring_head = 0;
+    rx_ring_tail = 0;
+}
+
+static uint32_t rx_ring_count(void)
+{
+    return rx_ring_head - rx_ring_tail;
+}
+
+/**
+ * @brief Reads whatever the connection has available into the ring buffer,
+ * waiting up to timeout_ms for data to arrive.
+ *
+ * @returns the number of bytes added to the ring buffer.
+ */
+static int rx_ring_fill(int timeout_ms)
+{
+    uint32_t free_space = RX_RING_SIZE - rx_ring_count();
+    if (free_space == 0) {
+        return 0;
+    }
+    // Read into the contiguous part of the free space only.
+    uint32_t offset = rx_ring_head & RX_RING_MASK;
+    uint32_t chunk  = RX_RING_SIZE - offset;
+    if (chunk > free_space) {
+        chunk = free_space;
+    }
+    int bytes_read = zwapi_connection_interface.read_available(rx_ring + offset, (int)chunk, timeout_ms);
+    if (bytes_read <= 0) {
+        return 0;
+    }
+    rx_ring_head += (uint32_t)bytes_read;
+    return bytes_read;
+}
+
+static uint8_t rx_ring_pop(void)
+{
+    uint8_t c = rx_ring[rx_ring_tail & RX_RING_MASK];
+    rx_ring_tail++;
+    return c;
+}
+
+static void rx_ring_copy(uint8_t *buffer, uint32_t length)
+{
+    for (uint32_t i = 0; i < length; i++) {
+        buffer[i] = rx_ring_pop();
+    }
+}
+
+/**
+ * @brief Makes sure that at least length bytes are in the ring buffer,
+ * waiting until the rx timeout at most.
+ *
+ * @returns true if the bytes are available, false on timeout.
+ */
+static bool rx_ring_wait_for(uint32_t length)
+{
+    while (rx_ring_count() < length) {
+        int remaining_ms = zwapi_timestamp_remaining_ms(&timeOutRX);
+        if (remaining_ms == 0 || rx_ring_fill(remaining_ms) == 0) {
+            return rx_ring_count() >= length;
+        }
+    }
+    return true;
+}
+
 static int zwapi_init_serial_connection(const zwapi_connection_params_t *connection_params)
 {
     int rc = zwapi_serial_init(connection_params->serial_port);
@@ -107,6 +186,7 @@ static int zwapi_init_serial_connection(const zwapi_connection_params_t *connect
     zwapi_connection_interface.get_buffer        = zwapi_serial_get_buffer;
     zwapi_connection_interface.put_buffer        = zwapi_serial_put_buffer;
     zwapi_connection_interface.is_file_available = zwapi_serial_is_file_available;
+    zwapi_connection_interface.read_available    = zwapi_serial_read_available;
     zwapi_connection_interface.drain_buffer      = zwapi_serial_drain_buffer;
 
     return rc;
@@ -129,6 +209,7 @@ static int zwapi_init_ip_connection(const zwapi_connection_params_t *connection_
     zwapi_connection_interface.get_buffer        = zwapi_ip_get_buffer;
     zwapi_connection_interface.put_buffer        = zwapi_ip_put_buffer;
     zwapi_connection_interface.is_file_available = zwapi_ip_is_file_available;
+    zwapi_connection_interface.read_available    = zwapi_ip_read_available;
     zwapi_connection_interface.drain_buffer      = zwapi_ip_drain_buffer;
 
     return rc;
@@ -149,6 +230,7 @@ int zwapi_connection_init(const zwapi_connection_params_t *connection_params)
     rx_buffer_length       = 0;
     zwapi_connection_state = STATE_SOF_HUNT;
     ack_nak_needed         = false;
+    rx_ring_reset();
 
     zwapi_timestamp_get(&timeOutACK, RX_ACK_TIMEOUT_DEFAULT);
     zwapi_timestamp_get(&timeOutRX, RX_BYTE_TIMEOUT_DEFAULT);
@@ -184,6 +266,7 @@ int zwapi_connection_restart()
     rx_buffer_length       = 0;
     zwapi_connection_state = STATE_SOF_HUNT;
     ack_nak_needed         = false;
+    rx_ring_reset();
 
     zwapi_timestamp_get(&timeOutACK, RX_ACK_TIMEOUT_DEFAULT);
     zwapi_timestamp_get(&timeOutRX, RX_BYTE_TIMEOUT_DEFAULT);
@@ -246,29 +329,28 @@ void zwapi_connection_tx(uint8_t cmd,        /* IN Command */
 }
 
 zwapi_connection_status_t zwapi_connection_refresh()
+{
+    return zwapi_connection_refresh_with_timeout(0);
+}
+
+zwapi_connection_status_t zwapi_connection_refresh_with_timeout(int timeout_ms)
 {
     uint8_t c                        = 0;
     bool rx_is_active                = false;
     zwapi_connection_status_t retVal = ZWAPI_CONNECTION_STATUS_IDLE;
 
-    while (zwapi_connection_interface.is_file_available() && retVal == ZWAPI_CONNECTION_STATUS_IDLE) {
-        if (zwapi_connection_interface.get_byte(&c) == 0) {
-            if (zwapi_connection_state == STATE_PARSE_FRAME) {
-                // If no more data is available and we are expecting
-                // to parse a frame, we mistakenly interpreted a SOF from
-                // another byte.
-                sl_log_warning(LOG_TAG, "Frame parsing went wrong. Aborting\n");
-                zwapi_connection_state = STATE_SOF_HUNT;
-                rx_is_active           = false;
-            }
-            // Check ACK timeout even when no byte is available, so upper layers
-            // receive TX_TIMEOUT for retry/reopen logic instead of IDLE.
-            if (ack_nak_needed && zwapi_is_timestamp_elapsed(&timeOutACK)) {
-                ack_nak_needed = false;
-                retVal         = ZWAPI_CONNECTION_STATUS_TX_TIMEOUT;
-            }
-            break;
-        }
+    // Block until some data arrives, instead of having callers spin on us.
+    // Wake up no later than the ACK deadline, so that it is reported on time.
+    if (ack_nak_needed) {
+        int ack_remaining_ms = zwapi_timestamp_remaining_ms(&timeOutACK);
+        timeout_ms           = (ack_remaining_ms < timeout_ms) ? ack_remaining_ms : timeout_ms;
+    }
+    if (rx_ring_count() == 0 && timeout_ms > 0) {
+        rx_ring_fill(timeout_ms);
+    }
+
+    while (retVal == ZWAPI_CONNECTION_STATUS_IDLE && (rx_ring_count() > 0 || rx_ring_fill(0) > 0)) {
+        c = rx_ring_pop();
 
         switch (zwapi_connection_state) {
             case STATE_SOF_HUNT:
@@ -304,21 +386,20 @@ zwapi_connection_status_t zwapi_connection_refresh()
                 // Copy the data in our rx buffer, starting an appended length byte
                 rx_buffer[0]     = c;
                 rx_buffer_length = c + 1;  // The initial length byte does not include the checksum field.
-                int bytes_read   = zwapi_connection_interface.get_buffer(rx_buffer + 1, rx_buffer_length - 1);
-                if (bytes_read < rx_buffer_length - 1) {
+                if (!rx_ring_wait_for(rx_buffer_length - 1)) {
+                    sl_log_warning(LOG_TAG, "Serial read timeout after %u/%d bytes\n", rx_ring_count(), rx_buffer_length - 1);
                     zwapi_connection_state = STATE_SOF_HUNT;
                     rx_is_active           = false;
                     break;
                 }
+                rx_ring_copy(rx_buffer + 1, rx_buffer_length - 1);
                 uint8_t sof = SOF;
                 zwapi_log_rx_start(&sof, 1);
                 zwapi_log_rx_continue(rx_buffer, rx_buffer_length);
 
                 uint8_t rx_checksum = 0xFF;
-                // printf("Buffer content: ");
                 for (uint8_t i = 0; i < rx_buffer_length; i++) {
                     rx_checksum ^= rx_buffer[i];
-                    // printf("%d ",rx_buffer[i]);
                 }
 
                 if (rx_checksum == 0) {
@@ -362,9 +443,21 @@ zwapi_connection_status_t zwapi_connection_refresh()
             }
         }
     }
+
+    // Check ACK timeout even when no byte is available, so upper layers
+    // receive TX_TIMEOUT for retry/reopen logic instead of IDLE.
+    if ((retVal == ZWAPI_CONNECTION_STATUS_IDLE) && ack_nak_needed && zwapi_is_timestamp_elapsed(&timeOutACK)) {
+        ack_nak_needed = false;
+        retVal         = ZWAPI_CONNECTION_STATUS_TX_TIMEOUT;
+    }
     return retVal;
 }
 
+bool zwapi_connection_has_pending_rx(void)
+{
+    return rx_ring_count() > 0;
+}
+
 int zwapi_connection_get_last_rx_frame(uint8_t *user_buffer, int user_buffer_length)
 {
     if (rx_buffer_length <= user_buffer_length) {
@@ -101,6 +101,29 @@ void zwapi_connection_tx(uint8_t cmd, uint8_t type, const uint8_t *Buf, uint8_t
  */
 zwapi_connection_status_t zwapi_connection_refresh();
 
+/**
+ * @brief Same as zwapi_connection_refresh(), but blocks until data arrives
+ * from the Z-Wave module if nothing has been received yet.
+ *
+ * While an ACK is expected, the wait ends at the ACK deadline at the latest,
+ * and ZWAPI_CONNECTION_STATUS_TX_TIMEOUT is returned if it passed.
+ *
+ * @param timeout_ms Maximum time to wait for data, 0 to return immediately.
+ * @returns The current connection state. Refer to zwapi_connection_status_t values
+ */
+zwapi_connection_status_t zwapi_connection_refresh_with_timeout(int timeout_ms);
+
+/**
+ * @brief Tells if bytes read from the Z-Wave module are waiting to be parsed.
+ *
+ * zwapi_connection_refresh_with_timeout() reads as much as is available, so
+ * bytes following a frame stay buffered and no longer make the connection
+ * file descriptor readable.
+ *
+ * @returns true if zwapi_connection_refresh() has data to parse.
+ */
+bool zwapi_connection_has_pending_rx(void);
+
 /**
  * @brief Provides the data of the serial buffer for the last received frame.
  * @param user_buffer a pointer to the user buffer in which the frame is to be copied
@@ -150,6 +150,11 @@ bool zwapi_poll()
     return more_frames;
 }
 
+bool zwapi_has_pending_rx(void)
+{
+    return zwapi_session_has_pending_rx();
+}
+
 sl_status_t zwapi_refresh_protocol_version(void)
 {
     uint8_t response_length                   = 0;
@@ -102,6 +102,18 @@ void zwapi_ip_put_buffer(uint8_t *c, int len);
  */
 bool zwapi_ip_is_file_available(void);
 
+/**
+ * @brief Waits until data is available on the IP socket and reads as much
+ * of it as fits in the buffer, with a single read call.
+ *
+ * @param c buffer to store the data to.
+ * @param len length of buffer.
+ * @param timeout_ms maximum time to wait for data, 0 to return immediately.
+ * @returns The length of the data copied in the buffer, 0 if no data arrived
+ * before the timeout, -1 on error.
+ */
+int zwapi_ip_read_available(uint8_t *c, int len, int timeout_ms);
+
 /**
  * @brief Flush the serial output if using buffered output.
  *
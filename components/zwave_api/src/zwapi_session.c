@@ -116,7 +116,8 @@ static zwapi_connection_status_t zwapi_session_wait_for_response(void)
     static zwapi_timestamp_t session_timer;
     zwapi_timestamp_get(&session_timer, TIMEOUT_TIME);
     while (1) {
-        connection_status = zwapi_connection_refresh();
+        // Sleep in the connection until data arrives or the session times out.
+        connection_status = zwapi_connection_refresh_with_timeout(zwapi_timestamp_remaining_ms(&session_timer));
         if (connection_status != ZWAPI_CONNECTION_STATUS_IDLE) {
             break;
         }
@@ -165,14 +166,31 @@ bool zwapi_session_dequeue_frame(uint8_t **frame_ptr, uint8_t *frame_len)
     return (zwapi_session_rx_queue) ? true : false;
 }
 
-static void enqueue_rx_frames(void)
+bool zwapi_session_has_pending_rx(void)
 {
-    while (zwapi_connection_refresh() == ZWAPI_CONNECTION_STATUS_FRAME_RECEIVED) {
+    if (pthread_mutex_trylock(&session_serial_mutex) != 0) {
+        return false;
+    }
+    bool pending_rx = zwapi_connection_has_pending_rx() || (zwapi_session_rx_queue != NULL);
+    pthread_mutex_unlock(&session_serial_mutex);
+    return pending_rx;
+}
+
+static void enqueue_rx_frames_with_timeout(int timeout_ms)
+{
+    zwapi_connection_status_t connection_status = zwapi_connection_refresh_with_timeout(timeout_ms);
+    while (connection_status == ZWAPI_CONNECTION_STATUS_FRAME_RECEIVED) {
         // Enqueue available REQ frames.
         zwapi_session_enqueue_frame();
+        connection_status = zwapi_connection_refresh();
     }
 }
 
+static void enqueue_rx_frames(void)
+{
+    enqueue_rx_frames_with_timeout(0);
+}
+
 void zwapi_session_enqueue_rx_frames()
 {
     pthread_mutex_lock(&session_serial_mutex);
@@ -180,6 +198,19 @@ void zwapi_session_enqueue_rx_frames()
     pthread_mutex_unlock(&session_serial_mutex);
 }
 
+/**
+ * Releases session_serial_mutex once done with the serial port. Bytes read
+ * along with the ACK or RES, such as a callback REQ, stay buffered in the
+ * connection where they no longer wake up the RX thread, so ask for a poll.
+ */
+static void unlock_serial_port(void)
+{
+    if (zwapi_connection_has_pending_rx() && zwave_api_get_callbacks()->poll_request) {
+        zwave_api_get_callbacks()->poll_request();
+    }
+    pthread_mutex_unlock(&session_serial_mutex);
+}
+
 // send_frame acquires session_serial_mutex for each individual transmit+ACK
 // exchange and releases it between retries so competing threads may interleave
 // during backoff.
@@ -236,7 +267,7 @@ static sl_status_t send_frame(uint8_t command, const uint8_t *payload_buffer, ui
                     // We should restart the serial port
                     sl_log_warning(LOG_TAG, "Reopening serial port\n");
                     zwapi_connection_restart();
-                    pthread_mutex_unlock(&session_serial_mutex);
+                    unlock_serial_port();
                     return SL_STATUS_FAIL;
                 }
                 break;
@@ -250,7 +281,7 @@ static sl_status_t send_frame(uint8_t command, const uint8_t *payload_buffer, ui
             case ZWAPI_CONNECTION_STATUS_TX_NAK:
                 // The other end is unhappy about our frame.
                 // Parsing went off the rails for them
-                pthread_mutex_unlock(&session_serial_mutex);
+                unlock_serial_port();
                 return SL_STATUS_FAIL;
 
             default:
@@ -270,7 +301,7 @@ static sl_status_t send_frame(uint8_t command, const uint8_t *payload_buffer, ui
             zwapi_timestamp_get(&retry_timer, 20);
             while (!zwapi_is_timestamp_elapsed(&retry_timer)) {
                 pthread_mutex_lock(&session_serial_mutex);
-                enqueue_rx_frames();
+                enqueue_rx_frames_with_timeout(zwapi_timestamp_remaining_ms(&retry_timer));
                 pthread_mutex_unlock(&session_serial_mutex);
             }
         }
@@ -286,7 +317,7 @@ sl_status_t zwapi_session_send_frame(uint8_t command, const uint8_t *payload_buf
     if (status == SL_STATUS_OK) {
         // send_frame returns with the mutex held on success; release it now
         // since this caller does not need to wait for a RES frame.
-        pthread_mutex_unlock(&session_serial_mutex);
+        unlock_serial_port();
     }
     return status;
 }
@@ -346,7 +377,7 @@ sl_status_t zwapi_session_send_frame_with_response(uint8_t command, const uint8_
             sl_log_warning(LOG_TAG, "Unexpected receive state! %s\n", zwapi_connection_status_to_string(connection_status));
         }
     }
-    pthread_mutex_unlock(&session_serial_mutex);
+    unlock_serial_port();
     return result;
 }
 
@@ -357,7 +388,7 @@ sl_status_t zwapi_session_send_frame_no_ack(uint8_t command, const uint8_t *payl
     enqueue_rx_frames();
     // Send our command
     zwapi_connection_tx(command, FRAME_TYPE_REQUEST, payload_buffer, payload_buffer_length, false);
-    pthread_mutex_unlock(&session_serial_mutex);
+    unlock_serial_port();
     return SL_STATUS_OK;
 }
 
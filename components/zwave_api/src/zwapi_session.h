@@ -123,6 +123,18 @@ sl_status_t zwapi_session_send_frame_no_ack(uint8_t command, const uint8_t *payl
  */
 void zwapi_session_enqueue_rx_frames(void);
 
+/**
+ * @brief Tells if received data waits to be handled by zwapi_poll()
+ *
+ * Does not wait for the serial port. While another thread holds it, false
+ * is returned: that thread requests a poll when releasing the port with
+ * data still buffered.
+ *
+ * @returns true if bytes are buffered in the connection or frames are
+ * queued in the zwapi_session receive queue.
+ */
+bool zwapi_session_has_pending_rx(void);
+
 /**
  * @brief Get the next frame from the zwapi_session receive queue
  *
@@ -46,6 +46,16 @@ void zwapi_timestamp_get(zwapi_timestamp_t *timestamp, int period_ms);
  */
 bool zwapi_is_timestamp_elapsed(const zwapi_timestamp_t *timestamp);
 
+/**
+ * @brief get the time left until the timestamp is elapsed
+ *
+ * @param timestamp
+ *
+ * @returns the number of milliseconds (rounded up) until the timestamp is
+ *          elapsed, 0 if it is already elapsed
+ */
+int zwapi_timestamp_remaining_ms(const zwapi_timestamp_t *timestamp);
+
 #ifdef __cplusplus
 }
 #endif
@@ -41,10 +41,12 @@
 // Generic includes
 #include <stdbool.h>
 
+#include <array>
 #include <string>
 #include <functional>
 #include <set>
 #include <memory>
+#include <unordered_map>
 
 #ifdef __cplusplus
 extern "C" {
@@ -137,6 +139,10 @@ class zwave_command_class_manager
         static inline zwave_controller_encapsulation_scheme_t zpc_highest_scheme = ZWAVE_CONTROLLER_ENCAPSULATION_NONE;
         static const zwave_controller_callbacks_t zwave_command_handler_callbacks;
         static inline std::vector<std::unique_ptr<zwave_command_class::zwave_command_class_base>> command_handler_list;
+        /// Handlers of the registered one byte Command Classes, indexed by Command Class ID
+        static inline std::array<zwave_command_class::zwave_command_class_base *, 256> command_handler_table = {};
+        /// Handlers of the registered extended (two bytes) Command Classes
+        static inline std::unordered_map<zwave_command_class_t, zwave_command_class::zwave_command_class_base *> extended_command_handlers;
 };  // class zwave_command_class_handler_manager
 
 #ifdef __cplusplus
@@ -54,6 +54,18 @@ const zwave_controller_callbacks_t zwave_command_class_manager::zwave_command_ha
 ///////////////////////////////////////////////////////////////////////////////
 namespace
 {
+    /// Writes "XX " for each byte of a frame, as many as fit in the buffer.
+    void frame_to_hex_string(const uint8_t *frame_data, uint16_t frame_length, char *buffer, size_t buffer_size)
+    {
+        constexpr char HEX_DIGITS[] = "0123456789ABCDEF";
+        size_t position             = 0;
+        for (uint16_t i = 0; i < frame_length && position + 3 < buffer_size; i++) {
+            buffer[position++] = HEX_DIGITS[frame_data[i] >> 4];
+            buffer[position++] = HEX_DIGITS[frame_data[i] & 0x0F];
+            buffer[position++] = ' ';
+        }
+        buffer[position] = '\0';
+    }
 
     void command_class_list_to_buffer(const std::set<uint16_t> &source_list, const std::set<uint16_t> &additional_controlled_list, std::vector<uint8_t> &destination_buffer)
     {
@@ -195,15 +207,12 @@ void zwave_command_class_manager::zwave_command_handler_on_new_network_entered(z
 
 void zwave_command_class_manager::zwave_command_handler_on_frame_received(const zwave_controller_connection_info_t *connection_info, const zwave_rx_receive_options_t *rx_options, const uint8_t *frame_data, uint16_t frame_length)
 {
-    // Print out the frame dispatch
-    std::stringstream message;
-    message << "Dispatching incoming command (encapsulation " << int(connection_info->encapsulation) << ") from NodeID " << int(connection_info->remote.node_id) << ":" << int(connection_info->remote.endpoint_id) << " - [ ";
-
-    for (uint16_t i = 0; i < frame_length; i++) {
-        message << std::setfill('0') << std::setw(2) << std::hex << std::uppercase << int(frame_data[i]) << " ";
+    // Print out the frame dispatch, only if it is going to be logged
+    if (sl_log_is_enabled(LOG_TAG, SL_LOG_DEBUG)) {
+        char frame_dump[ZWAVE_MAX_FRAME_SIZE * 3 + 1];
+        frame_to_hex_string(frame_data, frame_length, frame_dump, sizeof(frame_dump));
+        sl_log_debug(LOG_TAG, "Dispatching incoming command (encapsulation %d) from NodeID %d:%d - [ %s]", connection_info->encapsulation, connection_info->remote.node_id, connection_info->remote.endpoint_id, frame_dump);
     }
-    message << "]";
-    sl_log_debug(LOG_TAG, "%s", message.str().c_str());
 
     if (frame_length <= COMMAND_INDEX || frame_length >= ZWAVE_MAX_FRAME_SIZE) {
         sl_log_warning(LOG_TAG,
@@ -258,10 +267,13 @@ void zwave_command_class_manager::zwave_command_handler_on_frame_received(const
 ///////////////////////////////////////////////////////////////////////////////
 zwave_command_class::zwave_command_class_base *zwave_command_class_manager::get_command_class_handler(zwave_command_class_t command_class_id)
 {
-    auto cc_handler = std::find_if(command_handler_list.begin(), command_handler_list.end(), [&command_class_id](const auto &handler) { return handler->id() == command_class_id; });
+    if (command_class_id < command_handler_table.size()) {
+        return command_handler_table[command_class_id];
+    }
 
-    if (cc_handler != command_handler_list.end()) {
-        return cc_handler->get();
+    auto cc_handler = extended_command_handlers.find(command_class_id);
+    if (cc_handler != extended_command_handlers.end()) {
+        return cc_handler->second;
     }
 
     return nullptr;
@@ -272,12 +284,23 @@ zwave_command_class::zwave_command_class_base *zwave_command_class_manager::get_
 ///////////////////////////////////////////////////////////////////////////////
 sl_status_t zwave_command_class_manager::dispatch(const zwave_controller_connection_info_t *connection, const uint8_t *frame_data, uint16_t frame_length)
 {
-    sl_status_t rc           = SL_STATUS_NOT_SUPPORTED;
-    uint8_t command_class_id = frame_data[0];
+    sl_status_t rc                         = SL_STATUS_NOT_SUPPORTED;
+    zwave_command_class_t command_class_id = frame_data[COMMAND_CLASS_INDEX];
+    uint16_t command_index                 = COMMAND_INDEX;
+
+    // Extended Command Classes take the first 2 bytes, the command follows
+    if (frame_data[COMMAND_CLASS_INDEX] >= EXTENDED_COMMAND_CLASS_IDENTIFIER_START) {
+        command_index += 1;
+        if (frame_length <= command_index) {
+            sl_log_debug(LOG_TAG, "Frame too short for an extended Command Class, dropping it");
+            return SL_STATUS_NOT_SUPPORTED;
+        }
+        command_class_id = (frame_data[COMMAND_CLASS_INDEX] << 8) | frame_data[COMMAND_CLASS_INDEX + 1];
+    }
 
     // Check if this frame is a multicast get
-    if (connection->local.is_multicast) {
-        if (ZwaveCommandClassType::get_type(frame_data[0], frame_data[1]) == ZwaveCommandClassType::type_t::GET) {
+    if (connection->local.is_multicast && (frame_length > command_index)) {
+        if (ZwaveCommandClassType::get_type(command_class_id, frame_data[command_index]) == ZwaveCommandClassType::type_t::GET) {
             sl_log_debug(LOG_TAG, "Multicast get frame dropped");
             return SL_STATUS_NOT_SUPPORTED;
         }
@@ -285,7 +308,7 @@ sl_status_t zwave_command_class_manager::dispatch(const zwave_controller_connect
 
     auto *command_class_handle = get_command_class_handler(command_class_id);
     if (command_class_handle == nullptr) {
-        sl_log_debug(LOG_TAG, "No handler for Command Class 0x%02X", command_class_id);
+        sl_log_debug(LOG_TAG, "No handler for Command Class 0x%04X", command_class_id);
         return SL_STATUS_NOT_SUPPORTED;
     }
 
@@ -331,6 +354,8 @@ int zwave_command_class_manager::teardown()
 {
     // Stop being notified of incoming frames and network changes
     command_handler_list.clear();
+    command_handler_table.fill(nullptr);
+    extended_command_handlers.clear();
     zwave_controller_deregister_callbacks(&zwave_command_handler_callbacks);
     return 0;
 }
@@ -344,6 +369,11 @@ sl_status_t zwave_command_class_manager::register_command_class(zwave_command_cl
     }
 
     command_handler_list.emplace_back(std::unique_ptr<zwave_command_class::zwave_command_class_base>(new_command_class_handler));
+    if (new_command_class_handler->id() < command_handler_table.size()) {
+        command_handler_table[new_command_class_handler->id()] = new_command_class_handler;
+    } else {
+        extended_command_handlers[new_command_class_handler->id()] = new_command_class_handler;
+    }
 
     // Control-only CCs must report version 0 in Version CC Reports.
     // The base constructor unconditionally populates supported_command_class_versions;
@@ -32,12 +32,16 @@ class ZwaveCommandClassType
         /**
          * @brief Get the type of a Z-Wave frame
          *
-         * @param command_class Command class byte
+         * @param command_class Command class identifier
          * @param command       Command byte
-         * @return type_t
+         * @return type_t, UNKNOWN for extended (2 bytes) Command Classes
          */
         static inline type_t get_type(zwave_command_class_t command_class, zwave_command_t command)
         {
+            // The generated lists only hold one byte Command Classes
+            if (command_class > 0xFF) {
+                return type_t::UNKNOWN;
+            }
             uint16_t key = (command_class << 8) | command;
             if (key == 0x6C01) {
                 return type_t::SUPERVISION;